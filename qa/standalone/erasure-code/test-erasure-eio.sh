@@ -385,6 +385,42 @@ function TEST_ec_object_attr_read_error() {
     delete_erasure_coded_pool $poolname
 }
 
+# A small overwrite updating the parity in place falls back to a full
+# read-modify-write when neither the old chunks nor the whole stripes
+# can be read, instead of asserting on the primary
+function TEST_ec_parity_delta_read_errors() {
+    local dir=$1
+    local objname=myobject
+
+    setup_osds 6 || return 1
+    ceph config set osd osd_ec_parity_delta_write true || return 1
+
+    local poolname=pool-jerasure
+    create_erasure_coded_pool $poolname 4 2 || return 1
+    ceph osd pool set $poolname allow_ec_overwrites true || return 1
+
+    dd if=/dev/urandom of=$dir/ORIGINAL bs=64k count=1 || return 1
+    rados --pool $poolname put $objname $dir/ORIGINAL || return 1
+
+    # the delta read wants shard 1 and the coding shards, and the three
+    # shards left can't decode the stripe either
+    local shard_id
+    for shard_id in 1 4 5 ; do
+        inject_eio ec data $poolname $objname $dir $shard_id || return 1
+    done
+    dd if=/dev/urandom of=$dir/UPDATE bs=4k count=1 || return 1
+    rados --pool $poolname put $objname $dir/UPDATE --offset 4096 || return 1
+
+    local primary=$(get_primary $poolname $objname)
+    CEPH_ARGS='' ceph --admin-daemon $(get_asok_path osd.$primary) log flush || return 1
+    grep -q 'retry_delta_read: .* read failed' $dir/osd.$primary.log || return 1
+    grep -q 'fall_back_to_rmw: .* reading' $dir/osd.$primary.log || return 1
+    ceph tell osd.$primary version || return 1
+
+    rm -f $dir/ORIGINAL $dir/UPDATE
+    delete_erasure_coded_pool $poolname
+}
+
 # Test recovery the first k copies aren't all available
 function TEST_ec_single_recovery_error() {
     local dir=$1
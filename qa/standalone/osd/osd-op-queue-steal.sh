@@ -0,0 +1,91 @@
+#!/usr/bin/env bash
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU Library Public License as published by
+# the Free Software Foundation; either version 2, or (at your option)
+# any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Library Public License for more details.
+#
+
+source $CEPH_ROOT/qa/standalone/ceph-helpers.sh
+
+function run() {
+    local dir=$1
+    shift
+
+    export CEPH_MON="127.0.0.1:7103" # git grep '\<7103\>' : there must be only one
+    export CEPH_ARGS
+    CEPH_ARGS+="--fsid=$(uuidgen) --auth-supported=none "
+    CEPH_ARGS+="--mon-host=$CEPH_MON "
+    CEPH_ARGS+="--osd-op-queue=wpq "
+    CEPH_ARGS+="--osd-op-num-shards=4 "
+    CEPH_ARGS+="--osd-op-num-threads-per-shard=1 "
+
+    local funcs=${@:-$(set | sed -n -e 's/^\(TEST_[0-9a-z_]*\) .*/\1/p')}
+    for func in $funcs ; do
+        setup $dir || return 1
+        $func $dir || return 1
+        teardown $dir || return 1
+    done
+}
+
+function get_stolen() {
+    CEPH_ARGS='' ceph --admin-daemon $(get_asok_path osd.0) perf dump | \
+        jq '.osd.op_wq_steal'
+}
+
+# run many ops of a single pg, hence queued on a single shard, and
+# check that what they read back and the order their writes complete in
+# are those of the model
+function run_hot_pg() {
+    local dir=$1
+
+    create_pool test 1 1 || return 1
+    ceph osd pool set test size 1 --yes-i-really-mean-it || return 1
+    wait_for_clean || return 1
+
+    ceph_test_rados --pool test --max-ops 4000 --objects 8 \
+        --max-in-flight 64 --size 65536 \
+        --min-stride-size 1024 --max-stride-size 4096 \
+        --op read 100 --op write 100 --op append 50 --op delete 10 \
+        > $dir/test_rados.log 2>&1 || return 1
+}
+
+function TEST_steal() {
+    local dir=$1
+
+    run_mon $dir a --osd_pool_default_size=1 --mon_allow_pool_size_one=true || return 1
+    run_mgr $dir x || return 1
+    run_osd $dir 0 \
+        --osd-op-queue-steal=true \
+        --osd-op-queue-steal-min-depth=1 || return 1
+
+    run_hot_pg $dir || return 1
+
+    # the idle shards' threads took over some of the busy shard's items
+    local stolen=$(get_stolen)
+    echo "stolen $stolen"
+    test "$stolen" -gt 0 || return 1
+}
+
+function TEST_no_steal() {
+    local dir=$1
+
+    run_mon $dir a --osd_pool_default_size=1 --mon_allow_pool_size_one=true || return 1
+    run_mgr $dir x || return 1
+    run_osd $dir 0 --osd-op-queue-steal=false || return 1
+
+    run_hot_pg $dir || return 1
+
+    test "$(get_stolen)" -eq 0 || return 1
+}
+
+main osd-op-queue-steal "$@"
+
+# Local Variables:
+# compile-command: "cd ../../../build ; make -j4 && ../qa/run-standalone.sh osd-op-queue-steal.sh"
+# End:
@@ -18,6 +18,7 @@ for f in \
     api_aio api_aio_pp \
     api_io api_io_pp \
     api_asio api_list \
+    api_batch_pp \
     api_lock api_lock_pp \
     api_misc api_misc_pp \
     api_tier_pp \
@@ -23,6 +23,8 @@ int ceph_arch_intel_ssse3 = 0;
 int ceph_arch_intel_sse3 = 0;
 int ceph_arch_intel_sse2 = 0;
 int ceph_arch_intel_aesni = 0;
+int ceph_arch_intel_avx2 = 0;
+int ceph_arch_intel_avx512bw = 0;
 
 #ifdef __x86_64__
 #include <cpuid.h>
@@ -36,6 +38,23 @@ int ceph_arch_intel_aesni = 0;
 #define CPUID_SSE3	(1)
 #define CPUID_SSE2	(1 << 26)
 #define CPUID_AESNI (1 << 25)
+#define CPUID_OSXSAVE	(1 << 27)
+
+/* leaf 7, subleaf 0, ebx */
+#define CPUID_AVX2	(1 << 5)
+#define CPUID_AVX512F	(1 << 16)
+#define CPUID_AVX512BW	(1 << 30)
+
+/* XCR0: the OS saves the xmm/ymm and the opmask/zmm registers */
+#define XCR0_AVX	0x06
+#define XCR0_AVX512	0xe0
+
+static unsigned long long xgetbv0(void)
+{
+	unsigned int eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((unsigned long long)edx << 32) | eax;
+}
 
 int ceph_arch_intel_probe(void)
 {
@@ -65,6 +84,20 @@ int ceph_arch_intel_probe(void)
   if ((ecx & CPUID_AESNI) != 0) {
           ceph_arch_intel_aesni = 1;
   }
+	if ((ecx & CPUID_OSXSAVE) != 0) {
+		unsigned long long xcr0 = xgetbv0();
+		if ((xcr0 & XCR0_AVX) == XCR0_AVX &&
+		    __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+			if ((ebx & CPUID_AVX2) != 0) {
+				ceph_arch_intel_avx2 = 1;
+			}
+			if ((xcr0 & XCR0_AVX512) == XCR0_AVX512 &&
+			    (ebx & CPUID_AVX512F) != 0 &&
+			    (ebx & CPUID_AVX512BW) != 0) {
+				ceph_arch_intel_avx512bw = 1;
+			}
+		}
+	}
 
 	return 0;
 }
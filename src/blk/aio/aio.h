@@ -103,6 +103,13 @@ struct io_queue_t {
   virtual int submit_batch(aio_iter begin, aio_iter end, uint16_t aios_size,
 			   void *priv, int *retries) = 0;
   virtual int get_next_completed(int timeout_ms, aio_t **paio, int max) = 0;
+
+  // Returns a buffer the queue can do IO on without mapping it per IO
+  // (e.g. an io_uring registered buffer), or nullptr if none is available.
+  virtual ceph::unique_leakable_ptr<ceph::buffer::raw> create_fixed_buffer(
+    size_t len) {
+    return nullptr;
+  }
 };
 
 struct aio_queue_t final : public io_queue_t {
@@ -80,7 +80,12 @@ KernelDevice::KernelDevice(CephContext* cct, aio_callback_t cb, void *cbpriv, ai
   if (use_ioring && ioring_queue_t::supported()) {
     bool use_ioring_hipri = cct->_conf.get_val<bool>("bdev_ioring_hipri");
     bool use_ioring_sqthread_poll = cct->_conf.get_val<bool>("bdev_ioring_sqthread_poll");
-    io_queue = std::make_unique<ioring_queue_t>(iodepth, use_ioring_hipri, use_ioring_sqthread_poll);
+    unsigned fixed_buffers =
+      cct->_conf.get_val<uint64_t>("bdev_ioring_fixed_buffers");
+    size_t fixed_buffer_size =
+      cct->_conf.get_val<Option::size_t>("bdev_ioring_fixed_buffer_size");
+    io_queue = std::make_unique<ioring_queue_t>(iodepth, use_ioring_hipri, use_ioring_sqthread_poll,
+						fixed_buffers, fixed_buffer_size);
   } else {
     static bool once;
     if (use_ioring && !once) {
@@ -1016,7 +1021,21 @@ int KernelDevice::aio_write(
       aio.preadv(off, len);
       ++injecting_crash;
     } else {
-      if (bl.length() <= RW_IO_MAX) {
+      if (auto fixed = io_queue->create_fixed_buffer(len); fixed) {
+	// small write: one copy into a registered buffer is cheaper than
+	// having the kernel pin the user pages for this IO
+	bl.begin().copy(len, fixed->get_data());
+	bl.clear();
+	ioc->pending_aios.push_back(aio_t(ioc, choose_fd(false, write_hint)));
+	++ioc->num_pending;
+	auto& aio = ioc->pending_aios.back();
+	aio.bl.push_back(ceph::buffer::ptr_node::create(std::move(fixed)));
+	aio.bl.prepare_iov(&aio.iov);
+	aio.pwritev(off, len);
+	dout(30) << aio << dendl;
+	dout(5) << __func__ << " 0x" << std::hex << off << "~" << len
+		<< std::dec << " aio " << &aio << " (fixed)" << dendl;
+      } else if (bl.length() <= RW_IO_MAX) {
 	// fast path (non-huge write)
 	ioc->pending_aios.push_back(aio_t(ioc, choose_fd(false, write_hint)));
 	++ioc->num_pending;
@@ -1306,8 +1325,15 @@ int KernelDevice::aio_read(
     ioc->pending_aios.push_back(aio_t(ioc, fd_directs[WRITE_LIFE_NOT_SET]));
     ++ioc->num_pending;
     aio_t& aio = ioc->pending_aios.back();
-    aio.bl.push_back(
-      ceph::buffer::ptr_node::create(create_custom_aligned(len, ioc)));
+    auto raw = io_queue->create_fixed_buffer(len);
+    if (raw) {
+      // registered buffers are a scarce resource, don't let them linger
+      // in the cache
+      ioc->flags |= IOContext::FLAG_DONT_CACHE;
+    } else {
+      raw = create_custom_aligned(len, ioc);
+    }
+    aio.bl.push_back(ceph::buffer::ptr_node::create(std::move(raw)));
     aio.bl.prepare_iov(&aio.iov);
     aio.preadv(off, len);
     dout(30) << aio << dendl;
@@ -7,16 +7,114 @@
 
 #include "liburing.h"
 #include <sys/epoll.h>
+#include <sys/mman.h>
+
+#include "common/ceph_mutex.h"
+#include "include/buffer_raw.h"
+#include "include/intarith.h"
 
 using std::list;
 using std::make_unique;
 
+/*
+ * Buffers registered with the ring via IORING_REGISTER_BUFFERS.  They are
+ * handed out as bufferlist raws and come back to the free list when the
+ * last reference is dropped, which may happen after the ring is gone;
+ * hence the shared ownership.
+ */
+struct ioring_fixed_buffers
+  : public std::enable_shared_from_this<ioring_fixed_buffers> {
+  char *base = nullptr;
+  size_t buffer_size;
+  unsigned count;
+  ceph::mutex lock = ceph::make_mutex("ioring_fixed_buffers::lock");
+  std::vector<unsigned> free_list;
+
+  struct fixed_raw : public ceph::buffer::raw {
+    std::shared_ptr<ioring_fixed_buffers> parent;
+    unsigned index;
+    fixed_raw(std::shared_ptr<ioring_fixed_buffers> p, unsigned i,
+	      unsigned len)
+      : raw(p->base + p->buffer_size * i, len),
+	parent(std::move(p)),
+	index(i) {}
+    ~fixed_raw() override {
+      parent->put(index);
+    }
+  };
+
+  ioring_fixed_buffers(size_t buffer_size, unsigned count)
+    : buffer_size(p2roundup<size_t>(buffer_size, CEPH_PAGE_SIZE)),
+      count(count) {}
+  ~ioring_fixed_buffers() {
+    if (base) {
+      ::munmap(base, buffer_size * count);
+    }
+  }
+
+  int init() {
+    void *p = ::mmap(nullptr, buffer_size * count, PROT_READ | PROT_WRITE,
+		     MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (p == MAP_FAILED) {
+      return -errno;
+    }
+    base = static_cast<char*>(p);
+    free_list.reserve(count);
+    for (unsigned i = count; i > 0; --i) {
+      free_list.push_back(i - 1);
+    }
+    return 0;
+  }
+
+  std::vector<struct iovec> iovecs() const {
+    std::vector<struct iovec> iov(count);
+    for (unsigned i = 0; i < count; ++i) {
+      iov[i].iov_base = base + buffer_size * i;
+      iov[i].iov_len = buffer_size;
+    }
+    return iov;
+  }
+
+  ceph::unique_leakable_ptr<ceph::buffer::raw> get(size_t len) {
+    if (len > buffer_size) {
+      return nullptr;
+    }
+    std::lock_guard l(lock);
+    if (free_list.empty()) {
+      return nullptr;
+    }
+    unsigned i = free_list.back();
+    free_list.pop_back();
+    return ceph::unique_leakable_ptr<ceph::buffer::raw>(
+      new fixed_raw(shared_from_this(), i, len));
+  }
+
+  void put(unsigned i) {
+    std::lock_guard l(lock);
+    free_list.push_back(i);
+  }
+
+  // index of the registered buffer [p, p+len) lies in, or -1
+  int find(const void *p, size_t len) const {
+    const char *c = static_cast<const char*>(p);
+    if (c < base || c + len > base + buffer_size * count) {
+      return -1;
+    }
+    size_t i = (c - base) / buffer_size;
+    if (c + len > base + buffer_size * (i + 1)) {
+      return -1;
+    }
+    return i;
+  }
+};
+
 struct ioring_data {
   struct io_uring io_uring;
   pthread_mutex_t cq_mutex;
   pthread_mutex_t sq_mutex;
   int epoll_fd = -1;
   std::map<int, int> fixed_fds_map;
+  std::shared_ptr<ioring_fixed_buffers> fixed_buffers;
 };
 
 static int ioring_get_cqe(struct ioring_data *d, unsigned int max,
@@ -57,7 +155,22 @@ static void init_sqe(struct ioring_data *d, struct io_uring_sqe *sqe,
 
   ceph_assert(fixed_fd != -1);
 
-  if (io->iocb.aio_lio_opcode == IO_CMD_PWRITEV)
+  int buf_index = -1;
+  if (d->fixed_buffers && io->iov.size() == 1) {
+    buf_index = d->fixed_buffers->find(io->iov[0].iov_base,
+				       io->iov[0].iov_len);
+  }
+
+  if (buf_index >= 0) {
+    if (io->iocb.aio_lio_opcode == IO_CMD_PWRITEV)
+      io_uring_prep_write_fixed(sqe, fixed_fd, io->iov[0].iov_base,
+				io->iov[0].iov_len, io->offset, buf_index);
+    else if (io->iocb.aio_lio_opcode == IO_CMD_PREADV)
+      io_uring_prep_read_fixed(sqe, fixed_fd, io->iov[0].iov_base,
+			       io->iov[0].iov_len, io->offset, buf_index);
+    else
+      ceph_assert(0);
+  } else if (io->iocb.aio_lio_opcode == IO_CMD_PWRITEV)
     io_uring_prep_writev(sqe, fixed_fd, &io->iov[0],
 			 io->iov.size(), io->offset);
   else if (io->iocb.aio_lio_opcode == IO_CMD_PREADV)
@@ -106,11 +219,15 @@ static void build_fixed_fds_map(struct ioring_data *d,
   }
 }
 
-ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_) :
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_,
+			       unsigned fixed_buffers_,
+			       size_t fixed_buffer_size_) :
   d(make_unique<ioring_data>()),
   iodepth(iodepth_),
   hipri(hipri_),
-  sq_thread(sq_thread_)
+  sq_thread(sq_thread_),
+  fixed_buffers(fixed_buffers_),
+  fixed_buffer_size(fixed_buffer_size_)
 {
 }
 
@@ -143,6 +260,21 @@ int ioring_queue_t::init(std::vector<int> &fds)
 
   build_fixed_fds_map(d.get(), fds);
 
+  if (fixed_buffers && fixed_buffer_size) {
+    auto fb = std::make_shared<ioring_fixed_buffers>(fixed_buffer_size,
+						     fixed_buffers);
+    ret = fb->init();
+    if (ret < 0) {
+      goto close_ring_fd;
+    }
+    auto iov = fb->iovecs();
+    ret = io_uring_register_buffers(&d->io_uring, iov.data(), iov.size());
+    if (ret < 0) {
+      goto close_ring_fd;
+    }
+    d->fixed_buffers = std::move(fb);
+  }
+
   d->epoll_fd = epoll_create1(0);
   if (d->epoll_fd < 0) {
     ret = -errno;
@@ -162,6 +294,7 @@ int ioring_queue_t::init(std::vector<int> &fds)
 close_epoll_fd:
   close(d->epoll_fd);
 close_ring_fd:
+  d->fixed_buffers.reset();
   io_uring_queue_exit(&d->io_uring);
 
   return ret;
@@ -170,6 +303,8 @@ close_ring_fd:
 void ioring_queue_t::shutdown()
 {
   d->fixed_fds_map.clear();
+  // buffers still referenced by bufferlists stay mapped until released
+  d->fixed_buffers.reset();
   close(d->epoll_fd);
   d->epoll_fd = -1;
   io_uring_queue_exit(&d->io_uring);
@@ -209,6 +344,15 @@ get_cqe:
   return events;
 }
 
+ceph::unique_leakable_ptr<ceph::buffer::raw>
+ioring_queue_t::create_fixed_buffer(size_t len)
+{
+  if (!d->fixed_buffers) {
+    return nullptr;
+  }
+  return d->fixed_buffers->get(len);
+}
+
 bool ioring_queue_t::supported()
 {
   struct io_uring ring;
@@ -224,7 +368,9 @@ bool ioring_queue_t::supported()
 
 struct ioring_data {};
 
-ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_)
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_,
+			       unsigned fixed_buffers_,
+			       size_t fixed_buffer_size_)
 {
   ceph_assert(0);
 }
@@ -256,6 +402,12 @@ int ioring_queue_t::get_next_completed(int timeout_ms, aio_t **paio, int max)
   ceph_assert(0);
 }
 
+ceph::unique_leakable_ptr<ceph::buffer::raw>
+ioring_queue_t::create_fixed_buffer(size_t len)
+{
+  ceph_assert(0);
+}
+
 bool ioring_queue_t::supported()
 {
   return false;
@@ -0,0 +1,175 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_COMMON_SHARED_CHUNK_VECTOR_H
+#define CEPH_COMMON_SHARED_CHUNK_VECTOR_H
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include "include/encoding.h"
+
+namespace ceph {
+
+/**
+ * shared_chunk_vector
+ *
+ * A vector split in chunks of 2^ChunkBits elements, which copies of the
+ * vector share until one of them writes to it: mut() copies the chunk
+ * it writes to if another copy still uses it.  Copying the vector only
+ * copies the chunk pointers, and successive versions of a large
+ * structure which change a few elements at a time (e.g. the per osd
+ * info of successive OSDMap epochs) share nearly all their memory.
+ *
+ * Reads go through operator[] const, which is as cheap as for a vector
+ * but for the extra indirection.  The encoding is the one of a vector.
+ */
+template <typename T,
+	  template <typename> class Vector = std::vector,
+	  unsigned ChunkBits = 8>
+class shared_chunk_vector {
+  static constexpr size_t chunk_size = size_t(1) << ChunkBits;
+  static constexpr size_t chunk_mask = chunk_size - 1;
+
+  using chunk_t = Vector<T>;
+  /// all chunks are full but the last one
+  std::vector<std::shared_ptr<chunk_t>> chunks;
+  size_t count = 0;
+
+public:
+  class const_iterator {
+    const shared_chunk_vector *v = nullptr;
+    size_t i = 0;
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T*;
+    using reference = const T&;
+
+    const_iterator() = default;
+    const_iterator(const shared_chunk_vector *v, size_t i) : v(v), i(i) {}
+
+    reference operator*() const {
+      return (*v)[i];
+    }
+    pointer operator->() const {
+      return &(*v)[i];
+    }
+    const_iterator& operator++() {
+      ++i;
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator r = *this;
+      ++i;
+      return r;
+    }
+    friend bool operator==(const const_iterator& l, const const_iterator& r) {
+      return l.i == r.i;
+    }
+    friend bool operator!=(const const_iterator& l, const const_iterator& r) {
+      return l.i != r.i;
+    }
+  };
+
+  size_t size() const {
+    return count;
+  }
+  bool empty() const {
+    return count == 0;
+  }
+
+  const T& operator[](size_t i) const {
+    return (*chunks[i >> ChunkBits])[i & chunk_mask];
+  }
+
+  /// element i, for writing: its chunk is copied if it is shared
+  T& mut(size_t i) {
+    auto& c = chunks[i >> ChunkBits];
+    if (c.use_count() > 1) {
+      c = std::make_shared<chunk_t>(*c);
+    }
+    return (*c)[i & chunk_mask];
+  }
+
+  const_iterator begin() const {
+    return const_iterator(this, 0);
+  }
+  const_iterator end() const {
+    return const_iterator(this, count);
+  }
+
+  void resize(size_t n, const T& v = T()) {
+    const size_t num_chunks = (n + chunk_mask) >> ChunkBits;
+    chunks.resize(num_chunks);
+    for (size_t c = 0; c < num_chunks; ++c) {
+      const size_t want = std::min(chunk_size, n - (c << ChunkBits));
+      auto& p = chunks[c];
+      if (!p) {
+	p = std::make_shared<chunk_t>(want, v);
+      } else if (p->size() != want) {
+	if (p.use_count() > 1) {
+	  p = std::make_shared<chunk_t>(*p);
+	}
+	p->resize(want, v);
+      }
+    }
+    count = n;
+  }
+
+  void clear() {
+    chunks.clear();
+    count = 0;
+  }
+
+  /// number of chunks which are also used by another copy
+  size_t get_num_shared_chunks() const {
+    return std::count_if(chunks.begin(), chunks.end(),
+			 [](const auto& c) { return c.use_count() > 1; });
+  }
+  size_t get_num_chunks() const {
+    return chunks.size();
+  }
+};
+
+template <typename T, template <typename> class V, unsigned B>
+inline void encode(const shared_chunk_vector<T, V, B>& v,
+		   ceph::buffer::list& bl)
+{
+  __u32 n = v.size();
+  encode(n, bl);
+  for (const auto& i : v) {
+    encode(i, bl);
+  }
+}
+
+template <typename T, template <typename> class V, unsigned B>
+inline void encode(const shared_chunk_vector<T, V, B>& v,
+		   ceph::buffer::list& bl, uint64_t features)
+{
+  __u32 n = v.size();
+  encode(n, bl);
+  for (const auto& i : v) {
+    encode(i, bl, features);
+  }
+}
+
+template <typename T, template <typename> class V, unsigned B>
+inline void decode(shared_chunk_vector<T, V, B>& v,
+		   ceph::buffer::list::const_iterator& p)
+{
+  __u32 n;
+  decode(n, p);
+  v.clear();
+  v.resize(n);
+  for (__u32 i = 0; i < n; ++i) {
+    decode(v.mut(i), p);
+  }
+}
+
+} // namespace ceph
+
+#endif
@@ -570,6 +570,21 @@ int CrushTester::test(CephContext* cct)
         // create a vector to hold placement results temporarily 
         vector<int> temporary_per ( per.size() );
 
+        // map the whole batch at once
+        vector<int> batch_out, batch_out_len;
+        if (use_crush) {
+          vector<int> real_xs;
+          for (int x = batch_min; x <= batch_max; x++) {
+            uint32_t real_x = x;
+            if (pool_id != -1) {
+              real_x = crush_hash32_2(CRUSH_HASH_RJENKINS1, x, (uint32_t)pool_id);
+            }
+            real_xs.push_back(real_x);
+          }
+          crush.do_rule_batch(r, real_xs, nr, weight, 0,
+                              &batch_out, &batch_out_len);
+        }
+
         for (int x = batch_min; x <= batch_max; x++) {
           // create a vector to hold the results of a CRUSH placement or RNG simulation
           vector<int> out;
@@ -577,11 +592,9 @@ int CrushTester::test(CephContext* cct)
           if (use_crush) {
             if (output_mappings)
 	      err << "CRUSH"; // prepend CRUSH to placement output
-            uint32_t real_x = x;
-            if (pool_id != -1) {
-              real_x = crush_hash32_2(CRUSH_HASH_RJENKINS1, x, (uint32_t)pool_id);
-            }
-            crush.do_rule(r, real_x, out, nr, weight, 0);
+            unsigned i = x - batch_min;
+            out.assign(batch_out.begin() + i * nr,
+                       batch_out.begin() + i * nr + batch_out_len[i]);
           } else {
             if (output_mappings)
 	      err << "RNG"; // prepend RNG to placement output to denote simulation
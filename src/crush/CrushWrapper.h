@@ -1527,6 +1527,34 @@ public:
       out[i] = rawout[i];
   }
 
+  /**
+   * map each of xs like do_rule(), in one go
+   *
+   * @param out the maxout results of xs[i] start at out[i * maxout]
+   * @param out_len number of results of xs[i]
+   */
+  template<typename WeightVector>
+  void do_rule_batch(int rule, const std::vector<int>& xs, int maxout,
+		     const WeightVector& weight,
+		     uint64_t choose_args_index,
+		     std::vector<int> *out,
+		     std::vector<int> *out_len) const {
+    out->resize(xs.size() * maxout);
+    out_len->resize(xs.size());
+    std::vector<char> work(crush_work_size(crush, maxout));
+    crush_init_workspace(crush, work.data());
+    crush_choose_arg_map arg_map = choose_args_get_with_fallback(
+      choose_args_index);
+    crush_do_rule_batch(crush, rule, xs.data(), xs.size(),
+			out->data(), maxout, out_len->data(),
+			std::data(weight), std::size(weight),
+			work.data(), arg_map.args);
+    for (auto& len : *out_len) {
+      if (len < 0)
+	len = 0;
+    }
+  }
+
   int _choose_type_stack(
     CephContext *cct,
     const std::vector<std::pair<int,int>>& stack,
@@ -90,6 +90,60 @@ static __u32 crush_hash32_rjenkins1_5(__u32 a, __u32 b, __u32 c, __u32 d,
 }
 
 
+#if !defined(__KERNEL__) && (defined(__GNUC__) || defined(__clang__))
+/*
+ * crush_hashmix only uses wrapping add/sub, xor and shifts by constants,
+ * which the compiler maps lane by lane on its vector extensions (SSE2 or
+ * AVX2 on x86, NEON on arm): hash CRUSH_HASH_BATCH b values at once with
+ * the very same arithmetic as the scalar version.
+ */
+#define CRUSH_HASH_VECTOR 1
+typedef __u32 crush_u32xN
+	__attribute__((vector_size(CRUSH_HASH_BATCH * sizeof(__u32))));
+
+static void crush_hash32_rjenkins1_3_batch(__u32 sa, const __s32 *sb,
+					   __u32 sc, __u32 *out)
+{
+	const crush_u32xN zero = {0};
+	crush_u32xN a = zero + sa;
+	crush_u32xN b;
+	crush_u32xN c = zero + sc;
+	crush_u32xN hash;
+	crush_u32xN x = zero + 231232;
+	crush_u32xN y = zero + 1232;
+	int i;
+
+	for (i = 0; i < CRUSH_HASH_BATCH; i++)
+		b[i] = sb[i];
+	hash = (zero + crush_hash_seed) ^ a ^ b ^ c;
+	crush_hashmix(a, b, hash);
+	crush_hashmix(c, x, hash);
+	crush_hashmix(y, a, hash);
+	crush_hashmix(b, x, hash);
+	crush_hashmix(y, c, hash);
+	for (i = 0; i < CRUSH_HASH_BATCH; i++)
+		out[i] = hash[i];
+}
+#endif
+
+void crush_hash32_3_batch(int type, __u32 a, const __s32 *b,
+			  unsigned int n, __u32 c, __u32 *out)
+{
+	unsigned int i = 0;
+
+	if (type != CRUSH_HASH_RJENKINS1) {
+		for (; i < n; i++)
+			out[i] = 0;
+		return;
+	}
+#ifdef CRUSH_HASH_VECTOR
+	for (; i + CRUSH_HASH_BATCH <= n; i += CRUSH_HASH_BATCH)
+		crush_hash32_rjenkins1_3_batch(a, b + i, c, out + i);
+#endif
+	for (; i < n; i++)
+		out[i] = crush_hash32_rjenkins1_3(a, b[i], c);
+}
+
 __u32 crush_hash32(int type, __u32 a)
 {
 	switch (type) {
@@ -20,4 +20,12 @@ extern __u32 crush_hash32_4(int type, __u32 a, __u32 b, __u32 c, __u32 d);
 extern __u32 crush_hash32_5(int type, __u32 a, __u32 b, __u32 c, __u32 d,
 			    __u32 e);
 
+/*
+ * out[i] = crush_hash32_3(type, a, b[i], c) for i in [0, n), computing
+ * CRUSH_HASH_BATCH of them at a time with SIMD where available.
+ */
+#define CRUSH_HASH_BATCH 8
+extern void crush_hash32_3_batch(int type, __u32 a, const __s32 *b,
+				 unsigned int n, __u32 c, __u32 *out);
+
 #endif
@@ -308,11 +308,11 @@ static inline __s32 *get_choose_arg_ids(const struct crush_bucket_straw2 *bucket
  *
  * for reference, see the exponential distribution example at:  
  * https://en.wikipedia.org/wiki/Inverse_transform_sampling#Examples
+ *
+ * @u is the hash of the input, the item and the replica position.
  */
-static inline __s64 generate_exponential_distribution(int type, int x, int y, int z, 
-                                                      int weight)
+static inline __s64 exponential_distribution(unsigned int u, int weight)
 {
-	unsigned int u = crush_hash32_3(type, x, y, z);
 	u &= 0xffff;
 
 	/*
@@ -344,10 +344,20 @@ static int bucket_straw2_choose(const struct crush_bucket_straw2 *bucket,
 	__s64 draw, high_draw = 0;
         __u32 *weights = get_choose_arg_weights(bucket, arg, position);
         __s32 *ids = get_choose_arg_ids(bucket, arg);
+	__u32 u[CRUSH_HASH_BATCH];
 	for (i = 0; i < bucket->h.size; i++) {
                 dprintk("weight 0x%x item %d\n", weights[i], ids[i]);
+		/* hash the next items all at once */
+		if (i % CRUSH_HASH_BATCH == 0) {
+			unsigned int n = bucket->h.size - i;
+			if (n > CRUSH_HASH_BATCH)
+				n = CRUSH_HASH_BATCH;
+			crush_hash32_3_batch(bucket->h.hash, x, ids + i, n, r,
+					     u);
+		}
 		if (weights[i]) {
-			draw = generate_exponential_distribution(bucket->h.hash, x, ids[i], r, weights[i]);
+			draw = exponential_distribution(
+				u[i % CRUSH_HASH_BATCH], weights[i]);
 		} else {
 			draw = S64_MIN;
 		}
@@ -1081,3 +1091,28 @@ int crush_do_rule(const struct crush_map *map,
 
 	return result_len;
 }
+
+/**
+ * crush_do_rule_batch - calculate the mappings of many inputs
+ * @x: array of @n hash inputs
+ * @result: array of @n * @result_max results, those of x[i] start at
+ *          result + i * result_max
+ * @result_len: array of @n result sizes
+ *
+ * Same as calling crush_do_rule() for each input, but for the
+ * workspace, which is initialized once by the caller and reused.
+ */
+void crush_do_rule_batch(const struct crush_map *map,
+			 int ruleno, const int *x, int n,
+			 int *result, int result_max, int *result_len,
+			 const __u32 *weight, int weight_max,
+			 void *cwin, const struct crush_choose_arg *choose_args)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		result_len[i] = crush_do_rule(map, ruleno, x[i],
+					      result + i * result_max,
+					      result_max, weight, weight_max,
+					      cwin, choose_args);
+}
@@ -77,6 +77,21 @@ extern int crush_do_rule(const struct crush_map *map,
 			 const __u32 *weights, int weight_max,
 			 void *cwin, const struct crush_choose_arg *choose_args);
 
+/** @ingroup API
+ *
+ * Map each of the __n__ values of __x__ like crush_do_rule() would, the
+ * __result_max__ items of x[i] being stored at result + i * result_max
+ * and their number in result_len[i].  The workspace is shared by all
+ * the mappings, which spares initializing it for each of them: on maps
+ * with many buckets that is a good part of the cost of a mapping.
+ */
+extern void crush_do_rule_batch(const struct crush_map *map,
+				int ruleno, const int *x, int n,
+				int *result, int result_max, int *result_len,
+				const __u32 *weights, int weight_max,
+				void *cwin,
+				const struct crush_choose_arg *choose_args);
+
 /* Returns the exact amount of workspace that will need to be used
    for a given combination of crush_map and result_max. The caller can
    then allocate this much on its own, either on the stack, in a
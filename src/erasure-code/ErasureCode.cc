@@ -17,6 +17,7 @@
 
 #include <algorithm>
 #include <cerrno>
+#include <cstring>
 
 #include "ErasureCode.h"
 
@@ -345,4 +346,34 @@ int ErasureCode::decode_concat(const map<int, bufferlist> &chunks,
   }
   return r;
 }
+
+void ErasureCode::encode_delta(const bufferptr &old_data,
+                               const bufferptr &new_data,
+                               bufferptr *delta)
+{
+  // all the linear codes over GF(2^w) share this: the delta is the xor
+  ceph_assert(old_data.length() == new_data.length());
+  ceph_assert(delta->length() == new_data.length());
+  const char *a = old_data.c_str();
+  const char *b = new_data.c_str();
+  char *d = delta->c_str();
+  unsigned len = new_data.length();
+  unsigned i = 0;
+  for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+    uint64_t x, y;
+    memcpy(&x, a + i, sizeof(x));
+    memcpy(&y, b + i, sizeof(y));
+    x ^= y;
+    memcpy(d + i, &x, sizeof(x));
+  }
+  for (; i < len; ++i) {
+    d[i] = a[i] ^ b[i];
+  }
+}
+
+void ErasureCode::apply_delta(const std::map<int, bufferptr> &in,
+                              std::map<int, bufferptr> &out)
+{
+  ceph_abort_msg("parity delta is not supported by this plugin");
+}
 }
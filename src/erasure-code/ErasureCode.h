@@ -113,6 +113,17 @@ namespace ceph {
     int decode_concat(const std::map<int, bufferlist> &chunks,
 			      bufferlist *decoded) override;
 
+    uint64_t get_supported_optimizations() const override {
+      return 0;
+    }
+
+    void encode_delta(const bufferptr &old_data,
+                      const bufferptr &new_data,
+                      bufferptr *delta) override;
+
+    void apply_delta(const std::map<int, bufferptr> &in,
+                     std::map<int, bufferptr> &out) override;
+
   protected:
     int parse(const ErasureCodeProfile &profile,
 	      std::ostream *ss);
@@ -459,6 +459,54 @@ namespace ceph {
      */
     virtual int decode_concat(const std::map<int, bufferlist> &chunks,
 			      bufferlist *decoded) = 0;
+
+    /**
+     * Optional features an instance may support on top of the above,
+     * as returned by **get_supported_optimizations**.
+     */
+    enum {
+      /// encode_delta() and apply_delta() may be used to update coding
+      /// chunks after some data chunks changed, without reading the others
+      FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION = 1 << 0,
+    };
+
+    /**
+     * Return the FLAG_EC_PLUGIN_* bits supported by this instance.
+     *
+     * @return a bitmask of FLAG_EC_PLUGIN_*
+     */
+    virtual uint64_t get_supported_optimizations() const = 0;
+
+    /**
+     * Compute into **delta** the difference between the old and the
+     * new content of one data chunk, in a form suitable for
+     * **apply_delta**. The three buffers have the same length and
+     * **delta** may be the same buffer as either input.
+     *
+     * Only valid if FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION is set.
+     *
+     * @param [in] old_data data chunk before the change
+     * @param [in] new_data data chunk after the change
+     * @param [out] delta the change
+     */
+    virtual void encode_delta(const bufferptr &old_data,
+                              const bufferptr &new_data,
+                              bufferptr *delta) = 0;
+
+    /**
+     * Fold the deltas of some data chunks into coding chunks so that the
+     * coding chunks match what **encode** would produce for the new data.
+     * All buffers have the same length and cover the same range of their
+     * chunks.
+     *
+     * Only valid if FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION is set.
+     *
+     * @param [in] in map data chunk indexes to deltas from **encode_delta**
+     * @param [in,out] out map coding chunk indexes to their current
+     *                 content, updated in place
+     */
+    virtual void apply_delta(const std::map<int, bufferptr> &in,
+                             std::map<int, bufferptr> &out) = 0;
   };
 
   typedef std::shared_ptr<ErasureCodeInterface> ErasureCodeInterfaceRef;
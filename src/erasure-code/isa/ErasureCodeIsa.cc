@@ -132,6 +132,34 @@ ErasureCodeIsaDefault::isa_encode(char **data,
 
 // -----------------------------------------------------------------------------
 
+void
+ErasureCodeIsaDefault::apply_delta(const map<int, bufferptr> &in,
+                                   map<int, bufferptr> &out)
+{
+  for (auto &[coding, parity] : out) {
+    ceph_assert(coding >= k && coding < k + m);
+    unsigned char *dest = (unsigned char*) parity.c_str();
+    for (auto &[data, delta] : in) {
+      ceph_assert(data >= 0 && data < k);
+      ceph_assert(delta.length() == parity.length());
+      unsigned char *src = (unsigned char*) const_cast<char*>(delta.c_str());
+      if (m == 1) {
+        // single parity stripe is a plain xor, see isa_encode
+        for (unsigned i = 0; i < delta.length(); i++) {
+          dest[i] ^= src[i];
+        }
+      } else {
+        // tables are laid out row by row, 32 bytes per data chunk
+        ec_encode_data_update(delta.length(), k, 1, data,
+                              encode_tbls + 32 * k * (coding - k),
+                              src, &dest);
+      }
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+
 bool
 ErasureCodeIsaDefault::erasure_contains(int *erasures, int i)
 {
@@ -17,6 +17,7 @@
 
 #include "common/debug.h"
 #include "ErasureCodeJerasure.h"
+#include "jerasure_region.h"
 
 
 extern "C" {
@@ -152,6 +153,189 @@ bool ErasureCodeJerasure::is_prime(int value)
   return false;
 }
 
+void ErasureCodeJerasure::matrix_apply_delta(const int *matrix,
+					     const map<int, bufferptr> &in,
+					     map<int, bufferptr> &out)
+{
+  for (auto &[coding, parity] : out) {
+    ceph_assert(coding >= k && coding < k + m);
+    const int *row = &matrix[(coding - k) * k];
+    for (auto &[data, delta] : in) {
+      ceph_assert(data >= 0 && data < k);
+      ceph_assert(delta.length() == parity.length());
+      jerasure_region_multiply(w, const_cast<char*>(delta.c_str()), row[data],
+			       delta.length(), parity.c_str(), true);
+    }
+  }
+}
+
+ErasureCodeJerasure::decode_plan_ref ErasureCodeJerasure::get_decode_plan(
+  const int *erasures,
+  const std::function<int(decode_plan_t *plan)> &build)
+{
+  bool erased[k + m];
+  std::fill(erased, erased + k + m, false);
+  auto plan = std::make_shared<decode_plan_t>();
+  for (const int *e = erasures; *e != -1; e++) {
+    erased[*e] = true;
+    plan->erased.push_back(*e);
+  }
+  for (int i = 0; i < k + m && (int)plan->survivors.size() < k; i++) {
+    if (!erased[i])
+      plan->survivors.push_back(i);
+  }
+  if ((int)plan->survivors.size() < k)
+    return decode_plan_ref();
+
+  std::string signature = std::string(technique) +
+    " k=" + std::to_string(k) +
+    " m=" + std::to_string(m) +
+    " w=" + std::to_string(w) + " ";
+  for (int s : plan->survivors)
+    signature += "+" + std::to_string(s);
+  for (int e : plan->erased)
+    signature += "-" + std::to_string(e);
+
+  if (decode_cache) {
+    decode_plan_ref cached = decode_cache->get(signature);
+    if (cached)
+      return cached;
+  }
+  int r = build(plan.get());
+  if (r < 0) {
+    dout(0) << __func__ << ": cannot decode " << signature << dendl;
+    return decode_plan_ref();
+  }
+  if (decode_cache)
+    decode_cache->put(signature, plan);
+  return plan;
+}
+
+int ErasureCodeJerasure::matrix_decode(const int *matrix,
+				       int *erasures,
+				       char **data,
+				       char **coding,
+				       int blocksize)
+{
+  auto plan = get_decode_plan(erasures, [&](decode_plan_t *plan) {
+    // the rows of the generator matrix of the survivors ...
+    std::vector<int> b(k * k, 0), inv(k * k);
+    for (int i = 0; i < k; i++) {
+      int s = plan->survivors[i];
+      if (s < k)
+	b[i * k + s] = 1;
+      else
+	std::copy(matrix + (s - k) * k, matrix + (s - k + 1) * k, &b[i * k]);
+    }
+    // ... inverted turn the survivors into the data chunks
+    if (jerasure_invert_matrix(b.data(), inv.data(), k, w) < 0)
+      return -EINVAL;
+    for (int e : plan->erased) {
+      if (e < k) {
+	plan->matrix.insert(plan->matrix.end(),
+			    &inv[e * k], &inv[(e + 1) * k]);
+      } else {
+	const int *row = matrix + (e - k) * k;
+	for (int j = 0; j < k; j++) {
+	  int c = 0;
+	  for (int t = 0; t < k; t++)
+	    c ^= galois_single_multiply(row[t], inv[t * k + j], w);
+	  plan->matrix.push_back(c);
+	}
+      }
+    }
+    return 0;
+  });
+  if (!plan)
+    return -1;
+
+  char *chunks[k + m];
+  for (int i = 0; i < k + m; i++)
+    chunks[i] = i < k ? data[i] : coding[i - k];
+  for (unsigned e = 0; e < plan->erased.size(); e++) {
+    const int *row = &plan->matrix[e * k];
+    char *dst = chunks[plan->erased[e]];
+    bool add = false;
+    for (int j = 0; j < k; j++) {
+      if (row[j] == 0)
+	continue;
+      jerasure_region_multiply(w, chunks[plan->survivors[j]], row[j],
+			       blocksize, dst, add);
+      add = true;
+    }
+    if (!add)
+      memset(dst, 0, blocksize);
+  }
+  return 0;
+}
+
+int ErasureCodeJerasure::bitmatrix_decode(const int *bitmatrix,
+					  int packetsize,
+					  int *erasures,
+					  char **data,
+					  char **coding,
+					  int blocksize)
+{
+  auto plan = get_decode_plan(erasures, [&](decode_plan_t *plan) {
+    // same as matrix_decode, with one bit row per packet of each chunk
+    int kw = k * w;
+    std::vector<int> b(kw * kw, 0), inv(kw * kw);
+    for (int i = 0; i < k; i++) {
+      int s = plan->survivors[i];
+      for (int r = 0; r < w; r++) {
+	int *row = &b[(i * w + r) * kw];
+	if (s < k)
+	  row[s * w + r] = 1;
+	else
+	  std::copy(bitmatrix + ((s - k) * w + r) * kw,
+		    bitmatrix + ((s - k) * w + r + 1) * kw, row);
+      }
+    }
+    if (jerasure_invert_bitmatrix(b.data(), inv.data(), kw) < 0)
+      return -EINVAL;
+    std::vector<int> rows;
+    rows.reserve(plan->erased.size() * w * kw);
+    for (int e : plan->erased) {
+      for (int r = 0; r < w; r++) {
+	if (e < k) {
+	  rows.insert(rows.end(),
+		      &inv[(e * w + r) * kw], &inv[(e * w + r + 1) * kw]);
+	  continue;
+	}
+	const int *brow = bitmatrix + ((e - k) * w + r) * kw;
+	size_t start = rows.size();
+	rows.resize(start + kw, 0);
+	for (int t = 0; t < kw; t++) {
+	  if (!brow[t])
+	    continue;
+	  for (int c = 0; c < kw; c++)
+	    rows[start + c] ^= inv[t * kw + c];
+	}
+      }
+    }
+    plan->schedule = jerasure_smart_bitmatrix_to_schedule(
+      k, plan->erased.size(), w, rows.data());
+    return 0;
+  });
+  if (!plan)
+    return -1;
+
+  // the survivors are the "data" and the erased chunks the "coding" of
+  // the schedule
+  char *chunks[k + m];
+  for (int i = 0; i < k + m; i++)
+    chunks[i] = i < k ? data[i] : coding[i - k];
+  char *src[k];
+  char *dst[plan->erased.size()];
+  for (int i = 0; i < k; i++)
+    src[i] = chunks[plan->survivors[i]];
+  for (unsigned e = 0; e < plan->erased.size(); e++)
+    dst[e] = chunks[plan->erased[e]];
+  jerasure_schedule_encode(k, plan->erased.size(), w, plan->schedule,
+			   src, dst, blocksize, packetsize);
+  return 0;
+}
+
 // 
 // ErasureCodeJerasureReedSolomonVandermonde
 //
@@ -167,8 +351,7 @@ int ErasureCodeJerasureReedSolomonVandermonde::jerasure_decode(int *erasures,
                                                                 char **coding,
                                                                 int blocksize)
 {
-  return jerasure_matrix_decode(k, m, w, matrix, 1,
-				erasures, data, coding, blocksize);
+  return matrix_decode(matrix, erasures, data, coding, blocksize);
 }
 
 unsigned ErasureCodeJerasureReedSolomonVandermonde::get_alignment() const
@@ -218,7 +401,7 @@ int ErasureCodeJerasureReedSolomonRAID6::jerasure_decode(int *erasures,
 							 char **coding,
 							 int blocksize)
 {
-  return jerasure_matrix_decode(k, m, w, matrix, 1, erasures, data, coding, blocksize);
+  return matrix_decode(matrix, erasures, data, coding, blocksize);
 }
 
 unsigned ErasureCodeJerasureReedSolomonRAID6::get_alignment() const
@@ -271,8 +454,8 @@ int ErasureCodeJerasureCauchy::jerasure_decode(int *erasures,
 					       char **coding,
 					       int blocksize)
 {
-  return jerasure_schedule_decode_lazy(k, m, w, bitmatrix,
-				       erasures, data, coding, blocksize, packetsize, 1);
+  return bitmatrix_decode(bitmatrix, packetsize,
+			  erasures, data, coding, blocksize);
 }
 
 unsigned ErasureCodeJerasureCauchy::get_alignment() const
@@ -359,8 +542,8 @@ int ErasureCodeJerasureLiberation::jerasure_decode(int *erasures,
                                                     char **coding,
                                                     int blocksize)
 {
-  return jerasure_schedule_decode_lazy(k, m, w, bitmatrix, erasures, data,
-				       coding, blocksize, packetsize, 1);
+  return bitmatrix_decode(bitmatrix, packetsize,
+			  erasures, data, coding, blocksize);
 }
 
 unsigned ErasureCodeJerasureLiberation::get_alignment() const
@@ -18,7 +18,10 @@
 #ifndef CEPH_ERASURE_CODE_JERASURE_H
 #define CEPH_ERASURE_CODE_JERASURE_H
 
+#include <functional>
+
 #include "erasure-code/ErasureCode.h"
+#include "ErasureCodeJerasureDecodeCache.h"
 
 class ErasureCodeJerasure : public ceph::ErasureCode {
 public:
@@ -32,6 +35,8 @@ public:
   std::string rule_root;
   std::string rule_failure_domain;
   bool per_chunk_alignment;
+  /// shared by the instances of the plugin, decodes uncached if null
+  ErasureCodeJerasureDecodeCache *decode_cache;
 
   explicit ErasureCodeJerasure(const char *_technique) :
     k(0),
@@ -41,7 +46,8 @@ public:
     w(0),
     DEFAULT_W("8"),
     technique(_technique),
-    per_chunk_alignment(false)
+    per_chunk_alignment(false),
+    decode_cache(nullptr)
   {}
 
   ~ErasureCodeJerasure() override {}
@@ -77,6 +83,23 @@ public:
   static bool is_prime(int value);
 protected:
   virtual int parse(ceph::ErasureCodeProfile &profile, std::ostream *ss);
+  /// coding chunk i += sum over data chunks j of matrix[i][j] * delta j
+  void matrix_apply_delta(const int *matrix,
+			  const std::map<int, ceph::bufferptr> &in,
+			  std::map<int, ceph::bufferptr> &out);
+
+  typedef ErasureCodeJerasureDecodeCache::plan_t decode_plan_t;
+  typedef ErasureCodeJerasureDecodeCache::plan_ref decode_plan_ref;
+  /// the plan to rebuild erasures, built by build() unless it is cached
+  decode_plan_ref get_decode_plan(
+    const int *erasures,
+    const std::function<int(decode_plan_t *plan)> &build);
+  /// replaces jerasure_matrix_decode
+  int matrix_decode(const int *matrix, int *erasures,
+		    char **data, char **coding, int blocksize);
+  /// replaces jerasure_schedule_decode_lazy
+  int bitmatrix_decode(const int *bitmatrix, int packetsize, int *erasures,
+		       char **data, char **coding, int blocksize);
 };
 class ErasureCodeJerasureReedSolomonVandermonde : public ErasureCodeJerasure {
 public:
@@ -102,6 +125,14 @@ public:
                                char **data,
                                char **coding,
                                int blocksize) override;
+  uint64_t get_supported_optimizations() const override {
+    // the matrix is applied chunk by chunk, a remapping would confuse it
+    return chunk_mapping.empty() ? FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION : 0;
+  }
+  void apply_delta(const std::map<int, ceph::bufferptr> &in,
+		   std::map<int, ceph::bufferptr> &out) override {
+    matrix_apply_delta(matrix, in, out);
+  }
   unsigned get_alignment() const override;
   void prepare() override;
 private:
@@ -132,6 +163,14 @@ public:
                                char **data,
                                char **coding,
                                int blocksize) override;
+  uint64_t get_supported_optimizations() const override {
+    // the matrix is applied chunk by chunk, a remapping would confuse it
+    return chunk_mapping.empty() ? FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION : 0;
+  }
+  void apply_delta(const std::map<int, ceph::bufferptr> &in,
+		   std::map<int, ceph::bufferptr> &out) override {
+    matrix_apply_delta(matrix, in, out);
+  }
   unsigned get_alignment() const override;
   void prepare() override;
 private:
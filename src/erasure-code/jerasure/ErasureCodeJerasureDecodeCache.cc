@@ -0,0 +1,84 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph distributed storage system
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ */
+
+#include "common/debug.h"
+#include "ErasureCodeJerasureDecodeCache.h"
+
+extern "C" {
+#include "jerasure.h"
+}
+
+#define dout_context g_ceph_context
+#define dout_subsys ceph_subsys_osd
+#undef dout_prefix
+#define dout_prefix _prefix(_dout)
+
+static std::ostream& _prefix(std::ostream* _dout)
+{
+  return *_dout << "ErasureCodeJerasureDecodeCache: ";
+}
+
+ErasureCodeJerasureDecodeCache::plan_t::~plan_t()
+{
+  if (schedule)
+    jerasure_free_schedule(schedule);
+}
+
+ErasureCodeJerasureDecodeCache::plan_ref
+ErasureCodeJerasureDecodeCache::get(const std::string &signature)
+{
+  std::lock_guard l{lock};
+  auto p = plans.find(signature);
+  if (p == plans.end()) {
+    ++misses;
+    return plan_ref();
+  }
+  ++hits;
+  lru.splice(lru.begin(), lru, p->second.first);
+  return p->second.second;
+}
+
+void ErasureCodeJerasureDecodeCache::put(const std::string &signature,
+					 plan_ref plan)
+{
+  std::lock_guard l{lock};
+  if (plans.count(signature)) {
+    // another thread computed it meanwhile
+    return;
+  }
+  if (plans.size() >= max_plans) {
+    dout(12) << "evicting " << lru.back() << dendl;
+    plans.erase(lru.back());
+    lru.pop_back();
+  }
+  lru.push_front(signature);
+  plans.emplace(signature, std::make_pair(lru.begin(), std::move(plan)));
+  dout(12) << "cached " << signature << ", size " << plans.size() << dendl;
+}
+
+size_t ErasureCodeJerasureDecodeCache::size() const
+{
+  std::lock_guard l{lock};
+  return plans.size();
+}
+
+uint64_t ErasureCodeJerasureDecodeCache::get_hits() const
+{
+  std::lock_guard l{lock};
+  return hits;
+}
+
+uint64_t ErasureCodeJerasureDecodeCache::get_misses() const
+{
+  std::lock_guard l{lock};
+  return misses;
+}
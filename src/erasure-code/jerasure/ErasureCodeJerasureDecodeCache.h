@@ -0,0 +1,81 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph distributed storage system
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ */
+
+#ifndef CEPH_ERASURE_CODE_JERASURE_DECODE_CACHE_H
+#define CEPH_ERASURE_CODE_JERASURE_DECODE_CACHE_H
+
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/ceph_mutex.h"
+
+/**
+ * LRU cache of decoding plans, shared by all the jerasure instances of
+ * the plugin.
+ *
+ * Inverting the matrix of the surviving chunks (and for the bitmatrix
+ * techniques, turning the result into an XOR schedule) costs far more
+ * than decoding a few KiB, and the same few erasure patterns come back
+ * over and over during degraded reads and recovery.  The signature
+ * names the technique, k, m, w and the surviving and erased chunks,
+ * so instances with different profiles can share the cache.
+ */
+class ErasureCodeJerasureDecodeCache {
+public:
+  /// how to rebuild the erased chunks out of k surviving ones
+  struct plan_t {
+    std::vector<int> survivors;  ///< the k chunks decoded from
+    std::vector<int> erased;     ///< the chunks rebuilt
+    /// erased.size() rows of k coefficients over GF(2^w)
+    std::vector<int> matrix;
+    /// for bitmatrix techniques, the XOR schedule instead of the matrix
+    int **schedule = nullptr;
+
+    plan_t() = default;
+    plan_t(const plan_t&) = delete;
+    plan_t& operator=(const plan_t&) = delete;
+    ~plan_t();
+  };
+  using plan_ref = std::shared_ptr<const plan_t>;
+
+  // enough for every erasure pattern of a (12,4) code
+  static const size_t decoding_plans_lru_length = 2516;
+
+  explicit ErasureCodeJerasureDecodeCache(
+    size_t max_plans = decoding_plans_lru_length)
+    : max_plans(max_plans) {}
+
+  /// @return the plan for signature, or null if it is not cached
+  plan_ref get(const std::string &signature);
+  void put(const std::string &signature, plan_ref plan);
+
+  size_t size() const;
+  uint64_t get_hits() const;
+  uint64_t get_misses() const;
+
+private:
+  typedef std::list<std::string> lru_list_t;
+  typedef std::map<std::string,
+		   std::pair<lru_list_t::iterator, plan_ref>> lru_map_t;
+
+  const size_t max_plans;
+  mutable ceph::mutex lock = ceph::make_mutex("jerasure-decode-cache");
+  lru_list_t lru;  ///< most recently used first
+  lru_map_t plans;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+};
+
+#endif
@@ -61,6 +61,7 @@ int ErasureCodePluginJerasure::factory(const std::string& directory,
       return -ENOENT;
     }
     dout(20) << __func__ << ": " << profile << dendl;
+    interface->decode_cache = &decode_cache;
     int r = interface->init(profile, ss);
     if (r) {
       delete interface;
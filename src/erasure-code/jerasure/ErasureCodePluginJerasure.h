@@ -19,9 +19,12 @@
 #define CEPH_ERASURE_CODE_PLUGIN_JERASURE_H
 
 #include "erasure-code/ErasureCodePlugin.h"
+#include "ErasureCodeJerasureDecodeCache.h"
 
 class ErasureCodePluginJerasure : public ceph::ErasureCodePlugin {
 public:
+  ErasureCodeJerasureDecodeCache decode_cache;
+
   int factory(const std::string& directory,
 	      ceph::ErasureCodeProfile &profile,
 	      ceph::ErasureCodeInterfaceRef *erasure_code,
@@ -0,0 +1,189 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph distributed storage system
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ */
+
+#include <string.h>
+
+#include "arch/intel.h"
+#include "arch/probe.h"
+#include "include/ceph_assert.h"
+#include "jerasure_region.h"
+
+extern "C" {
+#include "galois.h"
+}
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+namespace {
+
+enum class region_impl_t {
+  GF_COMPLETE,
+  AVX2,
+  AVX512,
+};
+
+region_impl_t region_impl()
+{
+  static const region_impl_t impl = [] {
+    ceph_arch_probe();
+#ifdef __x86_64__
+    if (ceph_arch_intel_avx512bw) {
+      return region_impl_t::AVX512;
+    }
+    if (ceph_arch_intel_avx2) {
+      return region_impl_t::AVX2;
+    }
+#endif
+    return region_impl_t::GF_COMPLETE;
+  }();
+  return impl;
+}
+
+// multby * x == lo[x & 0xf] ^ hi[x >> 4] because multiplication is linear
+struct w08_tables_t {
+  alignas(16) unsigned char lo[16];
+  alignas(16) unsigned char hi[16];
+
+  explicit w08_tables_t(int multby) {
+    for (int x = 0; x < 16; x++) {
+      lo[x] = galois_single_multiply(multby, x, 8);
+      hi[x] = galois_single_multiply(multby, x << 4, 8);
+    }
+  }
+};
+
+void w08_region_multiply_tail(const w08_tables_t &t,
+			      const unsigned char *src, int nbytes,
+			      unsigned char *dst, bool add)
+{
+  for (int i = 0; i < nbytes; i++) {
+    unsigned char p = t.lo[src[i] & 0xf] ^ t.hi[src[i] >> 4];
+    dst[i] = add ? dst[i] ^ p : p;
+  }
+}
+
+#ifdef __x86_64__
+__attribute__((target("avx2")))
+void w08_region_multiply_avx2(const w08_tables_t &t,
+			      const unsigned char *src, int nbytes,
+			      unsigned char *dst, bool add)
+{
+  const __m256i lo = _mm256_broadcastsi128_si256(
+    _mm_load_si128(reinterpret_cast<const __m128i*>(t.lo)));
+  const __m256i hi = _mm256_broadcastsi128_si256(
+    _mm_load_si128(reinterpret_cast<const __m128i*>(t.hi)));
+  const __m256i mask = _mm256_set1_epi8(0x0f);
+  int i = 0;
+  for (; i + 32 <= nbytes; i += 32) {
+    __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    __m256i p = _mm256_xor_si256(
+      _mm256_shuffle_epi8(lo, _mm256_and_si256(s, mask)),
+      _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi64(s, 4), mask)));
+    if (add) {
+      p = _mm256_xor_si256(
+	p, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i)));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), p);
+  }
+  w08_region_multiply_tail(t, src + i, nbytes - i, dst + i, add);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void w08_region_multiply_avx512(const w08_tables_t &t,
+				const unsigned char *src, int nbytes,
+				unsigned char *dst, bool add)
+{
+  const __m512i lo = _mm512_broadcast_i32x4(
+    _mm_load_si128(reinterpret_cast<const __m128i*>(t.lo)));
+  const __m512i hi = _mm512_broadcast_i32x4(
+    _mm_load_si128(reinterpret_cast<const __m128i*>(t.hi)));
+  const __m512i mask = _mm512_set1_epi8(0x0f);
+  int i = 0;
+  for (; i + 64 <= nbytes; i += 64) {
+    __m512i s = _mm512_loadu_si512(src + i);
+    __m512i p = _mm512_xor_si512(
+      _mm512_shuffle_epi8(lo, _mm512_and_si512(s, mask)),
+      _mm512_shuffle_epi8(hi, _mm512_and_si512(_mm512_srli_epi64(s, 4), mask)));
+    if (add) {
+      p = _mm512_xor_si512(p, _mm512_loadu_si512(dst + i));
+    }
+    _mm512_storeu_si512(dst + i, p);
+  }
+  w08_region_multiply_tail(t, src + i, nbytes - i, dst + i, add);
+}
+#endif
+
+} // anonymous namespace
+
+void jerasure_region_multiply(int w, char *src, int multby, int nbytes,
+			      char *dst, bool add)
+{
+  if (multby == 0) {
+    if (!add) {
+      memset(dst, 0, nbytes);
+    }
+    return;
+  }
+  if (multby == 1) {
+    if (add) {
+      galois_region_xor(src, dst, nbytes);
+    } else if (src != dst) {
+      memcpy(dst, src, nbytes);
+    }
+    return;
+  }
+  switch (w) {
+  case 8:
+#ifdef __x86_64__
+    switch (region_impl()) {
+    case region_impl_t::AVX512:
+      w08_region_multiply_avx512(
+	w08_tables_t(multby),
+	reinterpret_cast<const unsigned char*>(src), nbytes,
+	reinterpret_cast<unsigned char*>(dst), add);
+      return;
+    case region_impl_t::AVX2:
+      w08_region_multiply_avx2(
+	w08_tables_t(multby),
+	reinterpret_cast<const unsigned char*>(src), nbytes,
+	reinterpret_cast<unsigned char*>(dst), add);
+      return;
+    case region_impl_t::GF_COMPLETE:
+      break;
+    }
+#endif
+    galois_w08_region_multiply(src, multby, nbytes, dst, add);
+    break;
+  case 16:
+    galois_w16_region_multiply(src, multby, nbytes, dst, add);
+    break;
+  case 32:
+    galois_w32_region_multiply(src, multby, nbytes, dst, add);
+    break;
+  default:
+    ceph_abort_msg("unsupported w");
+  }
+}
+
+const char *jerasure_region_multiply_impl()
+{
+  switch (region_impl()) {
+  case region_impl_t::AVX512:
+    return "avx512bw";
+  case region_impl_t::AVX2:
+    return "avx2";
+  default:
+    return "gf-complete";
+  }
+}
@@ -0,0 +1,30 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph distributed storage system
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ */
+
+#ifndef CEPH_JERASURE_REGION_H
+#define CEPH_JERASURE_REGION_H
+
+/**
+ * dst = multby * src, or dst ^= multby * src if add, over GF(2^w)
+ *
+ * For w=8 the multiplication uses AVX-512BW or AVX2 split nibble tables
+ * when the CPU has them, which gf-complete (SSSE3 at most) does not.
+ * Every other case is handed to gf-complete.  src and dst must not
+ * overlap unless they are the same region.
+ */
+void jerasure_region_multiply(int w, char *src, int multby, int nbytes,
+			      char *dst, bool add);
+
+/// which implementation jerasure_region_multiply uses for w=8
+const char *jerasure_region_multiply_impl();
+
+#endif
@@ -93,6 +93,9 @@
 /* Defined if you have liburing */
 #cmakedefine HAVE_LIBURING
 
+/* Define if the io_uring network stack of the async messenger is built */
+#cmakedefine HAVE_ASYNC_URING
+
 /* Defind if you have POSIX AIO */
 #cmakedefine HAVE_POSIXAIO
 
@@ -1213,6 +1213,44 @@ inline namespace v14_2_0 {
         ObjectReadOperation *op, int flags,
         bufferlist *pbl, const blkin_trace_info *trace_info);
 
+    /**
+     * Execute the operations of many objects, in batches
+     *
+     * The objects are grouped by placement group, and the operations
+     * of the objects of each group are sent to its primary OSD in a
+     * single message.  It executes them one object after the other,
+     * and commits their updates together.  The operations of each
+     * object are atomic, but not the batch as a whole.
+     *
+     * The outputs of each object's operations are set as if it was
+     * executed on its own.  Objects the OSD finds not to be in the
+     * placement group anymore (its pool's pg_num changed meanwhile)
+     * are sent again on their own.  So is every object as long as the
+     * cluster may have OSDs older than reef, which lack batches, and in
+     * pools with cache tiers, which do not take them.
+     *
+     * Watch and notify operations cannot be batched.
+     *
+     * @param ops the objects and their operations
+     * @param results where to store the result of each object's operations
+     * @param flags flags to apply to the operations (OPERATION_*)
+     * @returns 0 on success, negative error code on failure
+     */
+    int operate_batch(
+      const std::vector<std::pair<std::string, ObjectWriteOperation*>>& ops,
+      std::vector<int> *results, int flags);
+    int operate_batch(
+      const std::vector<std::pair<std::string, ObjectReadOperation*>>& ops,
+      std::vector<int> *results, int flags);
+    int aio_operate_batch(
+      AioCompletion *c,
+      const std::vector<std::pair<std::string, ObjectWriteOperation*>>& ops,
+      std::vector<int> *results, int flags);
+    int aio_operate_batch(
+      AioCompletion *c,
+      const std::vector<std::pair<std::string, ObjectReadOperation*>>& ops,
+      std::vector<int> *results, int flags);
+
     // watch/notify
     int watch2(const std::string& o, uint64_t *handle,
 	       librados::WatchCtx2 *ctx);
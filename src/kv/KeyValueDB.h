@@ -4,6 +4,7 @@
 #define KEY_VALUE_DB_H
 
 #include "include/buffer.h"
+#include <functional>
 #include <ostream>
 #include <set>
 #include <map>
@@ -189,6 +190,19 @@ public:
 		  ceph::buffer::list *value) {
     return get(prefix, std::string(key, keylen), value);
   }
+  /// Retrieve a value and pass it to @p f in place.  Backends that can
+  /// pin the value in their cache do so instead of copying it out; the
+  /// data is only valid for the duration of the call.
+  virtual int get_pinned(const std::string &prefix,
+			 const std::string &key,
+			 std::function<void(const char*, size_t)> f) {
+    ceph::buffer::list bl;
+    int r = get(prefix, key, &bl);
+    if (r >= 0) {
+      f(bl.c_str(), bl.length());
+    }
+    return r;
+  }
 
   // This superclass is used both by kv iterators *and* by the ObjectMap
   // omap iterator.  The class hierarchies are unfortunately tied together
@@ -1966,6 +1966,41 @@ int RocksDBStore::get(
   return r;
 }
 
+int RocksDBStore::get_pinned(
+  const string& prefix,
+  const string& key,
+  std::function<void(const char*, size_t)> f)
+{
+  utime_t start = ceph_clock_now();
+  int r = 0;
+  rocksdb::PinnableSlice value;
+  rocksdb::Status s;
+  auto cf = get_cf_handle(prefix, key);
+  if (cf) {
+    s = db->Get(rocksdb::ReadOptions(),
+		cf,
+		rocksdb::Slice(key),
+		&value);
+  } else {
+    string k = combine_strings(prefix, key);
+    s = db->Get(rocksdb::ReadOptions(),
+		default_cf,
+		rocksdb::Slice(k),
+		&value);
+  }
+  utime_t lat = ceph_clock_now() - start;
+  logger->tinc(l_rocksdb_get_latency, lat);
+  if (s.ok()) {
+    // value stays pinned in the block cache until it goes out of scope
+    f(value.data(), value.size());
+  } else if (s.IsNotFound()) {
+    r = -ENOENT;
+  } else {
+    ceph_abort_msg(s.getState());
+  }
+  return r;
+}
+
 int RocksDBStore::split_key(rocksdb::Slice in, string *prefix, string *key)
 {
   size_t prefix_len = 0;
@@ -350,6 +350,10 @@ public:
     const char *key,
     size_t keylen,
     ceph::bufferlist *out) override;
+  int get_pinned(
+    const std::string &prefix,
+    const std::string &key,
+    std::function<void(const char*, size_t)> f) override;
 
 
   class RocksDBWholeSpaceIteratorImpl :
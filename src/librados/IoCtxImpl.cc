@@ -23,6 +23,7 @@
 #include "include/ceph_assert.h"
 #include "common/valgrind.h"
 #include "common/EventTrace.h"
+#include "common/errno.h"
 
 #define dout_subsys ceph_subsys_rados
 #undef dout_prefix
@@ -229,6 +230,98 @@ struct C_aio_selfmanaged_snap_create_Complete : public C_aio_selfmanaged_snap_op
   }
 };
 
+/// the objects of an operate_batch() request in one pg
+struct BatchPG {
+  IoCtxImpl *io;
+  AioCompletionImpl *c;
+  bool write;
+  SnapContext snapc;
+  snapid_t snap_seq;
+  ceph::real_time ut;
+  int flags;
+  std::vector<int> *results;
+  std::vector<size_t> index;	///< of each object in the request
+  std::vector<std::pair<object_t, ::ObjectOperation>> objects;
+  std::vector<int> rvals;
+
+  void submit(const object_t& oid, ::ObjectOperation& op, Context *onfinish) {
+    Objecter::Op *objecter_op;
+    if (write) {
+      objecter_op = io->objecter->prepare_mutate_op(
+	oid, io->oloc, op, snapc, ut, flags, onfinish, &c->objver);
+    } else {
+      objecter_op = io->objecter->prepare_read_op(
+	oid, io->oloc, op, snap_seq, nullptr, flags, onfinish, &c->objver);
+    }
+    io->objecter->op_submit(objecter_op);
+  }
+  void set_result(size_t i, int r) {
+    if (results) {
+      (*results)[index[i]] = r;
+    }
+  }
+};
+using BatchPGRef = std::shared_ptr<BatchPG>;
+
+/// send the ops of the i-th object on their own
+void send_batch_object(const BatchPGRef& b, size_t i, Context *onfinish)
+{
+  auto& [oid, op] = b->objects[i];
+  b->submit(oid, op, new LambdaContext([b, i, onfinish](int r) {
+    b->set_result(i, r);
+    onfinish->complete(0);
+  }));
+}
+
+/// send the ops of all the objects in one batch op, and those of the
+/// objects no longer in the pg by the time it gets there on their own
+void send_batch(const BatchPGRef& b, Context *onfinish)
+{
+  std::vector<std::pair<object_t, ::ObjectOperation*>> batch;
+  std::vector<int*> rvals;
+  b->rvals.assign(b->objects.size(), 0);
+  for (size_t i = 0; i < b->objects.size(); ++i) {
+    batch.emplace_back(b->objects[i].first, &b->objects[i].second);
+    rvals.push_back(&b->rvals[i]);
+  }
+  ::ObjectOperation op;
+  op.batch(std::move(batch), b->io->oloc.key, std::move(rvals));
+  b->submit(b->objects.front().first, op, new LambdaContext(
+    [b, onfinish](int r) {
+      C_GatherBuilder resend(b->io->client->cct);
+      if (r == -EOPNOTSUPP) {
+	// e.g. a tiered pool, which does not take batches
+	ldout(b->io->client->cct, 10) << "operate_batch " << cpp_strerror(r)
+				      << ", sending the objects on their own"
+				      << dendl;
+	for (size_t i = 0; i < b->objects.size(); ++i) {
+	  send_batch_object(b, i, resend.new_sub());
+	}
+	resend.set_finisher(onfinish);
+	resend.activate();
+	return;
+      }
+      for (size_t i = 0; i < b->objects.size(); ++i) {
+	if (r < 0) {
+	  b->set_result(i, r);
+	} else if (b->rvals[i] == -EXDEV) {
+	  ldout(b->io->client->cct, 10) << "operate_batch " << b->objects[i].first
+					<< " moved to another pg, resending"
+					<< dendl;
+	  send_batch_object(b, i, resend.new_sub());
+	} else {
+	  b->set_result(i, b->rvals[i]);
+	}
+      }
+      if (resend.has_subs()) {
+	resend.set_finisher(onfinish);
+	resend.activate();
+      } else {
+	onfinish->complete(r);
+      }
+    }));
+}
+
 } // anonymous namespace
 } // namespace librados
 
@@ -786,6 +879,82 @@ int librados::IoCtxImpl::aio_operate(const object_t& oid,
   return 0;
 }
 
+int librados::IoCtxImpl::operate_batch(
+  const std::vector<std::pair<object_t, ::ObjectOperation*>>& ops,
+  bool write, std::vector<int> *results, int flags)
+{
+  AioCompletionImpl *c = new AioCompletionImpl;
+  int r = aio_operate_batch(ops, write, results, c, flags);
+  if (r == 0) {
+    c->wait_for_complete();
+    r = c->get_return_value();
+  }
+  c->release();
+  return r;
+}
+
+int librados::IoCtxImpl::aio_operate_batch(
+  const std::vector<std::pair<object_t, ::ObjectOperation*>>& ops,
+  bool write, std::vector<int> *results, AioCompletionImpl *c, int flags)
+{
+  FUNCTRACE(client->cct);
+  /* can't write to a snapshot */
+  if (write && snap_seq != CEPH_NOSNAP)
+    return -EROFS;
+  if (ops.empty())
+    return -EINVAL;
+
+  // one batch op for the objects of each pg, unless some of the osds
+  // do not know of them yet
+  std::map<pg_t, std::vector<size_t>> pgs;
+  bool batch_supported = false;
+  int r = objecter->with_osdmap([&](const OSDMap& o) {
+    batch_supported = o.require_osd_release >= ceph_release_t::reef;
+    for (size_t i = 0; i < ops.size(); ++i) {
+      pg_t raw;
+      int r = o.object_locator_to_pg(ops[i].first, oloc, raw);
+      if (r < 0)
+	return r;
+      pgs[o.raw_pg_to_pg(raw)].push_back(i);
+    }
+    return 0;
+  });
+  if (r < 0)
+    return r;
+  if (results)
+    results->assign(ops.size(), 0);
+
+  Context *oncomplete = new C_aio_Complete(c);
+  c->io = this;
+  if (write)
+    queue_aio_write(c);
+  else
+    c->is_read = true;
+
+  C_GatherBuilder gather(client->cct, oncomplete);
+  const ceph::real_time ut = ceph::real_clock::now();
+  for (auto& [pgid, objects] : pgs) {
+    auto b = std::make_shared<BatchPG>(BatchPG{
+      this, c, write, snapc, snap_seq, ut, flags | extra_op_flags, results,
+      std::move(objects)});
+    b->objects.reserve(b->index.size());
+    for (auto i : b->index) {
+      b->objects.emplace_back(ops[i].first, std::move(*ops[i].second));
+    }
+    if (batch_supported) {
+      ldout(client->cct, 10) << __func__ << " " << b->objects.size()
+			     << " objects in " << pgid << dendl;
+      send_batch(b, gather.new_sub());
+    } else {
+      for (size_t i = 0; i < b->objects.size(); ++i) {
+	send_batch_object(b, i, gather.new_sub());
+      }
+    }
+  }
+  gather.activate();
+  return 0;
+}
+
 int librados::IoCtxImpl::aio_read(const object_t oid, AioCompletionImpl *c,
 				  bufferlist *pbl, size_t len, uint64_t off,
 				  uint64_t snapid, const blkin_trace_info *info)
@@ -162,6 +162,12 @@ struct librados::IoCtxImpl {
 		  const blkin_trace_info *trace_info = nullptr);
   int aio_operate_read(const object_t& oid, ::ObjectOperation *o,
 		       AioCompletionImpl *c, int flags, bufferlist *pbl, const blkin_trace_info *trace_info = nullptr);
+  int operate_batch(
+    const std::vector<std::pair<object_t, ::ObjectOperation*>>& ops,
+    bool write, std::vector<int> *results, int flags);
+  int aio_operate_batch(
+    const std::vector<std::pair<object_t, ::ObjectOperation*>>& ops,
+    bool write, std::vector<int> *results, AioCompletionImpl *c, int flags);
 
   struct C_aio_stat_Ack : public Context {
     librados::AioCompletionImpl *c;
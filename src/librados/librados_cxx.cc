@@ -1665,6 +1665,64 @@ int librados::IoCtx::aio_operate(const std::string& oid, AioCompletion *c,
                translate_flags(flags), pbl, trace_info);
 }
 
+int librados::IoCtx::operate_batch(
+  const std::vector<std::pair<std::string, ObjectWriteOperation*>>& ops,
+  std::vector<int> *results, int flags)
+{
+  std::vector<std::pair<object_t, ::ObjectOperation*>> batch;
+  for (auto& [oid, o] : ops) {
+    if (unlikely(!o || !o->impl))
+      return -EINVAL;
+    batch.emplace_back(object_t(oid), &o->impl->o);
+  }
+  return io_ctx_impl->operate_batch(batch, true, results,
+				    translate_flags(flags));
+}
+
+int librados::IoCtx::operate_batch(
+  const std::vector<std::pair<std::string, ObjectReadOperation*>>& ops,
+  std::vector<int> *results, int flags)
+{
+  std::vector<std::pair<object_t, ::ObjectOperation*>> batch;
+  for (auto& [oid, o] : ops) {
+    if (unlikely(!o || !o->impl))
+      return -EINVAL;
+    batch.emplace_back(object_t(oid), &o->impl->o);
+  }
+  return io_ctx_impl->operate_batch(batch, false, results,
+				    translate_flags(flags));
+}
+
+int librados::IoCtx::aio_operate_batch(
+  AioCompletion *c,
+  const std::vector<std::pair<std::string, ObjectWriteOperation*>>& ops,
+  std::vector<int> *results, int flags)
+{
+  std::vector<std::pair<object_t, ::ObjectOperation*>> batch;
+  for (auto& [oid, o] : ops) {
+    if (unlikely(!o || !o->impl))
+      return -EINVAL;
+    batch.emplace_back(object_t(oid), &o->impl->o);
+  }
+  return io_ctx_impl->aio_operate_batch(batch, true, results, c->pc,
+					translate_flags(flags));
+}
+
+int librados::IoCtx::aio_operate_batch(
+  AioCompletion *c,
+  const std::vector<std::pair<std::string, ObjectReadOperation*>>& ops,
+  std::vector<int> *results, int flags)
+{
+  std::vector<std::pair<object_t, ::ObjectOperation*>> batch;
+  for (auto& [oid, o] : ops) {
+    if (unlikely(!o || !o->impl))
+      return -EINVAL;
+    batch.emplace_back(object_t(oid), &o->impl->o);
+  }
+  return io_ctx_impl->aio_operate_batch(batch, false, results, c->pc,
+					translate_flags(flags));
+}
+
 void librados::IoCtx::snap_set_read(snap_t seq)
 {
   io_ctx_impl->set_snap_read(seq);
@@ -469,6 +469,8 @@ void AsyncConnection::process() {
     }
 
     case STATE_CONNECTION_ESTABLISHED: {
+      // even if the protocol does not read now
+      cs.poll_completions();
       if (pendingReadLen) {
         ssize_t r = read(*pendingReadLen, read_buffer, readCallback);
         if (r <= 0) { // read all bytes, or an error occured
@@ -0,0 +1,813 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#include <bit>
+#include <deque>
+
+#include "IoUringStack.h"
+
+#include "common/errno.h"
+#include "common/dout.h"
+#include "common/linux_version.h"
+#include "include/compat.h"
+#include "include/sock_compat.h"
+
+#define dout_subsys ceph_subsys_ms
+#undef dout_prefix
+#define dout_prefix *_dout << "IoUringStack "
+
+// the group of the provided recv buffers
+static constexpr int RECV_BGID = 0;
+
+/// what a completion is for; its user_data points to it
+struct IoUringRequest {
+  enum op_t : uint8_t {
+    RECV,
+    SEND,
+    POLL,
+  };
+  op_t op;
+  IoUringSocket *socket;
+};
+
+struct IoUringSend : IoUringRequest {
+  ceph::buffer::list bl;
+  std::vector<iovec> iov;
+  msghdr msg = {};
+  /// a zero copy send holds on to bl until its notification
+  bool notif_pending = false;
+
+  explicit IoUringSend(IoUringSocket *s)
+    : IoUringRequest{SEND, s} {}
+};
+
+/**
+ * The state of a connected socket.  It outlives its ConnectedSocketImpl
+ * until the requests in flight for it complete.  Once started, i.e. once
+ * it is used by the worker it belongs to, only the thread of that worker
+ * uses it.
+ */
+class IoUringSocket {
+ public:
+  IoUringWorker *worker;
+  ceph::NetHandler &handler;
+  const entity_addr_t sa;
+  int sd;     ///< -1 once closed
+  int notify_fd;
+  bool connected;
+  bool started = false;
+  bool closed = false;
+  bool notified = false;
+  bool starved = false;
+  bool waiting_sqe = false;   ///< for a submission queue entry
+  bool poll_wanted = false;
+
+  IoUringRequest recv_req{IoUringRequest::RECV, this};
+  IoUringRequest poll_req{IoUringRequest::POLL, this};
+  bool recv_armed = false;
+  bool poll_armed = false;
+  bool send_inflight = false;
+  unsigned inflight = 0;   ///< requests whose completion is to come
+  std::set<IoUringSend*> sends;
+
+  struct rx_buf_t {
+    uint16_t bid;
+    uint32_t off;
+    uint32_t len;
+  };
+  std::deque<rx_buf_t> rx;         ///< received, in provided buffers
+  ceph::buffer::list rx_copied;    ///< received after rx had too many
+  unsigned held = 0;
+  bool eof = false;
+  int error = 0;
+  ceph::buffer::list pending;      ///< to send
+
+  IoUringSocket(IoUringWorker *w, ceph::NetHandler &h,
+		const entity_addr_t &sa, int sd, bool connected)
+    : worker(w), handler(h), sa(sa), sd(sd), connected(connected) {
+    notify_fd = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+    ceph_assert(notify_fd >= 0);
+  }
+
+  void start() {
+    if (started) {
+      return;
+    }
+    ceph_assert(worker->center.in_thread());
+    started = true;
+    worker->add_socket(this);
+    if (connected) {
+      arm_recv();
+    }
+  }
+
+  void notify() {
+    if (!notified) {
+      eventfd_write(notify_fd, 1);
+      notified = true;
+    }
+  }
+  void clear_notify() {
+    if (notified) {
+      eventfd_t v;
+      eventfd_read(notify_fd, &v);
+      notified = false;
+    }
+  }
+
+  void arm_recv() {
+    if (recv_armed || closed || eof || error) {
+      return;
+    }
+    auto sqe = worker->get_sqe(this);
+    if (!sqe) {
+      return;
+    }
+    io_uring_prep_recv_multishot(sqe, sd, nullptr, 0, 0);
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECV_BGID;
+    io_uring_sqe_set_data(sqe, &recv_req);
+    recv_armed = true;
+    ++inflight;
+    worker->queue_submit();
+  }
+
+  void handle_recv(int res, unsigned flags) {
+    if (!(flags & IORING_CQE_F_MORE)) {
+      recv_armed = false;
+      --inflight;
+    }
+    if (flags & IORING_CQE_F_BUFFER) {
+      unsigned bid = flags >> IORING_CQE_BUFFER_SHIFT;
+      worker->uring_logger->inc(l_msgr_uring_recv_bufs_in_use);
+      if (res > 0 && !closed) {
+	deliver(bid, res);
+      } else {
+	worker->put_buf(bid);
+      }
+    }
+    if (closed) {
+      return;
+    }
+    if (res > 0) {
+      // the kernel may end a multishot recv at any time
+      arm_recv();
+    } else if (res == 0) {
+      eof = true;
+    } else if (res == -ENOBUFS) {
+      worker->wait_for_bufs(this);
+      return;
+    } else if (res != -ECANCELED) {
+      error = res;
+    }
+    notify();
+  }
+
+  void deliver(unsigned bid, unsigned len) {
+    if (rx_copied.length() || held >= worker->get_max_held_bufs()) {
+      // do not let a socket which is not read from starve the others
+      rx_copied.append(worker->get_buf(bid), len);
+      worker->put_buf(bid);
+      worker->uring_logger->inc(l_msgr_uring_recv_copied_bytes, len);
+    } else {
+      rx.push_back(rx_buf_t{(uint16_t)bid, 0, len});
+      ++held;
+    }
+  }
+
+  ssize_t read(char *buf, size_t len) {
+    start();
+    size_t copied = 0;
+    while (copied < len && !rx.empty()) {
+      auto &b = rx.front();
+      size_t n = std::min<size_t>(len - copied, b.len - b.off);
+      memcpy(buf + copied, worker->get_buf(b.bid) + b.off, n);
+      copied += n;
+      b.off += n;
+      if (b.off == b.len) {
+	unsigned bid = b.bid;
+	rx.pop_front();
+	--held;
+	worker->put_buf(bid);
+      }
+    }
+    if (copied < len && rx_copied.length()) {
+      size_t n = std::min<size_t>(len - copied, rx_copied.length());
+      rx_copied.cbegin().copy(n, buf + copied);
+      rx_copied.splice(0, n);
+      copied += n;
+    }
+    if (rx.empty() && !rx_copied.length() && !eof && !error) {
+      clear_notify();
+    }
+    if (copied) {
+      return copied;
+    } else if (error) {
+      return error;
+    } else if (eof) {
+      return 0;
+    }
+    return -EAGAIN;
+  }
+
+  ssize_t send(ceph::buffer::list &bl) {
+    start();
+    if (error) {
+      return error;
+    }
+    // taken as a whole: what the socket cannot take yet waits for the
+    // sendmsg in flight to complete
+    ssize_t len = bl.length();
+    pending.claim_append(bl);
+    flush();
+    return len;
+  }
+
+  void flush() {
+    if (send_inflight || !connected || closed || error ||
+	pending.length() == 0) {
+      return;
+    }
+    auto sqe = worker->get_sqe(this);
+    if (!sqe) {
+      return;
+    }
+    auto req = new IoUringSend(this);
+    unsigned n = 0;
+    unsigned len = 0;
+    for (auto &p : pending.buffers()) {
+      if (n == IOV_MAX) {
+	break;
+      }
+      len += p.length();
+      ++n;
+    }
+    if (len == pending.length()) {
+      req->bl.swap(pending);
+    } else {
+      pending.splice(0, len, &req->bl);
+    }
+    req->iov.reserve(n);
+    for (auto &p : req->bl.buffers()) {
+      req->iov.push_back(iovec{(void*)p.c_str(), p.length()});
+    }
+    req->msg.msg_iov = req->iov.data();
+    req->msg.msg_iovlen = req->iov.size();
+
+    if (worker->use_send_zc(len)) {
+      io_uring_prep_sendmsg_zc(sqe, sd, &req->msg, MSG_NOSIGNAL);
+      sqe->ioprio |= worker->get_send_zc_flags();
+      worker->uring_logger->inc(l_msgr_uring_send_zc);
+    } else {
+      io_uring_prep_sendmsg(sqe, sd, &req->msg, MSG_NOSIGNAL);
+    }
+    io_uring_sqe_set_data(sqe, static_cast<IoUringRequest*>(req));
+    sends.insert(req);
+    ++inflight;
+    send_inflight = true;
+    worker->queue_submit();
+  }
+
+  void handle_send(IoUringSend *req, int res, unsigned flags) {
+    if (flags & IORING_CQE_F_NOTIF) {
+      if (res & IORING_NOTIF_USAGE_ZC_COPIED) {
+	worker->uring_logger->inc(l_msgr_uring_send_zc_copied);
+      }
+      finish_send(req);
+      return;
+    }
+    if (flags & IORING_CQE_F_MORE) {
+      req->notif_pending = true;
+    }
+    send_inflight = false;
+    if (!closed) {
+      if (res < 0 && res != -EAGAIN && res != -EINTR) {
+	error = res;
+	notify();
+      } else {
+	unsigned sent = std::max(res, 0);
+	if (sent < req->bl.length()) {
+	  ceph::buffer::list rest;
+	  rest.substr_of(req->bl, sent, req->bl.length() - sent);
+	  rest.claim_append(pending);
+	  pending.swap(rest);
+	}
+	flush();
+      }
+    }
+    if (!req->notif_pending) {
+      finish_send(req);
+    }
+  }
+
+  void finish_send(IoUringSend *req) {
+    sends.erase(req);
+    delete req;
+    --inflight;
+  }
+
+  int is_connected() {
+    start();
+    if (connected) {
+      return 1;
+    }
+    int r = handler.reconnect(sa, sd);
+    if (r == 0) {
+      connected = true;
+      clear_notify();
+      arm_recv();
+      flush();
+      return 1;
+    } else if (r < 0) {
+      return r;
+    }
+    arm_poll();
+    return 0;
+  }
+
+  void arm_poll() {
+    if (poll_armed || closed) {
+      return;
+    }
+    auto sqe = worker->get_sqe(this);
+    if (!sqe) {
+      poll_wanted = true;
+      return;
+    }
+    poll_wanted = false;
+    io_uring_prep_poll_add(sqe, sd, POLLOUT);
+    io_uring_sqe_set_data(sqe, &poll_req);
+    poll_armed = true;
+    ++inflight;
+    worker->queue_submit();
+  }
+
+  void handle_poll(int res) {
+    poll_armed = false;
+    --inflight;
+    if (!closed) {
+      notify();
+    }
+  }
+
+  /**
+   * go on with what waited for a submission queue entry
+   *
+   * @return whether it waits for another one, it may be gone otherwise
+   */
+  bool resume() {
+    if (closed) {
+      if (sd >= 0) {
+	// the requests in flight are still to be canceled
+	if (inflight && !cancel()) {
+	  return true;
+	}
+	close_sd();
+      }
+      return false;
+    }
+    if (connected && !starved) {
+      arm_recv();
+    }
+    flush();
+    if (poll_wanted) {
+      arm_poll();
+    }
+    return waiting_sqe;
+  }
+
+  /// the ring goes away: forget about the requests in flight
+  void detach() {
+    // what is in rx was received before rx_copied
+    ceph::buffer::list bl;
+    for (auto &b : rx) {
+      bl.append(worker->get_buf(b.bid) + b.off, b.len - b.off);
+    }
+    bl.claim_append(rx_copied);
+    rx_copied.swap(bl);
+    rx.clear();
+    held = 0;
+    for (auto req : sends) {
+      delete req;
+    }
+    sends.clear();
+    inflight = 0;
+    recv_armed = poll_armed = send_inflight = starved = false;
+    waiting_sqe = poll_wanted = false;
+    started = false;
+    if (!error) {
+      error = -ESHUTDOWN;
+    }
+    notify();
+  }
+
+  void close() {
+    ceph_assert(!closed);
+    closed = true;
+    ::close(notify_fd);
+    if (started) {
+      ceph_assert(worker->center.in_thread());
+      for (auto &b : rx) {
+	worker->put_buf(b.bid);
+      }
+      rx.clear();
+      held = 0;
+      if (inflight && !cancel()) {
+	// sd is closed once the cancelation is queued
+	return;
+      }
+    }
+    close_sd();
+  }
+
+  /// cancel the requests in flight, before sd goes away
+  bool cancel() {
+    auto sqe = worker->get_sqe(this);
+    if (!sqe) {
+      return false;
+    }
+    io_uring_prep_cancel_fd(sqe, sd, IORING_ASYNC_CANCEL_ALL);
+    io_uring_sqe_set_data(sqe, nullptr);
+    worker->submit();
+    return true;
+  }
+
+  void close_sd() {
+    compat_closesocket(sd);
+    sd = -1;
+    if (inflight == 0) {
+      if (started) {
+	worker->remove_socket(this);
+      }
+      delete this;
+    }
+  }
+};
+
+class IoUringConnectedSocketImpl final : public ConnectedSocketImpl {
+  IoUringSocket *s;
+
+ public:
+  explicit IoUringConnectedSocketImpl(IoUringSocket *s)
+    : s(s) {}
+  ~IoUringConnectedSocketImpl() override {
+    close();
+  }
+
+  int is_connected() override {
+    return s->is_connected();
+  }
+  ssize_t read(char *buf, size_t len) override {
+    return s->read(buf, len);
+  }
+  ssize_t send(ceph::buffer::list &bl, bool more) override {
+    return s->send(bl);
+  }
+  void shutdown() override {
+    ::shutdown(s->sd, SHUT_RDWR);
+  }
+  void close() override {
+    if (s) {
+      s->close();
+      s = nullptr;
+    }
+  }
+  void set_priority(int sd, int prio, int domain) override {
+    // sd is the eventfd fd() returns
+    s->handler.set_priority(s->sd, prio, domain);
+  }
+  int fd() const override {
+    return s->notify_fd;
+  }
+};
+
+class IoUringWorker::C_handle_reap : public EventCallback {
+  IoUringWorker *worker;
+ public:
+  explicit C_handle_reap(IoUringWorker *w) : worker(w) {}
+  void do_request(uint64_t fd) override {
+    worker->reap();
+  }
+};
+
+class IoUringWorker::C_handle_submit : public EventCallback {
+  IoUringWorker *worker;
+ public:
+  explicit C_handle_submit(IoUringWorker *w) : worker(w) {}
+  void do_request(uint64_t id) override {
+    worker->submit_queued = false;
+    worker->submit();
+    worker->resume_sqe_waiters();
+  }
+};
+
+IoUringWorker::IoUringWorker(CephContext *c, unsigned i)
+  : PosixWorker(c, i),
+    reap_handler(new C_handle_reap(this)),
+    submit_handler(new C_handle_submit(this))
+{
+  char name[128];
+  sprintf(name, "AsyncMessenger::IoUringWorker-%u", id);
+  PerfCountersBuilder plb(cct, name, l_msgr_uring_first, l_msgr_uring_last);
+  plb.add_u64_counter(l_msgr_uring_submits, "submits", "The number of io_uring submissions");
+  plb.add_u64_counter(l_msgr_uring_sqes, "sqes", "The number of io_uring requests submitted");
+  plb.add_u64_counter(l_msgr_uring_cqes, "cqes", "The number of io_uring completions reaped");
+  plb.add_u64(l_msgr_uring_recv_bufs_in_use, "recv_bufs_in_use", "The number of recv buffers holding data not read yet");
+  plb.add_u64_counter(l_msgr_uring_recv_no_bufs, "recv_no_bufs", "The number of times a recv stopped for lack of buffers");
+  plb.add_u64_counter(l_msgr_uring_recv_copied_bytes, "recv_copied_bytes", "Bytes copied out of recv buffers for connections holding too many", NULL, 0, unit_t(UNIT_BYTES));
+  plb.add_u64_counter(l_msgr_uring_send_zc, "send_zc", "The number of zero copy sends");
+  plb.add_u64_counter(l_msgr_uring_send_zc_copied, "send_zc_copied", "The number of zero copy sends the kernel copied anyway (Linux 6.2 and later)");
+  uring_logger = plb.create_perf_counters();
+  cct->get_perfcounters_collection()->add(uring_logger);
+}
+
+IoUringWorker::~IoUringWorker()
+{
+  cct->get_perfcounters_collection()->remove(uring_logger);
+  delete uring_logger;
+  delete reap_handler;
+  delete submit_handler;
+}
+
+void IoUringWorker::initialize()
+{
+  const unsigned depth = cct->_conf.get_val<uint64_t>("ms_async_uring_queue_depth");
+  struct io_uring_params p = {};
+  p.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+  int r = io_uring_queue_init_params(depth, &ring, &p);
+  if (r == -EINVAL) {
+    // older kernels
+    p = {};
+    r = io_uring_queue_init_params(depth, &ring, &p);
+  }
+  if (r < 0) {
+    lderr(cct) << __func__ << " unable to set up an io_uring: "
+	       << cpp_strerror(r) << dendl;
+    ceph_abort();
+  }
+  ring_ready = true;
+
+  ring_efd = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+  ceph_assert(ring_efd >= 0);
+  r = io_uring_register_eventfd(&ring, ring_efd);
+  ceph_assert(r == 0);
+
+  num_bufs = std::bit_ceil(
+    cct->_conf.get_val<uint64_t>("ms_async_uring_recv_buffers"));
+  buf_size = cct->_conf.get_val<Option::size_t>("ms_async_uring_recv_buffer_size");
+  bufs = static_cast<char*>(
+    aligned_alloc(CEPH_PAGE_SIZE, (size_t)num_bufs * buf_size));
+  ceph_assert(bufs);
+  buf_ring = io_uring_setup_buf_ring(&ring, num_bufs, RECV_BGID, 0, &r);
+  if (!buf_ring) {
+    lderr(cct) << __func__ << " unable to set up the recv buffers: "
+	       << cpp_strerror(r) << dendl;
+    ceph_abort();
+  }
+  const int mask = io_uring_buf_ring_mask(num_bufs);
+  for (unsigned bid = 0; bid < num_bufs; ++bid) {
+    io_uring_buf_ring_add(buf_ring, get_buf(bid), buf_size, bid, mask, bid);
+  }
+  io_uring_buf_ring_advance(buf_ring, num_bufs);
+
+  send_zc = false;
+  if (cct->_conf.get_val<bool>("ms_async_uring_send_zc")) {
+    if (auto probe = io_uring_get_probe_ring(&ring); probe) {
+      send_zc = io_uring_opcode_supported(probe, IORING_OP_SENDMSG_ZC);
+      io_uring_free_probe(probe);
+    }
+    if (!send_zc) {
+      ldout(cct, 1) << __func__ << " the kernel lacks zero copy sendmsg"
+		    << dendl;
+    }
+  }
+  // whether the kernel copied the data anyway is only reported on request,
+  // which older kernels reject
+  send_zc_flags = 0;
+#ifdef IORING_SEND_ZC_REPORT_USAGE
+  if (send_zc && get_linux_version() >= KERNEL_VERSION(6, 2, 0)) {
+    send_zc_flags = IORING_SEND_ZC_REPORT_USAGE;
+  }
+#endif
+  send_zc_min_bytes = cct->_conf.get_val<Option::size_t>("ms_async_uring_send_zc_min_bytes");
+
+  center.create_file_event(ring_efd, EVENT_READABLE, reap_handler);
+  ldout(cct, 10) << __func__ << " depth " << depth << " recv buffers "
+		 << num_bufs << "x" << buf_size << " send_zc " << send_zc
+		 << dendl;
+}
+
+void IoUringWorker::destroy()
+{
+  if (!ring_ready) {
+    return;
+  }
+  center.delete_file_event(ring_efd, EVENT_READABLE);
+  for (auto s : sockets) {
+    if (s->closed) {
+      if (s->sd >= 0) {
+	compat_closesocket(s->sd);
+      }
+      delete s;
+    } else {
+      s->detach();
+    }
+  }
+  sockets.clear();
+  starved.clear();
+  sqe_waiters.clear();
+  io_uring_free_buf_ring(&ring, buf_ring, num_bufs, RECV_BGID);
+  buf_ring = nullptr;
+  io_uring_queue_exit(&ring);
+  ring_ready = false;
+  free(bufs);
+  bufs = nullptr;
+  ::close(ring_efd);
+  ring_efd = -1;
+  uring_logger->set(l_msgr_uring_recv_bufs_in_use, 0);
+}
+
+std::unique_ptr<ConnectedSocketImpl> IoUringWorker::create_connected_socket(
+  const entity_addr_t &addr, int sd, bool connected)
+{
+  return std::make_unique<IoUringConnectedSocketImpl>(
+    new IoUringSocket(this, net, addr, sd, connected));
+}
+
+struct io_uring_sqe *IoUringWorker::get_sqe(IoUringSocket *s)
+{
+  auto sqe = io_uring_get_sqe(&ring);
+  if (!sqe) {
+    submit();
+    sqe = io_uring_get_sqe(&ring);
+  }
+  if (!sqe) {
+    // the kernel did not take any, its completion queue is full
+    ldout(cct, 10) << __func__ << " none left, " << s << " waits" << dendl;
+    if (!s->waiting_sqe) {
+      s->waiting_sqe = true;
+      sqe_waiters.push_back(s);
+    }
+    queue_submit();
+  }
+  return sqe;
+}
+
+void IoUringWorker::resume_sqe_waiters()
+{
+  auto waiters = std::move(sqe_waiters);
+  sqe_waiters.clear();
+  while (!waiters.empty()) {
+    auto s = waiters.front();
+    waiters.pop_front();
+    s->waiting_sqe = false;
+    if (s->resume()) {
+      // still none: the others wait along
+      sqe_waiters.splice(sqe_waiters.end(), waiters);
+      break;
+    }
+  }
+}
+
+void IoUringWorker::queue_submit()
+{
+  if (!submit_queued) {
+    submit_queued = true;
+    center.dispatch_event_external(submit_handler);
+  }
+}
+
+void IoUringWorker::submit()
+{
+  if (!io_uring_sq_ready(&ring)) {
+    return;
+  }
+  int r = io_uring_submit(&ring);
+  if (r < 0) {
+    if (r == -EAGAIN || r == -EBUSY) {
+      // the completion queue is full; retry once it is reaped
+      ldout(cct, 10) << __func__ << " " << cpp_strerror(r) << dendl;
+      queue_submit();
+      return;
+    }
+    lderr(cct) << __func__ << " io_uring_submit failed: "
+	       << cpp_strerror(r) << dendl;
+    ceph_abort();
+  }
+  uring_logger->inc(l_msgr_uring_submits);
+  uring_logger->inc(l_msgr_uring_sqes, r);
+}
+
+void IoUringWorker::reap()
+{
+  eventfd_t v;
+  eventfd_read(ring_efd, &v);
+  struct io_uring_cqe *cqe;
+  unsigned n = 0;
+  while (io_uring_peek_cqe(&ring, &cqe) == 0) {
+    // give its slot back first: submitting fails while the completion
+    // queue is full, and handling it may submit
+    struct io_uring_cqe c = *cqe;
+    io_uring_cqe_seen(&ring, cqe);
+    ++n;
+    handle_completion(&c);
+  }
+  uring_logger->inc(l_msgr_uring_cqes, n);
+  if (!sqe_waiters.empty()) {
+    queue_submit();
+  }
+}
+
+void IoUringWorker::handle_completion(struct io_uring_cqe *cqe)
+{
+  auto req = static_cast<IoUringRequest*>(io_uring_cqe_get_data(cqe));
+  if (!req) {
+    // a cancelation
+    return;
+  }
+  IoUringSocket *s = req->socket;
+  switch (req->op) {
+  case IoUringRequest::RECV:
+    s->handle_recv(cqe->res, cqe->flags);
+    break;
+  case IoUringRequest::SEND:
+    s->handle_send(static_cast<IoUringSend*>(req), cqe->res, cqe->flags);
+    break;
+  case IoUringRequest::POLL:
+    s->handle_poll(cqe->res);
+    break;
+  }
+  if (s->closed && s->inflight == 0 && s->sd < 0) {
+    remove_socket(s);
+    delete s;
+  }
+}
+
+void IoUringWorker::add_socket(IoUringSocket *s)
+{
+  sockets.insert(s);
+}
+
+void IoUringWorker::remove_socket(IoUringSocket *s)
+{
+  if (s->starved) {
+    starved.remove(s);
+    s->starved = false;
+  }
+  if (s->waiting_sqe) {
+    sqe_waiters.remove(s);
+    s->waiting_sqe = false;
+  }
+  sockets.erase(s);
+}
+
+void IoUringWorker::put_buf(unsigned bid)
+{
+  io_uring_buf_ring_add(buf_ring, get_buf(bid), buf_size, bid,
+			io_uring_buf_ring_mask(num_bufs), 0);
+  io_uring_buf_ring_advance(buf_ring, 1);
+  uring_logger->dec(l_msgr_uring_recv_bufs_in_use);
+  if (!starved.empty()) {
+    auto s = starved.front();
+    starved.pop_front();
+    s->starved = false;
+    s->arm_recv();
+  }
+}
+
+void IoUringWorker::wait_for_bufs(IoUringSocket *s)
+{
+  uring_logger->inc(l_msgr_uring_recv_no_bufs);
+  if (!s->starved) {
+    s->starved = true;
+    starved.push_back(s);
+  }
+}
+
+bool IoUringNetworkStack::is_supported(CephContext *cct)
+{
+  struct io_uring ring;
+  int r = io_uring_queue_init(2, &ring, 0);
+  if (r < 0) {
+    lderr(cct) << __func__ << " unable to set up an io_uring: "
+	       << cpp_strerror(r) << dendl;
+    return false;
+  }
+  // multishot recv and provided buffer rings cannot be probed for; they
+  // came before IORING_OP_SEND_ZC (Linux 6.0), which can
+  bool supported = false;
+  if (auto probe = io_uring_get_probe_ring(&ring); probe) {
+    supported = io_uring_opcode_supported(probe, IORING_OP_SEND_ZC);
+    io_uring_free_probe(probe);
+  }
+  io_uring_queue_exit(&ring);
+  if (!supported) {
+    lderr(cct) << __func__ << " multishot recv is not supported by the kernel"
+	       << dendl;
+  }
+  return supported;
+}
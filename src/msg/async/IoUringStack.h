@@ -0,0 +1,132 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_MSG_ASYNC_IOURINGSTACK_H
+#define CEPH_MSG_ASYNC_IOURINGSTACK_H
+
+#include <liburing.h>
+
+#include <list>
+#include <set>
+
+#include "PosixStack.h"
+
+class IoUringSocket;
+
+enum {
+  l_msgr_uring_first = 96000,
+  l_msgr_uring_submits,
+  l_msgr_uring_sqes,
+  l_msgr_uring_cqes,
+  l_msgr_uring_recv_bufs_in_use,
+  l_msgr_uring_recv_no_bufs,
+  l_msgr_uring_recv_copied_bytes,
+  l_msgr_uring_send_zc,
+  l_msgr_uring_send_zc_copied,
+  l_msgr_uring_last,
+};
+
+/**
+ * IoUringWorker
+ *
+ * A PosixWorker whose connected sockets are driven by an io_uring.  Each
+ * socket has a multishot recv armed, which fills the buffers of a ring of
+ * provided buffers shared by the sockets of the worker, and what is sent
+ * is queued as sendmsg requests, one in flight per socket.  The requests
+ * queued while the worker handles its events are submitted together, once
+ * per pass of its event loop, and their completions are reaped once the
+ * eventfd registered with the ring becomes readable.
+ *
+ * The EventCenter only deals with file descriptors, so each socket stands
+ * there for an eventfd of its own, which it signals as long as it has
+ * data (or an error) to read.
+ */
+class IoUringWorker : public PosixWorker {
+  class C_handle_reap;
+  class C_handle_submit;
+
+  struct io_uring ring;
+  bool ring_ready = false;
+  int ring_efd = -1;
+  EventCallbackRef reap_handler;
+  EventCallbackRef submit_handler;
+  bool submit_queued = false;
+
+  struct io_uring_buf_ring *buf_ring = nullptr;
+  char *bufs = nullptr;
+  unsigned num_bufs = 0;
+  unsigned buf_size = 0;
+  bool send_zc = false;
+  uint16_t send_zc_flags = 0;   ///< sqe->ioprio of the zero copy sends
+  uint64_t send_zc_min_bytes = 0;
+
+  std::set<IoUringSocket*> sockets;   ///< started on this worker
+  std::list<IoUringSocket*> starved;  ///< waiting for recv buffers
+  std::list<IoUringSocket*> sqe_waiters;  ///< waiting for an sqe
+
+  void initialize() override;
+  void handle_completion(struct io_uring_cqe *cqe);
+
+ public:
+  PerfCounters *uring_logger = nullptr;
+
+  IoUringWorker(CephContext *c, unsigned i);
+  ~IoUringWorker() override;
+  void destroy() override;
+  std::unique_ptr<ConnectedSocketImpl> create_connected_socket(
+    const entity_addr_t &addr, int sd, bool connected) override;
+
+  /**
+   * get a submission queue entry, submitting the queued ones if full
+   *
+   * @return nullptr if the kernel takes none meanwhile, s is resumed
+   *         once it does
+   */
+  struct io_uring_sqe *get_sqe(IoUringSocket *s);
+  /// submit the queued entries once done with the current events
+  void queue_submit();
+  void submit();
+  void resume_sqe_waiters();
+  void reap();
+
+  void add_socket(IoUringSocket *s);
+  void remove_socket(IoUringSocket *s);
+
+  char *get_buf(unsigned bid) {
+    return bufs + (size_t)bid * buf_size;
+  }
+  /// the most provided buffers a socket keeps its data in
+  unsigned get_max_held_bufs() const {
+    return std::max(1u, num_bufs / 4);
+  }
+  void put_buf(unsigned bid);
+  /// re-arm the recv of s once buffers are given back
+  void wait_for_bufs(IoUringSocket *s);
+  bool use_send_zc(uint64_t len) const {
+    return send_zc && len >= send_zc_min_bytes;
+  }
+  uint16_t get_send_zc_flags() const {
+    return send_zc_flags;
+  }
+};
+
+class IoUringNetworkStack : public PosixNetworkStack {
+  Worker* create_worker(CephContext *c, unsigned worker_id) override {
+    return new IoUringWorker(c, worker_id);
+  }
+
+ public:
+  explicit IoUringNetworkStack(CephContext *c)
+    : PosixNetworkStack(c) {}
+
+  // a connecting socket signals its eventfd once connected, which is
+  // always writable
+  bool nonblock_connect_need_writable_event() const override {
+    return false;
+  }
+
+  /// whether the kernel supports what the stack needs
+  static bool is_supported(CephContext *cct);
+};
+
+#endif //CEPH_MSG_ASYNC_IOURINGSTACK_H
@@ -33,20 +33,136 @@
 #include "include/compat.h"
 #include "include/sock_compat.h"
 
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#include <linux/errqueue.h>
+#include "ZeroCopyTracker.h"
+#define POSIX_STACK_ZEROCOPY
+#endif
+
 #define dout_subsys ceph_subsys_ms
 #undef dout_prefix
 #define dout_prefix *_dout << "PosixStack "
 
+#ifdef POSIX_STACK_ZEROCOPY
+/**
+ * The buffers a socket sent with MSG_ZEROCOPY, which are to stay as they
+ * are until the kernel tells (on the error queue of the socket) that it
+ * is done with them, as it sends from them rather than from copies.
+ */
+class PosixZeroCopy {
+  const int fd;
+  PerfCounters *logger;
+  const uint64_t min_bytes;
+  ZeroCopyTracker sent;
+
+ public:
+  PosixZeroCopy(int fd, PerfCounters *logger, uint64_t min_bytes)
+    : fd(fd), logger(logger), min_bytes(min_bytes) {}
+
+  bool eligible(const ceph::buffer::ptr &p) const {
+    return p.length() >= min_bytes;
+  }
+  bool empty() const {
+    return sent.empty();
+  }
+  /// keep off~len of bl, sent by that many sendmsg() calls
+  void pin(const ceph::buffer::list &bl, unsigned off, unsigned len,
+	   unsigned calls) {
+    sent.pin(bl, off, len, calls);
+    logger->inc(l_msgr_send_zerocopy, calls);
+  }
+  void copied() {
+    logger->inc(l_msgr_send_zerocopy_copied);
+  }
+  /// release what the kernel is done with
+  void reap() {
+    while (!sent.empty()) {
+      char control[CMSG_SPACE(sizeof(sock_extended_err)) + 64];
+      struct msghdr msg = {};
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      if (::recvmsg(fd, &msg, MSG_ERRQUEUE) < 0) {
+	break;
+      }
+      for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+	   cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+	if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) &&
+	    !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)) {
+	  continue;
+	}
+	auto serr = reinterpret_cast<sock_extended_err*>(CMSG_DATA(cmsg));
+	if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+	  continue;
+	}
+	complete(serr->ee_info, serr->ee_data,
+		 serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED);
+      }
+    }
+  }
+
+ private:
+  void complete(uint32_t lo, uint32_t hi, bool copied) {
+    logger->inc(l_msgr_send_zerocopy_completions, hi - lo + 1);
+    if (copied) {
+      // e.g. over loopback, or with a device which cannot gather
+      logger->inc(l_msgr_send_zerocopy_copied, hi - lo + 1);
+    }
+    sent.complete(lo, hi);
+  }
+};
+
+/// keeps a closed socket open until the kernel is done with its buffers
+class C_linger_zerocopy : public EventCallback {
+  static constexpr uint64_t interval_us = 10000;
+  EventCenter *center;
+  int fd;
+  std::unique_ptr<PosixZeroCopy> zc;
+
+ public:
+  C_linger_zerocopy(EventCenter *c, int fd, std::unique_ptr<PosixZeroCopy> zc)
+    : center(c), fd(fd), zc(std::move(zc)) {}
+  void do_request(uint64_t id) override {
+    zc->reap();
+    if (zc->empty()) {
+      compat_closesocket(fd);
+      delete this;
+      return;
+    }
+    center->create_time_event(interval_us, this);
+  }
+};
+#endif
+
 class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   ceph::NetHandler &handler;
+  Worker *worker;
   int _fd;
   entity_addr_t sa;
   bool connected;
+#ifdef POSIX_STACK_ZEROCOPY
+  std::unique_ptr<PosixZeroCopy> zc;
+#endif
 
  public:
-  explicit PosixConnectedSocketImpl(ceph::NetHandler &h, const entity_addr_t &sa,
+  explicit PosixConnectedSocketImpl(ceph::NetHandler &h, Worker *w,
+				    const entity_addr_t &sa,
 				    int f, bool connected)
-      : handler(h), _fd(f), sa(sa), connected(connected) {}
+      : handler(h), worker(w), _fd(f), sa(sa), connected(connected) {
+#ifdef POSIX_STACK_ZEROCOPY
+    auto cct = w->cct;
+    if (cct->_conf.get_val<bool>("ms_tcp_zerocopy")) {
+      int one = 1;
+      if (::setsockopt(_fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0) {
+	zc = std::make_unique<PosixZeroCopy>(
+	  _fd, w->get_perf_counter(),
+	  cct->_conf.get_val<Option::size_t>("ms_tcp_zerocopy_min_bytes"));
+      } else {
+	ldout(cct, 5) << __func__ << " unable to set SO_ZEROCOPY: "
+		      << cpp_strerror(ceph_sock_errno()) << dendl;
+      }
+    }
+#endif
+  }
 
   int is_connected() override {
     if (connected)
@@ -63,7 +179,21 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
     }
   }
 
+  void poll_completions() override {
+#ifdef POSIX_STACK_ZEROCOPY
+    // the completions wake the socket up as errors, until they are reaped
+    if (zc && !zc->empty()) {
+      zc->reap();
+    }
+#endif
+  }
+
   ssize_t read(char *buf, size_t len) override {
+#ifdef POSIX_STACK_ZEROCOPY
+    if (zc && !zc->empty()) {
+      zc->reap();
+    }
+#endif
     #ifdef _WIN32
     ssize_t r = ::recv(_fd, buf, len, 0);
     #else
@@ -77,22 +207,32 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   // return the sent length
   // < 0 means error occurred
   #ifndef _WIN32
-  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more)
+  // calls counts the successful ::sendmsg() calls, and nobufs tells
+  // whether it ran out of memory for the MSG_ZEROCOPY ones
+  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more,
+			    int flags = 0, unsigned *calls = nullptr,
+			    bool *nobufs = nullptr)
   {
     size_t sent = 0;
     while (1) {
       MSGR_SIGPIPE_STOPPER;
       ssize_t r;
-      r = ::sendmsg(fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+      r = ::sendmsg(fd, &msg, MSG_NOSIGNAL | flags | (more ? MSG_MORE : 0));
       if (r < 0) {
         int err = ceph_sock_errno();
         if (err == EINTR) {
           continue;
         } else if (err == EAGAIN) {
           break;
+        } else if (err == ENOBUFS && nobufs) {
+          *nobufs = true;
+          break;
         }
         return -err;
       }
+      if (calls) {
+        ++*calls;
+      }
 
       sent += r;
       if (len == sent) break;
@@ -113,7 +253,35 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
     return (ssize_t)sent;
   }
 
+#ifdef POSIX_STACK_ZEROCOPY
+  ssize_t send_zerocopy(struct msghdr &msg, unsigned len, bool more,
+			const ceph::buffer::list &bl, unsigned off)
+  {
+    unsigned calls = 0;
+    bool nobufs = false;
+    ssize_t r = do_sendmsg(_fd, msg, len, more, MSG_ZEROCOPY, &calls, &nobufs);
+    if (r > 0) {
+      zc->pin(bl, off, r, calls);
+    }
+    if (r >= 0 && nobufs) {
+      // too many sends are pinned already: copy what is left
+      zc->copied();
+      ssize_t rest = do_sendmsg(_fd, msg, len - r, more);
+      if (rest < 0) {
+	return r > 0 ? r : rest;
+      }
+      r += rest;
+    }
+    return r;
+  }
+#endif
+
   ssize_t send(ceph::buffer::list &bl, bool more) override {
+#ifdef POSIX_STACK_ZEROCOPY
+    if (zc && !zc->empty()) {
+      zc->reap();
+    }
+#endif
     size_t sent_bytes = 0;
     auto pb = std::cbegin(bl.buffers());
     uint64_t left_pbrs = bl.get_num_buffers();
@@ -121,6 +289,19 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
       struct msghdr msg;
       struct iovec msgvec[IOV_MAX];
       uint64_t size = std::min<uint64_t>(left_pbrs, IOV_MAX);
+#ifdef POSIX_STACK_ZEROCOPY
+      // the buffers sent without copying them are sent on their own
+      const bool zerocopy = zc && zc->eligible(*pb);
+      if (zc) {
+	auto p = pb;
+	for (uint64_t i = 0; i < size; ++i, ++p) {
+	  if (zc->eligible(*p) != zerocopy) {
+	    size = i;
+	    break;
+	  }
+	}
+      }
+#endif
       left_pbrs -= size;
       // FIPS zeroization audit 20191115: this memset is not security related.
       memset(&msg, 0, sizeof(msg));
@@ -133,7 +314,13 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
 	msglen += pb->length();
 	++pb;
       }
-      ssize_t r = do_sendmsg(_fd, msg, msglen, left_pbrs || more);
+      ssize_t r;
+#ifdef POSIX_STACK_ZEROCOPY
+      if (zerocopy) {
+	r = send_zerocopy(msg, msglen, left_pbrs || more, bl, sent_bytes);
+      } else
+#endif
+      r = do_sendmsg(_fd, msg, msglen, left_pbrs || more);
       if (r < 0)
         return r;
 
@@ -204,6 +391,18 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
     ::shutdown(_fd, SHUT_RDWR);
   }
   void close() override {
+#ifdef POSIX_STACK_ZEROCOPY
+    if (zc && !zc->empty()) {
+      zc->reap();
+    }
+    if (zc && !zc->empty()) {
+      // the kernel still sends from the buffers: wait for it, then close
+      ::shutdown(_fd, SHUT_WR);
+      worker->center.dispatch_event_external(
+	new C_linger_zerocopy(&worker->center, _fd, std::move(zc)));
+      return;
+    }
+#endif
     compat_closesocket(_fd);
   }
   void set_priority(int sd, int prio, int domain) override {
@@ -262,8 +461,9 @@ int PosixServerSocketImpl::accept(ConnectedSocket *sock, const SocketOptions &op
   out->set_sockaddr((sockaddr*)&ss);
   handler.set_priority(sd, opt.priority, out->get_family());
 
-  std::unique_ptr<PosixConnectedSocketImpl> csi(new PosixConnectedSocketImpl(handler, *out, sd, true));
-  *sock = ConnectedSocket(std::move(csi));
+  ceph_assert(w);
+  *sock = ConnectedSocket(
+    static_cast<PosixWorker*>(w)->create_connected_socket(*out, sd, true));
   return 0;
 }
 
@@ -330,11 +530,17 @@ int PosixWorker::connect(const entity_addr_t &addr, const SocketOptions &opts, C
   }
 
   net.set_priority(sd, opts.priority, addr.get_family());
-  *socket = ConnectedSocket(
-      std::unique_ptr<PosixConnectedSocketImpl>(new PosixConnectedSocketImpl(net, addr, sd, !opts.nonblock)));
+  *socket = ConnectedSocket(create_connected_socket(addr, sd, !opts.nonblock));
   return 0;
 }
 
+std::unique_ptr<ConnectedSocketImpl> PosixWorker::create_connected_socket(
+  const entity_addr_t &addr, int sd, bool connected)
+{
+  return std::make_unique<PosixConnectedSocketImpl>(net, this, addr, sd,
+						    connected);
+}
+
 PosixNetworkStack::PosixNetworkStack(CephContext *c)
     : NetworkStack(c)
 {
@@ -25,8 +25,9 @@
 #include "Stack.h"
 
 class PosixWorker : public Worker {
-  ceph::NetHandler net;
   void initialize() override;
+ protected:
+  ceph::NetHandler net;
  public:
   PosixWorker(CephContext *c, unsigned i)
       : Worker(c, i), net(c) {}
@@ -35,6 +36,9 @@ class PosixWorker : public Worker {
 	     const SocketOptions &opt,
 	     ServerSocket *socks) override;
   int connect(const entity_addr_t &addr, const SocketOptions &opts, ConnectedSocket *socket) override;
+  /// wrap sd, connected (or being connected) to addr, which this worker owns
+  virtual std::unique_ptr<ConnectedSocketImpl> create_connected_socket(
+    const entity_addr_t &addr, int sd, bool connected);
 };
 
 class PosixNetworkStack : public NetworkStack {
@@ -539,6 +539,7 @@ ssize_t ProtocolV2::write_message(Message *m, bool more) {
                            header.reserved};
 
   auto message = MessageFrame::Encode(
+			     tx_frame_asm,
 			     header2,
 			     m->get_payload(),
 			     m->get_middle(),
@@ -1189,8 +1190,16 @@ CtPtr ProtocolV2::read_frame_segment() {
   rx_buffer_t rx_buffer;
   uint16_t align = rx_frame_asm.get_segment_align(seg_idx);
   try {
-    rx_buffer = ceph::buffer::ptr_node::create(ceph::buffer::create_aligned(
-        onwire_len, align));
+    auto& pool = connection->worker->rx_buffer_pool;
+    bool hit = false;
+    auto raw = pool->get(onwire_len, align, &hit);
+    if (raw) {
+      connection->logger->inc(hit ? l_msgr_rx_pool_hits : l_msgr_rx_pool_misses);
+      connection->logger->set(l_msgr_rx_pool_bytes, pool->get_bytes());
+    } else {
+      raw = ceph::buffer::create_aligned(onwire_len, align);
+    }
+    rx_buffer = ceph::buffer::ptr_node::create(std::move(raw));
   } catch (const ceph::buffer::bad_alloc&) {
     // Catching because of potential issues with satisfying alignment.
     ldout(cct, 1) << __func__ << " can't allocate aligned rx_buffer"
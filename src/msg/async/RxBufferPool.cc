@@ -0,0 +1,120 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <stdlib.h>
+
+#include "RxBufferPool.h"
+
+#include "include/intarith.h"
+#include "include/mempool.h"
+#include "include/page.h"
+
+class RxBufferPool::raw_pooled : public ceph::buffer::raw {
+  std::shared_ptr<RxBufferPool> pool;
+  const unsigned cls;
+  const bool page_aligned;
+
+ public:
+  raw_pooled(char *data, unsigned len, std::shared_ptr<RxBufferPool> pool,
+	     unsigned cls, bool page_aligned)
+    : raw(data, len), pool(std::move(pool)), cls(cls),
+      page_aligned(page_aligned) {}
+  ~raw_pooled() override {
+    pool->put(data, cls, page_aligned);
+  }
+};
+
+RxBufferPool::RxBufferPool(uint64_t max_bytes, unsigned max_len)
+  : max_bytes(max_bytes),
+    max_len(std::min(max_len, get_class_len(NUM_CLASSES - 1)))
+{
+}
+
+RxBufferPool::~RxBufferPool()
+{
+  // the buffers in use keep the pool alive: all of them are back
+  for (unsigned page_aligned = 0; page_aligned < 2; page_aligned++) {
+    for (unsigned cls = 0; cls < NUM_CLASSES; cls++) {
+      auto& bufs = free_bufs[page_aligned][cls];
+      mempool::get_pool(mempool::mempool_msgr_rx_pool).adjust_count(
+	-(int64_t)bufs.size(), -(int64_t)(bufs.size() * get_class_len(cls)));
+      for (auto data : bufs) {
+	::free(data);
+      }
+    }
+  }
+}
+
+unsigned RxBufferPool::get_class(unsigned len)
+{
+  if (len <= get_class_len(0)) {
+    return 0;
+  }
+  return cbits(len - 1) - MIN_SHIFT;
+}
+
+ceph::unique_leakable_ptr<ceph::buffer::raw>
+RxBufferPool::get(unsigned len, unsigned align, bool *hit)
+{
+  if (!enabled() || len == 0 || len > max_len ||
+      align > CEPH_PAGE_SIZE || (align & (align - 1))) {
+    return nullptr;
+  }
+  const bool page_aligned = align > SMALL_ALIGN;
+  const unsigned cls = get_class(len);
+  const unsigned cls_len = get_class_len(cls);
+  char *data = nullptr;
+  {
+    std::lock_guard l(lock);
+    auto& bufs = free_bufs[page_aligned][cls];
+    if (!bufs.empty()) {
+      data = bufs.back();
+      bufs.pop_back();
+      bytes -= cls_len;
+    }
+  }
+  *hit = data;
+  if (data) {
+    mempool::get_pool(mempool::mempool_msgr_rx_pool).adjust_count(
+      -1, -(int64_t)cls_len);
+  } else if (::posix_memalign((void**)&data,
+			      page_aligned ? CEPH_PAGE_SIZE : SMALL_ALIGN,
+			      cls_len)) {
+    throw ceph::buffer::bad_alloc();
+  }
+  return ceph::unique_leakable_ptr<ceph::buffer::raw>(
+    new raw_pooled(data, len, shared_from_this(), cls, page_aligned));
+}
+
+void RxBufferPool::put(char *data, unsigned cls, bool page_aligned)
+{
+  const unsigned cls_len = get_class_len(cls);
+  {
+    std::lock_guard l(lock);
+    if (bytes + cls_len <= max_bytes) {
+      free_bufs[page_aligned][cls].push_back(data);
+      bytes += cls_len;
+      data = nullptr;
+    }
+  }
+  if (data) {
+    ::free(data);
+  } else {
+    mempool::get_pool(mempool::mempool_msgr_rx_pool).adjust_count(1, cls_len);
+  }
+}
+
+uint64_t RxBufferPool::get_bytes() const
+{
+  std::lock_guard l(lock);
+  return bytes;
+}
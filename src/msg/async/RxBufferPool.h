@@ -0,0 +1,81 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MSG_ASYNC_RXBUFFERPOOL_H
+#define CEPH_MSG_ASYNC_RXBUFFERPOOL_H
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "include/buffer.h"
+#include "include/buffer_raw.h"
+#include "include/spinlock.h"
+
+/**
+ * RxBufferPool
+ *
+ * Recycles the buffers a worker receives frame segments into.  A buffer
+ * goes back to the pool it came from once the last reference to it is
+ * dropped, by whichever thread, and the pool keeps up to max_bytes of
+ * them for the segments to come, instead of the allocator.  The buffers
+ * come in power of two size classes, and either cache line or page
+ * aligned, so that e.g. the data of a write may be written with O_DIRECT
+ * as is.
+ *
+ * The buffers in use are accounted to the buffer_anon mempool like any
+ * other, and those kept by the pool to the msgr_rx_pool one.
+ */
+class RxBufferPool : public std::enable_shared_from_this<RxBufferPool> {
+  class raw_pooled;
+
+  static constexpr unsigned MIN_SHIFT = 8;    ///< 256 bytes
+  static constexpr unsigned MAX_SHIFT = 24;   ///< 16 MiB
+  static constexpr unsigned NUM_CLASSES = MAX_SHIFT - MIN_SHIFT + 1;
+  static constexpr unsigned SMALL_ALIGN = 64;
+
+  const uint64_t max_bytes;
+  const unsigned max_len;
+  mutable ceph::spinlock lock;
+  uint64_t bytes = 0;   ///< kept by the pool
+  /// the free buffers, by alignment (cache line or page) and size class
+  std::array<std::array<std::vector<char*>, NUM_CLASSES>, 2> free_bufs;
+
+  static unsigned get_class(unsigned len);
+  static unsigned get_class_len(unsigned cls) {
+    return 1u << (cls + MIN_SHIFT);
+  }
+  void put(char *data, unsigned cls, bool page_aligned);
+
+ public:
+  /// keep up to max_bytes of buffers up to max_len long
+  RxBufferPool(uint64_t max_bytes, unsigned max_len);
+  ~RxBufferPool();
+
+  /**
+   * Get a buffer of len bytes, aligned to align.
+   *
+   * @param hit set to whether it was a recycled one
+   * @return the buffer, or nullptr if the pool does not deal with such
+   *         buffers (too long, or aligned beyond a page)
+   * @throws ceph::buffer::bad_alloc if out of memory
+   */
+  ceph::unique_leakable_ptr<ceph::buffer::raw> get(unsigned len,
+						    unsigned align,
+						    bool *hit);
+  bool enabled() const {
+    return max_bytes > 0;
+  }
+  uint64_t get_bytes() const;
+};
+
+#endif
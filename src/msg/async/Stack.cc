@@ -20,6 +20,9 @@
 #include "common/Cond.h"
 #include "common/errno.h"
 #include "PosixStack.h"
+#ifdef HAVE_ASYNC_URING
+#include "IoUringStack.h"
+#endif
 #ifdef HAVE_RDMA
 #include "rdma/RDMAStack.h"
 #endif
@@ -67,6 +70,10 @@ std::shared_ptr<NetworkStack> NetworkStack::create(CephContext *c,
 
   if (t == "posix")
     stack.reset(new PosixNetworkStack(c));
+#ifdef HAVE_ASYNC_URING
+  else if (t == "io_uring" && IoUringNetworkStack::is_supported(c))
+    stack.reset(new IoUringNetworkStack(c));
+#endif
 #ifdef HAVE_RDMA
   else if (t == "rdma")
     stack.reset(new RDMAStack(c));
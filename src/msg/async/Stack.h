@@ -21,6 +21,7 @@
 #include "common/perf_counters_key.h"
 #include "include/spinlock.h"
 #include "msg/async/Event.h"
+#include "msg/async/RxBufferPool.h"
 #include "msg/msg_types.h"
 #include <string>
 
@@ -31,6 +32,8 @@ class ConnectedSocketImpl {
   virtual int is_connected() = 0;
   virtual ssize_t read(char*, size_t) = 0;
   virtual ssize_t send(ceph::buffer::list &bl, bool more) = 0;
+  /// take the send completions the socket was notified of, if any
+  virtual void poll_completions() {}
   virtual void shutdown() = 0;
   virtual void close() = 0;
   virtual int fd() const = 0;
@@ -102,6 +105,13 @@ class ConnectedSocket {
   ssize_t send(ceph::buffer::list &bl, bool more) {
     return _csi->send(bl, more);
   }
+  /// Takes the send completions the socket was notified of.
+  ///
+  /// To be called whenever the socket is readable, whether or not the
+  /// input stream is read then, as they may keep it readable.
+  void poll_completions() {
+    _csi->poll_completions();
+  }
   /// Disables output to the socket.
   ///
   /// Current or future writes that have not been successfully flushed
@@ -213,6 +223,14 @@ enum {
   l_msgr_recv_encrypted_bytes,
   l_msgr_send_encrypted_bytes,
 
+  l_msgr_send_zerocopy,
+  l_msgr_send_zerocopy_completions,
+  l_msgr_send_zerocopy_copied,
+
+  l_msgr_rx_pool_hits,
+  l_msgr_rx_pool_misses,
+  l_msgr_rx_pool_bytes,
+
   l_msgr_last,
 };
 
@@ -240,12 +258,17 @@ class Worker {
 
   std::atomic_uint references;
   EventCenter center;
+  /// what frame segments are received into
+  std::shared_ptr<RxBufferPool> rx_buffer_pool;
 
   Worker(const Worker&) = delete;
   Worker& operator=(const Worker&) = delete;
 
   Worker(CephContext *c, unsigned worker_id)
-    : cct(c), id(worker_id), references(0), center(c) {
+    : cct(c), id(worker_id), references(0), center(c),
+      rx_buffer_pool(std::make_shared<RxBufferPool>(
+        c->_conf.get_val<Option::size_t>("ms_async_rx_buffer_pool_max_bytes"),
+        c->_conf.get_val<Option::size_t>("ms_async_rx_buffer_pool_max_len"))) {
     char name[128];
     char name_prefix[] = "AsyncMessenger::Worker";
     sprintf(name, "%s-%u", name_prefix, id);
@@ -271,6 +294,14 @@ class Worker {
     plb.add_u64_counter(l_msgr_recv_encrypted_bytes, "msgr_recv_encrypted_bytes", "Network received encrypted bytes", NULL, 0, unit_t(UNIT_BYTES));
     plb.add_u64_counter(l_msgr_send_encrypted_bytes, "msgr_send_encrypted_bytes", "Network sent encrypted bytes", NULL, 0, unit_t(UNIT_BYTES));
 
+    plb.add_u64_counter(l_msgr_send_zerocopy, "msgr_send_zerocopy", "Network sends done without copying the data");
+    plb.add_u64_counter(l_msgr_send_zerocopy_completions, "msgr_send_zerocopy_completions", "Network sends done without copying the data the kernel is done with");
+    plb.add_u64_counter(l_msgr_send_zerocopy_copied, "msgr_send_zerocopy_copied", "Network sends meant to be done without copying the data which copied it");
+
+    plb.add_u64_counter(l_msgr_rx_pool_hits, "msgr_rx_pool_hits", "Frame segments received into a recycled buffer");
+    plb.add_u64_counter(l_msgr_rx_pool_misses, "msgr_rx_pool_misses", "Frame segments received into a buffer allocated for them");
+    plb.add_u64(l_msgr_rx_pool_bytes, "msgr_rx_pool_bytes", "Bytes of buffers kept for frame segments to come", NULL, 0, unit_t(UNIT_BYTES));
+
     perf_logger = plb.create_perf_counters();
     cct->get_perfcounters_collection()->add(perf_logger);
 
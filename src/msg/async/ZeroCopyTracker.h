@@ -0,0 +1,87 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MSG_ASYNC_ZEROCOPYTRACKER_H
+#define CEPH_MSG_ASYNC_ZEROCOPYTRACKER_H
+
+#include <cstdint>
+#include <deque>
+
+#include "include/buffer.h"
+#include "include/ceph_assert.h"
+
+/**
+ * ZeroCopyTracker
+ *
+ * Keeps the buffers a socket sent with MSG_ZEROCOPY until the kernel is
+ * done with them.  The kernel numbers the sendmsg() calls of a socket
+ * with a 32 bit counter, starting from 0, and reports the ranges of
+ * calls it is done with, in any order and possibly merged.  The counter
+ * wraps around, so the ids are compared as serial numbers (RFC 1982).
+ */
+class ZeroCopyTracker {
+  struct sent_t {
+    uint32_t first;      ///< id of the first sendmsg() call
+    uint32_t last;       ///< id of the last one
+    uint32_t done = 0;   ///< calls the kernel is done with
+    ceph::buffer::list bl;
+  };
+  uint32_t next_id;
+  std::deque<sent_t> sent;
+
+  /// whether id a comes before id b
+  static bool before(uint32_t a, uint32_t b) {
+    return static_cast<int32_t>(a - b) < 0;
+  }
+
+ public:
+  explicit ZeroCopyTracker(uint32_t next_id = 0)
+    : next_id(next_id) {}
+
+  bool empty() const {
+    return sent.empty();
+  }
+  /// the number of sends still pinned
+  size_t size() const {
+    return sent.size();
+  }
+  /// keep off~len of bl, sent by that many sendmsg() calls
+  void pin(const ceph::buffer::list &bl, unsigned off, unsigned len,
+	   unsigned calls) {
+    ceph_assert(calls > 0);
+    sent_t s;
+    s.first = next_id;
+    s.last = next_id + calls - 1;
+    s.bl.substr_of(bl, off, len);
+    sent.push_back(std::move(s));
+    next_id += calls;
+  }
+  /// the kernel is done with the calls lo to hi, both included
+  void complete(uint32_t lo, uint32_t hi) {
+    for (auto &s : sent) {
+      if (before(hi, s.first)) {
+	break;
+      }
+      if (!before(s.last, lo)) {
+	uint32_t from = before(s.first, lo) ? lo : s.first;
+	uint32_t to = before(hi, s.last) ? hi : s.last;
+	s.done += to - from + 1;
+      }
+    }
+    while (!sent.empty() &&
+	   sent.front().done == sent.front().last - sent.front().first + 1) {
+      sent.pop_front();
+    }
+  }
+};
+
+#endif
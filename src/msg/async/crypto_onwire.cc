@@ -31,26 +31,45 @@ static_assert(sizeof(nonce_t) == AESGCM_IV_LEN);
 
 using key_t = std::array<std::uint8_t, AESGCM_KEY_LEN>;
 
+// the least the tx handler allocates at once, so that the ciphertext of
+// small frames shares buffers
+static constexpr const std::size_t TX_SPACE_MIN_LEN{16 << 10};
+
 // http://www.mindspring.com/~dmcgrew/gcm-nist-6.pdf
 // https://www.openssl.org/docs/man1.0.2/crypto/EVP_aes_128_gcm.html#GCM-mode
 // https://wiki.openssl.org/index.php/EVP_Authenticated_Encryption_and_Decryption
 // https://nvlpubs.nist.gov/nistpubs/Legacy/SP/nistspecialpublication800-38d.pdf
+//
+// The ciphertext goes to a buffer the handler keeps across frames, and
+// the plaintext buffers shorter than coalesce_len are copied there and
+// encrypted in place along with their neighbours, so that the segments
+// of a frame made of many small buffers take a few long EVP_EncryptUpdate()
+// calls rather than many short ones, which AES-NI and VAES do poorly.
 class AES128GCM_OnWireTxHandler : public ceph::crypto::onwire::TxHandler {
   CephContext* const cct;
   std::unique_ptr<EVP_CIPHER_CTX, decltype(&::EVP_CIPHER_CTX_free)> ectx;
-  ceph::bufferlist buffer;
+  ceph::bufferptr space;      // the ciphertext goes to its tail
+  unsigned frame_off = 0;     // where the current round starts in space
+  unsigned frame_end = 0;     // and where it is to end
+  unsigned pending_off = 0;   // the plaintext copied but not encrypted yet
+  const uint32_t coalesce_len;
   nonce_t nonce, initial_nonce;
   bool used_initial_nonce;
   bool new_nonce_format;  // 64-bit counter?
   static_assert(sizeof(nonce) == AESGCM_IV_LEN);
 
+  void encrypt(unsigned char* out, const unsigned char* in, int len);
+  void flush_pending();
+
 public:
   AES128GCM_OnWireTxHandler(CephContext* const cct,
 			    const key_t& key,
 			    const nonce_t& nonce,
-			    bool new_nonce_format)
+			    bool new_nonce_format,
+			    uint32_t coalesce_len)
     : cct(cct),
       ectx(EVP_CIPHER_CTX_new(), EVP_CIPHER_CTX_free),
+      coalesce_len(coalesce_len),
       nonce(nonce), initial_nonce(nonce), used_initial_nonce(false),
       new_nonce_format(new_nonce_format) {
     ceph_assert_always(ectx);
@@ -73,6 +92,7 @@ public:
   }
 
   void reset_tx_handler(const uint32_t* first, const uint32_t* last) override;
+  void reserve_tx_space(uint32_t len) override;
 
   void authenticated_encrypt_update(const ceph::bufferlist& plaintext) override;
   ceph::bufferlist authenticated_encrypt_final() override;
@@ -93,8 +113,11 @@ void AES128GCM_OnWireTxHandler::reset_tx_handler(const uint32_t* first,
     throw std::runtime_error("EVP_EncryptInit_ex failed");
   }
 
-  ceph_assert(buffer.get_append_buffer_unused_tail_length() == 0);
-  buffer.reserve(std::accumulate(first, last, AESGCM_TAG_LEN));
+  ceph_assert(frame_end == space.length());
+  const uint32_t len = std::accumulate(first, last, AESGCM_TAG_LEN);
+  reserve_tx_space(len);
+  frame_off = pending_off = space.length();
+  frame_end = frame_off + len;
 
   if (!new_nonce_format) {
     // msgr2.0: 32-bit counter followed by 64-bit fixed field,
@@ -105,59 +128,92 @@ void AES128GCM_OnWireTxHandler::reset_tx_handler(const uint32_t* first,
   }
 }
 
+void AES128GCM_OnWireTxHandler::reserve_tx_space(uint32_t len)
+{
+  if (space.unused_tail_length() >= len) {
+    return;
+  }
+  ceph_assert(frame_end == space.length());
+  // whatever was handed out keeps the old buffer alive
+  space = ceph::buffer::create_small_page_aligned(
+    std::max<std::size_t>(len, TX_SPACE_MIN_LEN));
+  space.set_length(0);
+  frame_off = frame_end = pending_off = 0;
+}
+
+void AES128GCM_OnWireTxHandler::encrypt(unsigned char* out,
+					const unsigned char* in,
+					int len)
+{
+  int update_len = 0;
+  if(1 != EVP_EncryptUpdate(ectx.get(), out, &update_len, in, len)) {
+    throw std::runtime_error("EVP_EncryptUpdate failed");
+  }
+  ceph_assert_always(update_len >= 0);
+  ceph_assert(update_len == len);
+}
+
+void AES128GCM_OnWireTxHandler::flush_pending()
+{
+  if (pending_off < space.length()) {
+    auto p = reinterpret_cast<unsigned char*>(space.c_str() + pending_off);
+    encrypt(p, p, space.length() - pending_off);
+    pending_off = space.length();
+  }
+}
+
 void AES128GCM_OnWireTxHandler::authenticated_encrypt_update(
   const ceph::bufferlist& plaintext)
 {
-  ceph_assert(buffer.get_append_buffer_unused_tail_length() >=
-              plaintext.length());
-  auto filler = buffer.append_hole(plaintext.length());
+  ceph_assert(space.length() + plaintext.length() + AESGCM_TAG_LEN <=
+              frame_end);
 
   for (const auto& plainbuf : plaintext.buffers()) {
-    int update_len = 0;
-
-    if(1 != EVP_EncryptUpdate(ectx.get(),
-	reinterpret_cast<unsigned char*>(filler.c_str()),
-	&update_len,
-	reinterpret_cast<const unsigned char*>(plainbuf.c_str()),
-	plainbuf.length())) {
-      throw std::runtime_error("EVP_EncryptUpdate failed");
+    if (plainbuf.length() < coalesce_len) {
+      space.append(plainbuf.c_str(), plainbuf.length());
+      continue;
     }
-    ceph_assert_always(update_len >= 0);
-    ceph_assert(static_cast<unsigned>(update_len) == plainbuf.length());
-    filler.advance(update_len);
+    flush_pending();
+    encrypt(reinterpret_cast<unsigned char*>(space.end_c_str()),
+	    reinterpret_cast<const unsigned char*>(plainbuf.c_str()),
+	    plainbuf.length());
+    space.set_length(space.length() + plainbuf.length());
+    pending_off = space.length();
   }
 
   ldout(cct, 15) << __func__
 		 << " plaintext.length()=" << plaintext.length()
-		 << " buffer.length()=" << buffer.length()
+		 << " buffer.length()=" << space.length() - frame_off
 		 << dendl;
 }
 
 ceph::bufferlist AES128GCM_OnWireTxHandler::authenticated_encrypt_final()
 {
+  flush_pending();
+
   int final_len = 0;
-  ceph_assert(buffer.get_append_buffer_unused_tail_length() ==
-              AESGCM_BLOCK_LEN);
-  auto filler = buffer.append_hole(AESGCM_BLOCK_LEN);
-  if(1 != EVP_EncryptFinal_ex(ectx.get(),
-	reinterpret_cast<unsigned char*>(filler.c_str()),
-	&final_len)) {
+  ceph_assert(space.length() + AESGCM_BLOCK_LEN == frame_end);
+  auto tag = reinterpret_cast<unsigned char*>(space.end_c_str());
+  if(1 != EVP_EncryptFinal_ex(ectx.get(), tag, &final_len)) {
     throw std::runtime_error("EVP_EncryptFinal_ex failed");
   }
   ceph_assert_always(final_len == 0);
 
   static_assert(AESGCM_BLOCK_LEN == AESGCM_TAG_LEN);
   if(1 != EVP_CIPHER_CTX_ctrl(ectx.get(),
-	EVP_CTRL_GCM_GET_TAG, AESGCM_TAG_LEN,
-	filler.c_str())) {
+	EVP_CTRL_GCM_GET_TAG, AESGCM_TAG_LEN, tag)) {
     throw std::runtime_error("EVP_CIPHER_CTX_ctrl failed");
   }
+  space.set_length(frame_end);
+  pending_off = frame_end;
 
   ldout(cct, 15) << __func__
-		 << " buffer.length()=" << buffer.length()
+		 << " buffer.length()=" << frame_end - frame_off
 		 << " final_len=" << final_len
 		 << dendl;
-  return std::move(buffer);
+  ceph::bufferlist bl;
+  bl.push_back(ceph::bufferptr(space, frame_off, frame_end - frame_off));
+  return bl;
 }
 
 // RX PART
@@ -295,11 +351,16 @@ ceph::crypto::onwire::rxtx_t ceph::crypto::onwire::rxtx_t::create_handler_pair(
       secbuf += sizeof(tx_nonce);
     }
 
+    // crimson has no CephContext to pass
+    const uint32_t coalesce_len = cct ?
+      cct->_conf.get_val<Option::size_t>("ms_secure_coalesce_len") : 0;
+
     return {
       std::make_unique<AES128GCM_OnWireRxHandler>(
 	cct, key, crossed ? tx_nonce : rx_nonce, new_nonce_format),
       std::make_unique<AES128GCM_OnWireTxHandler>(
-	cct, key, crossed ? rx_nonce : tx_nonce, new_nonce_format)
+	cct, key, crossed ? rx_nonce : tx_nonce, new_nonce_format,
+	coalesce_len)
     };
   } else {
     return { nullptr, nullptr };
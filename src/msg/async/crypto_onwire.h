@@ -77,6 +77,11 @@ struct TxHandler {
     }
   }
 
+  // Let the implementation know that the next len bytes of ciphertext,
+  // which may take several reset-update-final rounds (e.g. the parts of
+  // a msgr2.1 frame), should rather go to a single buffer.
+  virtual void reserve_tx_space(uint32_t len) = 0;
+
   // Perform encryption. Client gives full ownership right to provided
   // bufferlist. The method MUST NOT be called after _final() if there
   // was no call to _reset().
@@ -98,14 +98,31 @@ uint64_t FrameAssembler::get_frame_onwire_len() const {
   return onwire_len;
 }
 
+ceph::bufferptr FrameAssembler::get_space(unsigned len) {
+  if (m_space.unused_tail_length() < len) {
+    // whatever was carved out keeps the old buffer alive
+    m_space = buffer::create_small_page_aligned(std::max(len, SPACE_LEN));
+    m_space.set_length(0);
+  }
+  unsigned off = m_space.length();
+  m_space.set_length(off + len);
+  return ceph::bufferptr(m_space, off, len);
+}
+
+ceph::bufferptr FrameAssembler::copy_to_space(const void* p, unsigned len) {
+  auto bp = get_space(len);
+  ::memcpy(bp.c_str(), p, len);
+  return bp;
+}
+
 bufferlist FrameAssembler::asm_crc_rev0(const preamble_block_t& preamble,
-                                        bufferlist segment_bls[]) const {
+                                        bufferlist segment_bls[]) {
   epilogue_crc_rev0_block_t epilogue;
   // FIPS zeroization audit 20191115: this memset is not security related.
   ::memset(&epilogue, 0, sizeof(epilogue));
 
-  bufferlist frame_bl(sizeof(preamble) + sizeof(epilogue));
-  frame_bl.append(reinterpret_cast<const char*>(&preamble), sizeof(preamble));
+  bufferlist frame_bl;
+  frame_bl.push_back(copy_to_space(&preamble, sizeof(preamble)));
   for (size_t i = 0; i < m_descs.size(); i++) {
     ceph_assert(segment_bls[i].length() == m_descs[i].logical_len);
     epilogue.crc_values[i] = m_with_data_crc ? segment_bls[i].crc32c(-1) : 0;
@@ -113,22 +130,20 @@ bufferlist FrameAssembler::asm_crc_rev0(const preamble_block_t& preamble,
       frame_bl.claim_append(segment_bls[i]);
     }
   }
-  frame_bl.append(reinterpret_cast<const char*>(&epilogue), sizeof(epilogue));
+  frame_bl.push_back(copy_to_space(&epilogue, sizeof(epilogue)));
   return frame_bl;
 }
 
 bufferlist FrameAssembler::asm_secure_rev0(const preamble_block_t& preamble,
-                                           bufferlist segment_bls[]) const {
-  bufferlist preamble_bl(sizeof(preamble));
-  preamble_bl.append(reinterpret_cast<const char*>(&preamble),
-                     sizeof(preamble));
+                                           bufferlist segment_bls[]) {
+  bufferlist preamble_bl;
+  preamble_bl.push_back(copy_to_space(&preamble, sizeof(preamble)));
 
   epilogue_secure_rev0_block_t epilogue;
   // FIPS zeroization audit 20191115: this memset is not security related.
   ::memset(&epilogue, 0, sizeof(epilogue));
-  bufferlist epilogue_bl(sizeof(epilogue));
-  epilogue_bl.append(reinterpret_cast<const char*>(&epilogue),
-                     sizeof(epilogue));
+  bufferlist epilogue_bl;
+  epilogue_bl.push_back(copy_to_space(&epilogue, sizeof(epilogue)));
 
   // preamble + MAX_NUM_SEGMENTS + epilogue
   uint32_t onwire_lens[MAX_NUM_SEGMENTS + 2];
@@ -150,20 +165,36 @@ bufferlist FrameAssembler::asm_secure_rev0(const preamble_block_t& preamble,
 }
 
 bufferlist FrameAssembler::asm_crc_rev1(const preamble_block_t& preamble,
-                                        bufferlist segment_bls[]) const {
+                                        bufferlist segment_bls[]) {
   epilogue_crc_rev1_block_t epilogue;
   // FIPS zeroization audit 20191115: this memset is not security related.
   ::memset(&epilogue, 0, sizeof(epilogue));
   epilogue.late_status |= FRAME_LATE_STATUS_COMPLETE;
 
-  bufferlist frame_bl(sizeof(preamble) + FRAME_CRC_SIZE + sizeof(epilogue));
-  frame_bl.append(reinterpret_cast<const char*>(&preamble), sizeof(preamble));
-
+  bufferlist frame_bl;
   ceph_assert(segment_bls[0].length() == m_descs[0].logical_len);
-  if (segment_bls[0].length() > 0) {
-    uint32_t crc = m_with_data_crc ? segment_bls[0].crc32c(-1) : 0;
+  const uint32_t first_len = segment_bls[0].length();
+  ceph_le32 crc(0);
+  if (first_len > 0 && m_with_data_crc) {
+    crc = segment_bls[0].crc32c(-1);
+  }
+  if (first_len <= SPACE_COPY_MAX_LEN) {
+    // the preamble, the first segment and its crc go to a single buffer
+    auto bp = get_space(sizeof(preamble) +
+                        (first_len > 0 ? first_len + FRAME_CRC_SIZE : 0));
+    char* p = bp.c_str();
+    ::memcpy(p, &preamble, sizeof(preamble));
+    if (first_len > 0) {
+      p += sizeof(preamble);
+      segment_bls[0].cbegin().copy(first_len, p);
+      ::memcpy(p + first_len, &crc, FRAME_CRC_SIZE);
+      segment_bls[0].clear();
+    }
+    frame_bl.push_back(std::move(bp));
+  } else {
+    frame_bl.push_back(copy_to_space(&preamble, sizeof(preamble)));
     frame_bl.claim_append(segment_bls[0]);
-    encode(crc, frame_bl);
+    frame_bl.push_back(copy_to_space(&crc, FRAME_CRC_SIZE));
   }
   if (m_descs.size() == 1) {
     return frame_bl;  // no epilogue if only one segment
@@ -177,29 +208,32 @@ bufferlist FrameAssembler::asm_crc_rev1(const preamble_block_t& preamble,
       frame_bl.claim_append(segment_bls[i]);
     }
   }
-  frame_bl.append(reinterpret_cast<const char*>(&epilogue), sizeof(epilogue));
+  frame_bl.push_back(copy_to_space(&epilogue, sizeof(epilogue)));
   return frame_bl;
 }
 
 bufferlist FrameAssembler::asm_secure_rev1(const preamble_block_t& preamble,
-                                           bufferlist segment_bls[]) const {
+                                           bufferlist segment_bls[]) {
+  // the preamble, the first segment and the rest are encrypted
+  // separately, but all of them go to the same buffer
+  m_crypto->tx->reserve_tx_space(get_frame_onwire_len());
+
   bufferlist preamble_bl;
   if (segment_bls[0].length() > FRAME_PREAMBLE_INLINE_SIZE) {
     // first segment is partially inlined, inline buffer is full
-    preamble_bl.reserve(sizeof(preamble));
-    preamble_bl.append(reinterpret_cast<const char*>(&preamble),
-                       sizeof(preamble));
+    preamble_bl.push_back(copy_to_space(&preamble, sizeof(preamble)));
     segment_bls[0].splice(0, FRAME_PREAMBLE_INLINE_SIZE, &preamble_bl);
   } else {
     // first segment is fully inlined, inline buffer may need padding
-    uint32_t pad_len = FRAME_PREAMBLE_INLINE_SIZE - segment_bls[0].length();
-    preamble_bl.reserve(sizeof(preamble) + pad_len);
-    preamble_bl.append(reinterpret_cast<const char*>(&preamble),
-                       sizeof(preamble));
-    preamble_bl.claim_append(segment_bls[0]);
-    if (pad_len > 0) {
-      preamble_bl.append_zero(pad_len);
-    }
+    uint32_t first_len = segment_bls[0].length();
+    auto bp = get_space(sizeof(preamble) + FRAME_PREAMBLE_INLINE_SIZE);
+    char* p = bp.c_str();
+    ::memcpy(p, &preamble, sizeof(preamble));
+    p += sizeof(preamble);
+    segment_bls[0].cbegin().copy(first_len, p);
+    ::memset(p + first_len, 0, FRAME_PREAMBLE_INLINE_SIZE - first_len);
+    segment_bls[0].clear();
+    preamble_bl.push_back(std::move(bp));
   }
 
   m_crypto->tx->reset_tx_handler({preamble_bl.length()});
@@ -219,9 +253,8 @@ bufferlist FrameAssembler::asm_secure_rev1(const preamble_block_t& preamble,
   // FIPS zeroization audit 20191115: this memset is not security related.
   ::memset(&epilogue, 0, sizeof(epilogue));
   epilogue.late_status |= FRAME_LATE_STATUS_COMPLETE;
-  bufferlist epilogue_bl(sizeof(epilogue));
-  epilogue_bl.append(reinterpret_cast<const char*>(&epilogue),
-                     sizeof(epilogue));
+  bufferlist epilogue_bl;
+  epilogue_bl.push_back(copy_to_space(&epilogue, sizeof(epilogue)));
 
   // MAX_NUM_SEGMENTS - 1 + epilogue
   uint32_t onwire_lens[MAX_NUM_SEGMENTS];
@@ -266,8 +299,9 @@ bufferlist FrameAssembler::assemble_frame(Tag tag, bufferlist segment_bls[],
       uint32_t padded_len = get_segment_padded_len(i);
       if (padded_len > segment_bls[i].length()) {
         uint32_t pad_len = padded_len - segment_bls[i].length();
-        segment_bls[i].reserve(pad_len);
-        segment_bls[i].append_zero(pad_len);
+        auto bp = get_space(pad_len);
+        bp.zero(false);
+        segment_bls[i].push_back(std::move(bp));
       }
     }
     if (m_is_rev1) {
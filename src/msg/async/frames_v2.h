@@ -311,6 +311,10 @@ public:
                             const uint16_t segment_aligns[],
                             size_t segment_count);
 
+  // A copy of len bytes at p, in a buffer shared with the other small
+  // buffers of the frames assembled, e.g. their preambles and epilogues.
+  ceph::bufferptr copy_to_space(const void* p, unsigned len);
+
   Tag disassemble_preamble(bufferlist& preamble_bl);
 
   bool disassemble_segments(bufferlist& preamble_bl, 
@@ -338,14 +342,22 @@ private:
 
   void asm_compress(bufferlist segment_bls[]);
 
+  // The least get_space() allocates at once, and the longest first
+  // segment copied next to the preamble rather than sent on its own.
+  static constexpr unsigned SPACE_LEN = 4096;
+  static constexpr unsigned SPACE_COPY_MAX_LEN = 512;
+
+  // len bytes, uninitialized, out of m_space
+  ceph::bufferptr get_space(unsigned len);
+
   bufferlist asm_crc_rev0(const preamble_block_t& preamble,
-                          bufferlist segment_bls[]) const;
+                          bufferlist segment_bls[]);
   bufferlist asm_secure_rev0(const preamble_block_t& preamble,
-                             bufferlist segment_bls[]) const;
+                             bufferlist segment_bls[]);
   bufferlist asm_crc_rev1(const preamble_block_t& preamble,
-                          bufferlist segment_bls[]) const;
+                          bufferlist segment_bls[]);
   bufferlist asm_secure_rev1(const preamble_block_t& preamble,
-                             bufferlist segment_bls[]) const;
+                             bufferlist segment_bls[]);
 
   // Like msgr1, and unlike msgr2.0, msgr2.1 allows interpreting the
   // first segment before reading in the rest of the frame.
@@ -404,6 +416,9 @@ private:
   bool m_is_rev1;  // msgr2.1?
   bool m_with_data_crc;
   const ceph::compression::onwire::rxtx_t* m_compression;
+  // what the small buffers of the frames assembled are carved out of, so
+  // that assembling a frame seldom allocates one
+  ceph::bufferptr m_space;
 };
 
 template <class T, uint16_t... SegmentAlignmentVs>
@@ -824,6 +839,23 @@ struct MessageFrame : public Frame<MessageFrame,
     return f;
   }
 
+  // Same as above, but with the header in the space of tx_frame_asm.
+  static MessageFrame Encode(FrameAssembler &tx_frame_asm,
+                             const ceph_msg_header2 &msg_header,
+                             const ceph::bufferlist &front,
+                             const ceph::bufferlist &middle,
+                             const ceph::bufferlist &data) {
+    MessageFrame f;
+    f.segments[SegmentIndex::Msg::HEADER].push_back(
+        tx_frame_asm.copy_to_space(&msg_header, sizeof(msg_header)));
+
+    f.segments[SegmentIndex::Msg::FRONT] = front;
+    f.segments[SegmentIndex::Msg::MIDDLE] = middle;
+    f.segments[SegmentIndex::Msg::DATA] = data;
+
+    return f;
+  }
+
   static MessageFrame Decode(segment_bls_t& recv_segments) {
     MessageFrame f;
     // transfer segments' bufferlists. If a MessageFrame contains less
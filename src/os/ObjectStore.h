@@ -478,6 +478,37 @@ public:
      ceph::buffer::list& bl,
      uint32_t op_flags = 0) = 0;
 
+  /**
+   * digest -- crc32c of a byte range of data from an object
+   *
+   * Continues *crc with the data which read() would return for the
+   * range: the result is the one of ceph::buffer::list::crc32c(*crc) on
+   * it.  Implementations keeping verified checksums of the data may
+   * build the digest from them instead of hashing the data again.
+   *
+   * @param cid collection for object
+   * @param oid oid of object
+   * @param offset location offset of first byte to be digested
+   * @param len number of bytes to be digested
+   * @param crc crc32c to continue, updated on success
+   * @param op_flags is CEPH_OSD_OP_FLAG_*
+   * @returns number of bytes digested on success, or negative error code on failure.
+   */
+   virtual int digest(
+     CollectionHandle &c,
+     const ghobject_t& oid,
+     uint64_t offset,
+     size_t len,
+     uint32_t *crc,
+     uint32_t op_flags = 0) {
+     ceph::buffer::list bl;
+     int r = read(c, oid, offset, len, bl, op_flags);
+     if (r > 0) {
+       *crc = bl.crc32c(*crc);
+     }
+     return r;
+   }
+
   /**
    * fiemap -- get extent std::map of data of an object
    *
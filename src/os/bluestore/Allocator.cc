@@ -8,6 +8,7 @@
 #include "AvlAllocator.h"
 #include "BtreeAllocator.h"
 #include "HybridAllocator.h"
+#include "MagazineAllocator.h"
 #ifdef HAVE_LIBZBD
 #include "ZonedAllocator.h"
 #endif
@@ -190,6 +191,12 @@ Allocator *Allocator::create(
     return new HybridAllocator(cct, size, block_size,
       cct->_conf.get_val<uint64_t>("bluestore_hybrid_alloc_mem_cap"),
       name);
+  } else if (type == "magazine") {
+    return new MagazineAllocator(cct, size, block_size,
+      cct->_conf.get_val<uint64_t>("bluestore_hybrid_alloc_mem_cap"),
+      cct->_conf.get_val<uint64_t>("bluestore_magazine_alloc_shards"),
+      cct->_conf.get_val<uint64_t>("bluestore_magazine_alloc_size"),
+      name);
 #ifdef HAVE_LIBZBD
   } else if (type == "zoned") {
     return new ZonedAllocator(cct, size, block_size, zone_size, first_sequential_zone,
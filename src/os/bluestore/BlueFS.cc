@@ -427,6 +427,8 @@ void BlueFS::_init_logger()
 	    "How many times bluefs read found page with all 0s");
   b.add_u64(l_bluefs_read_zeros_errors, "read_zeros_errors",
 	    "How many times bluefs read found transient page with all 0s");
+  b.add_u64_counter(l_bluefs_wal_ring_fsync_count, "wal_ring_fsync_count",
+		    "WAL fsyncs persisted by a ring header without a log update");
 
   logger = b.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
@@ -991,6 +993,8 @@ int BlueFS::mount()
             << dendl;
   }
 
+  _recover_wal_ring_files();
+
   // set up the log for future writes
   log.writer = _create_writer(_get_file(1));
   ceph_assert(log.writer->file->fnode.ino == 1);
@@ -1001,6 +1005,16 @@ int BlueFS::mount()
            << dendl;
   // update log size
   logger->set(l_bluefs_log_bytes, log.writer->file->fnode.size);
+
+  if (cct->_conf->bluefs_wal_ring &&
+      !(super.incompat_features & bluefs_super_t::FEATURE_WAL_RING)) {
+    // keep older releases from mounting us before the first wal ring
+    // file is created
+    dout(1) << __func__ << " setting incompat feature wal_ring" << dendl;
+    super.incompat_features |= bluefs_super_t::FEATURE_WAL_RING;
+    _write_super(BDEV_DB);
+    _flush_bdev();
+  }
   return 0;
 
  out:
@@ -1008,6 +1022,112 @@ int BlueFS::mount()
   return r;
 }
 
+int BlueFS::_read_wal_ring(bluefs_fnode_t& fnode,
+			   uint64_t off, uint64_t len,
+			   bufferlist *bl)
+{
+  uint64_t x_off = 0;
+  auto p = fnode.seek(off, &x_off);
+  while (len > 0) {
+    if (p == fnode.extents.end()) {
+      return -ERANGE;
+    }
+    uint64_t x_len = std::min(p->length - x_off, len);
+    bufferlist t;
+    int r = _bdev_read(p->bdev, p->offset + x_off, x_len, &t, ioc[p->bdev],
+		       false);
+    if (r < 0) {
+      return r;
+    }
+    bl->claim_append(t);
+    off += x_len;
+    len -= x_len;
+    ++p;
+    x_off = 0;
+  }
+  return 0;
+}
+
+void BlueFS::_recover_wal_ring_files()
+{
+  const uint64_t slot = bluefs_fnode_t::WAL_RING_HEADER_SLOT;
+  for (auto& [ino, file] : nodes.file_map) {
+    auto& fnode = file->fnode;
+    if (!fnode.is_wal_ring() ||
+	fnode.get_allocated() < bluefs_fnode_t::WAL_RING_HEADER_SIZE) {
+      continue;
+    }
+    bufferlist slots;
+    if (_read_wal_ring(fnode, 0, bluefs_fnode_t::WAL_RING_HEADER_SIZE,
+		       &slots) < 0) {
+      derr << __func__ << " failed to read ring headers of " << fnode
+	   << dendl;
+      continue;
+    }
+    std::vector<bluefs_wal_ring_header_t> hdrs;
+    for (uint64_t i = 0; i < 2; ++i) {
+      bufferlist t;
+      t.substr_of(slots, i * slot, slot);
+      bluefs_wal_ring_header_t hdr;
+      try {
+	auto q = t.cbegin();
+	decode(hdr, q);
+	uint32_t len = q.get_off();
+	uint32_t crc;
+	decode(crc, q);
+	bufferlist e;
+	e.substr_of(t, 0, len);
+	if (crc != e.crc32c(-1)) {
+	  continue;
+	}
+      } catch (ceph::buffer::error& e) {
+	continue;
+      }
+      // only headers of the generation the log knows about count
+      if (hdr.ino != fnode.ino || hdr.mtime != fnode.mtime) {
+	continue;
+      }
+      hdrs.push_back(hdr);
+    }
+    std::sort(hdrs.begin(), hdrs.end(),
+	      [](auto& a, auto& b) { return a.seq > b.seq; });
+    for (auto& hdr : hdrs) {
+      if (hdr.size <= fnode.size) {
+	break;
+      }
+      if (hdr.tail_offset > hdr.size ||
+	  fnode.get_data_offset() + hdr.size > fnode.get_allocated()) {
+	continue;
+      }
+      // the data written since the previous header was in flight with this
+      // one; make sure it actually landed
+      uint64_t start = p2align(hdr.tail_offset, (uint64_t)super.block_size);
+      uint64_t end = round_up_to(hdr.size, (uint64_t)super.block_size);
+      bufferlist data;
+      if (_read_wal_ring(fnode, fnode.get_data_offset() + start, end - start,
+			 &data) < 0) {
+	continue;
+      }
+      bufferlist tail;
+      tail.substr_of(data, hdr.tail_offset - start,
+		     hdr.size - hdr.tail_offset);
+      if (tail.crc32c(-1) != hdr.tail_crc) {
+	dout(10) << __func__ << " " << fnode << " tail crc mismatch for "
+		 << hdr << dendl;
+	continue;
+      }
+      dout(10) << __func__ << " " << fnode << " size 0x" << std::hex
+	       << fnode.size << " -> 0x" << hdr.size << std::dec << dendl;
+      vselector->sub_usage(file->vselector_hint, fnode);
+      fnode.size = hdr.size;
+      vselector->add_usage(file->vselector_hint, fnode);
+      std::lock_guard ll(log.lock);
+      log.t.op_file_update_inc(fnode);
+      break;
+    }
+  }
+}
+
 int BlueFS::maybe_verify_layout(const bluefs_layout_t& layout) const
 {
   if (super.memorized_layout) {
@@ -1151,6 +1271,12 @@ int BlueFS::_open_super()
   }
   dout(10) << __func__ << " superblock " << super.version << dendl;
   dout(10) << __func__ << " log_fnode " << super.log_fnode << dendl;
+  if (super.incompat_features & ~bluefs_super_t::FEATURES_SUPPORTED) {
+    derr << __func__ << " unsupported incompat features 0x" << std::hex
+	 << (super.incompat_features & ~bluefs_super_t::FEATURES_SUPPORTED)
+	 << std::dec << dendl;
+    return -EOPNOTSUPP;
+  }
   return 0;
 }
 
@@ -2138,7 +2264,8 @@ int64_t BlueFS::_read_random(
     if (off < buf->bl_off || off >= buf->get_buf_end()) {
       s_lock.unlock();
       uint64_t x_off = 0;
-      auto p = h->file->fnode.seek(off, &x_off);
+      auto p = h->file->fnode.seek(off + h->file->fnode.get_data_offset(),
+				   &x_off);
       ceph_assert(p != h->file->fnode.extents.end());
       uint64_t l = std::min(p->length - x_off, len);
       //hard cap to 1GB
@@ -2251,7 +2378,8 @@ int64_t BlueFS::_read(
         buf->bl.clear();
         buf->bl_off = off & super.block_mask();
         uint64_t x_off = 0;
-        auto p = h->file->fnode.seek(buf->bl_off, &x_off);
+        auto p = h->file->fnode.seek(
+	  buf->bl_off + h->file->fnode.get_data_offset(), &x_off);
 	if (p == h->file->fnode.extents.end()) {
 	  dout(5) << __func__ << " reading less then required "
 		  << ret << "<" << ret + len << dendl;
@@ -2344,7 +2472,7 @@ void BlueFS::invalidate_cache(FileRef f, uint64_t offset, uint64_t length)
     length = round_up_to(length, super.block_size);
   }
   uint64_t x_off = 0;
-  auto p = f->fnode.seek(offset, &x_off);
+  auto p = f->fnode.seek(offset + f->fnode.get_data_offset(), &x_off);
   while (length > 0 && p != f->fnode.extents.end()) {
     uint64_t x_len = std::min(p->length - x_off, length);
     bdev[p->bdev]->invalidate_cache(p->offset + x_off, x_len);
@@ -3426,14 +3554,15 @@ int BlueFS::_flush_range_F(FileWriter *h, uint64_t offset, uint64_t length)
   ceph_assert(offset <= h->file->fnode.size);
 
   uint64_t allocated = h->file->fnode.get_allocated();
+  uint64_t need = h->file->fnode.get_data_offset() + offset + length;
   vselector->sub_usage(h->file->vselector_hint, h->file->fnode);
   // do not bother to dirty the file if we are overwriting
   // previously allocated extents.
-  if (allocated < offset + length) {
+  if (allocated < need) {
     // we should never run out of log space here; see the min runway check
     // in _flush_and_sync_log.
     int r = _allocate(vselector->select_prefer_bdev(h->file->vselector_hint),
-		      offset + length - allocated,
+		      need - allocated,
                       0,
 		      &h->file->fnode);
     if (r < 0) {
@@ -3448,7 +3577,11 @@ int BlueFS::_flush_range_F(FileWriter *h, uint64_t offset, uint64_t length)
   }
   if (h->file->fnode.size < offset + length) {
     h->file->fnode.size = offset + length;
-    h->file->is_dirty = true;
+    // a wal ring file publishes its size through the ring header on fsync
+    // instead of a bluefs log update
+    if (!h->file->fnode.is_wal_ring()) {
+      h->file->is_dirty = true;
+    }
   }
 
   dout(20) << __func__ << " file now, unflushed " << h->file->fnode << dendl;
@@ -3465,7 +3598,8 @@ int BlueFS::_flush_data(FileWriter *h, uint64_t offset, uint64_t length, bool bu
     ceph_assert(ceph_mutex_is_locked(h->file->lock));
   }
   uint64_t x_off = 0;
-  auto p = h->file->fnode.seek(offset, &x_off);
+  auto p = h->file->fnode.seek(offset + h->file->fnode.get_data_offset(),
+			       &x_off);
   ceph_assert(p != h->file->fnode.extents.end());
   dout(20) << __func__ << " in " << *p << " x_off 0x"
            << std::hex << x_off << std::dec << dendl;
@@ -3488,6 +3622,14 @@ int BlueFS::_flush_data(FileWriter *h, uint64_t offset, uint64_t length, bool bu
   auto bl = h->flush_buffer(cct, partial, length, super);
   ceph_assert(bl.length() >= length);
   h->pos = offset + length;
+  if (h->file->fnode.is_wal_ring()) {
+    // keep a running crc of everything written since the last ring header
+    // so that recovery can tell whether the tail made it to disk
+    ceph_assert(offset + partial >= h->ring_synced);
+    bufferlist t;
+    t.substr_of(bl, partial, length - partial);
+    h->ring_crc = t.crc32c(h->ring_crc);
+  }
   length = bl.length();
 
   logger->inc(l_bluefs_write_count, 1);
@@ -3546,6 +3688,60 @@ int BlueFS::_flush_data(FileWriter *h, uint64_t offset, uint64_t length, bool bu
   return 0;
 }
 
+void BlueFS::_write_wal_ring_header(FileWriter *h)
+{
+  ceph_assert(ceph_mutex_is_locked(h->lock));
+  ceph_assert(ceph_mutex_is_locked(h->file->lock));
+  auto& fnode = h->file->fnode;
+  bluefs_wal_ring_header_t hdr;
+  hdr.ino = fnode.ino;
+  hdr.mtime = fnode.mtime;
+  hdr.seq = ++h->ring_seq;
+  hdr.size = fnode.size;
+  hdr.tail_offset = h->ring_synced;
+  hdr.tail_crc = h->ring_crc;
+  dout(20) << __func__ << " " << hdr << dendl;
+
+  bufferlist bl;
+  encode(hdr, bl);
+  uint32_t crc = bl.crc32c(-1);
+  encode(crc, bl);
+  ceph_assert(bl.length() <= bluefs_fnode_t::WAL_RING_HEADER_SLOT);
+  bl.append_zero(bluefs_fnode_t::WAL_RING_HEADER_SLOT - bl.length());
+
+  // headers alternate between the two slots, so a torn write never
+  // destroys the previous valid one
+  uint64_t x_off = 0;
+  auto p = fnode.seek((hdr.seq % 2) * bluefs_fnode_t::WAL_RING_HEADER_SLOT,
+		      &x_off);
+  uint64_t bloff = 0;
+  uint64_t length = bl.length();
+  while (length > 0) {
+    ceph_assert(p != fnode.extents.end());
+    uint64_t x_len = std::min(p->length - x_off, length);
+    bufferlist t;
+    t.substr_of(bl, bloff, x_len);
+    if (cct->_conf->bluefs_sync_write) {
+      bdev[p->bdev]->write(p->offset + x_off, t, false, h->write_hint);
+    } else {
+      bdev[p->bdev]->aio_write(p->offset + x_off, t, h->iocv[p->bdev], false,
+			       h->write_hint);
+    }
+    h->dirty_devs[p->bdev] = true;
+    bloff += x_len;
+    length -= x_len;
+    ++p;
+    x_off = 0;
+  }
+  for (unsigned i = 0; i < MAX_BDEV; ++i) {
+    if (bdev[i] && h->iocv[i] && h->iocv[i]->has_pending_aios()) {
+      bdev[i]->aio_submit(h->iocv[i]);
+    }
+  }
+  h->ring_synced = hdr.size;
+  h->ring_crc = -1;
+}
+
 #ifdef HAVE_LIBAIO
 // we need to retire old completed aios so they don't stick around in
 // memory indefinitely (along with their bufferlist refs).
@@ -3713,6 +3909,13 @@ int BlueFS::truncate(FileWriter *h, uint64_t offset)/*_WF_L*/
   vselector->sub_usage(h->file->vselector_hint, h->file->fnode.size);
   h->file->fnode.size = offset;
   h->file->is_dirty = true;
+  if (h->file->fnode.is_wal_ring()) {
+    // start a new generation so ring headers describing the old, longer
+    // file are ignored on mount
+    h->file->fnode.mtime = ceph_clock_now();
+    h->ring_synced = offset;
+    h->ring_crc = -1;
+  }
   vselector->add_usage(h->file->vselector_hint, h->file->fnode.size);
   log.t.op_file_update_inc(h->file->fnode);
   logger->tinc(l_bluefs_truncate_lat, mono_clock::now() - t0);
@@ -3731,10 +3934,25 @@ int BlueFS::fsync(FileWriter *h)/*_WF_WD_WLD_WLNF_WNF*/
     int r = _flush_F(h, true);
     if (r < 0)
       return r;
+    if (h->file->fnode.is_wal_ring()) {
+      std::lock_guard fl(h->file->lock);
+      if (h->pos == h->file->fnode.size &&
+	  h->file->fnode.size > h->ring_synced) {
+	if (h->file->is_dirty) {
+	  // the log update below carries the size anyway
+	  h->ring_synced = h->file->fnode.size;
+	  h->ring_crc = -1;
+	} else {
+	  _write_wal_ring_header(h);
+	}
+      }
+    }
     _flush_bdev(h);
     if (h->file->is_dirty) {
       _signal_dirty_to_log_D(h);
       h->file->is_dirty = false;
+    } else if (h->file->fnode.is_wal_ring()) {
+      logger->inc(l_bluefs_wal_ring_fsync_count);
     }
     {
       std::lock_guard dl(dirty.lock);
@@ -3942,8 +4160,9 @@ int BlueFS::preallocate(FileRef f, uint64_t off, uint64_t len)/*_LF*/
   }
   ceph_assert(f->fnode.ino > 1);
   uint64_t allocated = f->fnode.get_allocated();
-  if (off + len > allocated) {
-    uint64_t want = off + len - allocated;
+  uint64_t need = f->fnode.get_data_offset() + off + len;
+  if (need > allocated) {
+    uint64_t want = need - allocated;
 
     vselector->sub_usage(f->vselector_hint, f->fnode);
     int r = _allocate(vselector->select_prefer_bdev(f->vselector_hint),
@@ -3955,6 +4174,11 @@ int BlueFS::preallocate(FileRef f, uint64_t off, uint64_t len)/*_LF*/
       return r;
 
     log.t.op_file_update_inc(f->fnode);
+    if (f->fnode.is_wal_ring()) {
+      // the next fsync must persist the new extents before relying on
+      // the ring header alone
+      f->is_dirty = true;
+    }
   }
   return 0;
 }
@@ -4061,6 +4285,20 @@ int BlueFS::open_for_write(
   ceph_assert(file->fnode.ino > 1);
 
   file->fnode.mtime = ceph_clock_now();
+  if (create || truncate) {
+    if (cct->_conf->bluefs_wal_ring &&
+	(super.incompat_features & bluefs_super_t::FEATURE_WAL_RING) &&
+	super.block_size <= bluefs_fnode_t::WAL_RING_HEADER_SLOT &&
+	boost::algorithm::ends_with(filename, ".log")) {
+      file->fnode.flags |= bluefs_fnode_t::FLAG_WAL_RING;
+    } else {
+      file->fnode.flags &= ~bluefs_fnode_t::FLAG_WAL_RING;
+    }
+  }
+  if (file->fnode.is_wal_ring()) {
+    // the first fsync must persist the new generation (mtime) in the log
+    file->is_dirty = true;
+  }
   file->vselector_hint = vselector->get_hint_by_dir(dirname);
   if (create || truncate) {
     vselector->add_usage(file->vselector_hint, file->fnode); // update file count
@@ -4080,6 +4318,7 @@ int BlueFS::open_for_write(
   }
   }
   *h = _create_writer(file);
+  (*h)->ring_synced = file->fnode.size;
 
   if (boost::algorithm::ends_with(filename, ".log")) {
     (*h)->writer_type = BlueFS::WRITER_WAL;
@@ -79,6 +79,7 @@ enum {
   l_bluefs_alloc_shared_size_fallbacks,
   l_bluefs_read_zeros_candidate,
   l_bluefs_read_zeros_errors,
+  l_bluefs_wal_ring_fsync_count,
   l_bluefs_last,
 };
 
@@ -227,6 +228,11 @@ public:
     std::array<IOContext*,MAX_BDEV> iocv; ///< for each bdev
     std::array<bool, MAX_BDEV> dirty_devs;
 
+    // wal ring files only, see bluefs_wal_ring_header_t
+    uint64_t ring_seq = 0;     ///< seq of the last header written
+    uint64_t ring_synced = 0;  ///< file size covered by a header or the log
+    uint32_t ring_crc = -1;    ///< crc of data flushed past ring_synced
+
     FileWriter(FileRef f)
       : file(std::move(f)),
        buffer_appender(buffer.get_page_aligned_appender(
@@ -503,6 +509,12 @@ private:
   void _flush_bdev();  // this is safe to call without a lock
   void _flush_bdev(std::array<bool, MAX_BDEV>& dirty_bdevs);  // this is safe to call without a lock
 
+  void _write_wal_ring_header(FileWriter *h);
+  int _read_wal_ring(bluefs_fnode_t& fnode,
+		     uint64_t off, uint64_t len,
+		     ceph::buffer::list *bl);
+  void _recover_wal_ring_files();
+
   int _preallocate(FileRef f, uint64_t off, uint64_t len);
   int _truncate(FileWriter *h, uint64_t off);
 
@@ -51,6 +51,7 @@
 #include "common/numa.h"
 #include "common/pretty_binary.h"
 #include "common/WorkQueue.h"
+#include "common/admin_socket.h"
 #include "kv/KeyValueHistogram.h"
 
 #ifdef HAVE_LIBZBD
@@ -133,6 +134,7 @@ const string PREFIX_DEFERRED = "L";    // id -> deferred_transaction_t
 const string PREFIX_ALLOC = "B";       // u64 offset -> u64 length (freelist)
 const string PREFIX_ALLOC_BITMAP = "b";// (see BitmapFreelistManager)
 const string PREFIX_SHARED_BLOB = "X"; // u64 SB id -> shared_blob_t
+const string PREFIX_ALLOC_DELTA = "A"; // u64 seq -> allocated + released extents
 
 #ifdef HAVE_LIBZBD
 const string PREFIX_ZONED_FM_META = "Z";  // (see ZonedFreelistManager)
@@ -554,6 +556,11 @@ static void get_deferred_key(uint64_t seq, string *out)
   _key_encode_u64(seq, out);
 }
 
+static void get_alloc_delta_key(uint64_t seq, string *out)
+{
+  _key_encode_u64(seq, out);
+}
+
 static void get_pool_stat_key(int64_t pool_id, string *key)
 {
   key->clear();
@@ -1107,6 +1114,7 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
     o->set_cached();
     if (o->pin_nref == 1) {
       (level > 0) ? lru.push_front(*o) : lru.push_back(*o);
+      o->lru_epoch = level > 0 ? lru_epoch.load() : 0;
       o->cache_age_bin = age_bins.front();
       *(o->cache_age_bin) += 1;
     }
@@ -1117,6 +1125,7 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
   void _rm(BlueStore::Onode* o) override
   {
     o->clear_cached();
+    o->lru_epoch = 0;
     if (o->lru_item.is_linked()) {
       *(o->cache_age_bin) -= 1;
       lru.erase(lru.iterator_to(*o));
@@ -1128,6 +1137,13 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
 
   void maybe_unpin(BlueStore::Onode* o) override
   {
+    // Already moved to the LRU head during this epoch, so there is nothing
+    // to do; the touch is deferred until the next bin rotation or trim.
+    // _trim_to() resets lru_epoch before re-checking pin_nref, hence
+    // either we see the reset here or it sees us unpinned.
+    if (o->lru_epoch == lru_epoch) {
+      return;
+    }
     OnodeCacheShard* ocs = this;
     ocs->lock.lock();
     // It is possible that during waiting split_cache moved us to different OnodeCacheShard.
@@ -1140,23 +1156,23 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
       if(!o->lru_item.is_linked()) {
         if (o->exists) {
 	  lru.push_front(*o);
+	  o->lru_epoch = lru_epoch.load();
 	  o->cache_age_bin = age_bins.front();
 	  *(o->cache_age_bin) += 1;
 	  dout(20) << __func__ << " " << this << " " << o->oid << " unpinned"
                    << dendl;
-        } else {
+        } else if (o->c->onode_space._try_remove(o)) {
+	  // caller still holds a reference, so o is valid here
 	  ceph_assert(num);
 	  --num;
-	  o->clear_cached();
 	  dout(20) << __func__ << " " << this << " " << o->oid << " removed"
                    << dendl;
-          // remove will also decrement nref
-          o->c->onode_space._remove(o->oid);
         }
       } else if (o->exists) {
         // move onode within LRU
         lru.erase(lru.iterator_to(*o));
         lru.push_front(*o);
+        o->lru_epoch = lru_epoch.load();
         if (o->cache_age_bin != age_bins.front()) {
           *(o->cache_age_bin) -= 1;
           o->cache_age_bin = age_bins.front();
@@ -1178,6 +1194,7 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
                                  // before n == 0 due to pinned
                                  // entries. And hence being unable
                                  // to reach new_size target.
+    bool evicted = false;
     while (n-- > 0 && lru.size() > 0) {
       BlueStore::Onode *o = &lru.back();
       lru.pop_back();
@@ -1186,15 +1203,20 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
                << o->nref << " " << o->cached << dendl;
 
       *(o->cache_age_bin) -= 1;
-      if (o->pin_nref > 1) {
+      // must precede the pin_nref check, see maybe_unpin()
+      o->lru_epoch = 0;
+      if (o->pin_nref > 1 || !o->c->onode_space._try_remove(o)) {
         dout(20) << __func__ << " " << this << " " << " " << " " << o->oid << dendl;
       } else {
 	ceph_assert(num);
         --num;
-        o->clear_cached();
-        o->c->onode_space._remove(o->oid);
+        evicted = true;
       }
     }
+    if (evicted) {
+      // the LRU order matters again, stop deferring promotions
+      ++lru_epoch;
+    }
   }
   void _move_pinned(OnodeCacheShard *to, BlueStore::Onode *o) override
   {
@@ -1983,13 +2005,17 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::add_onode(const ghobject_t& oid,
   OnodeRef& o)
 {
   std::lock_guard l(cache->lock);
-  // add entry or return existing one
-  auto p = onode_map.emplace(oid, o);
-  if (!p.second) {
-    ldout(cache->cct, 30) << __func__ << " " << oid << " " << o
-			  << " raced, returning existing " << p.first->second
-			  << dendl;
-    return p.first->second;
+  {
+    // _trim() below may need the map lock itself
+    std::unique_lock ml(lock);
+    // add entry or return existing one
+    auto p = onode_map.emplace(oid, o);
+    if (!p.second) {
+      ldout(cache->cct, 30) << __func__ << " " << oid << " " << o
+			    << " raced, returning existing " << p.first->second
+			    << dendl;
+      return p.first->second;
+    }
   }
   ldout(cache->cct, 20) << __func__ << " " << oid << " " << o << dendl;
   cache->_add(o.get(), 1);
@@ -1997,10 +2023,20 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::add_onode(const ghobject_t& oid,
   return o;
 }
 
-void BlueStore::OnodeSpace::_remove(const ghobject_t& oid)
+bool BlueStore::OnodeSpace::_try_remove(Onode* o)
 {
-  ldout(cache->cct, 20) << __func__ << " " << oid << " " << dendl;
-  onode_map.erase(oid);
+  // lookup() pins under the shared lock, so pin_nref can't grow from 1
+  // while we hold it exclusively
+  std::unique_lock l(lock);
+  if (o->pin_nref > 1) {
+    ldout(cache->cct, 20) << __func__ << " " << o->oid << " pinned" << dendl;
+    return false;
+  }
+  ldout(cache->cct, 20) << __func__ << " " << o->oid << " " << dendl;
+  o->clear_cached();
+  // remove will also decrement nref
+  onode_map.erase(o->oid);
+  return true;
 }
 
 BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
@@ -2009,7 +2045,8 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
   OnodeRef o;
 
   {
-    std::lock_guard l(cache->lock);
+    // no cache->lock here: hits only need the map to stay stable
+    std::shared_lock l(lock);
     ceph::unordered_map<ghobject_t,OnodeRef>::iterator p = onode_map.find(oid);
     if (p == onode_map.end()) {
       ldout(cache->cct, 30) << __func__ << " " << oid << " miss" << dendl;
@@ -2017,7 +2054,6 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
     } else {
       ldout(cache->cct, 30) << __func__ << " " << oid << " hit " << p->second
                             << " " << p->second->nref
-                            << " " << p->second->cached
 			    << dendl;
       // This will pin onode and implicitly touch the cache when Onode
       // eventually will become unpinned
@@ -2033,6 +2069,7 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
 void BlueStore::OnodeSpace::clear()
 {
   std::lock_guard l(cache->lock);
+  std::unique_lock ml(lock);
   ldout(cache->cct, 10) << __func__ << " " << onode_map.size()<< dendl;
   for (auto &p : onode_map) {
     cache->_rm(p.second.get());
@@ -2042,7 +2079,7 @@ void BlueStore::OnodeSpace::clear()
 
 bool BlueStore::OnodeSpace::empty()
 {
-  std::lock_guard l(cache->lock);
+  std::shared_lock l(lock);
   return onode_map.empty();
 }
 
@@ -2053,6 +2090,7 @@ void BlueStore::OnodeSpace::rename(
   const mempool::bluestore_cache_meta::string& new_okey)
 {
   std::lock_guard l(cache->lock);
+  std::unique_lock ml(lock);
   ldout(cache->cct, 30) << __func__ << " " << old_oid << " -> " << new_oid
 			<< dendl;
   ceph::unordered_map<ghobject_t,OnodeRef>::iterator po, pn;
@@ -2080,6 +2118,7 @@ void BlueStore::OnodeSpace::rename(
 
   o->oid = new_oid;
   o->key = new_okey;
+  ml.unlock();
   cache->_trim();
 }
 
@@ -4059,6 +4098,7 @@ unsigned BlueStore::ExtentMap::ExtentDecoder::decode_some(
   // handling at ExtentMap level below.
   ceph_assert(struct_v == 1 || struct_v == 2);
   denc_varint(num, p);
+  reserve_extents(num);
 
   extent_pos = 0;
   while (!p.end()) {
@@ -4212,11 +4252,19 @@ void BlueStore::ExtentMap::fault_range(
     if (!p->loaded) {
       dout(30) << __func__ << " opening shard 0x" << std::hex
 	       << p->shard_info->offset << std::dec << dendl;
-      bufferlist v;
+      size_t len = 0;
       generate_extent_shard_key_and_apply(
 	onode->key, p->shard_info->offset, &key,
         [&](const string& final_key) {
-          int r = db->get(PREFIX_OBJ, final_key, &v);
+          // decode straight out of the kv cache; the deep decode below
+          // copies whatever it keeps, so the value need not outlive it
+          int r = db->get_pinned(PREFIX_OBJ, final_key,
+            [&](const char* data, size_t l) {
+              bufferlist v;
+              v.push_back(buffer::create_static(l, const_cast<char*>(data)));
+              p->extents = decode_some(v);
+              len = l;
+            });
           if (r < 0) {
 	    derr << __func__ << " missing shard 0x" << std::hex
 		 << p->shard_info->offset << std::dec << " for " << onode->oid
@@ -4225,14 +4273,13 @@ void BlueStore::ExtentMap::fault_range(
           }
         }
       );
-      p->extents = decode_some(v);
       p->loaded = true;
       dout(20) << __func__ << " open shard 0x" << std::hex
 	       << p->shard_info->offset
 	       << " for range 0x" << offset << "~" << length << std::dec
-	       << " (" << v.length() << " bytes)" << dendl;
+	       << " (" << len << " bytes)" << dendl;
       ceph_assert(p->dirty == false);
-      ceph_assert(v.length() == p->shard_info->bytes);
+      ceph_assert(len == p->shard_info->bytes);
       onode->c->store->logger->inc(l_bluestore_onode_shard_misses);
     } else {
       onode->c->store->logger->inc(l_bluestore_onode_shard_hits);
@@ -5156,8 +5203,12 @@ void BlueStore::Collection::split_cache(
       // ensuring that nref is always >= 2 and hence onode is pinned
       OnodeRef o_pin = o;
 
-      p = onode_space.onode_map.erase(p);
-      dest->onode_space.onode_map[o->oid] = o;
+      {
+        // we hold both cache locks, so nothing but lookups can race here
+        std::scoped_lock ml(onode_space.lock, dest->onode_space.lock);
+        p = onode_space.onode_map.erase(p);
+        dest->onode_space.onode_map[o->oid] = o;
+      }
       if (o->cached) {
         get_onode_cache()->_move_pinned(dest->get_onode_cache(), o.get());
       }
@@ -5657,6 +5708,8 @@ BlueStore::BlueStore(CephContext *cct,
     finisher(cct, "commit_finisher", "cfin"),
     kv_sync_thread(this),
     kv_finalize_thread(this),
+    kv_commit_thread(this),
+    alloc_delta_thread(this),
 #ifdef HAVE_LIBZBD
     zoned_cleaner_thread(this),
 #endif
@@ -5700,6 +5753,7 @@ const char **BlueStore::get_tracked_conf_keys() const
     "bluestore_compression_max_blob_size",
     "bluestore_compression_max_blob_size_ssd",
     "bluestore_compression_max_blob_size_hdd",
+    "bluestore_compression_chunk_size",
     "bluestore_compression_required_ratio",
     "bluestore_max_alloc_size",
     "bluestore_prefer_deferred_size",
@@ -5754,7 +5808,8 @@ void BlueStore::handle_conf_change(const ConfigProxy& conf,
   if (changed.count("bluestore_compression_mode") ||
       changed.count("bluestore_compression_algorithm") ||
       changed.count("bluestore_compression_min_blob_size") ||
-      changed.count("bluestore_compression_max_blob_size")) {
+      changed.count("bluestore_compression_max_blob_size") ||
+      changed.count("bluestore_compression_chunk_size")) {
     if (bdev) {
       _set_compression();
     }
@@ -5845,6 +5900,9 @@ void BlueStore::_set_compression()
     }
   }
 
+  comp_chunk_size = std::bit_floor(
+    uint64_t(cct->_conf->bluestore_compression_chunk_size));
+
   auto& alg_name = cct->_conf->bluestore_compression_algorithm;
   if (!alg_name.empty()) {
     compressor = Compressor::create(cct, alg_name);
@@ -5859,6 +5917,7 @@ void BlueStore::_set_compression()
 	   << " alg " << (compressor ? compressor->get_type_name() : "(none)")
 	   << " min_blob " << comp_min_blob_size
 	   << " max_blob " << comp_max_blob_size
+	   << " chunk " << comp_chunk_size
 	   << dendl;
 }
 
@@ -6170,6 +6229,14 @@ void BlueStore::_init_logger()
   b.add_time_avg(l_bluestore_read_lat, "read_lat",
 		 "Average read latency",
 		 "r_l", PerfCountersBuilder::PRIO_CRITICAL);
+  b.add_time_avg(l_bluestore_digest_lat, "digest_lat",
+		 "Average data digest latency");
+  b.add_u64_counter(l_bluestore_digest_csum_bytes, "digest_csum_bytes",
+		    "Bytes digested from the stored blob checksums",
+		    NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_digest_data_bytes, "digest_data_bytes",
+		    "Bytes digested by hashing their data",
+		    NULL, 0, unit_t(UNIT_BYTES));
   //****************************************
 
   // kv_thread latencies
@@ -6186,6 +6253,11 @@ void BlueStore::_init_logger()
   b.add_time_avg(l_bluestore_kv_final_lat, "kv_final_lat",
 		 "Average kv_finalize thread latency",
 		 "kfll", PerfCountersBuilder::PRIO_INTERESTING);
+  b.add_time_avg(l_bluestore_kv_pipeline_wait_lat, "kv_pipeline_wait_lat",
+		 "Average time kv_sync thread waited for the previous batch's "
+		 "commit to start (bluestore_kv_sync_pipeline)");
+  b.add_u64_counter(l_bluestore_kv_pipelined, "kv_pipelined",
+		    "Batches flushed while the previous batch was committing");
   //****************************************
 
   // write op stats
@@ -6246,6 +6318,15 @@ void BlueStore::_init_logger()
 		    NULL,
 		    PerfCountersBuilder::PRIO_DEBUGONLY,
 		    unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_submitted_deferred_ios,
+		    "submitted_deferred_ios",
+		    "Deferred ios merged into submitted deferred writes");
+  b.add_u64_counter(l_bluestore_deferred_seek_bytes,
+		    "deferred_seek_bytes",
+		    "Total distance between consecutive deferred writes",
+		    NULL,
+		    PerfCountersBuilder::PRIO_DEBUGONLY,
+		    unit_t(UNIT_BYTES));
 
   b.add_u64_counter(l_bluestore_write_big_skipped_blobs,
       "write_big_skipped_blobs",
@@ -6282,6 +6363,14 @@ void BlueStore::_init_logger()
 	    "Sum for beneficial compress ops");
   b.add_u64_counter(l_bluestore_compress_rejected_count, "compress_rejected_count",
 	    "Sum for compress ops rejected due to low net gain of space");
+  b.add_u64_counter(l_bluestore_decompressed_bytes, "decompressed_bytes",
+	    "Sum for bytes decompressed to serve reads",
+	    NULL, PerfCountersBuilder::PRIO_USEFUL, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_decompressed_wanted_bytes,
+	    "decompressed_wanted_bytes",
+	    "Sum for decompressed bytes that reads asked for "
+	    "(decompressed_bytes / this is the read amplification)",
+	    NULL, PerfCountersBuilder::PRIO_USEFUL, unit_t(UNIT_BYTES));
   //****************************************
 
   // onode cache stats
@@ -6426,6 +6515,25 @@ void BlueStore::_init_logger()
     alloc_hist_x_axis_config, alloc_hist_y_axis_config,
     "Histogram of requested block allocations vs. given ones");
 
+  PerfHistogramCommon::axis_config_d deferred_seek_hist_x_axis_config{
+    "Seek distance (bytes)",
+    PerfHistogramCommon::SCALE_LOG2,
+    0,
+    4096,
+    36,                              ///< up to 32TB, and the ones beyond
+  };
+  PerfHistogramCommon::axis_config_d deferred_seek_hist_y_axis_config{
+    "Write size (bytes)",
+    PerfHistogramCommon::SCALE_LOG2,
+    0,
+    4096,
+    13,
+  };
+  b.add_u64_counter_histogram(
+    l_bluestore_deferred_seek_hist, "deferred_seek_histogram",
+    deferred_seek_hist_x_axis_config, deferred_seek_hist_y_axis_config,
+    "Histogram of distance from the previous deferred write vs. write size");
+
   logger = b.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 }
@@ -6913,7 +7021,8 @@ int BlueStore::_create_alloc()
   return 0;
 }
 
-int BlueStore::_init_alloc(std::map<uint64_t, uint64_t> *zone_adjustments)
+int BlueStore::_init_alloc(std::map<uint64_t, uint64_t> *zone_adjustments,
+			   bool replay_alloc_deltas)
 {
   int r = _create_alloc();
   if (r < 0) {
@@ -6983,7 +7092,44 @@ int BlueStore::_init_alloc(std::map<uint64_t, uint64_t> *zone_adjustments)
 
   uint64_t num = 0, bytes = 0;
   utime_t start_time = ceph_clock_now();
-  if (!fm->is_null_manager()) {
+  alloc_delta_log = false;
+  alloc_delta_stale = false;
+  {
+    // a previous run may have left deltas behind even if the option is off
+    // now, in which case the allocation file alone is outdated
+    KeyValueDB::Iterator it = db->get_iterator(PREFIX_ALLOC_DELTA);
+    it->lower_bound(string());
+    alloc_delta_stale = it->valid();
+  }
+  if (_use_alloc_delta_log() && replay_alloc_deltas && !skip_alloc_delta_replay) {
+    alloc_delta_t delta;
+    std::vector<std::string> keys;
+    int r = load_alloc_deltas(&delta, &keys);
+    if (r == 0) {
+      r = restore_allocator(alloc, &num, &bytes, &delta);
+    }
+    if (r == 0) {
+      alloc_delta_log = true;
+      alloc_delta_stale = false;
+      alloc_delta_pending = keys.size();
+      alloc_delta_seq = 0;
+      if (!keys.empty()) {
+	uint64_t seq;
+	_key_decode_u64(keys.back().c_str(), &seq);
+	alloc_delta_seq = seq;
+      }
+      utime_t duration = ceph_clock_now() - start_time;
+      dout(1) << __func__ << " loaded allocation file and " << keys.size()
+	      << " deltas in " << duration << " seconds" << dendl;
+    } else {
+      dout(0) << __func__ << " failed to load allocation file and deltas: "
+	      << cpp_strerror(r) << dendl;
+    }
+  }
+  skip_alloc_delta_replay = false;
+  if (alloc_delta_log) {
+    // nothing else to load
+  } else if (!fm->is_null_manager()) {
     // This is the original path - loading allocation map from RocksDB and feeding into the allocator
     dout(5) << __func__ << "::NCB::loading allocation from FM -> alloc" << dendl;
     // initialize from freelist
@@ -7007,7 +7153,7 @@ int BlueStore::_init_alloc(std::map<uint64_t, uint64_t> *zone_adjustments)
       derr << __func__ << "::NCB::Please change the value of bluestore_allocation_from_file to TRUE in your ceph.conf file" << dendl;
       return -ENOTSUP; // Operation not supported
     }
-    if (restore_allocator(alloc, &num, &bytes) == 0) {
+    if (!alloc_delta_stale && restore_allocator(alloc, &num, &bytes) == 0) {
       dout(5) << __func__ << "::NCB::restore_allocator() completed successfully alloc=" << alloc << dendl;
     } else {
       // This must mean that we had an unplanned shutdown and didn't manage to destage the allocator
@@ -7055,7 +7201,10 @@ void BlueStore::_post_init_alloc(const std::map<uint64_t, uint64_t>& zone_adjust
     r = db->submit_transaction_sync(t);
   } else
 #endif
-  if (fm->is_null_manager()) {
+  if (alloc_delta_log) {
+    // the file stays valid, the deltas logged from now on complete it
+    need_to_destage_allocation_file = true;
+  } else if (fm->is_null_manager() || _use_alloc_delta_log() || alloc_delta_stale) {
     // Now that we load the allocation map we need to invalidate the file as new allocation won't be reflected
     // Changes to the allocation map (alloc/release) are not updated inline and will only be stored on umount()
     // This means that we should not use the existing file on failure case (unplanned shutdown) and must resort
@@ -7232,8 +7381,8 @@ bool BlueStore::_use_rotational_settings()
 
 bool BlueStore::is_statfs_recoverable() const
 {
-  // abuse fm for now
-  return has_null_manager();
+  // abuse fm for now; with the delta log statfs must survive a crash as well
+  return has_null_manager() && !alloc_delta_log;
 }
 
 bool BlueStore::test_mount_in_use()
@@ -7516,9 +7665,13 @@ int BlueStore::_open_db_and_around(bool read_only, bool to_repair)
   if (r < 0)
     goto out_db;
 
-  r = _init_alloc(&zone_adjustments);
+  r = _init_alloc(&zone_adjustments, !to_repair);
   if (r < 0)
     goto out_fm;
+  if (read_only || to_repair) {
+    // whatever was loaded, this run doesn't log deltas
+    alloc_delta_log = false;
+  }
 
   // Re-open in the proper mode(s).
 
@@ -7538,7 +7691,7 @@ int BlueStore::_open_db_and_around(bool read_only, bool to_repair)
 
   // when function is called in repair mode (to_repair=true) we skip db->open()/create()
   // we can't change bluestore allocation so no need to invlidate allocation-file
-  if (fm->is_null_manager() && !read_only && !to_repair) {
+  if (fm->is_null_manager() && !alloc_delta_log && !read_only && !to_repair) {
     // Now that we load the allocation map we need to invalidate the file as new allocation won't be reflected
     // Changes to the allocation map (alloc/release) are not updated inline and will only be stored on umount()
     // This means that we should not use the existing file on failure case (unplanned shutdown) and must resort
@@ -7549,6 +7702,14 @@ int BlueStore::_open_db_and_around(bool read_only, bool to_repair)
       goto out_alloc;
     }
   }
+  // deltas that were not loaded don't belong to the file written on umount
+  if (alloc_delta_stale && !read_only && !to_repair) {
+    r = purge_alloc_deltas();
+    if (r != 0) {
+      derr << __func__ << " failed to remove stale allocation deltas" << dendl;
+      goto out_alloc;
+    }
+  }
 
   // when function is called in repair mode (to_repair=true) we skip db->open()/create()
   if (!is_db_rotational() && !read_only && !to_repair && cct->_conf->bluestore_allocation_from_file
@@ -7842,6 +8003,11 @@ void BlueStore::_close_db()
            << " pool stats=" << osd_pools.size()
            << dendl;
   bool do_destage = !db_was_opened_read_only && need_to_destage_allocation_file;
+  if (do_destage &&
+      cct->_conf.get_val<bool>("bluestore_debug_skip_allocation_file_destage")) {
+    derr << __func__ << " skipping allocation file destage" << dendl;
+    do_destage = false;
+  }
   if (do_destage && is_statfs_recoverable()) {
     auto t = db->get_transaction();
     store_statfs_t s;
@@ -7890,7 +8056,9 @@ void BlueStore::_close_db()
   delete db;
   db = nullptr;
 
-  if (do_destage && fm && fm->is_null_manager()) {
+  // never write a file that stale deltas would be replayed on top of
+  if (do_destage && fm && (fm->is_null_manager() || _use_alloc_delta_log()) &&
+      !alloc_delta_stale) {
     int ret = store_allocator(alloc);
     if (ret != 0) {
       derr << __func__ << "::NCB::store_allocator() failed (continue with bitmapFreelistManager)" << dendl;
@@ -8747,6 +8915,8 @@ int BlueStore::expand_devices(ostream& out)
       alloc->init_add_free(size0, size - size0);
       need_to_destage_allocation_file = true;
     }
+    // the allocation file doesn't cover the new space
+    skip_alloc_delta_replay = true;
     _close_db_and_around();
 
     // mount in read/write to sync expansion changes
@@ -9428,6 +9598,17 @@ BlueStore::OnodeRef BlueStore::fsck_check_objects_shallow(
       res_statfs->data_compressed += blob.get_compressed_payload_length();
       res_statfs->data_compressed_original +=
         i.first->get_referenced_bytes();
+      if (blob.has_compressed_chunks()) {
+        auto& ends = blob.compressed_chunk_ends;
+        uint64_t chunk_size = blob.get_compressed_chunk_size();
+        if (ends.size() != div_round_up(blob.get_logical_length(), chunk_size) ||
+            !std::is_sorted(ends.begin(), ends.end()) ||
+            ends.back() != blob.get_compressed_payload_length()) {
+          derr << "fsck error: " << oid << " blob " << *i.first
+               << " has a bad compressed chunk index" << dendl;
+          ++errors;
+        }
+      }
     }
     if (depth != FSCK_SHALLOW && repairer) {
       for (auto e : blob.get_extents()) {
@@ -9476,6 +9657,10 @@ BlueStore::OnodeRef BlueStore::fsck_check_objects_shallow(
     } else if (depth != FSCK_SHALLOW) {
       ceph_assert(used_blocks);
       string ctx_descr = " oid " + stringify(oid);
+      // the below lock is optional and provided in multithreading mode only
+      if (ctx.used_blocks_lock) {
+        ctx.used_blocks_lock->lock();
+      }
       errors += _fsck_check_extents(ctx_descr,
 	blob.get_extents(),
         blob.is_compressed(),
@@ -9484,6 +9669,9 @@ BlueStore::OnodeRef BlueStore::fsck_check_objects_shallow(
 	repairer,
         *res_statfs,
         depth);
+      if (ctx.used_blocks_lock) {
+        ctx.used_blocks_lock->unlock();
+      }
     } else {
       errors += _fsck_sum_extents(
         blob.get_extents(),
@@ -9806,6 +9994,160 @@ public:
   };
 };
 
+/*
+ * Readers for deep fsck when the objects are walked by a single thread
+ * (see _fsck_check_objects_parallel otherwise), which hands objects over
+ * here to have their data read back (and checksums verified).  The queue is bounded so that
+ * the walk never gets far ahead of the reads and the number of onodes
+ * pinned in memory stays small.
+ */
+class DeepFSCKReaders {
+  BlueStore* store;
+  BlueStore::FSCK_Progress& progress;
+  const size_t max_queued;
+
+  ceph::mutex lock = ceph::make_mutex("DeepFSCKReaders::lock");
+  ceph::condition_variable cond;
+  std::deque<std::pair<BlueStore::CollectionRef, BlueStore::OnodeRef>> q;
+  bool stop = false;
+  std::vector<std::thread> threads;
+  std::atomic<int64_t> errors = {0};
+
+  void entry() {
+    std::unique_lock l(lock);
+    while (true) {
+      if (q.empty()) {
+        if (stop) {
+          break;
+        }
+        cond.wait(l);
+        continue;
+      }
+      auto [c, o] = std::move(q.front());
+      q.pop_front();
+      --progress.deep_queued;
+      cond.notify_all();
+      l.unlock();
+      int64_t e = store->fsck_check_object_data(c, o);
+      errors += e;
+      progress.deep_errors += e;
+      ++progress.deep_objects;
+      progress.deep_bytes += o->onode.size;
+      o.reset();
+      c.reset();
+      l.lock();
+    }
+  }
+
+public:
+  DeepFSCKReaders(BlueStore* _store,
+                  BlueStore::FSCK_Progress& _progress,
+                  size_t thread_count)
+    : store(_store),
+      progress(_progress),
+      max_queued(thread_count * 4) {
+    for (size_t i = 0; i < thread_count; ++i) {
+      threads.emplace_back(make_named_thread("bstore_fsck_rd",
+                                             &DeepFSCKReaders::entry, this));
+    }
+  }
+  ~DeepFSCKReaders() {
+    finish();
+  }
+
+  void queue(BlueStore::CollectionRef c, BlueStore::OnodeRef o) {
+    std::unique_lock l(lock);
+    cond.wait(l, [this] { return q.size() < max_queued; });
+    q.emplace_back(std::move(c), std::move(o));
+    ++progress.deep_queued;
+    cond.notify_all();
+  }
+
+  /// wait for all queued reads, returns the number of errors they found
+  int64_t finish() {
+    {
+      std::lock_guard l(lock);
+      stop = true;
+      cond.notify_all();
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    threads.clear();
+    return errors.exchange(0);
+  }
+};
+
+class FSCKProgressHook : public AdminSocketHook {
+  BlueStore* store;
+  bool registered = false;
+public:
+  explicit FSCKProgressHook(BlueStore* _store) : store(_store) {
+    AdminSocket* admin_socket = store->cct->get_admin_socket();
+    if (admin_socket) {
+      // fails if another store in this process is being checked already
+      registered = admin_socket->register_command(
+        "bluestore fsck progress",
+        this,
+        "show the progress of a running fsck") == 0;
+    }
+  }
+  ~FSCKProgressHook() {
+    if (registered) {
+      store->cct->get_admin_socket()->unregister_commands(this);
+    }
+  }
+
+  int call(std::string_view command,
+           const cmdmap_t& cmdmap,
+           const bufferlist&,
+           Formatter* f,
+           std::ostream& ss,
+           bufferlist& out) override {
+    f->open_object_section("fsck_progress");
+    store->dump_fsck_progress(f);
+    f->close_section();
+    return 0;
+  }
+};
+
+void BlueStore::FSCK_Progress::dump(ceph::Formatter* f) const
+{
+  const char* p = phase;
+  f->dump_string("phase", p ? p : "idle");
+  f->dump_float("elapsed", ceph::to_seconds<double>(ceph::mono_clock::now() - start));
+  f->dump_unsigned("object_keys", object_keys);
+  f->dump_unsigned("deep_queued", deep_queued);
+  f->dump_unsigned("deep_objects", deep_objects);
+  f->dump_unsigned("deep_bytes", deep_bytes);
+  f->dump_unsigned("deep_errors", deep_errors);
+}
+
+int64_t BlueStore::fsck_check_object_data(CollectionRef c, OnodeRef o)
+{
+  int64_t errors = 0;
+  std::shared_lock cl(c->lock);
+  bufferlist bl;
+  uint64_t max_read_block = cct->_conf->bluestore_fsck_read_bytes_cap;
+  uint64_t offset = 0;
+  do {
+    uint64_t l = std::min(uint64_t(o->onode.size - offset), max_read_block);
+    int r = _do_read(c.get(), o, offset, l, bl,
+      CEPH_OSD_OP_FLAG_FADVISE_NOCACHE);
+    if (r < 0) {
+      ++errors;
+      derr << "fsck error: " << o->oid << std::hex
+        << " error during read: "
+        << " " << offset << "~" << l
+        << " " << cpp_strerror(r) << std::dec
+        << dendl;
+      break;
+    }
+    offset += l;
+  } while (offset < o->onode.size);
+  return errors;
+}
+
 void BlueStore::_fsck_check_object_omap(FSCKDepth depth,
   OnodeRef& o,
   const BlueStore::FSCK_ObjectCtx& ctx)
@@ -9952,262 +10294,435 @@ void BlueStore::_fsck_check_object_omap(FSCKDepth depth,
   }
 }
 
-void BlueStore::_fsck_check_objects(
+size_t BlueStore::_fsck_walk_objects(
   FSCKDepth depth,
+  const string& begin,
+  const string& end,
+  uint64_t_btree_t& used_nids,
+  std::function<bool(int64_t, CollectionRef, const ghobject_t&,
+                     const string&, const bufferlist&)> queue_shallow,
+  std::function<void(CollectionRef, OnodeRef)> queue_deep,
   BlueStore::FSCK_ObjectCtx& ctx)
 {
   auto& errors = ctx.errors;
-  auto sb_info_lock = ctx.sb_info_lock;
-  auto& sb_info = ctx.sb_info;
-  auto& sb_ref_counts = ctx.sb_ref_counts;
-  auto repairer = ctx.repairer;
-
-  uint64_t_btree_t used_nids;
-
   size_t processed_myself = 0;
 
   auto it = db->get_iterator(PREFIX_OBJ, KeyValueDB::ITERATOR_NOCACHE);
+  if (!it) {
+    return 0;
+  }
   mempool::bluestore_fsck::list<string> expecting_shards;
-  if (it) {
-    const size_t thread_count = cct->_conf->bluestore_fsck_quick_fix_threads;
-    typedef ShallowFSCKThreadPool::FSCKWorkQueue<256> WQ;
-    std::unique_ptr<WQ> wq(
-      new WQ(
-        "FSCKWorkQueue",
-        (thread_count ? : 1) * 32,
-        this,
-        sb_info_lock,
-        sb_info,
-	sb_ref_counts,
-        repairer));
-
-    ShallowFSCKThreadPool thread_pool(cct, "ShallowFSCKThreadPool", "ShallowFSCK", thread_count);
-
-    thread_pool.add_work_queue(wq.get());
-    if (depth == FSCK_SHALLOW && thread_count > 0) {
-      //not the best place but let's check anyway
-      ceph_assert(sb_info_lock);
-      thread_pool.start();
+  CollectionRef c;
+  int64_t pool_id = -1;
+  spg_t pgid;
+  bool seen_object = false;
+  for (it->lower_bound(begin); it->valid(); it->next()) {
+    dout(30) << __func__ << " key "
+      << pretty_binary_string(it->key()) << dendl;
+    if (is_extent_shard_key(it->key())) {
+      // the shards of the last object of the previous part, if any, are
+      // checked by the walk of that part
+      if (!seen_object && !begin.empty()) {
+        continue;
+      }
+    } else if (!end.empty() && it->key() >= end) {
+      break;
     }
-
-    // fill global if not overriden below
-    CollectionRef c;
-    int64_t pool_id = -1;
-    spg_t pgid;
-    for (it->lower_bound(string()); it->valid(); it->next()) {
-      dout(30) << __func__ << " key "
-        << pretty_binary_string(it->key()) << dendl;
-      if (is_extent_shard_key(it->key())) {
-        if (depth == FSCK_SHALLOW) {
-          continue;
-        }
-        while (!expecting_shards.empty() &&
-          expecting_shards.front() < it->key()) {
-          derr << "fsck error: missing shard key "
-            << pretty_binary_string(expecting_shards.front())
-            << dendl;
-          ++errors;
-          expecting_shards.pop_front();
-        }
-        if (!expecting_shards.empty() &&
-          expecting_shards.front() == it->key()) {
-          // all good
-          expecting_shards.pop_front();
-          continue;
-        }
-
-        uint32_t offset;
-        string okey;
-        get_key_extent_shard(it->key(), &okey, &offset);
-        derr << "fsck error: stray shard 0x" << std::hex << offset
-          << std::dec << dendl;
-        if (expecting_shards.empty()) {
-          derr << "fsck error: " << pretty_binary_string(it->key())
-            << " is unexpected" << dendl;
-          ++errors;
-          continue;
-        }
-        while (expecting_shards.front() > it->key()) {
-          derr << "fsck error:   saw " << pretty_binary_string(it->key())
-            << dendl;
-          derr << "fsck error:   exp "
-            << pretty_binary_string(expecting_shards.front()) << dendl;
-          ++errors;
-          expecting_shards.pop_front();
-          if (expecting_shards.empty()) {
-            break;
-          }
-        }
+    ++fsck_progress.object_keys;
+    if (is_extent_shard_key(it->key())) {
+      if (depth == FSCK_SHALLOW) {
+        continue;
+      }
+      while (!expecting_shards.empty() &&
+        expecting_shards.front() < it->key()) {
+        derr << "fsck error: missing shard key "
+          << pretty_binary_string(expecting_shards.front())
+          << dendl;
+        ++errors;
+        expecting_shards.pop_front();
+      }
+      if (!expecting_shards.empty() &&
+        expecting_shards.front() == it->key()) {
+        // all good
+        expecting_shards.pop_front();
         continue;
       }
 
-      ghobject_t oid;
-      int r = get_key_object(it->key(), &oid);
-      if (r < 0) {
-        derr << "fsck error: bad object key "
-          << pretty_binary_string(it->key()) << dendl;
+      uint32_t offset;
+      string okey;
+      get_key_extent_shard(it->key(), &okey, &offset);
+      derr << "fsck error: stray shard 0x" << std::hex << offset
+        << std::dec << dendl;
+      if (expecting_shards.empty()) {
+        derr << "fsck error: " << pretty_binary_string(it->key())
+          << " is unexpected" << dendl;
         ++errors;
         continue;
       }
-      if (!c ||
-        oid.shard_id != pgid.shard ||
-        oid.hobj.get_logical_pool() != (int64_t)pgid.pool() ||
-        !c->contains(oid)) {
-        c = nullptr;
-        for (auto& p : coll_map) {
-          if (p.second->contains(oid)) {
-            c = p.second;
-            break;
-          }
-        }
-        if (!c) {
-          derr << "fsck error: stray object " << oid
-            << " not owned by any collection" << dendl;
-          ++errors;
-          continue;
-        }
-        pool_id = c->cid.is_pg(&pgid) ? pgid.pool() : META_POOL_ID;
-        dout(20) << __func__ << "  collection " << c->cid << " " << c->cnode
+      while (expecting_shards.front() > it->key()) {
+        derr << "fsck error:   saw " << pretty_binary_string(it->key())
           << dendl;
+        derr << "fsck error:   exp "
+          << pretty_binary_string(expecting_shards.front()) << dendl;
+        ++errors;
+        expecting_shards.pop_front();
+        if (expecting_shards.empty()) {
+          break;
+        }
       }
+      continue;
+    }
 
-      if (depth != FSCK_SHALLOW &&
-        !expecting_shards.empty()) {
-        for (auto& k : expecting_shards) {
-          derr << "fsck error: missing shard key "
-            << pretty_binary_string(k) << dendl;
+    seen_object = true;
+    ghobject_t oid;
+    int r = get_key_object(it->key(), &oid);
+    if (r < 0) {
+      derr << "fsck error: bad object key "
+        << pretty_binary_string(it->key()) << dendl;
+      ++errors;
+      continue;
+    }
+    if (!c ||
+      oid.shard_id != pgid.shard ||
+      oid.hobj.get_logical_pool() != (int64_t)pgid.pool() ||
+      !c->contains(oid)) {
+      c = nullptr;
+      for (auto& p : coll_map) {
+        if (p.second->contains(oid)) {
+          c = p.second;
+          break;
         }
+      }
+      if (!c) {
+        derr << "fsck error: stray object " << oid
+          << " not owned by any collection" << dendl;
         ++errors;
-        expecting_shards.clear();
+        continue;
       }
+      pool_id = c->cid.is_pg(&pgid) ? pgid.pool() : META_POOL_ID;
+      dout(20) << __func__ << "  collection " << c->cid << " " << c->cnode
+        << dendl;
+    }
 
-      bool queued = false;
-      if (depth == FSCK_SHALLOW && thread_count > 0) {
-        queued = wq->queue(
-          pool_id,
-          c,
-          oid,
-          it->key(),
-          it->value());
-      }
-      OnodeRef o;
-      map<BlobRef, bluestore_blob_t::unused_t> referenced;
-
-      if (!queued) {
-        ++processed_myself;
-         o = fsck_check_objects_shallow(
-          depth,
-          pool_id,
-          c,
-          oid,
-          it->key(),
-          it->value(),
-          &expecting_shards,
-          &referenced,
-          ctx);
+    if (depth != FSCK_SHALLOW &&
+      !expecting_shards.empty()) {
+      for (auto& k : expecting_shards) {
+        derr << "fsck error: missing shard key "
+          << pretty_binary_string(k) << dendl;
       }
+      ++errors;
+      expecting_shards.clear();
+    }
+
+    bool queued = false;
+    if (queue_shallow) {
+      queued = queue_shallow(
+        pool_id,
+        c,
+        oid,
+        it->key(),
+        it->value());
+    }
+    OnodeRef o;
+    map<BlobRef, bluestore_blob_t::unused_t> referenced;
+
+    if (!queued) {
+      ++processed_myself;
+       o = fsck_check_objects_shallow(
+        depth,
+        pool_id,
+        c,
+        oid,
+        it->key(),
+        it->value(),
+        &expecting_shards,
+        &referenced,
+        ctx);
+    }
 
-      if (depth != FSCK_SHALLOW) {
-        ceph_assert(o != nullptr);
-        if (o->onode.nid) {
-          if (o->onode.nid > nid_max) {
-            derr << "fsck error: " << oid << " nid " << o->onode.nid
-              << " > nid_max " << nid_max << dendl;
-            ++errors;
-          }
-          if (used_nids.count(o->onode.nid)) {
-            derr << "fsck error: " << oid << " nid " << o->onode.nid
-              << " already in use" << dendl;
-            ++errors;
-            continue; // go for next object
-          }
-          used_nids.insert(o->onode.nid);
+    if (depth != FSCK_SHALLOW) {
+      ceph_assert(o != nullptr);
+      if (o->onode.nid) {
+        if (o->onode.nid > nid_max) {
+          derr << "fsck error: " << oid << " nid " << o->onode.nid
+            << " > nid_max " << nid_max << dendl;
+          ++errors;
         }
-        for (auto& i : referenced) {
-          dout(20) << __func__ << "  referenced 0x" << std::hex << i.second
-            << std::dec << " for " << *i.first << dendl;
-          const bluestore_blob_t& blob = i.first->get_blob();
-          if (i.second & blob.unused) {
-            derr << "fsck error: " << oid << " blob claims unused 0x"
-              << std::hex << blob.unused
-              << " but extents reference 0x" << i.second << std::dec
-              << " on blob " << *i.first << dendl;
-            ++errors;
-          }
-          if (blob.has_csum()) {
-            uint64_t blob_len = blob.get_logical_length();
-            uint64_t unused_chunk_size = blob_len / (sizeof(blob.unused) * 8);
-            unsigned csum_count = blob.get_csum_count();
-            unsigned csum_chunk_size = blob.get_csum_chunk_size();
-            for (unsigned p = 0; p < csum_count; ++p) {
-              unsigned pos = p * csum_chunk_size;
-              unsigned firstbit = pos / unused_chunk_size;    // [firstbit,lastbit]
-              unsigned lastbit = (pos + csum_chunk_size - 1) / unused_chunk_size;
-              unsigned mask = 1u << firstbit;
-              for (unsigned b = firstbit + 1; b <= lastbit; ++b) {
-                mask |= 1u << b;
-              }
-              if ((blob.unused & mask) == mask) {
-                // this csum chunk region is marked unused
-                if (blob.get_csum_item(p) != 0) {
-                  derr << "fsck error: " << oid
-                    << " blob claims csum chunk 0x" << std::hex << pos
-                    << "~" << csum_chunk_size
-                    << " is unused (mask 0x" << mask << " of unused 0x"
-                    << blob.unused << ") but csum is non-zero 0x"
-                    << blob.get_csum_item(p) << std::dec << " on blob "
-                    << *i.first << dendl;
-                  ++errors;
-                }
+        if (used_nids.count(o->onode.nid)) {
+          derr << "fsck error: " << oid << " nid " << o->onode.nid
+            << " already in use" << dendl;
+          ++errors;
+          continue; // go for next object
+        }
+        used_nids.insert(o->onode.nid);
+      }
+      for (auto& i : referenced) {
+        dout(20) << __func__ << "  referenced 0x" << std::hex << i.second
+          << std::dec << " for " << *i.first << dendl;
+        const bluestore_blob_t& blob = i.first->get_blob();
+        if (i.second & blob.unused) {
+          derr << "fsck error: " << oid << " blob claims unused 0x"
+            << std::hex << blob.unused
+            << " but extents reference 0x" << i.second << std::dec
+            << " on blob " << *i.first << dendl;
+          ++errors;
+        }
+        if (blob.has_csum()) {
+          uint64_t blob_len = blob.get_logical_length();
+          uint64_t unused_chunk_size = blob_len / (sizeof(blob.unused) * 8);
+          unsigned csum_count = blob.get_csum_count();
+          unsigned csum_chunk_size = blob.get_csum_chunk_size();
+          for (unsigned p = 0; p < csum_count; ++p) {
+            unsigned pos = p * csum_chunk_size;
+            unsigned firstbit = pos / unused_chunk_size;    // [firstbit,lastbit]
+            unsigned lastbit = (pos + csum_chunk_size - 1) / unused_chunk_size;
+            unsigned mask = 1u << firstbit;
+            for (unsigned b = firstbit + 1; b <= lastbit; ++b) {
+              mask |= 1u << b;
+            }
+            if ((blob.unused & mask) == mask) {
+              // this csum chunk region is marked unused
+              if (blob.get_csum_item(p) != 0) {
+                derr << "fsck error: " << oid
+                  << " blob claims csum chunk 0x" << std::hex << pos
+                  << "~" << csum_chunk_size
+                  << " is unused (mask 0x" << mask << " of unused 0x"
+                  << blob.unused << ") but csum is non-zero 0x"
+                  << blob.get_csum_item(p) << std::dec << " on blob "
+                  << *i.first << dendl;
+                ++errors;
               }
             }
           }
         }
-        // omap
-        if (o->onode.has_omap()) {
-          ceph_assert(ctx.used_omap_head);
-          if (ctx.used_omap_head->count(o->onode.nid)) {
-            derr << "fsck error: " << o->oid << " omap_head " << o->onode.nid
-                 << " already in use" << dendl;
-            ++errors;
-          } else {
-            ctx.used_omap_head->insert(o->onode.nid);
-          }
-        } // if (o->onode.has_omap())
-        if (depth == FSCK_DEEP) {
-          bufferlist bl;
-          uint64_t max_read_block = cct->_conf->bluestore_fsck_read_bytes_cap;
-          uint64_t offset = 0;
-          do {
-            uint64_t l = std::min(uint64_t(o->onode.size - offset), max_read_block);
-            int r = _do_read(c.get(), o, offset, l, bl,
-              CEPH_OSD_OP_FLAG_FADVISE_NOCACHE);
-            if (r < 0) {
-              ++errors;
-              derr << "fsck error: " << oid << std::hex
-                << " error during read: "
-                << " " << offset << "~" << l
-                << " " << cpp_strerror(r) << std::dec
-                << dendl;
-              break;
-            }
-            offset += l;
-          } while (offset < o->onode.size);
-        } // deep
-      } //if (depth != FSCK_SHALLOW)
-    } // for (it->lower_bound(string()); it->valid(); it->next())
-    if (depth == FSCK_SHALLOW && thread_count > 0) {
-      wq->finalize(thread_pool, ctx);
-      if (processed_myself) {
-        // may be needs more threads?
-        dout(0) << __func__ << " partial offload"
-                << ", done myself " << processed_myself
-                << " of " << ctx.num_objects
-                << "objects, threads " << thread_count
-                << dendl;
+      }
+      // omap
+      if (o->onode.has_omap()) {
+        ceph_assert(ctx.used_omap_head);
+        if (ctx.used_omap_head->count(o->onode.nid)) {
+          derr << "fsck error: " << o->oid << " omap_head " << o->onode.nid
+               << " already in use" << dendl;
+          ++errors;
+        } else {
+          ctx.used_omap_head->insert(o->onode.nid);
+        }
+      } // if (o->onode.has_omap())
+      if (depth == FSCK_DEEP) {
+        if (queue_deep) {
+          queue_deep(c, o);
+        } else {
+          int64_t e = fsck_check_object_data(c, o);
+          errors += e;
+          fsck_progress.deep_errors += e;
+          ++fsck_progress.deep_objects;
+          fsck_progress.deep_bytes += o->onode.size;
+        }
+      } // deep
+    } //if (depth != FSCK_SHALLOW)
+  } // for (it->lower_bound(begin); it->valid(); it->next())
+  if (depth != FSCK_SHALLOW &&
+    !expecting_shards.empty()) {
+    for (auto& k : expecting_shards) {
+      derr << "fsck error: missing shard key "
+        << pretty_binary_string(k) << dendl;
+    }
+    ++errors;
+  }
+  return processed_myself;
+}
+
+void BlueStore::_fsck_check_objects(
+  FSCKDepth depth,
+  BlueStore::FSCK_ObjectCtx& ctx)
+{
+  auto& errors = ctx.errors;
+  auto sb_info_lock = ctx.sb_info_lock;
+  auto& sb_info = ctx.sb_info;
+  auto& sb_ref_counts = ctx.sb_ref_counts;
+  auto repairer = ctx.repairer;
+
+  int64_t deep_threads = depth == FSCK_DEEP ?
+    cct->_conf.get_val<int64_t>("bluestore_fsck_deep_threads") : 0;
+  // repair and the zone refs of smr devices want a single walk
+  if (deep_threads > 1 && !repairer && !bdev->is_smr()) {
+    _fsck_check_objects_parallel(depth, deep_threads, ctx);
+    return;
+  }
+
+  uint64_t_btree_t used_nids;
+
+  const size_t thread_count = cct->_conf->bluestore_fsck_quick_fix_threads;
+  typedef ShallowFSCKThreadPool::FSCKWorkQueue<256> WQ;
+  std::unique_ptr<WQ> wq(
+    new WQ(
+      "FSCKWorkQueue",
+      (thread_count ? : 1) * 32,
+      this,
+      sb_info_lock,
+      sb_info,
+      sb_ref_counts,
+      repairer));
+
+  ShallowFSCKThreadPool thread_pool(cct, "ShallowFSCKThreadPool", "ShallowFSCK", thread_count);
+
+  std::optional<DeepFSCKReaders> readers;
+  if (deep_threads > 0) {
+    readers.emplace(this, fsck_progress, deep_threads);
+  }
+
+  thread_pool.add_work_queue(wq.get());
+  if (depth == FSCK_SHALLOW && thread_count > 0) {
+    //not the best place but let's check anyway
+    ceph_assert(sb_info_lock);
+    thread_pool.start();
+  }
+
+  size_t processed_myself = _fsck_walk_objects(
+    depth,
+    string(),
+    string(),
+    used_nids,
+    depth == FSCK_SHALLOW && thread_count > 0 ?
+      [&](int64_t pool_id, CollectionRef c, const ghobject_t& oid,
+          const string& key, const bufferlist& value) {
+        return wq->queue(pool_id, c, oid, key, value);
+      } : std::function<bool(int64_t, CollectionRef, const ghobject_t&,
+                             const string&, const bufferlist&)>(),
+    readers ?
+      [&](CollectionRef c, OnodeRef o) {
+        readers->queue(std::move(c), std::move(o));
+      } : std::function<void(CollectionRef, OnodeRef)>(),
+    ctx);
+  if (readers) {
+    errors += readers->finish();
+  }
+  if (depth == FSCK_SHALLOW && thread_count > 0) {
+    wq->finalize(thread_pool, ctx);
+    if (processed_myself) {
+      // may be needs more threads?
+      dout(0) << __func__ << " partial offload"
+              << ", done myself " << processed_myself
+              << " of " << ctx.num_objects
+              << "objects, threads " << thread_count
+              << dendl;
+    }
+  }
+}
+
+/*
+ * Deep fsck is bound by reading the data back, and a single walk of the
+ * object keys can't keep enough reads in flight on a fast device.  Split
+ * the keyspace where collections start into one part per walker, each
+ * walker checks the objects of its part and reads them back itself.
+ * used_blocks and the shared blob state are shared between the walkers
+ * under locks, the counters, statfs, nids and omap heads are kept per
+ * walker and merged once all are done, which is where nids or omap heads
+ * used in two parts show up.
+ */
+void BlueStore::_fsck_check_objects_parallel(
+  FSCKDepth depth,
+  size_t walkers,
+  BlueStore::FSCK_ObjectCtx& ctx)
+{
+  ceph_assert(ctx.sb_info_lock);
+  ceph_assert(!ctx.repairer);
+
+  vector<string> bounds;
+  for (auto& [cid, c] : coll_map) {
+    ghobject_t temp_start, temp_end, start, end;
+    get_coll_range(cid, c->cnode.bits, &temp_start, &temp_end,
+                   &start, &end, false);
+    for (auto* o : {&temp_start, &start}) {
+      bounds.emplace_back();
+      get_object_key(cct, *o, &bounds.back());
+    }
+  }
+  std::sort(bounds.begin(), bounds.end());
+  bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+  // collections hold similar numbers of objects, more or less
+  vector<string> splits;
+  splits.emplace_back();
+  for (size_t i = 1; i < walkers; ++i) {
+    size_t n = i * bounds.size() / walkers;
+    if (n > 0 && bounds[n] > splits.back()) {
+      splits.push_back(bounds[n]);
+    }
+  }
+  splits.emplace_back();
+  dout(10) << __func__ << " " << splits.size() - 1 << " walkers" << dendl;
+
+  struct walker_t {
+    int64_t errors = 0;
+    int64_t warnings = 0;
+    uint64_t num_objects = 0;
+    uint64_t num_extents = 0;
+    uint64_t num_blobs = 0;
+    uint64_t num_sharded_objects = 0;
+    uint64_t num_spanning_blobs = 0;
+    uint64_t_btree_t used_nids;
+    uint64_t_btree_t used_omap_head;
+    store_statfs_t expected_store_statfs;
+    per_pool_statfs expected_pool_statfs;
+  };
+  vector<walker_t> state(splits.size() - 1);
+  ceph::mutex used_blocks_lock =
+    ceph::make_mutex("BlueStore::fsck::used_blocks_lock");
+  vector<std::thread> threads;
+  for (size_t i = 0; i < state.size(); ++i) {
+    threads.emplace_back(make_named_thread("bstore_fsck_walk", [&, i] {
+      auto& w = state[i];
+      BlueStore::FSCK_ObjectCtx wctx(
+        w.errors,
+        w.warnings,
+        w.num_objects,
+        w.num_extents,
+        w.num_blobs,
+        w.num_sharded_objects,
+        w.num_spanning_blobs,
+        ctx.used_blocks,
+        &w.used_omap_head,
+        ctx.zone_refs,
+        ctx.sb_info_lock,
+        ctx.sb_info,
+        ctx.sb_ref_counts,
+        w.expected_store_statfs,
+        w.expected_pool_statfs,
+        nullptr);
+      wctx.used_blocks_lock = &used_blocks_lock;
+      _fsck_walk_objects(depth, splits[i], splits[i + 1], w.used_nids,
+                         nullptr, nullptr, wctx);
+    }));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  uint64_t_btree_t used_nids;
+  for (auto& w : state) {
+    ctx.errors += w.errors;
+    ctx.warnings += w.warnings;
+    ctx.num_objects += w.num_objects;
+    ctx.num_extents += w.num_extents;
+    ctx.num_blobs += w.num_blobs;
+    ctx.num_sharded_objects += w.num_sharded_objects;
+    ctx.num_spanning_blobs += w.num_spanning_blobs;
+    ctx.expected_store_statfs.add(w.expected_store_statfs);
+    for (auto& [pool_id, statfs] : w.expected_pool_statfs) {
+      ctx.expected_pool_statfs[pool_id].add(statfs);
+    }
+    for (auto nid : w.used_nids) {
+      if (!used_nids.insert(nid).second) {
+        derr << "fsck error: nid " << nid << " already in use" << dendl;
+        ++ctx.errors;
+      }
+    }
+    for (auto nid : w.used_omap_head) {
+      if (!ctx.used_omap_head->insert(nid).second) {
+        derr << "fsck error: omap_head " << nid << " already in use" << dendl;
+        ++ctx.errors;
       }
     }
-  } // if (it)
+  }
 }
 /**
 An overview for currently implemented repair logics 
@@ -10255,6 +10770,10 @@ int BlueStore::_fsck(BlueStore::FSCKDepth depth, bool repair)
 
   // in deep mode we need R/W write access to be able to replay deferred ops
   const bool read_only = !(repair || depth == FSCK_DEEP);
+  if (repair) {
+    // repair changes allocations behind the delta log's back
+    skip_alloc_delta_replay = true;
+  }
   int r = _open_db_and_around(read_only);
   if (r < 0) {
     return r;
@@ -10262,6 +10781,11 @@ int BlueStore::_fsck(BlueStore::FSCKDepth depth, bool repair)
   auto close_db = make_scope_guard([&] {
     _close_db_and_around();
   });
+  if (repair && !fm->is_null_manager()) {
+    // the freelist is what gets fixed, leave the allocation file invalid
+    // until a regular mount rebuilds it from the freelist
+    need_to_destage_allocation_file = false;
+  }
 
   if (!read_only) {
     r = _upgrade_super();
@@ -10312,6 +10836,9 @@ int BlueStore::_fsck_on_open(BlueStore::FSCKDepth depth, bool repair)
   int64_t errors = 0;
   int64_t warnings = 0;
   unsigned repaired = 0;
+  fsck_progress.reset();
+  fsck_progress.phase = "collections";
+  FSCKProgressHook progress_hook(this);
 
   uint64_t_btree_t used_omap_head;
   uint64_t_btree_t used_sbids;
@@ -10480,6 +11007,7 @@ int BlueStore::_fsck_on_open(BlueStore::FSCKDepth depth, bool repair)
 #endif
 
   dout(1) << __func__ << " checking shared_blobs (phase 1)" << dendl;
+  fsck_progress.phase = "shared_blobs";
   it = db->get_iterator(PREFIX_SHARED_BLOB, KeyValueDB::ITERATOR_NOCACHE);
   if (it) {
     for (it->lower_bound(string()); it->valid(); it->next()) {
@@ -10519,6 +11047,7 @@ int BlueStore::_fsck_on_open(BlueStore::FSCKDepth depth, bool repair)
   // walk PREFIX_OBJ
   {
     dout(1) << __func__ << " walking object keyspace" << dendl;
+    fsck_progress.phase = "objects";
     ceph::mutex sb_info_lock =  ceph::make_mutex("BlueStore::fsck::sbinfo_lock");
     BlueStore::FSCK_ObjectCtx ctx(
       errors,
@@ -10531,9 +11060,9 @@ int BlueStore::_fsck_on_open(BlueStore::FSCKDepth depth, bool repair)
       &used_blocks,
       &used_omap_head,
       &zone_refs,
-      //no need for the below lock when in non-shallow mode as
+      //no need for the below lock when in regular mode as
       // there is no multithreading in this case
-      depth == FSCK_SHALLOW ? &sb_info_lock : nullptr,
+      depth != FSCK_REGULAR ? &sb_info_lock : nullptr,
       sb_info,
       sb_ref_counts,
       expected_store_statfs,
@@ -10546,6 +11075,7 @@ int BlueStore::_fsck_on_open(BlueStore::FSCKDepth depth, bool repair)
 #ifdef HAVE_LIBZBD
   if (bdev->is_smr() && depth != FSCK_SHALLOW) {
     dout(1) << __func__ << " checking for leaked zone refs" << dendl;
+    fsck_progress.phase = "zone_refs";
     for (uint32_t zone = 0; zone < zone_refs.size(); ++zone) {
       for (auto& [oid, offset] : zone_refs[zone]) {
 	derr << "fsck error: stray zone ref 0x" << std::hex << zone
@@ -10592,6 +11122,7 @@ int BlueStore::_fsck_on_open(BlueStore::FSCKDepth depth, bool repair)
     _fsck_repair_shared_blobs(repairer, sb_ref_counts, sb_info);
   }
   dout(1) << __func__ << " checking shared_blobs (phase 2)" << dendl;
+  fsck_progress.phase = "shared_blobs (phase 2)";
   it = db->get_iterator(PREFIX_SHARED_BLOB, KeyValueDB::ITERATOR_NOCACHE);
   if (it) {
     // FIXME minor: perhaps simplify for shallow mode?
@@ -10671,6 +11202,7 @@ int BlueStore::_fsck_on_open(BlueStore::FSCKDepth depth, bool repair)
   if (repair && repairer.preprocess_misreference(db)) {
 
     dout(1) << __func__ << " sorting out misreferenced extents" << dendl;
+    fsck_progress.phase = "misreferenced extents";
     auto& misref_extents = repairer.get_misreferences();
     interval_set<uint64_t> to_release;
     it = db->get_iterator(PREFIX_OBJ, KeyValueDB::ITERATOR_NOCACHE);
@@ -10872,10 +11404,12 @@ int BlueStore::_fsck_on_open(BlueStore::FSCKDepth depth, bool repair)
   sb_ref_counts.reset();
 
   dout(1) << __func__ << " checking pool_statfs" << dendl;
+  fsck_progress.phase = "pool_statfs";
   _fsck_check_statfs(expected_store_statfs, expected_pool_statfs,
     errors, warnings, repair ? &repairer : nullptr);
   if (depth != FSCK_SHALLOW) {
     dout(1) << __func__ << " checking for stray omap data " << dendl;
+    fsck_progress.phase = "stray omap";
     it = db->get_iterator(PREFIX_OMAP, KeyValueDB::ITERATOR_NOCACHE);
     if (it) {
       uint64_t last_omap_head = 0;
@@ -10966,6 +11500,7 @@ int BlueStore::_fsck_on_open(BlueStore::FSCKDepth depth, bool repair)
       }
     }
     dout(1) << __func__ << " checking deferred events" << dendl;
+    fsck_progress.phase = "deferred events";
     it = db->get_iterator(PREFIX_DEFERRED, KeyValueDB::ITERATOR_NOCACHE);
     if (it) {
       for (it->lower_bound(string()); it->valid(); it->next()) {
@@ -11002,6 +11537,7 @@ int BlueStore::_fsck_on_open(BlueStore::FSCKDepth depth, bool repair)
     // skip freelist vs allocated compare when we have Null fm
     if (!fm->is_null_manager()) {
       dout(1) << __func__ << " checking freelist vs allocated" << dendl;
+      fsck_progress.phase = "freelist";
 #ifdef HAVE_LIBZBD
       if (freelist_type == "zoned") {
 	// verify per-zone state
@@ -12065,6 +12601,32 @@ void BlueStore::_read_cache(
   }
 }
 
+void BlueStore::_get_compressed_read_range(
+  const bluestore_blob_t& blob,
+  const regions2read_t& r2r,
+  unsigned* first,
+  unsigned* last,
+  uint64_t* r_off,
+  uint64_t* r_len)
+{
+  uint32_t lo = std::numeric_limits<uint32_t>::max();
+  uint32_t hi = 0;
+  for (auto& req : r2r) {
+    for (auto& r : req.regs) {
+      lo = std::min<uint32_t>(lo, r.blob_xoffset);
+      hi = std::max<uint32_t>(hi, r.blob_xoffset + r.length);
+    }
+  }
+  blob.get_compressed_chunk_range(lo, hi - lo, first, last);
+  // whole checksum chunks, which may cover bits of the neighbours
+  uint64_t chunk_size = blob.get_chunk_size(block_size);
+  *r_off = p2align<uint64_t>(blob.get_compressed_chunk_start(*first),
+                             chunk_size);
+  *r_len = p2roundup<uint64_t>(blob.get_compressed_chunk_end(*last),
+                               chunk_size) - *r_off;
+  ceph_assert(*r_off + *r_len <= blob.get_ondisk_length());
+}
+
 int BlueStore::_prepare_read_ioc(
   blobs2read_t& blobs2read,
   vector<bufferlist>* compressed_blob_bls,
@@ -12083,8 +12645,16 @@ int BlueStore::_prepare_read_ioc(
       }
       compressed_blob_bls->push_back(bufferlist());
       bufferlist& bl = compressed_blob_bls->back();
+      uint64_t r_off = 0;
+      uint64_t r_len = bptr->get_blob().get_ondisk_length();
+      if (bptr->get_blob().has_compressed_chunks()) {
+        // or rather just the chunks we need
+        unsigned first, last;
+        _get_compressed_read_range(bptr->get_blob(), r2r, &first, &last,
+                                   &r_off, &r_len);
+      }
       auto r = bptr->get_blob().map(
-        0, bptr->get_blob().get_ondisk_length(),
+        r_off, r_len,
         [&](uint64_t offset, uint64_t length) {
           int r = bdev->aio_read(offset, length, &bl, ioc);
           if (r < 0)
@@ -12134,16 +12704,13 @@ int BlueStore::_prepare_read_ioc(
   return 0;
 }
 
-int BlueStore::_generate_read_result_bl(
+int BlueStore::_fill_ready_regions(
   OnodeRef& o,
-  uint64_t offset,
-  size_t length,
   ready_regions_t& ready_regions,
   vector<bufferlist>& compressed_blob_bls,
   blobs2read_t& blobs2read,
   bool buffered,
-  bool* csum_error,
-  bufferlist& bl)
+  bool* csum_error)
 {
  // enumerate and decompress desired blobs
   auto p = compressed_blob_bls.begin();
@@ -12156,25 +12723,53 @@ int BlueStore::_generate_read_result_bl(
     if (bptr->get_blob().is_compressed()) {
       ceph_assert(p != compressed_blob_bls.end());
       bufferlist& compressed_bl = *p++;
-      if (_verify_csum(o, &bptr->get_blob(), 0, compressed_bl,
-                       r2r.front().regs.front().logical_offset) < 0) {
-        *csum_error = true;
-        return -EIO;
-      }
+      const bluestore_blob_t& blob = bptr->get_blob();
       bufferlist raw_bl;
-      auto r = _decompress(compressed_bl, &raw_bl);
-      if (r < 0)
-        return r;
+      uint64_t raw_off = 0;
+      if (blob.has_compressed_chunks()) {
+        unsigned first, last;
+        uint64_t r_off, r_len;
+        _get_compressed_read_range(blob, r2r, &first, &last, &r_off, &r_len);
+        if (_verify_csum(o, &blob, r_off, compressed_bl,
+                         r2r.front().regs.front().logical_offset) < 0) {
+          *csum_error = true;
+          return -EIO;
+        }
+        for (unsigned i = first; i <= last; ++i) {
+          uint64_t c_off = blob.get_compressed_chunk_start(i);
+          bufferlist chunk, chunk_raw;
+          chunk.substr_of(compressed_bl, c_off - r_off,
+                          blob.get_compressed_chunk_end(i) - c_off);
+          auto r = _decompress(chunk, &chunk_raw);
+          if (r < 0)
+            return r;
+          raw_bl.claim_append(chunk_raw);
+        }
+        raw_off = uint64_t(first) << blob.compressed_chunk_order;
+      } else {
+        if (_verify_csum(o, &blob, 0, compressed_bl,
+                         r2r.front().regs.front().logical_offset) < 0) {
+          *csum_error = true;
+          return -EIO;
+        }
+        auto r = _decompress(compressed_bl, &raw_bl);
+        if (r < 0)
+          return r;
+      }
       if (buffered) {
-        bptr->dirty_bc().did_read(bptr->shared_blob->get_cache(), 0,
+        bptr->dirty_bc().did_read(bptr->shared_blob->get_cache(), raw_off,
                                        raw_bl);
       }
+      uint64_t wanted = 0;
       for (auto& req : r2r) {
         for (auto& r : req.regs) {
           ready_regions[r.logical_offset].substr_of(
-            raw_bl, r.blob_xoffset, r.length);
+            raw_bl, r.blob_xoffset - raw_off, r.length);
+          wanted += r.length;
         }
       }
+      logger->inc(l_bluestore_decompressed_bytes, raw_bl.length());
+      logger->inc(l_bluestore_decompressed_wanted_bytes, wanted);
     } else {
       for (auto& req : r2r) {
         if (_verify_csum(o, &bptr->get_blob(), req.r_off, req.bl,
@@ -12195,6 +12790,25 @@ int BlueStore::_generate_read_result_bl(
     }
     ++b2r_it;
   }
+  return 0;
+}
+
+int BlueStore::_generate_read_result_bl(
+  OnodeRef& o,
+  uint64_t offset,
+  size_t length,
+  ready_regions_t& ready_regions,
+  vector<bufferlist>& compressed_blob_bls,
+  blobs2read_t& blobs2read,
+  bool buffered,
+  bool* csum_error,
+  bufferlist& bl)
+{
+  int r = _fill_ready_regions(o, ready_regions, compressed_blob_bls,
+                              blobs2read, buffered, csum_error);
+  if (r < 0) {
+    return r;
+  }
 
   // generate a resulting buffer
   auto pr = ready_regions.begin();
@@ -12347,6 +12961,223 @@ int BlueStore::_do_read(
   return r;
 }
 
+int BlueStore::digest(
+  CollectionHandle &c_,
+  const ghobject_t& oid,
+  uint64_t offset,
+  size_t length,
+  uint32_t *crc,
+  uint32_t op_flags)
+{
+  auto start = mono_clock::now();
+  Collection *c = static_cast<Collection *>(c_.get());
+  const coll_t &cid = c->get_cid();
+  dout(15) << __func__ << " " << cid << " " << oid
+	   << " 0x" << std::hex << offset << "~" << length << std::dec
+	   << dendl;
+  if (!c->exists)
+    return -ENOENT;
+
+  int r;
+  {
+    std::shared_lock l(c->lock);
+    OnodeRef o = c->get_onode(oid, false);
+    if (!o || !o->exists) {
+      r = -ENOENT;
+      goto out;
+    }
+
+    if (offset == length && offset == 0)
+      length = o->onode.size;
+
+    r = _do_digest(c, o, offset, length, crc, op_flags);
+    if (r == -EIO) {
+      logger->inc(l_bluestore_read_eio);
+    }
+  }
+
+ out:
+  if (r >= 0 && _debug_data_eio(oid)) {
+    r = -EIO;
+    derr << __func__ << " " << c->cid << " " << oid << " INJECT EIO" << dendl;
+  }
+  dout(10) << __func__ << " " << cid << " " << oid
+	   << " 0x" << std::hex << offset << "~" << length
+	   << " = " << std::dec << r << " crc 0x" << std::hex << *crc
+	   << std::dec << dendl;
+  log_latency(__func__,
+    l_bluestore_digest_lat,
+    mono_clock::now() - start,
+    cct->_conf->bluestore_log_op_age);
+  return r;
+}
+
+/*
+ * Unlike _do_read, the regions of the uncompressed crc32c checksummed
+ * blobs are not assembled: once verified, their stored per chunk
+ * checksums give the crc32c of their data.  The raw crc32c is linear,
+ * so for a chunk D of n bytes with a stored csum of crc(-1, D)
+ *
+ *   crc(c, D) = crc(c, 0^n) ^ crc(0, D) = crc(c ^ -1, 0^n) ^ csum
+ *
+ * and crc(x, 0^n) is computed without touching any data.  Only the
+ * unaligned ends of the regions, the cached and the other blobs'
+ * data are hashed.
+ */
+int BlueStore::_do_digest(
+  Collection *c,
+  OnodeRef& o,
+  uint64_t offset,
+  size_t length,
+  uint32_t *crc,
+  uint32_t op_flags,
+  uint64_t retry_count)
+{
+  FUNCTRACE(cct);
+  int r = 0;
+  int read_cache_policy = 0; // do not bypass clean or dirty cache
+
+  dout(20) << __func__ << " 0x" << std::hex << offset << "~" << length
+           << " size 0x" << o->onode.size << " (" << std::dec
+           << o->onode.size << ")" << dendl;
+
+  if (offset >= o->onode.size) {
+    return r;
+  }
+  if (offset + length > o->onode.size) {
+    length = o->onode.size - offset;
+  }
+
+  o->extent_map.fault_range(db, offset, length);
+  _dump_onode<30>(cct, *o);
+
+  if (op_flags & CEPH_OSD_OP_FLAG_BYPASS_CLEAN_CACHE) {
+    read_cache_policy = BufferSpace::BYPASS_CLEAN_CACHE;
+  }
+
+  ready_regions_t ready_regions;
+  blobs2read_t blobs2read;
+  _read_cache(o, offset, length, read_cache_policy, ready_regions, blobs2read);
+
+  vector<bufferlist> compressed_blob_bls;
+  IOContext ioc(cct, NULL, !cct->_conf->bluestore_fail_eio);
+  r = _prepare_read_ioc(blobs2read, &compressed_blob_bls, &ioc);
+  if (r < 0)
+    return r;
+  if (ioc.has_pending_aios()) {
+    bdev->aio_submit(&ioc);
+    dout(20) << __func__ << " waiting for aio" << dendl;
+    ioc.aio_wait();
+    r = ioc.get_return_value();
+    if (r < 0) {
+      ceph_assert(r == -EIO); // no other errors allowed
+      return -EIO;
+    }
+  }
+
+  // logical offset -> (length, crc32c from a 0 seed) of the regions
+  // digested from the stored checksums
+  std::map<uint64_t, std::pair<uint64_t, uint32_t>> csum_regions;
+  uint64_t csum_bytes = 0;
+  uint64_t data_bytes = 0;
+  bool csum_error = false;
+  blobs2read_t data_blobs;
+  for (auto& [bptr, r2r] : blobs2read) {
+    const bluestore_blob_t& blob = bptr->get_blob();
+    if (blob.is_compressed() || blob.csum_type != Checksummer::CSUM_CRC32C) {
+      data_blobs.emplace(bptr, std::move(r2r));
+      continue;
+    }
+    const uint64_t cs = blob.get_csum_chunk_size();
+    for (auto& req : r2r) {
+      if (_verify_csum(o, &blob, req.r_off, req.bl,
+                       req.regs.front().logical_offset) < 0) {
+        csum_error = true;
+        break;
+      }
+      for (const auto& reg : req.regs) {
+        const uint64_t b_end = reg.blob_xoffset + reg.length;
+        const uint64_t head = std::min(p2roundup<uint64_t>(reg.blob_xoffset, cs),
+                                       b_end);
+        const uint64_t tail = std::max(p2align<uint64_t>(b_end, cs), head);
+        uint32_t c = 0;
+        if (head > reg.blob_xoffset) {
+          bufferlist t;
+          t.substr_of(req.bl, reg.front, head - reg.blob_xoffset);
+          c = t.crc32c(c);
+        }
+        for (uint64_t b = head; b < tail; b += cs) {
+          c = ceph_crc32c(c ^ 0xffffffff, NULL, cs) ^
+            (uint32_t)blob.get_csum_item(b / cs);
+        }
+        if (b_end > tail) {
+          bufferlist t;
+          t.substr_of(req.bl, reg.front + (tail - reg.blob_xoffset),
+                      b_end - tail);
+          c = t.crc32c(c);
+        }
+        csum_bytes += tail - head;
+        data_bytes += reg.length - (tail - head);
+        csum_regions[reg.logical_offset] = std::make_pair(reg.length, c);
+      }
+    }
+    if (csum_error) {
+      break;
+    }
+  }
+  if (!csum_error) {
+    r = _fill_ready_regions(o, ready_regions, compressed_blob_bls, data_blobs,
+                            false, &csum_error);
+  }
+  if (csum_error) {
+    if (retry_count >= cct->_conf->bluestore_retry_disk_reads) {
+      return -EIO;
+    }
+    return _do_digest(c, o, offset, length, crc, op_flags, retry_count + 1);
+  }
+  if (r < 0) {
+    return r;
+  }
+  if (retry_count) {
+    logger->inc(l_bluestore_reads_with_retries);
+  }
+
+  // combine the regions in logical order, holes are zeros
+  uint32_t v = *crc;
+  auto pr = ready_regions.begin();
+  auto pc = csum_regions.begin();
+  const uint64_t end = offset + length;
+  uint64_t pos = offset;
+  while (pos < end) {
+    if (pr != ready_regions.end() && pr->first == pos) {
+      v = pr->second.crc32c(v);
+      pos += pr->second.length();
+      data_bytes += pr->second.length();
+      ++pr;
+    } else if (pc != csum_regions.end() && pc->first == pos) {
+      v = ceph_crc32c(v, NULL, pc->second.first) ^ pc->second.second;
+      pos += pc->second.first;
+      ++pc;
+    } else {
+      uint64_t next = end;
+      if (pr != ready_regions.end()) {
+        next = std::min(next, pr->first);
+      }
+      if (pc != csum_regions.end()) {
+        next = std::min(next, pc->first);
+      }
+      ceph_assert(next > pos);
+      v = ceph_crc32c(v, NULL, next - pos);
+      pos = next;
+    }
+  }
+  ceph_assert(pos == end);
+  *crc = v;
+  logger->inc(l_bluestore_digest_csum_bytes, csum_bytes);
+  logger->inc(l_bluestore_digest_data_bytes, data_bytes);
+  return length;
+}
+
 int BlueStore::_verify_csum(OnodeRef& o,
 			    const bluestore_blob_t* blob, uint64_t blob_xoffset,
 			    const bufferlist& bl,
@@ -12434,6 +13265,34 @@ int BlueStore::_decompress(bufferlist& source, bufferlist* result)
   return r;
 }
 
+int BlueStore::_compress_chunks(
+  CompressorRef& c,
+  const bufferlist& source,
+  uint64_t chunk_size,
+  bufferlist* result,
+  mempool::bluestore_cache_other::vector<uint32_t>* ends)
+{
+  ends->clear();
+  for (uint64_t off = 0; off < source.length(); off += chunk_size) {
+    bufferlist in, t;
+    in.substr_of(source, off, std::min(chunk_size, source.length() - off));
+    std::optional<int32_t> compressor_message;
+    int r = c->compress(in, t, compressor_message);
+    if (r != 0) {
+      ends->clear();
+      return r;
+    }
+    bluestore_compression_header_t chdr;
+    chdr.type = c->get_type();
+    chdr.length = t.length();
+    chdr.compressor_message = compressor_message;
+    encode(chdr, *result);
+    result->claim_append(t);
+    ends->push_back(result->length());
+  }
+  return 0;
+}
+
 // this stores fiemap into interval_set, other variations
 // use it internally
 int BlueStore::_fiemap(
@@ -13392,6 +14251,33 @@ void BlueStore::_prepare_ondisk_format_super(KeyValueDB::Transaction& t)
     encode(min_compat_ondisk_format, bl);
     t->set(PREFIX_SUPER, "min_compat_ondisk_format", bl);
   }
+  super_compat_ondisk_format = min_compat_ondisk_format;
+}
+
+bool BlueStore::_allow_compressed_chunks()
+{
+  if (super_compat_ondisk_format >= compressed_chunks_compat_ondisk_format) {
+    return true;
+  }
+  // older releases would misread such blobs: keep them from mounting us
+  // before the first one is written
+  std::lock_guard l(super_compat_lock);
+  if (super_compat_ondisk_format < compressed_chunks_compat_ondisk_format) {
+    KeyValueDB::Transaction t = db->get_transaction();
+    bufferlist bl;
+    encode(compressed_chunks_compat_ondisk_format, bl);
+    t->set(PREFIX_SUPER, "min_compat_ondisk_format", bl);
+    int r = db->submit_transaction_sync(t);
+    if (r < 0) {
+      derr << __func__ << " failed to set min_compat_ondisk_format: "
+	   << cpp_strerror(r) << dendl;
+      return false;
+    }
+    dout(1) << __func__ << " min_compat_ondisk_format "
+	    << compressed_chunks_compat_ondisk_format << dendl;
+    super_compat_ondisk_format = compressed_chunks_compat_ondisk_format;
+  }
+  return true;
 }
 
 int BlueStore::_open_super_meta()
@@ -13486,6 +14372,7 @@ int BlueStore::_open_super_meta()
 	 << latest_ondisk_format << dendl;
     return -EPERM;
   }
+  super_compat_ondisk_format = compat_ondisk_format;
 
   {
     bufferlist bl;
@@ -13598,6 +14485,13 @@ int BlueStore::_upgrade_super()
       ceph_assert(r == 0);
       ondisk_format = 4;
     }
+    if (ondisk_format == 4) {
+      // changes:
+      // - blobs may be compressed in independent chunks
+      //   (FLAG_COMPRESSED_CHUNKS).  min_compat_ondisk_format is only raised
+      //   to 5 when the first of them is written.
+      ondisk_format = 5;
+    }
     // This to be the last operation
     _prepare_ondisk_format_super(t);
     int r = db->submit_transaction_sync(t);
@@ -13925,7 +14819,7 @@ void BlueStore::_txc_finalize_kv(TransContext *txc, KeyValueDB::Transaction t)
 	   << " released 0x" << txc->released
 	   << std::dec << dendl;
 
-  if (!fm->is_null_manager())
+  if (!fm->is_null_manager() || alloc_delta_log)
   {
     // We have to handle the case where we allocate *and* deallocate the
     // same region in this transaction.  The freelist doesn't like that.
@@ -13952,17 +14846,37 @@ void BlueStore::_txc_finalize_kv(TransContext *txc, KeyValueDB::Transaction t)
     }
 
     // update freelist with non-overlap sets
-    for (interval_set<uint64_t>::iterator p = pallocated->begin();
-	 p != pallocated->end();
-	 ++p) {
-      fm->allocate(p.get_start(), p.get_len(), t);
+    if (!fm->is_null_manager()) {
+      for (interval_set<uint64_t>::iterator p = pallocated->begin();
+	   p != pallocated->end();
+	   ++p) {
+	fm->allocate(p.get_start(), p.get_len(), t);
+      }
+      for (interval_set<uint64_t>::iterator p = preleased->begin();
+	   p != preleased->end();
+	   ++p) {
+	dout(20) << __func__ << " release 0x" << std::hex << p.get_start()
+		 << "~" << p.get_len() << std::dec << dendl;
+	fm->release(p.get_start(), p.get_len(), t);
+      }
     }
-    for (interval_set<uint64_t>::iterator p = preleased->begin();
-	 p != preleased->end();
-	 ++p) {
-      dout(20) << __func__ << " release 0x" << std::hex << p.get_start()
-	       << "~" << p.get_len() << std::dec << dendl;
-      fm->release(p.get_start(), p.get_len(), t);
+
+    // the seq is taken after the allocation, so an extent released by one
+    // txc and reused by another is always logged in that order
+    if (alloc_delta_log && (!pallocated->empty() || !preleased->empty())) {
+      string key;
+      get_alloc_delta_key(++alloc_delta_seq, &key);
+      bufferlist bl;
+      ENCODE_START(1, 1, bl);
+      encode(*pallocated, bl);
+      encode(*preleased, bl);
+      ENCODE_FINISH(bl);
+      t->set(PREFIX_ALLOC_DELTA, key, bl);
+      if (++alloc_delta_pending >= alloc_delta_compact_entries &&
+	  !alloc_delta_compacting.exchange(true)) {
+	std::lock_guard l(alloc_delta_lock);
+	alloc_delta_cond.notify_one();
+      }
     }
   }
 
@@ -14327,13 +15241,23 @@ void BlueStore::_kv_start()
   dout(10) << __func__ << dendl;
 
   finisher.start();
+  kv_pipeline = cct->_conf.get_val<bool>("bluestore_kv_sync_pipeline");
   kv_sync_thread.create("bstore_kv_sync");
+  if (kv_pipeline) {
+    kv_commit_thread.create("bstore_kv_commit");
+  }
   kv_finalize_thread.create("bstore_kv_final");
+  if (alloc_delta_log) {
+    _alloc_delta_start();
+  }
 }
 
 void BlueStore::_kv_stop()
 {
   dout(10) << __func__ << dendl;
+  if (alloc_delta_log) {
+    _alloc_delta_stop();
+  }
   {
     std::unique_lock l{kv_lock};
     while (!kv_sync_started) {
@@ -14351,6 +15275,20 @@ void BlueStore::_kv_stop()
     kv_finalize_cond.notify_all();
   }
   kv_sync_thread.join();
+  if (kv_pipeline) {
+    // only once kv_sync has exited, so that it can't queue more batches
+    {
+      std::unique_lock l{kv_commit_lock};
+      while (!kv_commit_started) {
+	kv_commit_cond.wait(l);
+      }
+      kv_commit_stop = true;
+      kv_commit_cond.notify_all();
+    }
+    kv_commit_thread.join();
+    std::lock_guard l(kv_commit_lock);
+    kv_commit_stop = false;
+  }
   kv_finalize_thread.join();
   ceph_assert(removed_collections.empty());
   {
@@ -14533,109 +15471,170 @@ void BlueStore::_kv_sync_thread()
 	}
       }
 
+      KVCommitBatch b;
+      b.committing.swap(kv_committing);
+      b.deferred_stable.swap(deferred_stable);
+      b.deferred_done = deferred_done.size();
+      b.synct = synct;
+      b.new_nid_max = new_nid_max;
+      b.new_blobid_max = new_blobid_max;
+      b.start = start;
+      b.after_flush = after_flush;
+      if (!kv_pipeline) {
+	_kv_commit_batch(b);
+      } else {
+	std::unique_lock m{kv_commit_lock};
+	if (kv_commit_in_progress) {
+	  logger->inc(l_bluestore_kv_pipelined);
+	}
+	// keep at most one batch queued behind the one being synced; the
+	// time we wait here lets the next batch grow instead
+	auto wait_start = mono_clock::now();
+	while (!kv_commit_queue.empty()) {
+	  kv_commit_cond.wait(m);
+	}
+	logger->tinc(l_bluestore_kv_pipeline_wait_lat,
+		     mono_clock::now() - wait_start);
+	kv_commit_queue.emplace_back(std::move(b));
+	kv_commit_cond.notify_all();
+      }
+
+      l.lock();
+      // previously deferred "done" are now "stable" by virtue of this
+      // commit cycle.
+      deferred_stable_queue.swap(deferred_done);
+    }
+  }
+  dout(10) << __func__ << " finish" << dendl;
+  kv_sync_started = false;
+}
+
+void BlueStore::_kv_commit_batch(KVCommitBatch& b)
+{
 #if defined(WITH_LTTNG)
-      auto sync_start = mono_clock::now();
+  auto sync_start = mono_clock::now();
 #endif
-      // submit synct synchronously (block and wait for it to commit)
-      int r = cct->_conf->bluestore_debug_omit_kv_commit ? 0 : db->submit_transaction_sync(synct);
-      ceph_assert(r == 0);
+  // submit synct synchronously (block and wait for it to commit)
+  int r = cct->_conf->bluestore_debug_omit_kv_commit ? 0 : db->submit_transaction_sync(b.synct);
+  ceph_assert(r == 0);
 
 #ifdef WITH_BLKIN
-      for (auto txc : kv_committing) {
-        if (txc->trace) {
-          txc->trace.event("db sync submit");
-          txc->trace.keyval("kv_committing size", kv_committing.size());
-        }
-      }
+  for (auto txc : b.committing) {
+    if (txc->trace) {
+      txc->trace.event("db sync submit");
+      txc->trace.keyval("kv_committing size", b.committing.size());
+    }
+  }
 #endif
 
-      int committing_size = kv_committing.size();
-      int deferred_size = deferred_stable.size();
+  int committing_size = b.committing.size();
+  int deferred_size = b.deferred_stable.size();
 
 #if defined(WITH_LTTNG)
-      double sync_latency = ceph::to_seconds<double>(mono_clock::now() - sync_start);
-      for (auto txc: kv_committing) {
-	if (txc->tracing) {
-	  tracepoint(
-	    bluestore,
-	    transaction_kv_sync_latency,
-	    txc->osr->get_sequencer_id(),
-	    txc->seq,
-	    kv_committing.size(),
-	    deferred_done.size(),
-	    deferred_stable.size(),
-	    sync_latency);
-	}
-      }
+  double sync_latency = ceph::to_seconds<double>(mono_clock::now() - sync_start);
+  for (auto txc: b.committing) {
+    if (txc->tracing) {
+      tracepoint(
+	bluestore,
+	transaction_kv_sync_latency,
+	txc->osr->get_sequencer_id(),
+	txc->seq,
+	b.committing.size(),
+	b.deferred_done,
+	b.deferred_stable.size(),
+	sync_latency);
+    }
+  }
 #endif
 
-      {
-	std::unique_lock m{kv_finalize_lock};
-	if (kv_committing_to_finalize.empty()) {
-	  kv_committing_to_finalize.swap(kv_committing);
-	} else {
-	  kv_committing_to_finalize.insert(
-	      kv_committing_to_finalize.end(),
-	      kv_committing.begin(),
-	      kv_committing.end());
-	  kv_committing.clear();
-	}
-	if (deferred_stable_to_finalize.empty()) {
-	  deferred_stable_to_finalize.swap(deferred_stable);
-	} else {
-	  deferred_stable_to_finalize.insert(
-	      deferred_stable_to_finalize.end(),
-	      deferred_stable.begin(),
-	      deferred_stable.end());
-	  deferred_stable.clear();
-	}
-	if (!kv_finalize_in_progress) {
-	  kv_finalize_in_progress = true;
-	  kv_finalize_cond.notify_one();
-	}
-      }
+  {
+    std::unique_lock m{kv_finalize_lock};
+    if (kv_committing_to_finalize.empty()) {
+      kv_committing_to_finalize.swap(b.committing);
+    } else {
+      kv_committing_to_finalize.insert(
+	  kv_committing_to_finalize.end(),
+	  b.committing.begin(),
+	  b.committing.end());
+      b.committing.clear();
+    }
+    if (deferred_stable_to_finalize.empty()) {
+      deferred_stable_to_finalize.swap(b.deferred_stable);
+    } else {
+      deferred_stable_to_finalize.insert(
+	  deferred_stable_to_finalize.end(),
+	  b.deferred_stable.begin(),
+	  b.deferred_stable.end());
+      b.deferred_stable.clear();
+    }
+    if (!kv_finalize_in_progress) {
+      kv_finalize_in_progress = true;
+      kv_finalize_cond.notify_one();
+    }
+  }
 
-      if (new_nid_max) {
-	nid_max = new_nid_max;
-	dout(10) << __func__ << " nid_max now " << nid_max << dendl;
-      }
-      if (new_blobid_max) {
-	blobid_max = new_blobid_max;
-	dout(10) << __func__ << " blobid_max now " << blobid_max << dendl;
-      }
+  if (b.new_nid_max) {
+    nid_max = b.new_nid_max;
+    dout(10) << __func__ << " nid_max now " << nid_max << dendl;
+  }
+  if (b.new_blobid_max) {
+    blobid_max = b.new_blobid_max;
+    dout(10) << __func__ << " blobid_max now " << blobid_max << dendl;
+  }
 
-      {
-	auto finish = mono_clock::now();
-	ceph::timespan dur_flush = after_flush - start;
-	ceph::timespan dur_kv = finish - after_flush;
-	ceph::timespan dur = finish - start;
-	dout(20) << __func__ << " committed " << committing_size
-	  << " cleaned " << deferred_size
-	  << " in " << dur
-	  << " (" << dur_flush << " flush + " << dur_kv << " kv commit)"
-	  << dendl;
-	log_latency("kv_flush",
-	  l_bluestore_kv_flush_lat,
-	  dur_flush,
-	  cct->_conf->bluestore_log_op_age);
-	log_latency("kv_commit",
-	  l_bluestore_kv_commit_lat,
-	  dur_kv,
-	  cct->_conf->bluestore_log_op_age);
-	log_latency("kv_sync",
-	  l_bluestore_kv_sync_lat,
-	  dur,
-	  cct->_conf->bluestore_log_op_age);
-      }
+  {
+    auto finish = mono_clock::now();
+    ceph::timespan dur_flush = b.after_flush - b.start;
+    ceph::timespan dur_kv = finish - b.after_flush;
+    ceph::timespan dur = finish - b.start;
+    dout(20) << __func__ << " committed " << committing_size
+      << " cleaned " << deferred_size
+      << " in " << dur
+      << " (" << dur_flush << " flush + " << dur_kv << " kv commit)"
+      << dendl;
+    log_latency("kv_flush",
+      l_bluestore_kv_flush_lat,
+      dur_flush,
+      cct->_conf->bluestore_log_op_age);
+    log_latency("kv_commit",
+      l_bluestore_kv_commit_lat,
+      dur_kv,
+      cct->_conf->bluestore_log_op_age);
+    log_latency("kv_sync",
+      l_bluestore_kv_sync_lat,
+      dur,
+      cct->_conf->bluestore_log_op_age);
+  }
+}
 
+void BlueStore::_kv_commit_thread()
+{
+  dout(10) << __func__ << " start" << dendl;
+  std::unique_lock l{kv_commit_lock};
+  ceph_assert(!kv_commit_started);
+  kv_commit_started = true;
+  kv_commit_cond.notify_all();
+  while (true) {
+    if (kv_commit_queue.empty()) {
+      if (kv_commit_stop)
+	break;
+      dout(20) << __func__ << " sleep" << dendl;
+      kv_commit_cond.wait(l);
+      dout(20) << __func__ << " wake" << dendl;
+    } else {
+      KVCommitBatch b = std::move(kv_commit_queue.front());
+      kv_commit_queue.pop_front();
+      kv_commit_in_progress = true;
+      // let kv_sync queue the next batch while we sync this one
+      kv_commit_cond.notify_all();
+      l.unlock();
+      _kv_commit_batch(b);
       l.lock();
-      // previously deferred "done" are now "stable" by virtue of this
-      // commit cycle.
-      deferred_stable_queue.swap(deferred_done);
+      kv_commit_in_progress = false;
     }
   }
   dout(10) << __func__ << " finish" << dendl;
-  kv_sync_started = false;
+  kv_commit_started = false;
 }
 
 void BlueStore::_kv_finalize_thread()
@@ -14710,6 +15709,77 @@ void BlueStore::_kv_finalize_thread()
   kv_finalize_started = false;
 }
 
+bool BlueStore::_use_alloc_delta_log() const
+{
+#ifdef HAVE_LIBZBD
+  if (bdev->is_smr()) {
+    return false;
+  }
+#endif
+  return cct->_conf.get_val<bool>("bluestore_allocation_delta_log");
+}
+
+void BlueStore::_alloc_delta_start()
+{
+  dout(10) << __func__ << dendl;
+  alloc_delta_compact_entries = std::max<uint64_t>(1,
+    cct->_conf.get_val<uint64_t>("bluestore_allocation_delta_log_compact_entries"));
+  alloc_delta_compacting = false;
+  alloc_delta_thread.create("bstore_alloc_dl");
+}
+
+void BlueStore::_alloc_delta_stop()
+{
+  dout(10) << __func__ << dendl;
+  {
+    std::unique_lock l{alloc_delta_lock};
+    while (!alloc_delta_started) {
+      alloc_delta_cond.wait(l);
+    }
+    alloc_delta_stop = true;
+    alloc_delta_cond.notify_all();
+  }
+  alloc_delta_thread.join();
+  {
+    std::lock_guard l{alloc_delta_lock};
+    alloc_delta_stop = false;
+  }
+  dout(10) << __func__ << " done" << dendl;
+}
+
+void BlueStore::_alloc_delta_thread()
+{
+  dout(10) << __func__ << " start" << dendl;
+  std::unique_lock l{alloc_delta_lock};
+  ceph_assert(!alloc_delta_started);
+  alloc_delta_started = true;
+  alloc_delta_cond.notify_all();
+  bool failed = false;
+  while (!alloc_delta_stop) {
+    if (failed || alloc_delta_pending < alloc_delta_compact_entries) {
+      if (!failed) {
+	alloc_delta_compacting = false;
+      }
+      dout(20) << __func__ << " sleep" << dendl;
+      alloc_delta_cond.wait(l);
+      dout(20) << __func__ << " wake" << dendl;
+      continue;
+    }
+    alloc_delta_compacting = true;
+    l.unlock();
+    int r = compact_alloc_deltas();
+    l.lock();
+    if (r < 0) {
+      // keep logging, the allocation file is rewritten on umount anyway
+      derr << __func__ << " failed to fold allocation deltas: "
+	   << cpp_strerror(r) << ", not retrying until remount" << dendl;
+      failed = true;
+    }
+  }
+  dout(10) << __func__ << " finish" << dendl;
+  alloc_delta_started = false;
+}
+
 #ifdef HAVE_LIBZBD
 void BlueStore::_zoned_cleaner_start()
 {
@@ -14986,11 +16056,18 @@ void BlueStore::deferred_try_submit()
     }
   }
 
+  bool elevator = cct->_conf->bluestore_deferred_elevator;
+  std::vector<DeferredBatch*> batches;
   for (auto& osr : osrs) {
     osr->deferred_lock.lock();
     if (osr->deferred_pending) {
       if (!osr->deferred_running) {
-	_deferred_submit_unlock(osr.get());
+	if (elevator) {
+	  batches.push_back(_deferred_take_pending(osr.get()));
+	  osr->deferred_lock.unlock();
+	} else {
+	  _deferred_submit_unlock(osr.get());
+	}
       } else {
 	osr->deferred_lock.unlock();
 	dout(20) << __func__ << "  osr " << osr << " already has running"
@@ -15001,6 +16078,9 @@ void BlueStore::deferred_try_submit()
       dout(20) << __func__ << "  osr " << osr << " has no pending" << dendl;
     }
   }
+  if (!batches.empty()) {
+    _deferred_submit(batches);
+  }
 
   {
     std::lock_guard l(deferred_lock);
@@ -15008,11 +16088,9 @@ void BlueStore::deferred_try_submit()
   }
 }
 
-void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
+BlueStore::DeferredBatch *BlueStore::_deferred_take_pending(OpSequencer *osr)
 {
-  dout(10) << __func__ << " osr " << osr
-	   << " " << osr->deferred_pending->iomap.size() << " ios pending "
-	   << dendl;
+  ceph_assert(ceph_mutex_is_locked(osr->deferred_lock));
   ceph_assert(osr->deferred_pending);
   ceph_assert(!osr->deferred_running);
 
@@ -15022,47 +16100,87 @@ void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
 
   osr->deferred_running = osr->deferred_pending;
   osr->deferred_pending = nullptr;
+  return b;
+}
 
+void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
+{
+  dout(10) << __func__ << " osr " << osr
+	   << " " << osr->deferred_pending->iomap.size() << " ios pending "
+	   << dendl;
+  auto b = _deferred_take_pending(osr);
   osr->deferred_lock.unlock();
+  _deferred_submit({b});
+}
 
-  for (auto& txc : b->txcs) {
-    throttle.log_state_latency(txc, logger, l_bluestore_state_deferred_queued_lat);
+void BlueStore::_deferred_submit(const std::vector<DeferredBatch*>& batches)
+{
+  IOContext *ioc;
+  // offset -> data, across all batches; sequencers never have deferred
+  // io in flight to the same extents so there is no overlap to order
+  std::multimap<uint64_t, bufferlist*> ios;
+  if (batches.size() == 1) {
+    ioc = &batches.front()->ioc;
+  } else {
+    auto g = new DeferredBatchGroup(cct);
+    g->batches = batches;
+    ioc = &g->ioc;
+    dout(10) << __func__ << " " << batches.size() << " batches as one group"
+	     << dendl;
   }
+  for (auto b : batches) {
+    for (auto& txc : b->txcs) {
+      throttle.log_state_latency(txc, logger,
+				 l_bluestore_state_deferred_queued_lat);
+    }
+    for (auto& [off, io] : b->iomap) {
+      ios.emplace_hint(ios.end(), off, &io.bl);
+    }
+  }
+
   uint64_t start = 0, pos = 0;
   bufferlist bl;
-  auto i = b->iomap.begin();
+  auto i = ios.begin();
   while (true) {
-    if (i == b->iomap.end() || i->first != pos) {
+    if (i == ios.end() || i->first != pos) {
       if (bl.length()) {
 	dout(20) << __func__ << " write 0x" << std::hex
 		 << start << "~" << bl.length()
 		 << " crc " << bl.crc32c(-1) << std::dec << dendl;
 	if (!g_conf()->bluestore_debug_omit_block_device_write) {
+	  uint64_t last_end = deferred_last_write_end.exchange(
+	    start + bl.length());
+	  uint64_t seek = start > last_end ? start - last_end : last_end - start;
 	  logger->inc(l_bluestore_submitted_deferred_writes);
 	  logger->inc(l_bluestore_submitted_deferred_write_bytes, bl.length());
-	  int r = bdev->aio_write(start, bl, &b->ioc, false);
+	  logger->inc(l_bluestore_deferred_seek_bytes, seek);
+	  logger->hinc(l_bluestore_deferred_seek_hist, seek, bl.length());
+	  int r = bdev->aio_write(start, bl, ioc, false);
 	  ceph_assert(r == 0);
 	}
       }
-      if (i == b->iomap.end()) {
+      if (i == ios.end()) {
 	break;
       }
       start = 0;
       pos = i->first;
       bl.clear();
     }
-    dout(20) << __func__ << "   seq " << i->second.seq << " 0x"
-	     << std::hex << pos << "~" << i->second.bl.length() << std::dec
+    dout(20) << __func__ << "   0x"
+	     << std::hex << pos << "~" << i->second->length() << std::dec
 	     << dendl;
     if (!bl.length()) {
       start = pos;
     }
-    pos += i->second.bl.length();
-    bl.claim_append(i->second.bl);
+    pos += i->second->length();
+    bl.claim_append(*i->second);
+    if (!g_conf()->bluestore_debug_omit_block_device_write) {
+      logger->inc(l_bluestore_submitted_deferred_ios);
+    }
     ++i;
   }
 
-  bdev->aio_submit(&b->ioc);
+  bdev->aio_submit(ioc);
 }
 
 struct C_DeferredTrySubmit : public Context {
@@ -16688,7 +17806,18 @@ int BlueStore::_do_alloc_write(
       // FIXME: memory alignment here is bad
       bufferlist t;
       std::optional<int32_t> compressor_message;
-      int r = c->compress(wi.bl, t, compressor_message);
+      uint64_t chunk_size = comp_chunk_size;
+      bool chunked = chunk_size && wi.blob_length > chunk_size &&
+        _allow_compressed_chunks();
+      int r;
+      if (chunked) {
+        // chunks carry their own headers, so this is the final payload
+        r = _compress_chunks(c, wi.bl, chunk_size, &t,
+                             &wi.compressed_chunk_ends);
+        wi.compressed_chunk_order = std::countr_zero(chunk_size);
+      } else {
+        r = c->compress(wi.bl, t, compressor_message);
+      }
       uint64_t want_len_raw = wi.blob_length * crr;
       uint64_t want_len = p2roundup(want_len_raw, min_alloc_size);
       bool rejected = false;
@@ -16697,11 +17826,13 @@ int BlueStore::_do_alloc_write(
       // that doesn't take header overhead  into account
       uint64_t result_len = p2roundup(compressed_len, min_alloc_size);
       if (r == 0 && result_len <= want_len && result_len < wi.blob_length) {
-	bluestore_compression_header_t chdr;
-	chdr.type = c->get_type();
-	chdr.length = t.length();
-	chdr.compressor_message = compressor_message;
-	encode(chdr, wi.compressed_bl);
+	if (!chunked) {
+	  bluestore_compression_header_t chdr;
+	  chdr.type = c->get_type();
+	  chdr.length = t.length();
+	  chdr.compressor_message = compressor_message;
+	  encode(chdr, wi.compressed_bl);
+	}
 	wi.compressed_bl.claim_append(t);
 
 	compressed_len = wi.compressed_bl.length();
@@ -16797,6 +17928,13 @@ int BlueStore::_do_alloc_write(
       unsigned csum_order = std::countr_zero(csum_length);
       l = &wi.compressed_bl;
       dblob.set_compressed(wi.blob_length, wi.compressed_len);
+      if (!wi.compressed_chunk_ends.empty()) {
+        dblob.set_compressed_chunks(wi.compressed_chunk_order,
+                                    std::move(wi.compressed_chunk_ends));
+        // checksum at the usual granularity, otherwise reading one chunk
+        // would still mean reading the whole blob to verify it
+        csum_order = std::min<unsigned>(csum_order, wctx->csum_order);
+      }
       if (csum != Checksummer::CSUM_NONE) {
         dout(20) << __func__
 		 << " initialize csum setting for compressed blob " << *wi.b
@@ -19719,11 +20857,38 @@ int BlueStore::store_allocator(Allocator* src_allocator)
     }
   }
   bluefs->compact_log();
+  ret = store_allocator_image(allocator_file,
+    [&](std::function<void(uint64_t, uint64_t)> add_free) {
+      unique_ptr<Allocator> allocator(clone_allocator_without_bluefs(src_allocator));
+      if (!allocator) {
+	return -1;
+      }
+      allocator->foreach(add_free);
+      return 0;
+    });
+  if (ret != 0) {
+    return ret;
+  }
+
+  utime_t duration = ceph_clock_now() - start_time;
+  dout(5) <<"WRITE-duration=" << duration << " seconds" << dendl;
+  need_to_destage_allocation_file = false;
+  return 0;
+}
+
+// write the free extents produced by iterate() to allocator_dir/file_name,
+// iterate() gets the callback to feed them to and returns non-zero on failure
+//-----------------------------------------------------------------------------------
+int BlueStore::store_allocator_image(
+  const std::string& file_name,
+  std::function<int(std::function<void(uint64_t, uint64_t)>)> iterate)
+{
+  int ret = 0;
   // reuse previous file-allocation if exists
-  ret = bluefs->stat(allocator_dir, allocator_file, nullptr, nullptr);
+  ret = bluefs->stat(allocator_dir, file_name, nullptr, nullptr);
   bool overwrite_file = (ret == 0);
   BlueFS::FileWriter *p_handle = nullptr;
-  ret = bluefs->open_for_write(allocator_dir, allocator_file, &p_handle, overwrite_file);
+  ret = bluefs->open_for_write(allocator_dir, file_name, &p_handle, overwrite_file);
   if (ret != 0) {
     derr <<  __func__ << "Failed open_for_write with error-code " << ret << dendl;
     return -1;
@@ -19734,11 +20899,6 @@ int BlueStore::store_allocator(Allocator* src_allocator)
   dout(10) << "file_size=" << file_size << ", allocated=" << allocated << dendl;
 
   bluefs->sync_metadata(false);
-  unique_ptr<Allocator> allocator(clone_allocator_without_bluefs(src_allocator));
-  if (!allocator) {
-    bluefs->close_writer(p_handle);
-    return -1;
-  }
 
   // store all extents (except for the bluefs extents we removed) in a single flat file
   utime_t                 timestamp = ceph_clock_now();
@@ -19775,10 +20935,10 @@ int BlueStore::store_allocator(Allocator* src_allocator)
       p_curr = buffer; // recycle the buffer
     }
   };
-  allocator->foreach(iterated_allocation);
+  int r = iterate(iterated_allocation);
   // if got null extent -> fail the operation
-  if (ret != 0) {
-    derr << "Illegal extent, fail store operation" << dendl;
+  if (ret != 0 || r != 0) {
+    derr << "Illegal extent or iteration failure, fail store operation" << dendl;
     derr << "invalidate using bluefs->truncate(p_handle, 0)" << dendl;
     bluefs->truncate(p_handle, 0);
     bluefs->close_writer(p_handle);
@@ -19804,12 +20964,12 @@ int BlueStore::store_allocator(Allocator* src_allocator)
   bluefs->truncate(p_handle, p_handle->pos);
   bluefs->fsync(p_handle);
 
-  utime_t duration = ceph_clock_now() - start_time;
   dout(5) <<"WRITE-extent_count=" << extent_count << ", allocation_size=" << allocation_size << ", serial=" << s_serial << dendl;
-  dout(5) <<"p_handle->pos=" << p_handle->pos << " WRITE-duration=" << duration << " seconds" << dendl;
+  dout(5) <<"p_handle->pos=" << p_handle->pos << dendl;
 
   bluefs->close_writer(p_handle);
-  need_to_destage_allocation_file = false;
+  // the next image is a newer one
+  ++s_serial;
   return 0;
 }
 
@@ -19859,7 +21019,8 @@ int calc_allocator_image_trailer_size()
 }
 
 //-----------------------------------------------------------------------------------
-int BlueStore::__restore_allocator(Allocator* allocator, uint64_t *num, uint64_t *bytes)
+int BlueStore::__restore_allocator(std::function<void(uint64_t, uint64_t)> add_free,
+				   uint64_t *num, uint64_t *bytes)
 {
   if (cct->_conf->bluestore_debug_inject_allocation_from_file_failure > 0) {
      boost::mt11213b rng(time(NULL));
@@ -19947,7 +21108,7 @@ int BlueStore::__restore_allocator(Allocator* allocator, uint64_t *num, uint64_t
       read_alloc_size += length;
 
       if (length > 0) {
-	allocator->init_add_free(offset, length);
+	add_free(offset, length);
 	extent_count ++;
       } else {
 	derr << "extent with zero length at idx=" << extent_count << dendl;
@@ -20016,11 +21177,30 @@ int BlueStore::__restore_allocator(Allocator* allocator, uint64_t *num, uint64_t
 }
 
 //-----------------------------------------------------------------------------------
-int BlueStore::restore_allocator(Allocator* dest_allocator, uint64_t *num, uint64_t *bytes)
+int BlueStore::restore_allocator(Allocator* dest_allocator, uint64_t *num, uint64_t *bytes,
+				 const alloc_delta_t *delta)
 {
   utime_t    start = ceph_clock_now();
   auto temp_allocator = unique_ptr<Allocator>(create_bitmap_allocator(bdev->get_size()));
-  int ret = __restore_allocator(temp_allocator.get(), num, bytes);
+  auto add_free = [&](uint64_t offset, uint64_t length) {
+    temp_allocator->init_add_free(offset, length);
+  };
+  int ret;
+  if (delta) {
+    ret = __restore_allocator([&](uint64_t offset, uint64_t length) {
+      delta->for_each_free(offset, length, add_free);
+    }, num, bytes);
+    if (ret == 0) {
+      for (auto p = delta->released.begin(); p != delta->released.end(); ++p) {
+	add_free(p.get_start(), p.get_len());
+      }
+      dout(5) << "applied " << delta->count << " deltas, allocated 0x" << std::hex
+	      << delta->allocated.size() << " released 0x" << delta->released.size()
+	      << std::dec << dendl;
+    }
+  } else {
+    ret = __restore_allocator(add_free, num, bytes);
+  }
   if (ret != 0) {
     return ret;
   }
@@ -20033,6 +21213,191 @@ int BlueStore::restore_allocator(Allocator* dest_allocator, uint64_t *num, uint6
   return ret;
 }
 
+//-----------------------------------------------------------------------------------
+static void cut_extent(interval_set<uint64_t>& s, uint64_t offset, uint64_t length)
+{
+  uint64_t end = offset + length;
+  std::vector<std::pair<uint64_t, uint64_t>> overlap;
+  for (auto p = s.lower_bound(offset); p != s.end() && p.get_start() < end; ++p) {
+    uint64_t b = std::max(p.get_start(), offset);
+    uint64_t e = std::min(p.get_end(), end);
+    overlap.emplace_back(b, e - b);
+  }
+  for (auto& [o, l] : overlap) {
+    s.erase(o, l);
+  }
+}
+
+template <typename F>
+static void for_each_gap(const interval_set<uint64_t>& s, uint64_t offset, uint64_t length, F&& f)
+{
+  uint64_t end = offset + length;
+  uint64_t pos = offset;
+  for (auto p = s.lower_bound(offset); p != s.end() && p.get_start() < end; ++p) {
+    if (p.get_start() > pos) {
+      f(pos, p.get_start() - pos);
+    }
+    pos = std::max(pos, p.get_end());
+  }
+  if (pos < end) {
+    f(pos, end - pos);
+  }
+}
+
+//-----------------------------------------------------------------------------------
+void BlueStore::alloc_delta_t::add(const interval_set<uint64_t>& a,
+				    const interval_set<uint64_t>& r)
+{
+  for (auto p = a.begin(); p != a.end(); ++p) {
+    cut_extent(released, p.get_start(), p.get_len());
+    cut_extent(allocated, p.get_start(), p.get_len());
+    allocated.insert(p.get_start(), p.get_len());
+  }
+  for (auto p = r.begin(); p != r.end(); ++p) {
+    cut_extent(allocated, p.get_start(), p.get_len());
+    cut_extent(released, p.get_start(), p.get_len());
+    released.insert(p.get_start(), p.get_len());
+  }
+  ++count;
+}
+
+//-----------------------------------------------------------------------------------
+void BlueStore::alloc_delta_t::for_each_free(
+  uint64_t offset, uint64_t length,
+  const std::function<void(uint64_t, uint64_t)>& f) const
+{
+  for_each_gap(allocated, offset, length, [&](uint64_t o, uint64_t l) {
+    for_each_gap(released, o, l, f);
+  });
+}
+
+// fold all logged allocation deltas, in seq order, and return their keys
+//-----------------------------------------------------------------------------------
+int BlueStore::load_alloc_deltas(alloc_delta_t *delta, std::vector<std::string> *keys)
+{
+  KeyValueDB::Iterator it = db->get_iterator(PREFIX_ALLOC_DELTA, KeyValueDB::ITERATOR_NOCACHE);
+  for (it->lower_bound(string()); it->valid(); it->next()) {
+    interval_set<uint64_t> allocated, released;
+    bufferlist bl = it->value();
+    auto p = bl.cbegin();
+    try {
+      DECODE_START(1, p);
+      decode(allocated, p);
+      decode(released, p);
+      DECODE_FINISH(p);
+    } catch (ceph::buffer::error& e) {
+      derr << "failed to decode allocation delta "
+	   << pretty_binary_string(it->key()) << dendl;
+      return -EIO;
+    }
+    delta->add(allocated, released);
+    keys->push_back(it->key());
+  }
+  dout(5) << "loaded " << keys->size() << " deltas" << dendl;
+  return 0;
+}
+
+//-----------------------------------------------------------------------------------
+int BlueStore::purge_alloc_deltas()
+{
+  dout(5) << "t->rmkeys_by_prefix(PREFIX_ALLOC_DELTA)" << dendl;
+  KeyValueDB::Transaction t = db->get_transaction();
+  t->rmkeys_by_prefix(PREFIX_ALLOC_DELTA);
+  int r = db->submit_transaction_sync(t);
+  if (r == 0) {
+    alloc_delta_stale = false;
+  }
+  return r;
+}
+
+// Fold the deltas logged so far into a new allocation file and drop them.
+// Replaying a delta that is already part of the file is harmless (every
+// extent ends up in the state of its last event), so a crash between the
+// rename and the key removal only costs a longer replay on the next mount.
+//-----------------------------------------------------------------------------------
+int BlueStore::compact_alloc_deltas()
+{
+  utime_t start_time = ceph_clock_now();
+  alloc_delta_t delta;
+  std::vector<std::string> keys;
+  int ret = load_alloc_deltas(&delta, &keys);
+  if (ret != 0 || keys.empty()) {
+    return ret;
+  }
+
+  // the file is sorted and coalesced (it's written from a bitmap allocator),
+  // keep it that way by merging the released extents in offset order
+  static const std::string compact_file = allocator_file + ".compact";
+  ret = store_allocator_image(compact_file,
+    [&](std::function<void(uint64_t, uint64_t)> add_free) {
+      uint64_t pending_offset = 0, pending_length = 0;
+      auto emit = [&](uint64_t offset, uint64_t length) {
+	if (pending_length && pending_offset + pending_length == offset) {
+	  pending_length += length;
+	  return;
+	}
+	if (pending_length) {
+	  add_free(pending_offset, pending_length);
+	}
+	pending_offset = offset;
+	pending_length = length;
+      };
+      auto rp = delta.released.begin();
+      auto put = [&](uint64_t offset, uint64_t length) {
+	for (; rp != delta.released.end() && rp.get_start() < offset; ++rp) {
+	  emit(rp.get_start(), rp.get_len());
+	}
+	emit(offset, length);
+      };
+      uint64_t last_end = 0;
+      bool sorted = true;
+      uint64_t num, bytes;
+      int r = __restore_allocator([&](uint64_t offset, uint64_t length) {
+	sorted = sorted && offset >= last_end;
+	last_end = offset + length;
+	delta.for_each_free(offset, length, put);
+      }, &num, &bytes);
+      if (r != 0) {
+	return r;
+      }
+      if (!sorted) {
+	derr << "allocation file is not sorted, can't fold deltas" << dendl;
+	return -EINVAL;
+      }
+      for (; rp != delta.released.end(); ++rp) {
+	emit(rp.get_start(), rp.get_len());
+      }
+      if (pending_length) {
+	add_free(pending_offset, pending_length);
+      }
+      return 0;
+    });
+  if (ret != 0) {
+    return -EIO;
+  }
+  ret = bluefs->rename(allocator_dir, compact_file, allocator_dir, allocator_file);
+  if (ret != 0) {
+    derr << "failed to rename " << compact_file << " to " << allocator_file
+	 << ": " << cpp_strerror(ret) << dendl;
+    return ret;
+  }
+  bluefs->sync_metadata(false);
+
+  KeyValueDB::Transaction t = db->get_transaction();
+  for (auto& key : keys) {
+    t->rmkey(PREFIX_ALLOC_DELTA, key);
+  }
+  ret = db->submit_transaction_sync(t);
+  if (ret != 0) {
+    return ret;
+  }
+  alloc_delta_pending -= keys.size();
+  utime_t duration = ceph_clock_now() - start_time;
+  dout(5) << "folded " << keys.size() << " deltas in " << duration
+	  << " seconds" << dendl;
+  return 0;
+}
+
 //-----------------------------------------------------------------------------------
 void BlueStore::set_allocation_in_simple_bmap(SimpleBitmap* sbmap, uint64_t offset, uint64_t length)
 {
@@ -111,6 +111,9 @@ enum {
   l_bluestore_read_eio,
   l_bluestore_reads_with_retries,
   l_bluestore_read_lat,
+  l_bluestore_digest_lat,
+  l_bluestore_digest_csum_bytes,
+  l_bluestore_digest_data_bytes,
   //****************************************
 
   // kv_thread latencies
@@ -119,6 +122,8 @@ enum {
   l_bluestore_kv_commit_lat,
   l_bluestore_kv_sync_lat,
   l_bluestore_kv_final_lat,
+  l_bluestore_kv_pipeline_wait_lat,
+  l_bluestore_kv_pipelined,
   //****************************************
 
   // write op stats
@@ -141,6 +146,8 @@ enum {
   l_bluestore_issued_deferred_write_bytes,
   l_bluestore_submitted_deferred_writes,
   l_bluestore_submitted_deferred_write_bytes,
+  l_bluestore_submitted_deferred_ios,
+  l_bluestore_deferred_seek_bytes,
 
   l_bluestore_write_big_skipped_blobs,
   l_bluestore_write_big_skipped_bytes,
@@ -157,6 +164,8 @@ enum {
   l_bluestore_decompress_lat,
   l_bluestore_compress_success_count,
   l_bluestore_compress_rejected_count,
+  l_bluestore_decompressed_bytes,
+  l_bluestore_decompressed_wanted_bytes,
   //****************************************
 
   // onode cache stats
@@ -211,6 +220,7 @@ enum {
   // allocation stats
   //****************************************
   l_bluestore_allocate_hist,
+  l_bluestore_deferred_seek_hist,
   //****************************************
 
   // slow op counter
@@ -987,6 +997,9 @@ public:
       virtual void consume_spanning_blob(uint64_t sbid, BlobRef b) = 0;
       virtual Extent* get_next_extent() = 0;
       virtual void add_extent(Extent*) = 0;
+      /// called once per shard with the encoded extent count
+      virtual void reserve_extents(uint32_t n) {
+      }
 
       void decode_extent(Extent* le,
                          __u8 struct_v,
@@ -1012,6 +1025,9 @@ public:
       void consume_spanning_blob(uint64_t sbid, BlobRef b) override;
       Extent* get_next_extent() override;
       void add_extent(Extent* ) override;
+      void reserve_extents(uint32_t n) override {
+        blobs.reserve(n);
+      }
     public:
       ExtentDecoderFull (ExtentMap& _extent_map) : extent_map(_extent_map) {
       }
@@ -1280,6 +1296,9 @@ public:
     ceph::mutex flush_lock = ceph::make_mutex("BlueStore::Onode::flush_lock");
     ceph::condition_variable flush_cond;   ///< wait here for uncommitted txns
     std::shared_ptr<int64_t> cache_age_bin;  ///< cache age bin
+    /// OnodeCacheShard::lru_epoch at which we were last moved to the LRU
+    /// head, or 0 if we are not at the head (see maybe_unpin)
+    std::atomic<uint64_t> lru_epoch = {0};
 
     Onode(Collection *c, const ghobject_t& o,
 	  const mempool::bluestore_cache_meta::string& k)
@@ -1475,6 +1494,11 @@ private:
   struct OnodeCacheShard : public CacheShard {
     std::array<std::pair<ghobject_t, ceph::mono_clock::time_point>, 64> dumped_onodes;
 
+    /// bumped on every age bin rotation and on every trim that evicts
+    /// something; an Onode that was promoted during the current epoch
+    /// can be unpinned without taking the shard lock
+    std::atomic<uint64_t> lru_epoch = {1};
+
   public:
     OnodeCacheShard(CephContext* cct) : CacheShard(cct) {}
     static OnodeCacheShard *create(CephContext* cct, std::string type,
@@ -1491,6 +1515,11 @@ private:
     bool empty() {
       return _get_num() == 0;
     }
+
+    void shift_bins() override {
+      CacheShard::shift_bins();
+      ++lru_epoch;
+    }
   };
 
   /// A Generic buffer Cache Shard
@@ -1546,13 +1575,20 @@ private:
     OnodeCacheShard *cache;
 
   private:
+    /// protect onode_map against concurrent lookups.  Modifications take
+    /// it exclusively while holding cache->lock; lookups only take it
+    /// shared so that cache hits never contend on the cache shard lock.
+    ceph::shared_mutex lock =
+      ceph::make_shared_mutex("BlueStore::OnodeSpace::lock");
+
     /// forward lookups
     mempool::bluestore_cache_meta::unordered_map<ghobject_t,OnodeRef> onode_map;
 
     friend struct Collection; // for split_cache()
     friend struct Onode; // for put()
     friend struct LruOnodeCacheShard;
-    void _remove(const ghobject_t& oid);
+    /// drop o from the map unless a lookup has pinned it meanwhile
+    bool _try_remove(Onode* o);
   public:
     OnodeSpace(OnodeCacheShard *c) : cache(c) {}
     ~OnodeSpace() {
@@ -2089,6 +2125,22 @@ private:
     }
   };
 
+  /// deferred batches of several sequencers submitted as one sorted stream
+  struct DeferredBatchGroup final : public AioContext {
+    std::vector<DeferredBatch*> batches;
+    IOContext ioc;                   ///< aios of all batches
+
+    DeferredBatchGroup(CephContext *cct)
+      : ioc(cct, this) {}
+
+    void aio_finish(BlueStore *store) override {
+      for (auto b : batches) {
+	store->_deferred_aio_finish(b->osr);
+      }
+      delete this;
+    }
+  };
+
   class OpSequencer : public RefCountedObject {
   public:
     ceph::mutex qlock = ceph::make_mutex("BlueStore::OpSequencer::qlock");
@@ -2241,6 +2293,34 @@ private:
       return NULL;
     }
   };
+  struct KVCommitThread : public Thread {
+    BlueStore *store;
+    explicit KVCommitThread(BlueStore *s) : store(s) {}
+    void *entry() override {
+      store->_kv_commit_thread();
+      return NULL;
+    }
+  };
+  struct AllocDeltaThread : public Thread {
+    BlueStore *store;
+    explicit AllocDeltaThread(BlueStore *s) : store(s) {}
+    void *entry() override {
+      store->_alloc_delta_thread();
+      return NULL;
+    }
+  };
+
+  /// a flushed and applied batch waiting for its kv sync
+  struct KVCommitBatch {
+    std::deque<TransContext*> committing;
+    std::deque<DeferredBatch*> deferred_stable;
+    size_t deferred_done = 0;  ///< for tracing only
+    KeyValueDB::Transaction synct;
+    uint64_t new_nid_max = 0;
+    uint64_t new_blobid_max = 0;
+    ceph::mono_clock::time_point start;
+    ceph::mono_clock::time_point after_flush;
+  };
 
 #ifdef HAVE_LIBZBD
   struct ZonedCleanerThread : public Thread {
@@ -2299,6 +2379,18 @@ private:
   bool db_was_opened_read_only = true;
   bool need_to_destage_allocation_file = false;
 
+  /// allocation deltas are logged with every txc in this run, and the
+  /// allocation file plus the deltas describe the allocation state
+  bool alloc_delta_log = false;
+  /// deltas left by a previous run that don't match the allocation file
+  bool alloc_delta_stale = false;
+  /// don't trust the allocation file + deltas on the next mount
+  bool skip_alloc_delta_replay = false;
+  std::atomic<uint64_t> alloc_delta_seq = {0};
+  std::atomic<uint64_t> alloc_delta_pending = {0}; ///< deltas not folded yet
+  std::atomic_bool alloc_delta_compacting = {false};
+  uint64_t alloc_delta_compact_entries = 0;
+
   ///< rwlock to protect coll_map/new_coll_map
   ceph::shared_mutex coll_lock = ceph::make_shared_mutex("BlueStore::coll_lock");
   mempool::bluestore_cache_other::unordered_map<coll_t, CollectionRef> coll_map;
@@ -2327,6 +2419,7 @@ private:
   std::atomic_int deferred_aggressive = {0}; ///< aggressive wakeup of kv thread
   Finisher  finisher;
   utime_t  deferred_last_submitted = utime_t();
+  std::atomic<uint64_t> deferred_last_write_end = {0}; ///< for seek stats
 
   KVSyncThread kv_sync_thread;
   ceph::mutex kv_lock = ceph::make_mutex("BlueStore::kv_lock");
@@ -2349,6 +2442,24 @@ private:
   std::deque<DeferredBatch*> deferred_stable_to_finalize; ///< pending finalization
   bool kv_finalize_in_progress = false;
 
+  /// with bluestore_kv_sync_pipeline the kv sync thread only flushes and
+  /// applies, and the sync of the db happens here so that the next batch
+  /// can be flushed meanwhile
+  bool kv_pipeline = false;
+  KVCommitThread kv_commit_thread;
+  ceph::mutex kv_commit_lock = ceph::make_mutex("BlueStore::kv_commit_lock");
+  ceph::condition_variable kv_commit_cond;
+  std::deque<KVCommitBatch> kv_commit_queue;  ///< flushed, waiting for sync
+  bool kv_commit_in_progress = false;  ///< a batch is being synced
+  bool kv_commit_started = false;
+  bool kv_commit_stop = false;
+
+  AllocDeltaThread alloc_delta_thread;
+  ceph::mutex alloc_delta_lock = ceph::make_mutex("BlueStore::alloc_delta_lock");
+  ceph::condition_variable alloc_delta_cond;
+  bool alloc_delta_started = false;
+  bool alloc_delta_stop = false;
+
 #ifdef HAVE_LIBZBD
   ZonedCleanerThread zoned_cleaner_thread;
   ceph::mutex zoned_cleaner_lock = ceph::make_mutex("BlueStore::zoned_cleaner_lock");
@@ -2410,6 +2521,7 @@ private:
   CompressorRef compressor;
   std::atomic<uint64_t> comp_min_blob_size = {0};
   std::atomic<uint64_t> comp_max_blob_size = {0};
+  std::atomic<uint64_t> comp_chunk_size = {0};  ///< 0 or a power of two
 
   std::atomic<uint64_t> max_blob_size = {0};  ///< maximum blob size
 
@@ -2741,7 +2853,8 @@ private:
   void _close_fm();
   int _write_out_fm_meta(uint64_t target_size);
   int _create_alloc();
-  int _init_alloc(std::map<uint64_t, uint64_t> *zone_adjustments);
+  int _init_alloc(std::map<uint64_t, uint64_t> *zone_adjustments,
+		  bool replay_alloc_deltas);
   void _post_init_alloc(const std::map<uint64_t, uint64_t>& zone_adjustments);
   void _close_alloc();
   int _open_collections();
@@ -2819,8 +2932,15 @@ private:
   void _kv_start();
   void _kv_stop();
   void _kv_sync_thread();
+  void _kv_commit_thread();
+  void _kv_commit_batch(KVCommitBatch& b);
   void _kv_finalize_thread();
 
+  bool _use_alloc_delta_log() const;
+  void _alloc_delta_start();
+  void _alloc_delta_stop();
+  void _alloc_delta_thread();
+
 #ifdef HAVE_LIBZBD
   void _zoned_cleaner_start();
   void _zoned_cleaner_stop();
@@ -2837,6 +2957,8 @@ public:
   void deferred_try_submit();
 private:
   void _deferred_submit_unlock(OpSequencer *osr);
+  DeferredBatch *_deferred_take_pending(OpSequencer *osr);
+  void _deferred_submit(const std::vector<DeferredBatch*>& batches);
   void _deferred_aio_finish(OpSequencer *osr);
   int _deferred_replay();
   bool _eliminate_outdated_deferred(bluestore_deferred_transaction_t* deferred_txn,
@@ -2919,12 +3041,19 @@ private:
 
   // -- ondisk version ---
 public:
-  const int32_t latest_ondisk_format = 4;        ///< our version
+  const int32_t latest_ondisk_format = 5;        ///< our version
   const int32_t min_readable_ondisk_format = 1;  ///< what we can read
   const int32_t min_compat_ondisk_format = 3;    ///< who can read us
+  /// who can read us once a blob was compressed in chunks
+  const int32_t compressed_chunks_compat_ondisk_format = 5;
 
 private:
   int32_t ondisk_format = 0;  ///< value detected on mount
+  /// min_compat_ondisk_format in the superblock
+  std::atomic<int32_t> super_compat_ondisk_format = {0};
+  ceph::mutex super_compat_lock =
+    ceph::make_mutex("BlueStore::super_compat_lock");
+  bool _allow_compressed_chunks();
   bool    m_fast_shutdown = false;
   int _upgrade_super();  ///< upgrade (called during open_super)
   uint64_t _get_ondisk_reserved() const;
@@ -2957,6 +3086,11 @@ public:
   bool is_journal_rotational() override;
   bool is_db_rotational();
   bool is_statfs_recoverable() const;
+  /// deltas loaded on mount or logged since which aren't in the allocation
+  /// file yet, 0 if this run doesn't log them
+  uint64_t get_alloc_deltas_pending() const {
+    return alloc_delta_log ? alloc_delta_pending.load() : 0;
+  }
 
   std::string get_default_device_class() override {
     std::string device_class;
@@ -3093,6 +3227,14 @@ public:
     ceph::buffer::list& bl,
     uint32_t op_flags = 0) override;
 
+  int digest(
+    CollectionHandle &c,
+    const ghobject_t& oid,
+    uint64_t offset,
+    size_t len,
+    uint32_t *crc,
+    uint32_t op_flags = 0) override;
+
 private:
 
   // --------------------------------------------------------
@@ -3151,11 +3293,29 @@ private:
     blobs2read_t& blobs2read);
 
 
+  /// part of a chunked compressed blob to read for r2r
+  void _get_compressed_read_range(
+    const bluestore_blob_t& blob,
+    const regions2read_t& r2r,
+    unsigned* first,
+    unsigned* last,
+    uint64_t* r_off,
+    uint64_t* r_len);
+
   int _prepare_read_ioc(
     blobs2read_t& blobs2read,
     std::vector<ceph::buffer::list>* compressed_blob_bls,
     IOContext* ioc);
 
+  /// verify and decompress blobs2read into ready_regions
+  int _fill_ready_regions(
+    OnodeRef& o,
+    ready_regions_t& ready_regions,
+    std::vector<ceph::buffer::list>& compressed_blob_bls,
+    blobs2read_t& blobs2read,
+    bool buffered,
+    bool* csum_error);
+
   int _generate_read_result_bl(
     OnodeRef& o,
     uint64_t offset,
@@ -3176,6 +3336,15 @@ private:
     uint32_t op_flags = 0,
     uint64_t retry_count = 0);
 
+  int _do_digest(
+    Collection *c,
+    OnodeRef& o,
+    uint64_t offset,
+    size_t len,
+    uint32_t *crc,
+    uint32_t op_flags = 0,
+    uint64_t retry_count = 0);
+
   int _do_readv(
     Collection *c,
     OnodeRef& o,
@@ -3480,6 +3649,12 @@ private:
     const ceph::buffer::list& bl,
     uint64_t logical_offset) const;
   int _decompress(ceph::buffer::list& source, ceph::buffer::list* result);
+  int _compress_chunks(
+    CompressorRef& c,
+    const ceph::buffer::list& source,
+    uint64_t chunk_size,
+    ceph::buffer::list* result,
+    mempool::bluestore_cache_other::vector<uint32_t>* ends);
 
 
   // --------------------------------------------------------
@@ -3509,6 +3684,9 @@ private:
       bool compressed = false;
       ceph::buffer::list compressed_bl;
       size_t compressed_len = 0;
+      uint8_t compressed_chunk_order = 0;
+      /// set if compressed in chunks, see bluestore_blob_t
+      mempool::bluestore_cache_other::vector<uint32_t> compressed_chunk_ends;
 
       write_item(
 	uint64_t logical_offs,
@@ -3777,6 +3955,8 @@ public:
     store_statfs_t& expected_store_statfs;
     per_pool_statfs& expected_pool_statfs;
     BlueStoreRepairer* repairer;
+    /// guards used_blocks when several threads walk the objects
+    ceph::mutex* used_blocks_lock = nullptr;
 
     FSCK_ObjectCtx(int64_t& e,
                    int64_t& w,
@@ -3824,6 +4004,34 @@ public:
     mempool::bluestore_fsck::list<std::string>* expecting_shards,
     std::map<BlobRef, bluestore_blob_t::unused_t>* referenced,
     const BlueStore::FSCK_ObjectCtx& ctx);
+  // reads all object data back, which verifies its checksums;
+  // returns the number of errors found
+  int64_t fsck_check_object_data(CollectionRef c, OnodeRef o);
+
+  /// where a running fsck is, reported by "bluestore fsck progress"
+  struct FSCK_Progress {
+    std::atomic<const char*> phase = {nullptr};
+    std::atomic<uint64_t> object_keys = {0};   ///< onode keys walked
+    std::atomic<uint64_t> deep_queued = {0};   ///< objects waiting for a read
+    std::atomic<uint64_t> deep_objects = {0};  ///< objects read back
+    std::atomic<uint64_t> deep_bytes = {0};
+    std::atomic<uint64_t> deep_errors = {0};
+    ceph::mono_time start;
+
+    void reset() {
+      phase = nullptr;
+      object_keys = 0;
+      deep_queued = 0;
+      deep_objects = 0;
+      deep_bytes = 0;
+      deep_errors = 0;
+      start = ceph::mono_clock::now();
+    }
+    void dump(ceph::Formatter* f) const;
+  };
+  void dump_fsck_progress(ceph::Formatter* f) const {
+    fsck_progress.dump(f);
+  }
 #ifdef CEPH_BLUESTORE_TOOL_RESTORE_ALLOCATION
   int  push_allocation_to_rocksdb();
   int  read_allocation_from_drive_for_bluestore_tool();
@@ -3831,6 +4039,8 @@ public:
   void set_allocation_in_simple_bmap(SimpleBitmap* sbmap, uint64_t offset, uint64_t length);
 
 private:
+  FSCK_Progress fsck_progress;
+
   struct  read_alloc_stats_t {
     uint32_t onode_count             = 0;
     uint32_t shard_count             = 0;
@@ -3908,6 +4118,20 @@ private:
     return out;
   }
 
+  /// net effect of a sequence of allocation deltas; every extent that was
+  /// touched is in exactly one of the sets, according to its last event
+  struct alloc_delta_t {
+    interval_set<uint64_t> allocated;
+    interval_set<uint64_t> released;
+    uint64_t count = 0;
+
+    void add(const interval_set<uint64_t>& a, const interval_set<uint64_t>& r);
+    /// call f for the pieces of a free extent that are neither allocated nor
+    /// released by the deltas (released space is reported separately)
+    void for_each_free(uint64_t offset, uint64_t length,
+		       const std::function<void(uint64_t, uint64_t)>& f) const;
+  };
+
   int  compare_allocators(Allocator* alloc1, Allocator* alloc2, uint64_t req_extent_count, uint64_t memory_target);
   Allocator* create_bitmap_allocator(uint64_t bdev_size);
   int  add_existing_bluefs_allocation(Allocator* allocator, read_alloc_stats_t& stats);
@@ -3916,9 +4140,15 @@ private:
 
   int  copy_allocator(Allocator* src_alloc, Allocator *dest_alloc, uint64_t* p_num_entries);
   int  store_allocator(Allocator* allocator);
+  int  store_allocator_image(const std::string& file_name,
+			     std::function<int(std::function<void(uint64_t, uint64_t)>)> iterate);
   int  invalidate_allocation_file_on_bluefs();
-  int  __restore_allocator(Allocator* allocator, uint64_t *num, uint64_t *bytes);
-  int  restore_allocator(Allocator* allocator, uint64_t *num, uint64_t *bytes);
+  int  __restore_allocator(std::function<void(uint64_t, uint64_t)> add_free, uint64_t *num, uint64_t *bytes);
+  int  restore_allocator(Allocator* allocator, uint64_t *num, uint64_t *bytes,
+			 const alloc_delta_t *delta = nullptr);
+  int  load_alloc_deltas(alloc_delta_t *delta, std::vector<std::string> *keys);
+  int  purge_alloc_deltas();
+  int  compact_alloc_deltas();
   int  read_allocation_from_drive_on_startup();
   int  reconstruct_allocations(SimpleBitmap *smbmp, read_alloc_stats_t &stats);
   int  read_allocation_from_onodes(SimpleBitmap *smbmp, read_alloc_stats_t& stats);
@@ -3939,6 +4169,19 @@ private:
 
   void _fsck_check_objects(FSCKDepth depth,
     FSCK_ObjectCtx& ctx);
+  void _fsck_check_objects_parallel(FSCKDepth depth,
+    size_t walkers,
+    FSCK_ObjectCtx& ctx);
+  /// walks the object keys from begin up to end (no bound if empty),
+  /// returns the number of objects checked on the calling thread
+  size_t _fsck_walk_objects(FSCKDepth depth,
+    const std::string& begin,
+    const std::string& end,
+    uint64_t_btree_t& used_nids,
+    std::function<bool(int64_t, CollectionRef, const ghobject_t&,
+                       const std::string&, const ceph::buffer::list&)> queue_shallow,
+    std::function<void(CollectionRef, OnodeRef)> queue_deep,
+    FSCK_ObjectCtx& ctx);
 };
 
 inline std::ostream& operator<<(std::ostream& out, const BlueStore::volatile_statfs& s) {
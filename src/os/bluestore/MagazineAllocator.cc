@@ -0,0 +1,203 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "MagazineAllocator.h"
+
+#include <thread>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "common/debug.h"
+
+#define dout_context cct
+#define dout_subsys ceph_subsys_bluestore
+#undef  dout_prefix
+#define dout_prefix *_dout << "MagazineAllocator "
+
+MagazineAllocator::MagazineAllocator(
+  CephContext* cct,
+  int64_t device_size,
+  int64_t _block_size,
+  uint64_t max_mem,
+  size_t _num_shards,
+  uint64_t _mag_size,
+  std::string_view name)
+  : HybridAllocator(cct, device_size, _block_size, max_mem, name),
+    mag_size(std::max<uint64_t>(_mag_size, 2)),
+    num_shards(_num_shards ? _num_shards :
+	       std::max(1u, std::thread::hardware_concurrency()))
+{
+  shards.reset(new shard_t[num_shards]);
+  for (size_t i = 0; i < num_shards; ++i) {
+    shards[i].mag.reserve(mag_size);
+  }
+  ldout(cct, 10) << __func__ << " shards " << num_shards
+		 << " magazine size " << mag_size << dendl;
+}
+
+MagazineAllocator::shard_t& MagazineAllocator::_get_shard()
+{
+#ifdef __linux__
+  int cpu = sched_getcpu();
+  if (cpu >= 0) {
+    return shards[cpu % num_shards];
+  }
+#endif
+  return shards[std::hash<std::thread::id>()(std::this_thread::get_id()) %
+		num_shards];
+}
+
+void MagazineAllocator::_refill(shard_t& s)
+{
+  // take half a magazine at once; the rest is left for releases
+  uint64_t unit = get_block_size();
+  PExtentVector tmp;
+  int64_t r = HybridAllocator::allocate(unit * (mag_size / 2), unit, unit,
+					0, &tmp);
+  if (r <= 0) {
+    return;
+  }
+  for (auto& e : tmp) {
+    ceph_assert(e.length == unit);
+    s.mag.push_back(e.offset);
+  }
+  cached += r;
+}
+
+void MagazineAllocator::_flush_all()
+{
+  interval_set<uint64_t> to_release;
+  for (size_t i = 0; i < num_shards; ++i) {
+    auto& s = shards[i];
+    std::lock_guard l(s.lock);
+    for (auto o : s.mag) {
+      to_release.insert(o, get_block_size());
+    }
+    cached -= s.mag.size() * get_block_size();
+    s.mag.clear();
+  }
+  if (!to_release.empty()) {
+    ldout(cct, 20) << __func__ << " returning 0x" << std::hex
+		   << to_release.size() << std::dec << " bytes" << dendl;
+    HybridAllocator::release(to_release);
+  }
+}
+
+int64_t MagazineAllocator::allocate(
+  uint64_t want,
+  uint64_t unit,
+  uint64_t max_alloc_size,
+  int64_t  hint,
+  PExtentVector* extents)
+{
+  uint64_t mag_unit = get_block_size();
+  if (want == mag_unit && unit <= mag_unit && mag_unit % unit == 0) {
+    auto& s = _get_shard();
+    std::lock_guard l(s.lock);
+    if (s.mag.empty()) {
+      ++s.misses;
+      _refill(s);
+    } else {
+      ++s.hits;
+    }
+    if (!s.mag.empty()) {
+      extents->emplace_back(s.mag.back(), mag_unit);
+      s.mag.pop_back();
+      cached -= mag_unit;
+      return mag_unit;
+    }
+  }
+
+  auto orig_size = extents->size();
+  int64_t r = HybridAllocator::allocate(want, unit, max_alloc_size, hint,
+					extents);
+  if ((r < 0 || (uint64_t)r < want) && cached) {
+    // part of the free space is parked in magazines; give it back and
+    // retry so that caching never turns into ENOSPC
+    if (r > 0) {
+      interval_set<uint64_t> partial;
+      for (auto i = orig_size; i < extents->size(); ++i) {
+	partial.insert((*extents)[i].offset, (*extents)[i].length);
+      }
+      extents->resize(orig_size);
+      HybridAllocator::release(partial);
+    }
+    _flush_all();
+    r = HybridAllocator::allocate(want, unit, max_alloc_size, hint, extents);
+  }
+  return r;
+}
+
+void MagazineAllocator::release(const interval_set<uint64_t>& release_set)
+{
+  uint64_t mag_unit = get_block_size();
+  interval_set<uint64_t> rest;
+  {
+    auto& s = _get_shard();
+    std::lock_guard l(s.lock);
+    for (auto p = release_set.begin(); p != release_set.end(); ++p) {
+      if (p.get_len() != mag_unit || p.get_start() % mag_unit != 0) {
+	rest.insert(p.get_start(), p.get_len());
+	continue;
+      }
+      if (s.mag.size() >= mag_size) {
+	// hand the older half back, it is the least likely to be hot
+	auto half = s.mag.begin() + mag_size / 2;
+	for (auto i = s.mag.begin(); i != half; ++i) {
+	  rest.union_insert(*i, mag_unit);
+	}
+	s.mag.erase(s.mag.begin(), half);
+	cached -= (mag_size / 2) * mag_unit;
+      }
+      s.mag.push_back(p.get_start());
+      cached += mag_unit;
+    }
+  }
+  if (!rest.empty()) {
+    HybridAllocator::release(rest);
+  }
+}
+
+uint64_t MagazineAllocator::get_free()
+{
+  return HybridAllocator::get_free() + cached;
+}
+
+double MagazineAllocator::get_fragmentation()
+{
+  _flush_all();
+  return HybridAllocator::get_fragmentation();
+}
+
+void MagazineAllocator::dump()
+{
+  _flush_all();
+  HybridAllocator::dump();
+  for (size_t i = 0; i < num_shards; ++i) {
+    auto& s = shards[i];
+    std::lock_guard l(s.lock);
+    ldout(cct, 0) << __func__ << " shard " << i
+		  << " hits " << s.hits
+		  << " misses " << s.misses << dendl;
+  }
+}
+
+void MagazineAllocator::foreach(
+  std::function<void(uint64_t offset, uint64_t length)> notify)
+{
+  _flush_all();
+  HybridAllocator::foreach(notify);
+}
+
+void MagazineAllocator::init_rm_free(uint64_t offset, uint64_t length)
+{
+  _flush_all();
+  HybridAllocator::init_rm_free(offset, length);
+}
+
+void MagazineAllocator::shutdown()
+{
+  _flush_all();
+  HybridAllocator::shutdown();
+}
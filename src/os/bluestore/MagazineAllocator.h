@@ -0,0 +1,75 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "HybridAllocator.h"
+#include "common/ceph_mutex.h"
+
+/*
+ * Hybrid allocator fronted by per-CPU magazines of single allocation
+ * units.
+ *
+ * Releases of exactly one allocation unit are parked in the releasing
+ * CPU's magazine, and single unit allocations are served from it, so the
+ * common small-write case never touches the shared allocator lock.  An
+ * empty magazine is refilled from the backing allocator in one batch, a
+ * full one hands its older half back in one release.  Whenever the
+ * backing allocator can't satisfy a request all magazines are drained
+ * into it and the request is retried, so cached units never cause
+ * ENOSPC.  Anything that needs an exact view of free space (foreach,
+ * dump, fragmentation, init_rm_free) drains the magazines first.
+ */
+class MagazineAllocator : public HybridAllocator {
+  struct alignas(64) shard_t {
+    ceph::mutex lock = ceph::make_mutex("MagazineAllocator::shard_t::lock");
+    std::vector<uint64_t> mag;  ///< offsets of cached units, LIFO
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+  };
+
+  const uint64_t mag_size;
+  std::unique_ptr<shard_t[]> shards;
+  const size_t num_shards;
+  std::atomic<uint64_t> cached = {0};  ///< bytes held in magazines
+
+  shard_t& _get_shard();
+  void _refill(shard_t& s);
+  void _flush_all();
+
+public:
+  MagazineAllocator(CephContext* cct, int64_t device_size, int64_t _block_size,
+                    uint64_t max_mem,
+                    size_t _num_shards,
+                    uint64_t _mag_size,
+                    std::string_view name);
+  const char* get_type() const override
+  {
+    return "magazine";
+  }
+  int64_t allocate(
+    uint64_t want,
+    uint64_t unit,
+    uint64_t max_alloc_size,
+    int64_t  hint,
+    PExtentVector *extents) override;
+  void release(const interval_set<uint64_t>& release_set) override;
+  using Allocator::release;
+  uint64_t get_free() override;
+  double get_fragmentation() override;
+
+  void dump() override;
+  void foreach(
+    std::function<void(uint64_t offset, uint64_t length)> notify) override;
+  void init_rm_free(uint64_t offset, uint64_t length) override;
+  void shutdown() override;
+
+  // intended primarily for UT
+  uint64_t get_cached() const {
+    return cached;
+  }
+};
@@ -68,19 +68,21 @@ void bluefs_layout_t::dump(Formatter *f) const
 
 void bluefs_super_t::encode(bufferlist& bl) const
 {
-  ENCODE_START(2, 1, bl);
+  // older releases refuse to decode us once we have incompat features
+  ENCODE_START(3, incompat_features ? 3 : 1, bl);
   encode(uuid, bl);
   encode(osd_uuid, bl);
   encode(version, bl);
   encode(block_size, bl);
   encode(log_fnode, bl);
   encode(memorized_layout, bl);
+  encode(incompat_features, bl);
   ENCODE_FINISH(bl);
 }
 
 void bluefs_super_t::decode(bufferlist::const_iterator& p)
 {
-  DECODE_START(2, p);
+  DECODE_START(3, p);
   decode(uuid, p);
   decode(osd_uuid, p);
   decode(version, p);
@@ -89,6 +91,11 @@ void bluefs_super_t::decode(bufferlist::const_iterator& p)
   if (struct_v >= 2) {
     decode(memorized_layout, p);
   }
+  if (struct_v >= 3) {
+    decode(incompat_features, p);
+  } else {
+    incompat_features = 0;
+  }
   DECODE_FINISH(p);
 }
 
@@ -99,6 +106,7 @@ void bluefs_super_t::dump(Formatter *f) const
   f->dump_unsigned("version", version);
   f->dump_unsigned("block_size", block_size);
   f->dump_object("log_fnode", log_fnode);
+  f->dump_unsigned("incompat_features", incompat_features);
 }
 
 void bluefs_super_t::generate_test_instances(list<bluefs_super_t*>& ls)
@@ -107,6 +115,8 @@ void bluefs_super_t::generate_test_instances(list<bluefs_super_t*>& ls)
   ls.push_back(new bluefs_super_t);
   ls.back()->version = 1;
   ls.back()->block_size = 4096;
+  ls.push_back(new bluefs_super_t);
+  ls.back()->incompat_features = bluefs_super_t::FEATURE_WAL_RING;
 }
 
 ostream& operator<<(ostream& out, const bluefs_super_t& s)
@@ -116,6 +126,7 @@ ostream& operator<<(ostream& out, const bluefs_super_t& s)
 	     << " v " << s.version
 	     << " block_size 0x" << std::hex << s.block_size
 	     << " log_fnode 0x" << s.log_fnode
+	     << " incompat 0x" << s.incompat_features
 	     << std::dec << ")";
 }
 
@@ -177,6 +188,7 @@ void bluefs_fnode_t::dump(Formatter *f) const
   f->dump_unsigned("ino", ino);
   f->dump_unsigned("size", size);
   f->dump_stream("mtime") << mtime;
+  f->dump_unsigned("flags", flags);
   f->open_array_section("extents");
   for (auto& p : extents)
     f->dump_object("extent", p);
@@ -192,6 +204,12 @@ void bluefs_fnode_t::generate_test_instances(list<bluefs_fnode_t*>& ls)
   ls.back()->mtime = utime_t(123,45);
   ls.back()->extents.push_back(bluefs_extent_t(0, 1048576, 4096));
   ls.back()->__unused__ = 1;
+  ls.push_back(new bluefs_fnode_t);
+  ls.back()->ino = 124;
+  ls.back()->size = 65536;
+  ls.back()->mtime = utime_t(123,46);
+  ls.back()->extents.push_back(bluefs_extent_t(0, 2097152, 1048576));
+  ls.back()->flags = bluefs_fnode_t::FLAG_WAL_RING;
 }
 
 ostream& operator<<(ostream& out, const bluefs_fnode_t& file)
@@ -199,12 +217,49 @@ ostream& operator<<(ostream& out, const bluefs_fnode_t& file)
   return out << "file(ino " << file.ino
 	     << " size 0x" << std::hex << file.size << std::dec
 	     << " mtime " << file.mtime
+	     << (file.is_wal_ring() ? " wal_ring" : "")
 	     << " allocated " << std::hex << file.allocated << std::dec
 	     << " alloc_commit " << std::hex << file.allocated_commited << std::dec
 	     << " extents " << file.extents
 	     << ")";
 }
 
+// bluefs_wal_ring_header_t
+
+void bluefs_wal_ring_header_t::dump(Formatter *f) const
+{
+  f->dump_unsigned("ino", ino);
+  f->dump_stream("mtime") << mtime;
+  f->dump_unsigned("seq", seq);
+  f->dump_unsigned("size", size);
+  f->dump_unsigned("tail_offset", tail_offset);
+  f->dump_unsigned("tail_crc", tail_crc);
+}
+
+void bluefs_wal_ring_header_t::generate_test_instances(
+  list<bluefs_wal_ring_header_t*>& ls)
+{
+  ls.push_back(new bluefs_wal_ring_header_t);
+  ls.push_back(new bluefs_wal_ring_header_t);
+  ls.back()->ino = 123;
+  ls.back()->mtime = utime_t(123,45);
+  ls.back()->seq = 7;
+  ls.back()->size = 0x12345;
+  ls.back()->tail_offset = 0x10000;
+  ls.back()->tail_crc = 0xdeadbeef;
+}
+
+ostream& operator<<(ostream& out, const bluefs_wal_ring_header_t& h)
+{
+  return out << "wal_ring_header(ino " << h.ino
+	     << " mtime " << h.mtime
+	     << " seq " << h.seq
+	     << " size 0x" << std::hex << h.size
+	     << " tail 0x" << h.tail_offset
+	     << " crc 0x" << h.tail_crc << std::dec
+	     << ")";
+}
+
 // bluefs_fnode_delta_t
 
 std::ostream& operator<<(std::ostream& out, const bluefs_fnode_delta_t& delta)
@@ -72,13 +72,22 @@ struct bluefs_fnode_t {
   uint64_t allocated;
   uint64_t allocated_commited;
 
+  enum {
+    FLAG_WAL_RING = 1,  ///< data follows two bluefs_wal_ring_header_t slots
+  };
+  uint8_t flags = 0;
+
+  static constexpr uint64_t WAL_RING_HEADER_SLOT = 4096;
+  static constexpr uint64_t WAL_RING_HEADER_SIZE = 2 * WAL_RING_HEADER_SLOT;
+
   bluefs_fnode_t() : ino(0), size(0), allocated(0), allocated_commited(0) {}
   bluefs_fnode_t(uint64_t _ino, uint64_t _size, utime_t _mtime) :
     ino(_ino), size(_size), mtime(_mtime), allocated(0), allocated_commited(0) {}
   bluefs_fnode_t(const bluefs_fnode_t& other) :
     ino(other.ino), size(other.size), mtime(other.mtime),
     allocated(other.allocated),
-    allocated_commited(other.allocated_commited) {
+    allocated_commited(other.allocated_commited),
+    flags(other.flags) {
     clone_extents(other);
   }
 
@@ -86,6 +95,14 @@ struct bluefs_fnode_t {
     return allocated;
   }
 
+  bool is_wal_ring() const {
+    return flags & FLAG_WAL_RING;
+  }
+  /// where file data starts within the extents
+  uint64_t get_data_offset() const {
+    return is_wal_ring() ? WAL_RING_HEADER_SIZE : 0;
+  }
+
   void recalc_allocated() {
     allocated = 0;
     extents_index.reserve(extents.size());
@@ -111,12 +128,17 @@ struct bluefs_fnode_t {
   template<typename T, typename P>
   friend std::enable_if_t<std::is_same_v<bluefs_fnode_t, std::remove_const_t<T>>>
   _denc_friend(T& v, P& p) {
-    DENC_START(1, 1, p);
+    // releases that predate FLAG_WAL_RING can't read such files, but
+    // denc does not check struct_compat: see bluefs_super_t::FEATURE_WAL_RING
+    DENC_START(2, v.is_wal_ring() ? 2 : 1, p);
     denc_varint(v.ino, p);
     denc_varint(v.size, p);
     denc(v.mtime, p);
     denc(v.__unused__, p);
     denc(v.extents, p);
+    if (struct_v >= 2) {
+      denc(v.flags, p);
+    }
     DENC_FINISH(p);
   }
   void reset_delta() {
@@ -160,6 +182,7 @@ struct bluefs_fnode_t {
     std::swap(ino, other.ino);
     std::swap(size, other.size);
     std::swap(mtime, other.mtime);
+    std::swap(flags, other.flags);
     swap_extents(other);
   }
   void swap_extents(bluefs_fnode_t& other) {
@@ -187,6 +210,36 @@ WRITE_CLASS_DENC(bluefs_fnode_t)
 
 std::ostream& operator<<(std::ostream& out, const bluefs_fnode_t& file);
 
+/// One of the two slots at the start of a FLAG_WAL_RING file.  fsync
+/// stores the new file size here, alternating between the slots, instead
+/// of logging it; mount takes the newest valid slot of the current writer
+/// generation (the fnode mtime) whose tail checksum matches the data.
+struct bluefs_wal_ring_header_t {
+  uint64_t ino = 0;
+  utime_t mtime;             ///< fnode mtime when the writer was opened
+  uint64_t seq = 0;          ///< slot is seq % 2
+  uint64_t size = 0;         ///< file size made durable by this fsync
+  uint64_t tail_offset = 0;  ///< where data written since the last slot starts
+  uint32_t tail_crc = 0;     ///< crc32c(-1) of [tail_offset, size)
+
+  DENC(bluefs_wal_ring_header_t, v, p) {
+    DENC_START(1, 1, p);
+    denc(v.ino, p);
+    denc(v.mtime, p);
+    denc(v.seq, p);
+    denc(v.size, p);
+    denc(v.tail_offset, p);
+    denc(v.tail_crc, p);
+    DENC_FINISH(p);
+  }
+  void dump(ceph::Formatter *f) const;
+  static void generate_test_instances(std::list<bluefs_wal_ring_header_t*>& ls);
+};
+WRITE_CLASS_DENC(bluefs_wal_ring_header_t)
+
+std::ostream& operator<<(std::ostream& out,
+                         const bluefs_wal_ring_header_t& h);
+
 struct bluefs_layout_t {
   unsigned shared_bdev = 0;         ///< which bluefs bdev we are sharing
   bool dedicated_db = false;        ///< whether block.db is present
@@ -209,6 +262,11 @@ struct bluefs_layout_t {
 WRITE_CLASS_ENCODER(bluefs_layout_t)
 
 struct bluefs_super_t {
+  enum {
+    FEATURE_WAL_RING = 1,  ///< files may be FLAG_WAL_RING
+  };
+  static constexpr uint64_t FEATURES_SUPPORTED = FEATURE_WAL_RING;
+
   uuid_d uuid;      ///< unique to this bluefs instance
   uuid_d osd_uuid;  ///< matches the osd that owns us
   uint64_t version;
@@ -218,6 +276,9 @@ struct bluefs_super_t {
 
   std::optional<bluefs_layout_t> memorized_layout;
 
+  /// what one must understand to mount us
+  uint64_t incompat_features = 0;
+
   bluefs_super_t()
     : version(0),
       block_size(4096) { }
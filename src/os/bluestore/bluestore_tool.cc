@@ -9,6 +9,7 @@
 #include <filesystem>
 #include <iostream>
 #include <fstream>
+#include <iomanip>
 #include <time.h>
 #include <fcntl.h>
 #include <unistd.h>
@@ -336,7 +337,8 @@ int main(int argc, char **argv)
         "free-fragmentation, "
         "bluefs-stats, "
         "reshard, "
-        "show-sharding")
+        "show-sharding, "
+        "mount-time")
     ;
   po::options_description po_all("All options");
   po_all.add(po_options).add(po_positional);
@@ -429,7 +431,8 @@ int main(int argc, char **argv)
     }
   }
 
-  if (action == "fsck" || action == "repair" || action == "quick-fix" || action == "allocmap" || action == "qfsck" || action == "restore_cfb") {
+  if (action == "fsck" || action == "repair" || action == "quick-fix" || action == "allocmap" || action == "qfsck" || action == "restore_cfb" ||
+      action == "mount-time") {
     if (path.empty()) {
       cerr << "must specify bluestore path" << std::endl;
       exit(EXIT_FAILURE);
@@ -1151,6 +1154,20 @@ int main(int argc, char **argv)
       exit(EXIT_FAILURE);
     }
     cout << sharding << std::endl;
+  } else if (action == "mount-time") {
+    validate_path(cct.get(), path, false);
+    BlueStore bluestore(cct.get(), path);
+    auto start = ceph::mono_clock::now();
+    int r = bluestore.cold_open();
+    if (r < 0) {
+      cerr << "error from cold_open: " << cpp_strerror(r) << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    auto duration = ceph::mono_clock::now() - start;
+    bluestore.cold_close();
+    cout << action << " " << std::fixed << std::setprecision(3)
+	 << std::chrono::duration<double>(duration).count()
+	 << " seconds" << std::endl;
   } else {
     cerr << "unrecognized action " << action << std::endl;
     return 1;
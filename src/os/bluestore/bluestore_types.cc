@@ -716,6 +716,11 @@ string bluestore_blob_t::get_flags_string(unsigned flags)
       s += '+';
     s += "shared";
   }
+  if (flags & FLAG_COMPRESSED_CHUNKS) {
+    if (s.length())
+      s += '+';
+    s += "compressed_chunks";
+  }
 
   return s;
 }
@@ -757,6 +762,14 @@ void bluestore_blob_t::dump(Formatter *f) const
   f->close_section();
   f->dump_unsigned("logical_length", logical_length);
   f->dump_unsigned("compressed_length", compressed_length);
+  if (has_compressed_chunks()) {
+    f->dump_unsigned("compressed_chunk_order", compressed_chunk_order);
+    f->open_array_section("compressed_chunk_ends");
+    for (auto e : compressed_chunk_ends) {
+      f->dump_unsigned("end", e);
+    }
+    f->close_section();
+  }
   f->dump_unsigned("flags", flags);
   f->dump_unsigned("csum_type", csum_type);
   f->dump_unsigned("csum_chunk_order", csum_chunk_order);
@@ -783,6 +796,10 @@ void bluestore_blob_t::generate_test_instances(list<bluestore_blob_t*>& ls)
   ls.back()->allocated_test(
     bluestore_pextent_t(bluestore_pextent_t::INVALID_OFFSET, 0x1000));
   ls.back()->allocated_test(bluestore_pextent_t(0x40120000, 0x10000));
+  ls.push_back(new bluestore_blob_t);
+  ls.back()->allocated_test(bluestore_pextent_t(0x40200000, 0x4000));
+  ls.back()->set_compressed(0x10000, 0x3100);
+  ls.back()->set_compressed_chunks(14, {0x900, 0x1500, 0x2300, 0x3100});
 }
 
 ostream& operator<<(ostream& out, const bluestore_blob_t& o)
@@ -794,6 +811,9 @@ ostream& operator<<(ostream& out, const bluestore_blob_t& o)
 	<< " -> 0x"
 	<< o.get_compressed_payload_length()
 	<< std::dec;
+    if (o.has_compressed_chunks()) {
+      out << " in " << o.compressed_chunk_ends.size() << " chunks";
+    }
   } else {
     out << " llen=0x" << std::hex << o.get_logical_length() << std::dec;
   }
@@ -1139,6 +1159,8 @@ void bluestore_blob_t::dup(const bluestore_blob_t& from)
   logical_length = from.logical_length;
   compressed_length = from.compressed_length;
   flags = from.flags;
+  compressed_chunk_order = from.compressed_chunk_order;
+  compressed_chunk_ends = from.compressed_chunk_ends;
   unused = from.unused;
   csum_type = from.csum_type;
   csum_chunk_order = from.csum_chunk_order;
@@ -474,6 +474,7 @@ public:
     FLAG_CSUM = 4,            ///< blob has checksums
     FLAG_HAS_UNUSED = 8,      ///< blob has unused std::map
     FLAG_SHARED = 16,         ///< blob is shared; see external SharedBlob
+    FLAG_COMPRESSED_CHUNKS = 32, ///< compressed in independent chunks
   };
   static std::string get_flags_string(unsigned flags);
 
@@ -487,6 +488,12 @@ public:
 
   ceph::buffer::ptr csum_data;                ///< opaque std::vector of csum data
 
+  /// with FLAG_COMPRESSED_CHUNKS each 1<<compressed_chunk_order bytes of
+  /// logical data are compressed on their own (header included), and
+  /// compressed_chunk_ends holds the end of each in the compressed payload
+  uint8_t compressed_chunk_order = 0;
+  mempool::bluestore_cache_other::vector<uint32_t> compressed_chunk_ends;
+
   bluestore_blob_t(uint32_t f = 0) : flags(f) {}
 
   void dup(const bluestore_blob_t& from);
@@ -508,6 +515,13 @@ public:
     denc_varint(flags, p);
     denc_varint_lowz(logical_length, p);
     denc_varint_lowz(compressed_length, p);
+    if (has_compressed_chunks()) {
+      denc(compressed_chunk_order, p);
+      denc_varint(compressed_chunk_ends.size(), p);
+      for (auto e : compressed_chunk_ends) {
+        denc_varint_lowz(e, p);
+      }
+    }
     denc(csum_type, p);
     denc(csum_chunk_order, p);
     denc_varint(csum_data.length(), p);
@@ -522,6 +536,16 @@ public:
     if (is_compressed()) {
       denc_varint_lowz(logical_length, p);
       denc_varint_lowz(compressed_length, p);
+      if (has_compressed_chunks()) {
+        // chunk ends go as deltas, they are much smaller
+        denc(compressed_chunk_order, p);
+        denc_varint(compressed_chunk_ends.size(), p);
+        uint32_t prev = 0;
+        for (auto e : compressed_chunk_ends) {
+          denc_varint_lowz(e - prev, p);
+          prev = e;
+        }
+      }
     }
     if (has_csum()) {
       denc(csum_type, p);
@@ -542,6 +566,18 @@ public:
     if (is_compressed()) {
       denc_varint_lowz(logical_length, p);
       denc_varint_lowz(compressed_length, p);
+      if (has_compressed_chunks()) {
+        denc(compressed_chunk_order, p);
+        size_t n;
+        denc_varint(n, p);
+        compressed_chunk_ends.resize(n);
+        uint32_t prev = 0;
+        for (auto& e : compressed_chunk_ends) {
+          denc_varint_lowz(e, p);
+          e += prev;
+          prev = e;
+        }
+      }
     } else {
       logical_length = get_ondisk_length();
     }
@@ -604,6 +640,37 @@ public:
   bool is_shared() const {
     return has_flag(FLAG_SHARED);
   }
+  bool has_compressed_chunks() const {
+    return has_flag(FLAG_COMPRESSED_CHUNKS);
+  }
+  void set_compressed_chunks(
+    uint8_t order,
+    mempool::bluestore_cache_other::vector<uint32_t>&& ends) {
+    ceph_assert(is_compressed());
+    ceph_assert(!ends.empty() && ends.back() == compressed_length);
+    set_flag(FLAG_COMPRESSED_CHUNKS);
+    compressed_chunk_order = order;
+    compressed_chunk_ends = std::move(ends);
+  }
+  uint32_t get_compressed_chunk_size() const {
+    return 1u << compressed_chunk_order;
+  }
+  /// where compressed chunk i starts in the compressed payload
+  uint32_t get_compressed_chunk_start(unsigned i) const {
+    return i ? compressed_chunk_ends[i - 1] : 0;
+  }
+  uint32_t get_compressed_chunk_end(unsigned i) const {
+    return compressed_chunk_ends[i];
+  }
+  /// compressed chunks [*first, *last] holding logical range b_off~b_len
+  void get_compressed_chunk_range(uint32_t b_off, uint32_t b_len,
+                                  unsigned* first, unsigned* last) const {
+    ceph_assert(b_len > 0);
+    ceph_assert(b_off + b_len <= logical_length);
+    *first = b_off >> compressed_chunk_order;
+    *last = (b_off + b_len - 1) >> compressed_chunk_order;
+    ceph_assert(*last < compressed_chunk_ends.size());
+  }
 
   /// return chunk (i.e. min readable block) size for the blob
   uint64_t get_chunk_size(uint64_t dev_block_size) const {
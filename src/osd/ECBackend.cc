@@ -179,6 +179,7 @@ ostream &operator<<(ostream &lhs, const ECBackend::RMWPipeline::Op &rhs)
       << " pending_commit=" << rhs.pending_commit
       << " plan.to_read=" << rhs.plan.to_read
       << " plan.will_write=" << rhs.plan.will_write
+      << " plan.delta_write=" << rhs.plan.delta_write
       << ")";
   return lhs;
 }
@@ -1264,11 +1265,18 @@ void ECBackend::handle_sub_read_reply(
 
   ceph_assert(rop.in_progress.count(from));
   rop.in_progress.erase(from);
+  auto &latency = get_parent()->get_ec_peer_latency();
+  auto now = ceph::mono_clock::now();
+  if (auto sent = rop.sent.find(from); sent != rop.sent.end()) {
+    latency.add_sample(from.osd, now - sent->second);
+    rop.sent.erase(sent);
+  }
   unsigned is_complete = 0;
   bool need_resend = false;
-  // For redundant reads check for completion as each shard comes in,
-  // or in a non-recovery read check for completion once all the shards read.
-  if (rop.do_redundant_reads || rop.in_progress.empty()) {
+  // For redundant and hedged reads check for completion as each shard comes
+  // in, otherwise check for completion once all the shards read.
+  if (rop.do_redundant_reads || !rop.hedged_to.empty() ||
+      rop.in_progress.empty()) {
     for (map<hobject_t, read_result_t>::const_iterator iter =
         rop.complete.begin();
       iter != rop.complete.end();
@@ -1333,6 +1341,25 @@ void ECBackend::handle_sub_read_reply(
   } else if (rop.in_progress.empty() || 
              is_complete == rop.complete.size()) {
     dout(20) << __func__ << " Complete: " << rop << dendl;
+    if (!rop.hedged_to.empty() && !rop.in_progress.empty()) {
+      // the shards we didn't wait for took at least this long; without
+      // it a peer that got slow would never look slow again
+      for (auto &&shard : rop.in_progress) {
+	if (auto sent = rop.sent.find(shard); sent != rop.sent.end()) {
+	  latency.add_sample(shard.osd, now - sent->second);
+	}
+      }
+      bool won = false;
+      for (auto &&shard : rop.hedged_to) {
+	if (!rop.in_progress.count(shard)) {
+	  latency.hedge_won(shard.osd);
+	  won = true;
+	}
+      }
+      if (won) {
+	get_parent()->get_logger()->inc(l_osd_ec_read_hedge_win);
+      }
+    }
     rop.trace.event("ec read complete");
     complete_read_op(rop, m);
   } else {
@@ -1565,6 +1592,7 @@ struct ECClassicalOp : ECBackend::RMWPipeline::Op {
         pgid,
         sinfo,
         remote_read_result,
+        delta_read_result,
         log_entries,
         written,
         transactions,
@@ -1580,13 +1608,15 @@ struct ECClassicalOp : ECBackend::RMWPipeline::Op {
     const ECUtil::stripe_info_t &sinfo,
     PGTransaction& t,
     F &&get_hinfo,
-    DoutPrefixProvider *dpp)
+    DoutPrefixProvider *dpp,
+    unsigned delta_coding_chunks)
   {
     return ECTransaction::get_write_plan(
       sinfo,
       t,
       std::forward<F>(get_hinfo),
-      dpp);
+      dpp,
+      delta_coding_chunks);
   }
 };
 
@@ -1621,6 +1651,13 @@ void ECBackend::submit_transaction(
   if (client_op) {
     op->trace = client_op->pg_trace;
   }
+  unsigned delta_coding_chunks = 0;
+  if (get_parent()->get_pool().allows_ecoverwrites() &&
+      cct->_conf->osd_ec_parity_delta_write &&
+      (ec_impl->get_supported_optimizations() &
+       ErasureCodeInterface::FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION)) {
+    delta_coding_chunks = ec_impl->get_coding_chunk_count();
+  }
   op->plan = op->get_write_plan(
     sinfo,
     *(op->t),
@@ -1635,7 +1672,8 @@ void ECBackend::submit_transaction(
       }
       return ref;
     },
-    get_parent()->get_dpp());
+    get_parent()->get_dpp(),
+    delta_coding_chunks);
   dout(10) << __func__ << ": op " << *op << " starting" << dendl;
   rmw_pipeline.start_rmw(std::move(op));
 }
@@ -1733,7 +1771,33 @@ int ECBackend::get_min_avail_to_read_shards(
   get_all_avail_shards(hoid, error_shards, have, shards, for_recovery);
 
   map<int, vector<pair<int, int>>> need;
-  int r = ec_impl->minimum_to_decode(want, have, &need);
+  int r = -EIO;
+  if (!for_recovery && !do_redundant_reads &&
+      cct->_conf->osd_ec_read_fastest_shards) {
+    // add shards in the order they are expected to answer until enough of
+    // them decode
+    map<int, int> osds;
+    for (auto &&[id, shard] : shards) {
+      osds[id.id] = shard.osd;
+    }
+    auto by_latency = get_parent()->get_ec_peer_latency().sort_shards(
+      osds, want);
+    set<int> fastest;
+    for (auto id : by_latency) {
+      fastest.insert(id);
+      need.clear();
+      r = ec_impl->minimum_to_decode(want, fastest, &need);
+      if (r == 0) {
+	break;
+      }
+    }
+    dout(20) << __func__ << ": " << hoid << " fastest " << by_latency
+	     << " r " << r << dendl;
+  }
+  if (r < 0) {
+    need.clear();
+    r = ec_impl->minimum_to_decode(want, have, &need);
+  }
   if (r < 0)
     return r;
 
@@ -1831,9 +1895,6 @@ void ECBackend::start_read_op(
 
 void ECBackend::do_read_op(ReadOp &op)
 {
-  int priority = op.priority;
-  ceph_tid_t tid = op.tid;
-
   dout(10) << __func__ << ": starting read " << op << dendl;
 
   map<pg_shard_t, ECSubRead> messages;
@@ -1872,6 +1933,20 @@ void ECBackend::do_read_op(ReadOp &op)
     }
   }
 
+  send_sub_reads(op, messages);
+  schedule_hedge_reads(op);
+
+  dout(10) << __func__ << ": started " << op << dendl;
+}
+
+void ECBackend::send_sub_reads(
+  ReadOp &op,
+  map<pg_shard_t, ECSubRead> &messages)
+{
+  int priority = op.priority;
+  ceph_tid_t tid = op.tid;
+  auto now = ceph::mono_clock::now();
+
   std::vector<std::pair<int, Message*>> m;
   m.reserve(messages.size());
   for (map<pg_shard_t, ECSubRead>::iterator i = messages.begin();
@@ -1879,6 +1954,9 @@ void ECBackend::do_read_op(ReadOp &op)
        ++i) {
     op.in_progress.insert(i->first);
     shard_to_read_map[i->first].insert(op.tid);
+    if (!op.for_recovery) {
+      op.sent[i->first] = now;
+    }
     i->second.tid = tid;
     MOSDECSubOpRead *msg = new MOSDECSubOpRead;
     msg->set_priority(priority);
@@ -1900,8 +1978,107 @@ void ECBackend::do_read_op(ReadOp &op)
   if (!m.empty()) {
     get_parent()->send_message_osd_cluster(m, get_osdmap_epoch());
   }
+}
 
-  dout(10) << __func__ << ": started " << op << dendl;
+void ECBackend::schedule_hedge_reads(ReadOp &op)
+{
+  double deviations = cct->_conf->osd_ec_read_hedge_deviations;
+  if (deviations <= 0 || op.for_recovery || op.do_redundant_reads ||
+      op.hedge_scheduled || op.in_progress.empty()) {
+    return;
+  }
+  for (auto &&[hoid, req] : op.to_read) {
+    if (req.want_attrs) {
+      // attrs come from a single shard, which a hedge could not replace
+      return;
+    }
+  }
+
+  // give up on the slowest shard once it is later than it usually is
+  set<int> osds;
+  for (auto &&shard : op.in_progress) {
+    osds.insert(shard.osd);
+  }
+  auto delay = get_parent()->get_ec_peer_latency().hedge_delay(
+    osds, deviations,
+    cct->_conf.get_val<std::chrono::milliseconds>(
+      "osd_ec_read_hedge_min_delay"));
+  if (!delay) {
+    return;
+  }
+
+  op.hedge_scheduled = true;
+  ceph_tid_t tid = op.tid;
+  get_parent()->schedule_delayed_work(
+    make_gen_lambda_context<PGBackend*>(
+      [tid](PGBackend *backend) {
+	static_cast<ECBackend*>(backend)->send_hedge_reads(tid);
+      }),
+    *delay);
+}
+
+void ECBackend::send_hedge_reads(ceph_tid_t tid)
+{
+  auto iter = tid_to_read_map.find(tid);
+  if (iter == tid_to_read_map.end()) {
+    return;
+  }
+  ReadOp &op = iter->second;
+  if (op.in_progress.empty()) {
+    return;
+  }
+
+  // read one more shard of each object still waiting, from a peer this
+  // op does not talk to yet, picking the one expected to answer first
+  auto &latency = get_parent()->get_ec_peer_latency();
+  set<pg_shard_t> busy;
+  for (auto &&[shard, objs] : op.source_to_obj) {
+    busy.insert(shard);
+  }
+  vector<pair<int, int>> subchunks;
+  subchunks.push_back(make_pair(0, ec_impl->get_sub_chunk_count()));
+  map<pg_shard_t, ECSubRead> messages;
+  for (auto &&[hoid, req] : op.to_read) {
+    if (req.need.empty()) {
+      continue;
+    }
+    set<int> have;
+    map<shard_id_t, pg_shard_t> shards;
+    get_all_avail_shards(hoid, {}, have, shards, false);
+    map<int, int> idle;
+    for (auto &&[id, shard] : shards) {
+      if (!busy.count(shard)) {
+	idle[id.id] = shard.osd;
+      }
+    }
+    auto best_id = latency.fastest_shard(idle);
+    if (!best_id) {
+      continue;
+    }
+    std::optional<pg_shard_t> best = shards[shard_id_t(*best_id)];
+    dout(10) << __func__ << ": tid " << tid << " " << hoid
+	     << " hedging to " << *best << dendl;
+    req.need[*best] = subchunks;
+    op.obj_to_source[hoid].insert(*best);
+    op.source_to_obj[*best].insert(hoid);
+    messages[*best].subchunks[hoid] = subchunks;
+    for (auto &&extent : req.to_read) {
+      pair<uint64_t, uint64_t> chunk_off_len =
+	sinfo.aligned_offset_len_to_chunk(
+	  make_pair(extent.get<0>(), extent.get<1>()));
+      messages[*best].to_read[hoid].push_back(
+	boost::make_tuple(
+	  chunk_off_len.first,
+	  chunk_off_len.second,
+	  extent.get<2>()));
+    }
+  }
+  for (auto &&[shard, msg] : messages) {
+    op.hedged_to.insert(shard);
+    latency.hedge_sent(shard.osd);
+    get_parent()->get_logger()->inc(l_osd_ec_read_hedge);
+  }
+  send_sub_reads(op, messages);
 }
 
 ECUtil::HashInfoRef ECBackend::get_hash_info(
@@ -1998,6 +2175,21 @@ bool ECBackend::RMWPipeline::try_state_to_reads()
     pipeline_state.invalidate();
   }
 
+  if (!op->plan.delta_write.empty()) {
+    if (op->using_cache && can_delta_write(*op)) {
+      dout(20) << __func__ << ": updating parity in place for "
+	       << op->plan.delta_write << dendl;
+      for (auto &&[hoid, extents] : op->plan.delta_write) {
+	op->rmw_to_read[hoid] = op->plan.to_read[hoid];
+	op->rmw_will_write[hoid] = op->plan.will_write[hoid];
+      }
+      op->plan.to_read.clear();
+      op->plan.will_write = op->plan.delta_write;
+    } else {
+      op->plan.delta_write.clear();
+    }
+  }
+
   waiting_state.pop_front();
   waiting_reads.push_back(*op);
 
@@ -2045,10 +2237,239 @@ bool ECBackend::RMWPipeline::try_state_to_reads()
 	check_ops();
       });
   }
+  if (!op->plan.delta_write.empty()) {
+    start_delta_reads(op);
+  }
 
   return true;
 }
 
+bool ECBackend::RMWPipeline::can_delta_write(const Op &op)
+{
+  const unsigned chunk_count = ec_impl->get_chunk_count();
+  for (auto &&[hoid, extents] : op.plan.delta_write) {
+    // the coding chunks can't be recomputed from a partial read, so every
+    // shard we'd read or write must be there
+    set<int> have;
+    map<shard_id_t, pg_shard_t> shards;
+    ec_backend.get_all_avail_shards(hoid, {}, have, shards, false);
+    if (have.size() != chunk_count) {
+      dout(20) << __func__ << ": " << hoid << " degraded" << dendl;
+      return false;
+    }
+    // nor can the coding chunks of stripes with writes in flight be read
+    // back from the shards; the cache only holds data
+    extent_set stripes;
+    for (auto &&e : extents) {
+      auto bounds = sinfo.offset_len_to_stripe_bounds(
+	make_pair(e.first, e.second));
+      stripes.union_insert(bounds.first, bounds.second);
+    }
+    for (auto *l : {&waiting_reads, &waiting_commit}) {
+      for (auto &&other : *l) {
+	auto i = other.plan.will_write.find(hoid);
+	if (i == other.plan.will_write.end()) {
+	  continue;
+	}
+	extent_set overlap;
+	overlap.intersection_of(i->second, stripes);
+	if (!overlap.empty()) {
+	  dout(20) << __func__ << ": " << hoid << " overlaps tid "
+		   << other.tid << dendl;
+	  return false;
+	}
+      }
+    }
+  }
+  return true;
+}
+
+struct OnDeltaReadComplete :
+  public GenContext<pair<RecoveryMessages*, ECBackend::read_result_t& > &> {
+  ECBackend::RMWPipeline *pipeline;
+  ECBackend::RMWPipeline::Op *op;
+  hobject_t hoid;
+  set<int> want;
+  OnDeltaReadComplete(
+    ECBackend::RMWPipeline *pipeline,
+    ECBackend::RMWPipeline::Op *op,
+    const hobject_t &hoid,
+    const set<int> &want)
+    : pipeline(pipeline), op(op), hoid(hoid), want(want) {}
+  void finish(pair<RecoveryMessages *, ECBackend::read_result_t &> &in) override {
+    ECBackend::read_result_t &res = in.second;
+    if (res.r != 0) {
+      pipeline->retry_delta_read(op, hoid, want);
+      return;
+    }
+    auto &result = op->delta_read_result[hoid];
+    for (auto &&extent : res.returned) {
+      uint64_t chunk_off =
+	pipeline->sinfo.aligned_logical_offset_to_chunk_offset(extent.get<0>());
+      map<int, bufferlist> have;
+      for (auto &&j : extent.get<2>()) {
+	have[j.first.shard] = std::move(j.second);
+      }
+      // a shard that failed was replaced by others, decode what is missing
+      map<int, bufferlist> decoded;
+      map<int, bufferlist*> out;
+      for (int s : want) {
+	if (!have.count(s)) {
+	  out[s] = &decoded[s];
+	}
+      }
+      if (!out.empty()) {
+	int r = ECUtil::decode(pipeline->sinfo, pipeline->ec_impl, have, out);
+	ceph_assert(r == 0);
+      }
+      for (int s : want) {
+	bufferlist &bl = have.count(s) ? have[s] : decoded[s];
+	ceph_assert(bl.length() ==
+		    pipeline->sinfo.aligned_logical_offset_to_chunk_offset(
+		      extent.get<1>()));
+	result[s].insert(chunk_off, bl.length(), bl);
+      }
+    }
+    ceph_assert(op->delta_reads_in_progress);
+    --op->delta_reads_in_progress;
+    pipeline->check_ops();
+  }
+};
+
+void ECBackend::RMWPipeline::start_delta_reads(Op *op)
+{
+  const int k = ec_impl->get_data_chunk_count();
+  const int n = ec_impl->get_chunk_count();
+  const uint64_t cs = sinfo.get_chunk_size();
+  const uint64_t sw = sinfo.get_stripe_width();
+  vector<pair<int, int>> subchunks;
+  subchunks.push_back(make_pair(0, ec_impl->get_sub_chunk_count()));
+
+  map<hobject_t, set<int>> obj_want_to_read;
+  map<hobject_t, read_request_t> for_read_op;
+  for (auto &&[hoid, extents] : op->plan.delta_write) {
+    set<int> want;
+    extent_set stripes;
+    for (auto &&e : extents) {
+      for (uint64_t off = e.first; off < e.first + e.second; off += cs) {
+	want.insert((off % sw) / cs);
+      }
+      auto bounds = sinfo.offset_len_to_stripe_bounds(
+	make_pair(e.first, e.second));
+      stripes.union_insert(bounds.first, bounds.second);
+    }
+    for (int p = k; p < n; ++p) {
+      want.insert(p);
+    }
+
+    set<int> have;
+    map<shard_id_t, pg_shard_t> shards;
+    ec_backend.get_all_avail_shards(hoid, {}, have, shards, false);
+    map<pg_shard_t, vector<pair<int, int>>> need;
+    for (int s : want) {
+      ceph_assert(shards.count(shard_id_t(s)));
+      need[shards[shard_id_t(s)]] = subchunks;
+    }
+    list<boost::tuple<uint64_t, uint64_t, uint32_t> > to_read;
+    for (auto &&e : stripes) {
+      to_read.push_back(boost::make_tuple(e.first, e.second, 0));
+    }
+    dout(20) << __func__ << ": " << hoid << " shards " << want
+	     << " stripes " << stripes << dendl;
+    for_read_op.insert(
+      make_pair(
+	hoid,
+	read_request_t(
+	  to_read,
+	  need,
+	  false,
+	  new OnDeltaReadComplete(this, op, hoid, want))));
+    obj_want_to_read.insert(make_pair(hoid, want));
+    ++op->delta_reads_in_progress;
+  }
+  ec_backend.start_read_op(
+    CEPH_MSG_PRIO_DEFAULT,
+    obj_want_to_read,
+    for_read_op,
+    OpRequestRef(),
+    false,
+    false);
+}
+
+void ECBackend::RMWPipeline::retry_delta_read(
+  Op *op,
+  const hobject_t &hoid,
+  const set<int> &want)
+{
+  // the shards we asked for failed and the others could not make up for
+  // them: read the whole stripes the way a full rmw does instead, and
+  // encode them again for the old data and coding chunks
+  extent_set stripes;
+  for (auto &&e : op->plan.delta_write[hoid]) {
+    auto bounds = sinfo.offset_len_to_stripe_bounds(
+      make_pair(e.first, e.second));
+    stripes.union_insert(bounds.first, bounds.second);
+  }
+  dout(10) << __func__ << ": " << hoid << " delta read failed, reading stripes "
+	   << stripes << dendl;
+  objects_read_async_no_cache(
+    map<hobject_t,extent_set>{{hoid, stripes}},
+    [op, hoid, want, this](map<hobject_t,pair<int, extent_map> > &&results) {
+      for (auto &&[oid, res] : results) {
+	if (res.first < 0) {
+	  derr << "retry_delta_read: " << oid << " read failed: "
+	       << cpp_strerror(res.first) << dendl;
+	  fall_back_to_rmw(op, hoid);
+	  return;
+	}
+	auto &result = op->delta_read_result[hoid];
+	for (auto &&extent : res.second) {
+	  bufferlist bl = extent.get_val();
+	  map<int, bufferlist> chunks;
+	  int r = ECUtil::encode(sinfo, ec_impl, bl, want, &chunks);
+	  ceph_assert(r == 0);
+	  uint64_t chunk_off =
+	    sinfo.aligned_logical_offset_to_chunk_offset(extent.get_off());
+	  for (auto &&[s, cbl] : chunks) {
+	    result[s].insert(chunk_off, cbl.length(), cbl);
+	  }
+	}
+      }
+      ceph_assert(op->delta_reads_in_progress);
+      --op->delta_reads_in_progress;
+      check_ops();
+    });
+}
+
+void ECBackend::RMWPipeline::fall_back_to_rmw(
+  Op *op,
+  const hobject_t &hoid)
+{
+  // without the old chunks there is no delta to fold into the parity: go
+  // back to the plan of a full rmw for this object.  The cache keeps the
+  // extents reserved for the delta, later ops on these stripes expect them
+  // and the rest of the stripes is written back unchanged.
+  auto p = op->plan.delta_write.find(hoid);
+  ceph_assert(p != op->plan.delta_write.end());
+  op->delta_fallback[hoid] = std::move(p->second);
+  op->plan.delta_write.erase(p);
+  op->delta_read_result.erase(hoid);
+  op->plan.to_read[hoid] = op->rmw_to_read[hoid];
+  op->plan.will_write[hoid] = op->rmw_will_write[hoid];
+  dout(10) << __func__ << ": " << hoid << " reading " << op->plan.to_read[hoid]
+	   << " to write " << op->plan.will_write[hoid] << dendl;
+  objects_read_async_no_cache(
+    map<hobject_t,extent_set>{{hoid, op->plan.to_read[hoid]}},
+    [op, this](map<hobject_t,pair<int, extent_map> > &&results) {
+      for (auto &&i: results) {
+	op->remote_read_result.emplace(i.first, i.second.second);
+      }
+      ceph_assert(op->delta_reads_in_progress);
+      --op->delta_reads_in_progress;
+      check_ops();
+    });
+}
+
 bool ECBackend::RMWPipeline::try_reads_to_commit()
 {
   if (waiting_reads.empty())
@@ -2123,11 +2544,25 @@ bool ECBackend::RMWPipeline::try_reads_to_commit()
   if (op->using_cache) {
     for (auto &&hpair: written) {
       dout(20) << __func__ << ": " << hpair << dendl;
-      cache.present_rmw_update(hpair.first, op->pin, hpair.second);
+      auto fallback = op->delta_fallback.find(hpair.first);
+      if (fallback == op->delta_fallback.end()) {
+	cache.present_rmw_update(hpair.first, op->pin, hpair.second);
+	continue;
+      }
+      // only the extents reserved for the parity delta are pinned
+      extent_map reserved;
+      for (auto &&e : fallback->second) {
+	reserved.insert(hpair.second.intersect(e.first, e.second));
+      }
+      cache.present_rmw_update(hpair.first, op->pin, reserved);
     }
   }
   op->remote_read.clear();
   op->remote_read_result.clear();
+  op->delta_read_result.clear();
+  op->rmw_to_read.clear();
+  op->rmw_will_write.clear();
+  op->delta_fallback.clear();
 
   ObjectStore::Transaction empty;
   bool should_write_local = false;
@@ -2606,21 +3041,25 @@ int ECBackend::be_deep_scrub(
   if (stride % sinfo.get_chunk_size())
     stride += sinfo.get_chunk_size() - (stride % sinfo.get_chunk_size());
 
-  bufferlist bl;
-  r = store->read(
-    ch,
-    ghobject_t(
-      poid, ghobject_t::NO_GEN, get_parent()->whoami_shard().shard),
-    pos.data_pos,
-    stride, bl,
-    fadvise_flags);
+  const ghobject_t goid(
+    poid, ghobject_t::NO_GEN, get_parent()->whoami_shard().shard);
+  uint32_t crc = pos.data_hash.digest();
+  if (cct->_conf->osd_deep_scrub_store_digest) {
+    r = store->digest(ch, goid, pos.data_pos, stride, &crc, fadvise_flags);
+  } else {
+    bufferlist bl;
+    r = store->read(ch, goid, pos.data_pos, stride, bl, fadvise_flags);
+    if (r > 0) {
+      crc = bl.crc32c(crc);
+    }
+  }
   if (r < 0) {
     dout(20) << __func__ << "  " << poid << " got "
 	     << r << " on read, read_error" << dendl;
     o.read_error = true;
     return 0;
   }
-  if (bl.length() % sinfo.get_chunk_size()) {
+  if (r % sinfo.get_chunk_size()) {
     dout(20) << __func__ << "  " << poid << " got "
 	     << r << " on read, not chunk size " << sinfo.get_chunk_size() << " aligned"
 	     << dendl;
@@ -2628,7 +3067,7 @@ int ECBackend::be_deep_scrub(
     return 0;
   }
   if (r > 0) {
-    pos.data_hash << bl;
+    pos.data_hash = bufferhash(crc);
   }
   pos.data_pos += r;
   if (r == (int)stride) {
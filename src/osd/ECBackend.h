@@ -370,6 +370,12 @@ public:
 
     std::set<pg_shard_t> in_progress;
 
+    // when each sub read of a client read was sent, for the peer latency
+    std::map<pg_shard_t, ceph::mono_time> sent;
+    // extra shards read because the first ones were late
+    std::set<pg_shard_t> hedged_to;
+    bool hedge_scheduled = false;
+
     ReadOp(
       int priority,
       ceph_tid_t tid,
@@ -412,6 +418,9 @@ public:
     bool do_redundant_reads, bool for_recovery);
 
   void do_read_op(ReadOp &rop);
+  void send_sub_reads(ReadOp &rop, std::map<pg_shard_t, ECSubRead> &messages);
+  void schedule_hedge_reads(ReadOp &rop);
+  void send_hedge_reads(ceph_tid_t tid);
   int send_all_remaining_reads(
     const hobject_t &hoid,
     ReadOp &rop);
@@ -457,7 +466,9 @@ public:
       std::set<hobject_t> temp_cleared;
 
       ECTransaction::WritePlan plan;
-      bool requires_rmw() const { return !plan.to_read.empty(); }
+      bool requires_rmw() const {
+        return !plan.to_read.empty() || !plan.delta_write.empty();
+      }
       bool invalidates_cache() const { return plan.invalidates_cache; }
 
       // must be true if requires_rmw(), must be false if invalidates_cache()
@@ -467,8 +478,18 @@ public:
       std::map<hobject_t,extent_set> pending_read; // subset already being read
       std::map<hobject_t,extent_set> remote_read;  // subset we must read
       std::map<hobject_t,extent_map> remote_read_result;
+      /// old data and coding chunks for plan.delta_write, by shard
+      std::map<hobject_t,std::map<int,extent_map>> delta_read_result;
+      unsigned delta_reads_in_progress = 0;
+      /// the full rmw plan of the objects in plan.delta_write
+      std::map<hobject_t,extent_set> rmw_to_read;
+      std::map<hobject_t,extent_set> rmw_will_write;
+      /// objects which fell back to a full rmw, and what they reserved in
+      /// the cache for the parity delta
+      std::map<hobject_t,extent_set> delta_fallback;
       bool read_in_progress() const {
-        return !remote_read.empty() && remote_read_result.empty();
+        return (!remote_read.empty() && remote_read_result.empty()) ||
+          delta_reads_in_progress > 0;
       }
 
       /// In progress write state.
@@ -557,6 +578,11 @@ public:
     void start_rmw(OpRef op);
     bool try_state_to_reads();
     bool try_reads_to_commit();
+    bool can_delta_write(const Op &op);
+    void start_delta_reads(Op *op);
+    void retry_delta_read(Op *op, const hobject_t &hoid,
+			  const std::set<int> &want);
+    void fall_back_to_rmw(Op *op, const hobject_t &hoid);
     bool try_finish_rmw();
     void check_ops();
 
@@ -0,0 +1,134 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "ECPeerLatency.h"
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+#include "common/perf_counters_key.h"
+#include "include/stringify.h"
+#include "osd_perf_counters.h"
+
+// enough for any sane cluster; the least recently used peers are dropped
+static constexpr size_t max_peer_counters = 4096;
+
+ECPeerLatency::ECPeerLatency(CephContext *cct)
+  : counters(cct, max_peer_counters, build_ec_peer_perf)
+{
+}
+
+std::string ECPeerLatency::counters_key(int osd)
+{
+  return ceph::perf_counters::key_create(
+    osd_ec_peer_counters_key, {{"peer", "osd." + stringify(osd)}});
+}
+
+void ECPeerLatency::add_sample(int osd, ceph::timespan lat)
+{
+  double ns = std::chrono::duration<double, std::nano>(lat).count();
+  double avg;
+  {
+    std::lock_guard l(lock);
+    auto [p, fresh] = peers.try_emplace(osd);
+    peer_t &peer = p->second;
+    if (fresh) {
+      peer.avg = ns;
+      peer.dev = ns / 2;
+    } else {
+      // same gains as the TCP RTT estimator (RFC 6298)
+      peer.dev += (std::abs(ns - peer.avg) - peer.dev) / 4;
+      peer.avg += (ns - peer.avg) / 8;
+    }
+    avg = peer.avg;
+  }
+  std::string key = counters_key(osd);
+  counters.tinc(key, l_osd_ec_peer_sub_read_lat, lat);
+  counters.set_counter(key, l_osd_ec_peer_sub_read_ewma, avg / 1000);
+}
+
+bool ECPeerLatency::get(int osd, ceph::timespan *avg,
+			ceph::timespan *dev) const
+{
+  std::lock_guard l(lock);
+  auto p = peers.find(osd);
+  if (p == peers.end()) {
+    return false;
+  }
+  *avg = ceph::timespan(static_cast<ceph::timespan::rep>(p->second.avg));
+  *dev = ceph::timespan(static_cast<ceph::timespan::rep>(p->second.dev));
+  return true;
+}
+
+std::vector<int> ECPeerLatency::sort_shards(const std::map<int, int> &shards,
+					    const std::set<int> &want) const
+{
+  std::vector<std::tuple<double, bool, int>> by_latency;
+  {
+    std::lock_guard l(lock);
+    for (auto &&[id, osd] : shards) {
+      bool wanted = want.count(id);
+      double est = 0;
+      if (auto p = peers.find(osd); p != peers.end()) {
+	est = p->second.avg + (wanted ? 0 : p->second.dev);
+      }
+      by_latency.emplace_back(est, !wanted, id);
+    }
+  }
+  std::sort(by_latency.begin(), by_latency.end());
+  std::vector<int> ids;
+  ids.reserve(by_latency.size());
+  for (auto &&[est, unwanted, id] : by_latency) {
+    ids.push_back(id);
+  }
+  return ids;
+}
+
+std::optional<int> ECPeerLatency::fastest_shard(
+  const std::map<int, int> &shards) const
+{
+  std::lock_guard l(lock);
+  std::optional<int> best;
+  double best_ns = 0;
+  for (auto &&[id, osd] : shards) {
+    double est = 0;
+    if (auto p = peers.find(osd); p != peers.end()) {
+      est = p->second.avg + p->second.dev;
+    }
+    if (!best || est < best_ns) {
+      best = id;
+      best_ns = est;
+    }
+  }
+  return best;
+}
+
+std::optional<ceph::timespan> ECPeerLatency::hedge_delay(
+  const std::set<int> &osds,
+  double deviations,
+  ceph::timespan min_delay) const
+{
+  double delay_ns = std::chrono::duration<double, std::nano>(
+    min_delay).count();
+  std::lock_guard l(lock);
+  for (auto osd : osds) {
+    auto p = peers.find(osd);
+    if (p == peers.end()) {
+      return std::nullopt;
+    }
+    delay_ns = std::max(delay_ns,
+			p->second.avg + deviations * p->second.dev);
+  }
+  return ceph::timespan(static_cast<ceph::timespan::rep>(delay_ns));
+}
+
+void ECPeerLatency::hedge_sent(int osd)
+{
+  counters.inc(counters_key(osd), l_osd_ec_peer_hedge, 1);
+}
+
+void ECPeerLatency::hedge_won(int osd)
+{
+  counters.inc(counters_key(osd), l_osd_ec_peer_hedge_win, 1);
+}
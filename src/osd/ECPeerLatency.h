@@ -0,0 +1,71 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "common/ceph_mutex.h"
+#include "common/ceph_time.h"
+#include "common/perf_counters_cache.h"
+
+/**
+ * ECPeerLatency
+ *
+ * How fast each peer OSD answers EC sub reads, shared by all the PGs of
+ * an OSD.  Like the TCP retransmit timer, it keeps exponentially
+ * weighted moving averages of the latency and of its mean deviation, so
+ * reads can go to the fastest shards and a sub read can be deemed late
+ * compared to what the peer usually does.
+ */
+class ECPeerLatency {
+  struct peer_t {
+    double avg = 0;  ///< ns
+    double dev = 0;  ///< ns
+  };
+
+  mutable ceph::mutex lock = ceph::make_mutex("ECPeerLatency::lock");
+  std::map<int, peer_t> peers;
+  ceph::perf_counters::PerfCountersCache counters;
+
+  static std::string counters_key(int osd);
+
+public:
+  explicit ECPeerLatency(CephContext *cct);
+
+  void add_sample(int osd, ceph::timespan lat);
+
+  /// @return false if nothing was measured for osd yet
+  bool get(int osd, ceph::timespan *avg, ceph::timespan *dev) const;
+
+  /**
+   * the shards in the order they are expected to answer
+   *
+   * Those never measured come first.  One not in want has to beat a
+   * wanted one by a deviation, so noise doesn't turn plain reads into
+   * decodes.
+   *
+   * @param shards the osd of each shard
+   */
+  std::vector<int> sort_shards(const std::map<int, int> &shards,
+			       const std::set<int> &want) const;
+  /// the shard expected to answer first, if any
+  std::optional<int> fastest_shard(const std::map<int, int> &shards) const;
+  /**
+   * how long to wait for sub reads sent to osds before hedging them
+   *
+   * @return the time the slowest of them usually takes, plus deviations
+   *         of it, but at least min_delay; nullopt if one of them was
+   *         never measured, there is nothing to judge lateness by then
+   */
+  std::optional<ceph::timespan> hedge_delay(const std::set<int> &osds,
+					    double deviations,
+					    ceph::timespan min_delay) const;
+
+  void hedge_sent(int osd);
+  void hedge_won(int osd);
+};
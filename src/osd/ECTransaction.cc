@@ -30,6 +30,7 @@ using std::string;
 using std::vector;
 
 using ceph::bufferlist;
+using ceph::bufferptr;
 using ceph::decode;
 using ceph::encode;
 using ceph::ErasureCodeInterfaceRef;
@@ -94,6 +95,134 @@ static void encode_and_write(
   }
 }
 
+extent_set ECTransaction::get_parity_delta_extents(
+  const ECUtil::stripe_info_t &sinfo,
+  unsigned coding_chunks,
+  const extent_set &raw_writes,
+  const extent_set &stripe_reads,
+  const extent_set &stripe_writes)
+{
+  const uint64_t cs = sinfo.get_chunk_size();
+  const uint64_t sw = sinfo.get_stripe_width();
+  const uint64_t k = sw / cs;
+
+  extent_set chunks;
+  extent_set stripes;
+  set<uint64_t> data_shards;
+  for (auto &&e : raw_writes) {
+    uint64_t start = (e.first / cs) * cs;
+    uint64_t end = ((e.first + e.second + cs - 1) / cs) * cs;
+    chunks.union_insert(start, end - start);
+    uint64_t stripe_start = sinfo.logical_to_prev_stripe_offset(start);
+    stripes.union_insert(
+      stripe_start,
+      sinfo.logical_to_next_stripe_offset(end) - stripe_start);
+  }
+  for (auto &&e : chunks) {
+    for (uint64_t off = e.first; off < e.first + e.second; off += cs) {
+      data_shards.insert((off % sw) / cs);
+    }
+  }
+
+  // the shard reads cover every touched stripe on each touched data shard;
+  // the writes are the touched chunks plus all the parity of those stripes
+  uint64_t parity = (stripes.size() / sw) * cs * coding_chunks;
+  uint64_t delta_io =
+    (stripes.size() / sw) * cs * data_shards.size() + parity +
+    chunks.size() + parity;
+  uint64_t rmw_io =
+    stripe_reads.size() +
+    (stripe_writes.size() / sw) * cs * (k + coding_chunks);
+  if (delta_io >= rmw_io) {
+    return extent_set();
+  }
+  return chunks;
+}
+
+static void delta_and_write(
+  pg_t pgid,
+  const hobject_t &oid,
+  const ECUtil::stripe_info_t &sinfo,
+  ErasureCodeInterfaceRef &ecimpl,
+  const extent_map &updates,
+  const extent_set &chunks,
+  const map<int, extent_map> &shard_reads,
+  uint32_t flags,
+  extent_map &written,
+  map<shard_id_t, ObjectStore::Transaction> *transactions,
+  DoutPrefixProvider *dpp)
+{
+  const uint64_t cs = sinfo.get_chunk_size();
+  const uint64_t sw = sinfo.get_stripe_width();
+  const int k = ecimpl->get_data_chunk_count();
+  const int n = ecimpl->get_chunk_count();
+
+  auto read_chunk = [&](int shard, uint64_t chunk_off) {
+    auto i = shard_reads.find(shard);
+    ceph_assert(i != shard_reads.end());
+    auto old = i->second.intersect(chunk_off, cs);
+    ceph_assert(old.ext_count() == 1);
+    ceph_assert(old.begin().get_len() == cs);
+    bufferptr bp = ceph::buffer::create_page_aligned(cs);
+    old.begin().get_val().begin().copy(cs, bp.c_str());
+    return bp;
+  };
+  auto write_chunk = [&](int shard, uint64_t chunk_off, bufferlist &bl) {
+    auto t = transactions->find(shard_id_t(shard));
+    if (t == transactions->end()) {
+      return;
+    }
+    t->second.write(
+      coll_t(spg_t(pgid, t->first)),
+      ghobject_t(oid, ghobject_t::NO_GEN, t->first),
+      chunk_off,
+      bl.length(),
+      bl,
+      flags);
+  };
+
+  map<uint64_t, set<int>> stripes;
+  for (auto &&e : chunks) {
+    for (uint64_t off = e.first; off < e.first + e.second; off += cs) {
+      stripes[sinfo.logical_to_prev_stripe_offset(off)].insert(
+	(off % sw) / cs);
+    }
+  }
+  for (auto &&[stripe_off, data] : stripes) {
+    uint64_t chunk_off = sinfo.aligned_logical_offset_to_chunk_offset(
+      stripe_off);
+    ldpp_dout(dpp, 20) << __func__ << ": " << oid << " stripe " << stripe_off
+		       << " data chunks " << data << dendl;
+    map<int, bufferptr> deltas;
+    for (int j : data) {
+      uint64_t off = stripe_off + j * cs;
+      bufferptr delta = read_chunk(j, chunk_off);
+      bufferptr new_data(delta.c_str(), cs);
+      for (auto &&u : updates.intersect(off, cs)) {
+	u.get_val().begin().copy(
+	  u.get_len(), new_data.c_str() + (u.get_off() - off));
+      }
+      ecimpl->encode_delta(delta, new_data, &delta);
+      deltas[j] = std::move(delta);
+
+      bufferlist bl;
+      bl.append(std::move(new_data));
+      written.insert(off, cs, bl);
+      write_chunk(j, chunk_off, bl);
+    }
+    map<int, bufferptr> parity;
+    for (int p = k; p < n; ++p) {
+      parity[p] = read_chunk(p, chunk_off);
+    }
+    ecimpl->apply_delta(deltas, parity);
+    for (auto &&[p, bp] : parity) {
+      bufferlist bl;
+      bl.append(std::move(bp));
+      write_chunk(p, chunk_off, bl);
+    }
+  }
+}
+
 void ECTransaction::generate_transactions(
   PGTransaction* _t,
   WritePlan &plan,
@@ -101,6 +230,7 @@ void ECTransaction::generate_transactions(
   pg_t pgid,
   const ECUtil::stripe_info_t &sinfo,
   const map<hobject_t,extent_map> &partial_extents,
+  const map<hobject_t,map<int,extent_map>> &delta_reads,
   vector<pg_log_entry_t> &entries,
   map<hobject_t,extent_map> *written_map,
   map<shard_id_t, ObjectStore::Transaction> *transactions,
@@ -392,6 +522,103 @@ void ECTransaction::generate_transactions(
 	}
       }
 
+      auto dwiter = plan.delta_write.find(oid);
+      if (dwiter != plan.delta_write.end()) {
+	// in place update of existing chunks: no truncate, no append
+	ceph_assert(!op.truncate);
+	auto driter = delta_reads.find(oid);
+	ceph_assert(driter != delta_reads.end());
+	const uint64_t size = hinfo->get_total_logical_size(sinfo);
+
+	extent_map updates;
+	uint32_t fadvise_flags = 0;
+	for (auto &&extent: op.buffer_updates) {
+	  using BufferUpdate = PGTransaction::ObjectOperation::BufferUpdate;
+	  bufferlist bl;
+	  match(
+	    extent.get_val(),
+	    [&](const BufferUpdate::Write &op) {
+	      bl = op.buffer;
+	      fadvise_flags |= op.fadvise_flags;
+	    },
+	    [&](const BufferUpdate::Zero &) {
+	      bl.append_zero(extent.get_len());
+	    },
+	    [&](const BufferUpdate::CloneRange &) {
+	      ceph_assert(
+		0 ==
+		"CloneRange is not allowed, do_op should have returned ENOTSUPP");
+	    });
+	  ceph_assert(extent.get_off() + extent.get_len() <= size);
+	  updates.insert(extent.get_off(), extent.get_len(), bl);
+	}
+
+	if (entry) {
+	  // the stripes are only partly rewritten, but rollback works on
+	  // whole chunk ranges of all shards
+	  extent_set stripes;
+	  for (auto &&e : dwiter->second) {
+	    uint64_t start = sinfo.logical_to_prev_stripe_offset(e.first);
+	    stripes.union_insert(
+	      start,
+	      sinfo.logical_to_next_stripe_offset(e.first + e.second) - start);
+	  }
+	  vector<pair<uint64_t, uint64_t> > rollback_extents;
+	  for (auto &&st : *transactions) {
+	    st.second.touch(
+	      coll_t(spg_t(pgid, st.first)),
+	      ghobject_t(oid, entry->version.version, st.first));
+	  }
+	  for (auto &&e : stripes) {
+	    uint64_t restore_from =
+	      sinfo.aligned_logical_offset_to_chunk_offset(e.first);
+	    uint64_t restore_len =
+	      sinfo.aligned_logical_offset_to_chunk_offset(e.second);
+	    ldpp_dout(dpp, 20) << "generate_transactions: delta overwriting "
+			       << restore_from << "~" << restore_len
+			       << dendl;
+	    rollback_extents.emplace_back(make_pair(restore_from, restore_len));
+	    for (auto &&st : *transactions) {
+	      st.second.clone_range(
+		coll_t(spg_t(pgid, st.first)),
+		ghobject_t(oid, ghobject_t::NO_GEN, st.first),
+		ghobject_t(oid, entry->version.version, st.first),
+		restore_from,
+		restore_len,
+		restore_from);
+	    }
+	  }
+	  entry->mod_desc.rollback_extents(
+	    entry->version.version, rollback_extents);
+	}
+
+	delta_and_write(
+	  pgid,
+	  oid,
+	  sinfo,
+	  ecimpl,
+	  updates,
+	  dwiter->second,
+	  driter->second,
+	  fadvise_flags,
+	  written,
+	  transactions,
+	  dpp);
+
+	hinfo->set_total_chunk_size_clear_hash(
+	  sinfo.aligned_logical_offset_to_chunk_offset(size));
+	bufferlist hbuf;
+	encode(*hinfo, hbuf);
+	for (auto &&i : *transactions) {
+	  i.second.setattr(
+	    coll_t(spg_t(pgid, i.first)),
+	    ghobject_t(oid, ghobject_t::NO_GEN, i.first),
+	    ECUtil::get_hinfo_key(),
+	    hbuf);
+	}
+	return;
+      }
+
       extent_map to_write;
       auto pextiter = partial_extents.find(oid);
       if (pextiter != partial_extents.end()) {
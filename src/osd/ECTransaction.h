@@ -28,15 +28,31 @@ namespace ECTransaction {
     std::map<hobject_t,extent_set> to_read;
     std::map<hobject_t,extent_set> will_write; // superset of to_read
 
+    /* chunk aligned extents which may instead be updated in place by
+     * reading the old chunks and the parity and folding in the deltas,
+     * see get_parity_delta_extents.  The backend either switches to it
+     * (to_read empty, will_write = delta_write) or clears it. */
+    std::map<hobject_t,extent_set> delta_write;
+
     std::map<hobject_t,ECUtil::HashInfoRef> hash_infos;
   };
 
+  /// chunk aligned extents covering raw_writes if updating them through
+  /// parity deltas moves fewer bytes than the stripe rewrite, else empty
+  extent_set get_parity_delta_extents(
+    const ECUtil::stripe_info_t &sinfo,
+    unsigned coding_chunks,
+    const extent_set &raw_writes,
+    const extent_set &stripe_reads,
+    const extent_set &stripe_writes);
+
   template <typename F>
   WritePlan get_write_plan(
     const ECUtil::stripe_info_t &sinfo,
     PGTransaction& t,
     F &&get_hinfo,
-    DoutPrefixProvider *dpp) {
+    DoutPrefixProvider *dpp,
+    unsigned delta_coding_chunks = 0) {  ///< 0 disables delta_write
     WritePlan plan;
     t.safe_create_traverse(
       [&](std::pair<const hobject_t, PGTransaction::ObjectOperation> &i) {
@@ -146,6 +162,27 @@ namespace ECTransaction {
 	  }
 	}
 
+	if (delta_coding_chunks &&
+	    !i.second.is_fresh_object() &&
+	    !i.second.deletes_first() &&
+	    !i.second.has_source() &&
+	    !i.second.truncate &&
+	    !raw_write_set.empty() &&
+	    raw_write_set.range_end() <= orig_size &&
+	    plan.to_read.count(i.first)) {
+	  extent_set delta = get_parity_delta_extents(
+	    sinfo,
+	    delta_coding_chunks,
+	    raw_write_set,
+	    plan.to_read[i.first],
+	    will_write);
+	  if (!delta.empty()) {
+	    ldpp_dout(dpp, 20) << __func__ << ": parity delta candidate "
+			       << delta << dendl;
+	    plan.delta_write[i.first] = std::move(delta);
+	  }
+	}
+
 	if (i.second.truncate &&
 	    i.second.truncate->second > projected_size) {
 	  uint64_t truncating_to =
@@ -184,6 +221,7 @@ namespace ECTransaction {
     pg_t pgid,
     const ECUtil::stripe_info_t &sinfo,
     const std::map<hobject_t,extent_map> &partial_extents,
+    const std::map<hobject_t,std::map<int,extent_map>> &delta_reads,
     std::vector<pg_log_entry_t> &entries,
     std::map<hobject_t,extent_map> *written,
     std::map<shard_id_t, ObjectStore::Transaction> *transactions,
@@ -244,6 +244,7 @@ OSDService::OSDService(OSD *osd, ceph::async::io_context_pool& poolctx) :
   monc(osd->monc),
   osd_max_object_size(cct->_conf, "osd_max_object_size"),
   osd_skip_data_digest(cct->_conf, "osd_skip_data_digest"),
+  ec_peer_latency(cct),
   publish_lock{ceph::make_mutex("OSDService::publish_lock")},
   pre_publish_lock{ceph::make_mutex("OSDService::pre_publish_lock")},
   m_osd_scrub{cct, *this, cct->_conf},
@@ -688,6 +689,14 @@ void OSDService::agent_stop()
 
 // -------------------------------------
 
+void OSDService::update_read_coalesce_limits()
+{
+  read_coalesce_max_bytes = cct->_conf.get_val<Option::size_t>(
+    "osd_read_coalesce_max_bytes");
+  read_coalesce_window = cct->_conf.get_val<std::chrono::milliseconds>(
+    "osd_read_coalesce_window");
+}
+
 void OSDService::promote_throttle_recalibrate()
 {
   utime_t now = ceph_clock_now();
@@ -1692,6 +1701,15 @@ void OSDService::queue_recovery_context(
   GenContext<ThreadPool::TPHandle&> *c,
   uint64_t cost,
   int priority)
+{
+  queue_recovery_context(pg->get_pgid(), c, cost, priority);
+}
+
+void OSDService::queue_recovery_context(
+  spg_t pgid,
+  GenContext<ThreadPool::TPHandle&> *c,
+  uint64_t cost,
+  int priority)
 {
   epoch_t e = get_osdmap_epoch();
 
@@ -1711,7 +1729,7 @@ void OSDService::queue_recovery_context(
   enqueue_back(
     OpSchedulerItem(
       unique_ptr<OpSchedulerItem::OpQueueable>(
-	new PGRecoveryContext(pg->get_pgid(), c, e, priority)),
+	new PGRecoveryContext(pgid, c, e, priority)),
       cost_for_queue,
       cct->_conf->osd_recovery_priority,
       ceph_clock_now(),
@@ -2372,6 +2390,7 @@ OSD::OSD(CephContext *cct_,
   op_tracker.set_history_slow_op_size_and_threshold(cct->_conf->osd_op_history_slow_op_size,
                                                     cct->_conf->osd_op_history_slow_op_threshold);
   ObjectCleanRegions::set_max_num_intervals(cct->_conf->osd_object_clean_region_max_num_intervals);
+  service.update_read_coalesce_limits();
 #ifdef WITH_BLKIN
   std::stringstream ss;
   ss << "osd." << whoami;
@@ -9709,6 +9728,8 @@ const char** OSD::get_tracked_conf_keys() const
     "osd_scrub_max_interval",
     "osd_op_thread_timeout",
     "osd_op_thread_suicide_timeout",
+    "osd_read_coalesce_max_bytes",
+    "osd_read_coalesce_window",
     NULL
   };
   return KEYS;
@@ -9824,6 +9845,10 @@ void OSD::handle_conf_change(const ConfigProxy& conf,
   if (changed.count("osd_object_clean_region_max_num_intervals")) {
     ObjectCleanRegions::set_max_num_intervals(cct->_conf->osd_object_clean_region_max_num_intervals);
   }
+  if (changed.count("osd_read_coalesce_max_bytes") ||
+      changed.count("osd_read_coalesce_window")) {
+    service.update_read_coalesce_limits();
+  }
 
   if (changed.count("osd_scrub_min_interval") ||
       changed.count("osd_scrub_max_interval") ||
@@ -10464,6 +10489,7 @@ int OSDShard::_wake_pg_slot(
   }
   slot->waiting_peering.clear();
   ++slot->requeue_seq;
+  queue_depth += count;
   return count;
 }
 
@@ -10735,6 +10761,16 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
 
   // peek at spg_t
   sdata->shard_lock.lock();
+  if (sdata->scheduler->empty() &&
+      (!is_smallest_thread_index || sdata->context_queue.empty()) &&
+      osd->cct->_conf->osd_op_queue_steal) {
+    // nothing to do here, help out a busier shard before going to sleep
+    sdata->shard_lock.unlock();
+    if (_steal(shard_index, hb)) {
+      return;
+    }
+    sdata->shard_lock.lock();
+  }
   if (sdata->scheduler->empty() &&
       (!is_smallest_thread_index || sdata->context_queue.empty())) {
     std::unique_lock wait_lock{sdata->sdata_wait_lock};
@@ -10745,7 +10781,9 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
       dout(20) << __func__ << " empty q, waiting" << dendl;
       osd->cct->get_heartbeat_map()->clear_timeout(hb);
       sdata->shard_lock.unlock();
+      ++sdata->idle_threads;
       sdata->sdata_cond.wait(wait_lock);
+      --sdata->idle_threads;
       wait_lock.unlock();
       sdata->shard_lock.lock();
       if (sdata->scheduler->empty() &&
@@ -10764,6 +10802,58 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
     }
   }
 
+  _process_shard(sdata, is_smallest_thread_index, false, hb);
+}
+
+bool OSD::ShardedOpWQ::_steal(uint32_t shard_index, heartbeat_handle_d *hb)
+{
+  // pick the deepest queue without taking any of the shard locks
+  const uint64_t min_depth = osd->cct->_conf->osd_op_queue_steal_min_depth;
+  OSDShard *victim = nullptr;
+  uint64_t victim_depth = 0;
+  for (uint32_t i = 1; i < osd->num_shards; ++i) {
+    OSDShard *s = osd->shards[(shard_index + i) % osd->num_shards];
+    uint64_t depth = s->queue_depth.load(std::memory_order_relaxed);
+    if (depth >= std::max<uint64_t>(min_depth, 1) && depth > victim_depth) {
+      victim = s;
+      victim_depth = depth;
+    }
+  }
+  if (!victim) {
+    return false;
+  }
+
+  victim->shard_lock.lock();
+  if (victim->scheduler->empty()) {
+    victim->shard_lock.unlock();
+    return false;
+  }
+  dout(20) << __func__ << " from shard " << victim->shard_id
+	   << " depth " << victim_depth << dendl;
+  // never the smallest thread index of the victim: its oncommits stay
+  // with its own thread to keep them in order
+  return _process_shard(victim, false, true, hb);
+}
+
+void OSD::ShardedOpWQ::_wake_thief(uint32_t shard_index)
+{
+  for (uint32_t i = 1; i < osd->num_shards; ++i) {
+    OSDShard *s = osd->shards[(shard_index + i) % osd->num_shards];
+    if (s->idle_threads.load(std::memory_order_relaxed) > 0) {
+      std::lock_guard l{s->sdata_wait_lock};
+      s->sdata_cond.notify_one();
+      return;
+    }
+  }
+}
+
+bool OSD::ShardedOpWQ::_process_shard(OSDShard *sdata,
+				      bool is_smallest_thread_index,
+				      bool stealing,
+				      heartbeat_handle_d *hb)
+{
+  const uint32_t shard_index = sdata->shard_id;
+
   list<Context *> oncommits;
   if (is_smallest_thread_index) {
     sdata->context_queue.move_to(oncommits);
@@ -10778,26 +10868,34 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
           dout(10) << __func__ << " discarding in-flight oncommit " << c << dendl;
           delete c;
         }
-        return;    // OSD shutdown, discard.
+        return true;    // OSD shutdown, discard.
       }
       sdata->shard_lock.unlock();
       handle_oncommits(oncommits);
-      return;
+      return false;
     }
 
     work_item = sdata->scheduler->dequeue();
+    if (std::get_if<OpSchedulerItem>(&work_item)) {
+      --sdata->queue_depth;
+    }
     if (osd->is_stopping()) {
       sdata->shard_lock.unlock();
       for (auto c : oncommits) {
         dout(10) << __func__ << " discarding in-flight oncommit " << c << dendl;
         delete c;
       }
-      return;    // OSD shutdown, discard.
+      return true;    // OSD shutdown, discard.
     }
 
     // If the work item is scheduled in the future, wait until
     // the time returned in the dequeue response before retrying.
     if (auto when_ready = std::get_if<double>(&work_item)) {
+      if (stealing) {
+	// not our shard, leave it to its own threads
+	sdata->shard_lock.unlock();
+	return false;
+      }
       if (is_smallest_thread_index) {
         sdata->shard_lock.unlock();
         handle_oncommits(oncommits);
@@ -10827,13 +10925,17 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
 
   // Access the stored item
   auto item = std::move(std::get<OpSchedulerItem>(work_item));
+  if (stealing) {
+    ++sdata->stolen;
+    osd->logger->inc(l_osd_op_wq_steal);
+  }
   if (osd->is_stopping()) {
     sdata->shard_lock.unlock();
     for (auto c : oncommits) {
       dout(10) << __func__ << " discarding in-flight oncommit " << c << dendl;
       delete c;
     }
-    return;    // OSD shutdown, discard.
+    return true;    // OSD shutdown, discard.
   }
 
   const auto token = item.get_ordering_token();
@@ -10874,7 +10976,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
       pg->unlock();
       sdata->shard_lock.unlock();
       handle_oncommits(oncommits);
-      return;
+      return true;
     }
     slot = q->second.get();
     --slot->num_running;
@@ -10886,7 +10988,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
       pg->unlock();
       sdata->shard_lock.unlock();
       handle_oncommits(oncommits);
-      return;
+      return true;
     }
     if (requeue_seq != slot->requeue_seq) {
       dout(20) << __func__ << " " << token
@@ -10896,7 +10998,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
       pg->unlock();
       sdata->shard_lock.unlock();
       handle_oncommits(oncommits);
-      return;
+      return true;
     }
     if (slot->pg != pg) {
       // this can happen if we race with pg removal.
@@ -10995,12 +11097,12 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
 	sdata->shard_lock.unlock();
 	osd->service.release_reserved_pushes(pushes_to_free);
 	handle_oncommits(oncommits);
-	return;
+	return true;
       }
     }
     sdata->shard_lock.unlock();
     handle_oncommits(oncommits);
-    return;
+    return true;
   }
   if (qi.is_peering()) {
     OSDMapRef osdmap = sdata->shard_osdmap;
@@ -11009,7 +11111,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
       sdata->shard_lock.unlock();
       pg->unlock();
       handle_oncommits(oncommits);
-      return;
+      return true;
     }
   }
   sdata->shard_lock.unlock();
@@ -11057,6 +11159,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
   }
 
   handle_oncommits(oncommits);
+  return true;
 }
 
 void OSD::ShardedOpWQ::_enqueue(OpSchedulerItem&& item) {
@@ -11074,10 +11177,12 @@ void OSD::ShardedOpWQ::_enqueue(OpSchedulerItem&& item) {
   dout(20) << fmt::format("{} {}", __func__, item) << dendl;
 
   bool empty = true;
+  uint64_t depth;
   {
     std::lock_guard l{sdata->shard_lock};
     empty = sdata->scheduler->empty();
     sdata->scheduler->enqueue(std::move(item));
+    depth = ++sdata->queue_depth;
   }
 
   {
@@ -11088,6 +11193,11 @@ void OSD::ShardedOpWQ::_enqueue(OpSchedulerItem&& item) {
       sdata->sdata_cond.notify_one();
     }
   }
+
+  if (osd->cct->_conf->osd_op_queue_steal &&
+      depth >= osd->cct->_conf->osd_op_queue_steal_min_depth) {
+    _wake_thief(shard_index);
+  }
 }
 
 void OSD::ShardedOpWQ::_enqueue_front(OpSchedulerItem&& item)
@@ -11118,6 +11228,7 @@ void OSD::ShardedOpWQ::_enqueue_front(OpSchedulerItem&& item)
     dout(20) << __func__ << " " << item << dendl;
   }
   sdata->scheduler->enqueue_front(std::move(item));
+  ++sdata->queue_depth;
   sdata->shard_lock.unlock();
   std::lock_guard l{sdata->sdata_wait_lock};
   sdata->sdata_cond.notify_one();
@@ -11134,6 +11245,7 @@ void OSD::ShardedOpWQ::stop_for_fast_shutdown()
     while (!sdata->scheduler->empty()) {
       sdata->scheduler->dequeue();
     }
+    sdata->queue_depth = 0;
   }
 }
 
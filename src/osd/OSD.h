@@ -52,6 +52,7 @@
 #include "messages/MOSDOp.h"
 #include "common/EventTrace.h"
 #include "osd/osd_perf_counters.h"
+#include "osd/ECPeerLatency.h"
 #include "common/Finisher.h"
 #include "scrubber/osd_scrub.h"
 
@@ -116,6 +117,8 @@ public:
   md_config_cacher_t<Option::size_t> osd_max_object_size;
   md_config_cacher_t<bool> osd_skip_data_digest;
 
+  ECPeerLatency ec_peer_latency;
+
   void enqueue_back(OpSchedulerItem&& qi);
   void enqueue_front(OpSchedulerItem&& qi);
 
@@ -402,6 +405,12 @@ public:
     promote_counter.finish(bytes);
   }
   void promote_throttle_recalibrate();
+
+  /// limits of the PGs' read coalescers, refreshed on config changes
+  std::atomic<uint64_t> read_coalesce_max_bytes{0};
+  std::atomic<ceph::timespan> read_coalesce_window{ceph::timespan::zero()};
+  void update_read_coalesce_limits();
+
   unsigned get_num_shards() const {
     return m_objecter_finishers;
   }
@@ -499,6 +508,10 @@ public:
                               GenContext<ThreadPool::TPHandle&> *c,
                               uint64_t cost,
 			      int priority);
+  void queue_recovery_context(spg_t pgid,
+                              GenContext<ThreadPool::TPHandle&> *c,
+                              uint64_t cost,
+			      int priority);
   void queue_for_snap_trim(PG *pg);
   void queue_for_scrub(PG* pg, Scrub::scrub_prio_t with_priority);
 
@@ -962,6 +975,14 @@ struct OSDShard {
   ceph::mutex sdata_wait_lock;
   ceph::condition_variable sdata_cond;
   int waiting_threads = 0;
+  /// threads sleeping on an empty queue; read without the lock to pick
+  /// a thread to wake up for work stealing
+  std::atomic<int> idle_threads = {0};
+
+  /// items in scheduler, so other shards can look without shard_lock
+  std::atomic<uint64_t> queue_depth = {0};
+  /// items of this shard processed by threads of other shards
+  std::atomic<uint64_t> stolen = {0};
 
   ceph::mutex osdmap_lock;  ///< protect shard_osdmap updates vs users w/o shard_lock
   OSDMapRef shard_osdmap;
@@ -1553,6 +1574,17 @@ protected:
     /// try to do some work
     void _process(uint32_t thread_index, ceph::heartbeat_handle_d *hb) override;
 
+    /// dequeue and run one item of sdata; called with sdata->shard_lock held
+    /// @return false if nothing was ready to be dequeued
+    bool _process_shard(OSDShard *sdata, bool is_smallest_thread_index,
+			bool stealing, ceph::heartbeat_handle_d *hb);
+
+    /// run one item of the busiest sibling of shard_index, if any
+    bool _steal(uint32_t shard_index, ceph::heartbeat_handle_d *hb);
+
+    /// wake an idle thread of another shard to help out shard_index
+    void _wake_thief(uint32_t shard_index);
+
     void stop_for_fast_shutdown();
 
     /// enqueue a new item
@@ -1590,6 +1622,8 @@ protected:
 
 	std::scoped_lock l{sdata->shard_lock};
 	f->open_object_section(queue_name);
+	f->dump_unsigned("queue_depth", sdata->queue_depth);
+	f->dump_unsigned("stolen", sdata->stolen);
 	sdata->scheduler->dump(*f);
 	f->close_section();
       }
@@ -1545,13 +1545,14 @@ void OSDMap::set_max_osd(int m)
   osd_weight.resize(max_osd, CEPH_OSD_OUT);
   osd_info.resize(max_osd);
   osd_xinfo.resize(max_osd);
-  osd_addrs->client_addrs.resize(max_osd);
-  osd_addrs->cluster_addrs.resize(max_osd);
-  osd_addrs->hb_back_addrs.resize(max_osd);
-  osd_addrs->hb_front_addrs.resize(max_osd);
-  osd_uuid->resize(max_osd);
+  auto& addrs = cow(osd_addrs);
+  addrs.client_addrs.resize(max_osd);
+  addrs.cluster_addrs.resize(max_osd);
+  addrs.hb_back_addrs.resize(max_osd);
+  addrs.hb_front_addrs.resize(max_osd);
+  cow(osd_uuid).resize(max_osd);
   if (osd_primary_affinity)
-    osd_primary_affinity->resize(max_osd, CEPH_OSD_DEFAULT_PRIMARY_AFFINITY);
+    cow(osd_primary_affinity).resize(max_osd, CEPH_OSD_DEFAULT_PRIMARY_AFFINITY);
 
   calc_num_osds();
 }
@@ -1765,7 +1766,7 @@ uint64_t OSDMap::get_features(int entity_type, uint64_t *pmask) const
   }
   mask |= CEPH_FEATURES_CRUSH;
 
-  if (!pg_upmap.empty() || !pg_upmap_items.empty() || !pg_upmap_primaries.empty())
+  if (!pg_upmap->empty() || !pg_upmap_items->empty() || !pg_upmap_primaries->empty())
     features |= CEPH_FEATUREMASK_OSDMAP_PG_UPMAP;
   mask |= CEPH_FEATUREMASK_OSDMAP_PG_UPMAP;
 
@@ -1913,58 +1914,78 @@ void OSDMap::dedup(const OSDMap *o, OSDMap *n)
 
   int diff = 0;
 
-  // do addrs match?
-  if (o->max_osd != n->max_osd)
-    diff++;
-  for (int i = 0; i < o->max_osd && i < n->max_osd; i++) {
-    if ( n->osd_addrs->client_addrs[i] &&  o->osd_addrs->client_addrs[i] &&
-	*n->osd_addrs->client_addrs[i] == *o->osd_addrs->client_addrs[i])
-      n->osd_addrs->client_addrs[i] = o->osd_addrs->client_addrs[i];
-    else
-      diff++;
-    if ( n->osd_addrs->cluster_addrs[i] &&  o->osd_addrs->cluster_addrs[i] &&
-	*n->osd_addrs->cluster_addrs[i] == *o->osd_addrs->cluster_addrs[i])
-      n->osd_addrs->cluster_addrs[i] = o->osd_addrs->cluster_addrs[i];
-    else
-      diff++;
-    if ( n->osd_addrs->hb_back_addrs[i] &&  o->osd_addrs->hb_back_addrs[i] &&
-	*n->osd_addrs->hb_back_addrs[i] == *o->osd_addrs->hb_back_addrs[i])
-      n->osd_addrs->hb_back_addrs[i] = o->osd_addrs->hb_back_addrs[i];
-    else
+  // do addrs match?  (n may already share them with o, see
+  // deepish_copy_from)
+  if (n->osd_addrs != o->osd_addrs) {
+    if (o->max_osd != n->max_osd)
       diff++;
-    if ( n->osd_addrs->hb_front_addrs[i] &&  o->osd_addrs->hb_front_addrs[i] &&
-	*n->osd_addrs->hb_front_addrs[i] == *o->osd_addrs->hb_front_addrs[i])
-      n->osd_addrs->hb_front_addrs[i] = o->osd_addrs->hb_front_addrs[i];
-    else
-      diff++;
-  }
-  if (diff == 0) {
-    // zoinks, no differences at all!
-    n->osd_addrs = o->osd_addrs;
+    auto& addrs = cow(n->osd_addrs);
+    for (int i = 0; i < o->max_osd && i < n->max_osd; i++) {
+      if ( addrs.client_addrs[i] &&  o->osd_addrs->client_addrs[i] &&
+	  *addrs.client_addrs[i] == *o->osd_addrs->client_addrs[i])
+	addrs.client_addrs[i] = o->osd_addrs->client_addrs[i];
+      else
+	diff++;
+      if ( addrs.cluster_addrs[i] &&  o->osd_addrs->cluster_addrs[i] &&
+	  *addrs.cluster_addrs[i] == *o->osd_addrs->cluster_addrs[i])
+	addrs.cluster_addrs[i] = o->osd_addrs->cluster_addrs[i];
+      else
+	diff++;
+      if ( addrs.hb_back_addrs[i] &&  o->osd_addrs->hb_back_addrs[i] &&
+	  *addrs.hb_back_addrs[i] == *o->osd_addrs->hb_back_addrs[i])
+	addrs.hb_back_addrs[i] = o->osd_addrs->hb_back_addrs[i];
+      else
+	diff++;
+      if ( addrs.hb_front_addrs[i] &&  o->osd_addrs->hb_front_addrs[i] &&
+	  *addrs.hb_front_addrs[i] == *o->osd_addrs->hb_front_addrs[i])
+	addrs.hb_front_addrs[i] = o->osd_addrs->hb_front_addrs[i];
+      else
+	diff++;
+    }
+    if (diff == 0) {
+      // zoinks, no differences at all!
+      n->osd_addrs = o->osd_addrs;
+    }
   }
 
   // does crush match?
-  ceph::buffer::list oc, nc;
-  encode(*o->crush, oc, CEPH_FEATURES_SUPPORTED_DEFAULT);
-  encode(*n->crush, nc, CEPH_FEATURES_SUPPORTED_DEFAULT);
-  if (oc.contents_equal(nc)) {
-    n->crush = o->crush;
+  if (n->crush != o->crush) {
+    ceph::buffer::list oc, nc;
+    encode(*o->crush, oc, CEPH_FEATURES_SUPPORTED_DEFAULT);
+    encode(*n->crush, nc, CEPH_FEATURES_SUPPORTED_DEFAULT);
+    if (oc.contents_equal(nc)) {
+      n->crush = o->crush;
+    }
   }
 
   // does pg_temp match?
-  if (*o->pg_temp == *n->pg_temp)
+  if (n->pg_temp != o->pg_temp &&
+      *o->pg_temp == *n->pg_temp)
     n->pg_temp = o->pg_temp;
 
   // does primary_temp match?
-  if (o->primary_temp->size() == n->primary_temp->size()) {
+  if (n->primary_temp != o->primary_temp &&
+      o->primary_temp->size() == n->primary_temp->size()) {
     if (*o->primary_temp == *n->primary_temp)
       n->primary_temp = o->primary_temp;
   }
 
   // do uuids match?
-  if (o->osd_uuid->size() == n->osd_uuid->size() &&
+  if (n->osd_uuid != o->osd_uuid &&
+      o->osd_uuid->size() == n->osd_uuid->size() &&
       *o->osd_uuid == *n->osd_uuid)
     n->osd_uuid = o->osd_uuid;
+
+  // do upmaps match?
+  if (n->pg_upmap != o->pg_upmap &&
+      *o->pg_upmap == *n->pg_upmap)
+    n->pg_upmap = o->pg_upmap;
+  if (n->pg_upmap_items != o->pg_upmap_items &&
+      *o->pg_upmap_items == *n->pg_upmap_items)
+    n->pg_upmap_items = o->pg_upmap_items;
+  if (n->pg_upmap_primaries != o->pg_upmap_primaries &&
+      *o->pg_upmap_primaries == *n->pg_upmap_primaries)
+    n->pg_upmap_primaries = o->pg_upmap_primaries;
 }
 
 void OSDMap::clean_temps(CephContext *cct,
@@ -2056,10 +2077,10 @@ void OSDMap::clean_temps(CephContext *cct,
 
 void OSDMap::get_upmap_pgs(vector<pg_t> *upmap_pgs) const
 {
-  upmap_pgs->reserve(pg_upmap.size() + pg_upmap_items.size());
-  for (auto& p : pg_upmap)
+  upmap_pgs->reserve(pg_upmap->size() + pg_upmap_items->size());
+  for (auto& p : *pg_upmap)
     upmap_pgs->push_back(p.first);
-  for (auto& p : pg_upmap_items)
+  for (auto& p : *pg_upmap_items)
     upmap_pgs->push_back(p.first);
 }
 
@@ -2139,8 +2160,8 @@ bool OSDMap::check_pg_upmaps(
       continue;
     // okay, upmap is valid
     // continue to check if it is still necessary
-    auto i = pg_upmap.find(pg);
-    if (i != pg_upmap.end()) {
+    auto i = pg_upmap->find(pg);
+    if (i != pg_upmap->end()) {
       if (i->second == raw) {
         ldout(cct, 10) << __func__ << "removing redundant pg_upmap " << i->first << " "
                        << i->second << dendl;
@@ -2155,21 +2176,21 @@ bool OSDMap::check_pg_upmaps(
         continue;
       }
     }
-    auto j = pg_upmap_items.find(pg);
-    if (j != pg_upmap_items.end()) {
+    auto j = pg_upmap_items->find(pg);
+    if (j != pg_upmap_items->end()) {
       mempool::osdmap::vector<pair<int,int>> newmap;
       for (auto& p : j->second) {
 	auto osd_from = p.first;
 	auto osd_to = p.second;
         if (std::find(raw.begin(), raw.end(), osd_from) == raw.end()) {
           // cancel mapping if source osd does not exist anymore
-          ldout(cct, 20) << __func__ << " pg_upmap_items (source osd does not exist) " << pg_upmap_items << dendl;
+          ldout(cct, 20) << __func__ << " pg_upmap_items (source osd does not exist) " << *pg_upmap_items << dendl;
           continue;
         }
         if (osd_to != CRUSH_ITEM_NONE && osd_to < max_osd &&
             osd_to >= 0 && osd_weight[osd_to] == 0) {
           // cancel mapping if target osd is out
-          ldout(cct, 20) << __func__ << " pg_upmap_items (target osd is out) " << pg_upmap_items << dendl;
+          ldout(cct, 20) << __func__ << " pg_upmap_items (target osd is out) " << *pg_upmap_items << dendl;
           continue;
         }
         newmap.push_back(p);
@@ -2209,8 +2230,8 @@ void OSDMap::clean_pg_upmaps(
                      << dendl;
       pending_inc->new_pg_upmap.erase(i);
     }
-    auto j = pg_upmap.find(pg);
-    if (j != pg_upmap.end()) {
+    auto j = pg_upmap->find(pg);
+    if (j != pg_upmap->end()) {
       ldout(cct, 10) << __func__ << " cancel invalid pg_upmap entry "
                      << j->first << "->" << j->second
                      << dendl;
@@ -2224,8 +2245,8 @@ void OSDMap::clean_pg_upmaps(
                      << dendl;
       pending_inc->new_pg_upmap_items.erase(p);
     }
-    auto q = pg_upmap_items.find(pg);
-    if (q != pg_upmap_items.end()) {
+    auto q = pg_upmap_items->find(pg);
+    if (q != pg_upmap_items->end()) {
       ldout(cct, 10) << __func__ << " cancel invalid "
                      << "pg_upmap_items entry "
                      << q->first << "->" << q->second
@@ -2353,7 +2374,7 @@ int OSDMap::apply_incremental(const Incremental &inc)
     // xinfo old_weight.
     if (weight.second) {
       osd_state[weight.first] &= ~(CEPH_OSD_AUTOOUT | CEPH_OSD_NEW);
-      osd_xinfo[weight.first].old_weight = 0;
+      osd_xinfo.mut(weight.first).old_weight = 0;
     }
   }
 
@@ -2375,20 +2396,20 @@ int OSDMap::apply_incremental(const Incremental &inc)
     int s = state.second ? state.second : CEPH_OSD_UP;
     if ((osd_state[osd] & CEPH_OSD_UP) &&
 	(s & CEPH_OSD_UP)) {
-      osd_info[osd].down_at = epoch;
-      osd_xinfo[osd].down_stamp = modified;
+      osd_info.mut(osd).down_at = epoch;
+      osd_xinfo.mut(osd).down_stamp = modified;
     }
     if ((osd_state[osd] & CEPH_OSD_EXISTS) &&
 	(s & CEPH_OSD_EXISTS)) {
       // osd is destroyed; clear out anything interesting.
-      (*osd_uuid)[osd] = uuid_d();
-      osd_info[osd] = osd_info_t();
-      osd_xinfo[osd] = osd_xinfo_t();
+      cow(osd_uuid)[osd] = uuid_d();
+      osd_info.mut(osd) = osd_info_t();
+      osd_xinfo.mut(osd) = osd_xinfo_t();
       set_primary_affinity(osd, CEPH_OSD_DEFAULT_PRIMARY_AFFINITY);
-      osd_addrs->client_addrs[osd].reset(new entity_addrvec_t());
-      osd_addrs->cluster_addrs[osd].reset(new entity_addrvec_t());
-      osd_addrs->hb_front_addrs[osd].reset(new entity_addrvec_t());
-      osd_addrs->hb_back_addrs[osd].reset(new entity_addrvec_t());
+      cow(osd_addrs).client_addrs[osd].reset(new entity_addrvec_t());
+      cow(osd_addrs).cluster_addrs[osd].reset(new entity_addrvec_t());
+      cow(osd_addrs).hb_front_addrs[osd].reset(new entity_addrvec_t());
+      cow(osd_addrs).hb_back_addrs[osd].reset(new entity_addrvec_t());
       osd_state[osd] = 0;
     } else {
       osd_state[osd] ^= s;
@@ -2398,77 +2419,77 @@ int OSDMap::apply_incremental(const Incremental &inc)
   for (const auto &client : inc.new_up_client) {
     osd_state[client.first] |= CEPH_OSD_EXISTS | CEPH_OSD_UP;
     osd_state[client.first] &= ~CEPH_OSD_STOP; // if any
-    osd_addrs->client_addrs[client.first].reset(
+    cow(osd_addrs).client_addrs[client.first].reset(
       new entity_addrvec_t(client.second));
-    osd_addrs->hb_back_addrs[client.first].reset(
+    cow(osd_addrs).hb_back_addrs[client.first].reset(
       new entity_addrvec_t(inc.new_hb_back_up.find(client.first)->second));
-    osd_addrs->hb_front_addrs[client.first].reset(
+    cow(osd_addrs).hb_front_addrs[client.first].reset(
       new entity_addrvec_t(inc.new_hb_front_up.find(client.first)->second));
 
-    osd_info[client.first].up_from = epoch;
+    osd_info.mut(client.first).up_from = epoch;
   }
 
   for (const auto &cluster : inc.new_up_cluster)
-    osd_addrs->cluster_addrs[cluster.first].reset(
+    cow(osd_addrs).cluster_addrs[cluster.first].reset(
       new entity_addrvec_t(cluster.second));
 
   // info
   for (const auto &thru : inc.new_up_thru)
-    osd_info[thru.first].up_thru = thru.second;
+    osd_info.mut(thru.first).up_thru = thru.second;
   
   for (const auto &interval : inc.new_last_clean_interval) {
-    osd_info[interval.first].last_clean_begin = interval.second.first;
-    osd_info[interval.first].last_clean_end = interval.second.second;
+    osd_info.mut(interval.first).last_clean_begin = interval.second.first;
+    osd_info.mut(interval.first).last_clean_end = interval.second.second;
   }
   
   for (const auto &lost : inc.new_lost)
-    osd_info[lost.first].lost_at = lost.second;
+    osd_info.mut(lost.first).lost_at = lost.second;
 
   // xinfo
   for (const auto &xinfo : inc.new_xinfo)
-    osd_xinfo[xinfo.first] = xinfo.second;
+    osd_xinfo.mut(xinfo.first) = xinfo.second;
 
   // uuid
   for (const auto &uuid : inc.new_uuid)
-    (*osd_uuid)[uuid.first] = uuid.second;
+    cow(osd_uuid)[uuid.first] = uuid.second;
 
   // pg rebuild
   for (const auto &pg : inc.new_pg_temp) {
     if (pg.second.empty())
-      pg_temp->erase(pg.first);
+      cow(pg_temp).erase(pg.first);
     else
-      pg_temp->set(pg.first, pg.second);
+      cow(pg_temp).set(pg.first, pg.second);
   }
   if (!inc.new_pg_temp.empty()) {
     // make sure pg_temp is efficiently stored
-    pg_temp->rebuild();
+    cow(pg_temp).rebuild();
   }
 
   for (const auto &pg : inc.new_primary_temp) {
     if (pg.second == -1)
-      primary_temp->erase(pg.first);
+      cow(primary_temp).erase(pg.first);
     else
-      (*primary_temp)[pg.first] = pg.second;
+      cow(primary_temp)[pg.first] = pg.second;
   }
 
   for (auto& p : inc.new_pg_upmap) {
-    pg_upmap[p.first] = p.second;
+    cow(pg_upmap)[p.first] = p.second;
   }
   for (auto& pg : inc.old_pg_upmap) {
-    pg_upmap.erase(pg);
+    cow(pg_upmap).erase(pg);
   }
   for (auto& p : inc.new_pg_upmap_items) {
-    pg_upmap_items[p.first] = p.second;
+    cow(pg_upmap_items)[p.first] = p.second;
   }
   for (auto& pg : inc.old_pg_upmap_items) {
-    pg_upmap_items.erase(pg);
+    cow(pg_upmap_items).erase(pg);
   }
 
   for (auto& [pg, prim] : inc.new_pg_upmap_primary) {
-    pg_upmap_primaries[pg] = prim;
+    cow(pg_upmap_primaries)[pg] = prim;
   }
   for (auto& pg : inc.old_pg_upmap_primary) {
-    pg_upmap_primaries.erase(pg);
+    cow(pg_upmap_primaries).erase(pg);
   }
 
   // blocklist
@@ -2690,8 +2711,8 @@ int OSDMap::_pick_primary(const vector<int>& osds) const
 void OSDMap::_apply_upmap(const pg_pool_t& pi, pg_t raw_pg, vector<int> *raw) const
 {
   pg_t pg = pi.raw_pg_to_pg(raw_pg);
-  auto p = pg_upmap.find(pg);
-  if (p != pg_upmap.end()) {
+  auto p = pg_upmap->find(pg);
+  if (p != pg_upmap->end()) {
     // make sure targets aren't marked out
     for (auto osd : p->second) {
       if (osd != CRUSH_ITEM_NONE && osd < max_osd && osd >= 0 &&
@@ -2704,8 +2725,8 @@ void OSDMap::_apply_upmap(const pg_pool_t& pi, pg_t raw_pg, vector<int> *raw) co
     // continue to check and apply pg_upmap_items if any
   }
 
-  auto q = pg_upmap_items.find(pg);
-  if (q != pg_upmap_items.end()) {
+  auto q = pg_upmap_items->find(pg);
+  if (q != pg_upmap_items->end()) {
     // NOTE: this approach does not allow a bidirectional swap,
     // e.g., [[1,2],[2,1]] applied to [0,1,2] -> [0,2,1].
     for (auto& [osd_from, osd_to] : q->second) {
@@ -2732,8 +2753,8 @@ void OSDMap::_apply_upmap(const pg_pool_t& pi, pg_t raw_pg, vector<int> *raw) co
       }
     }
   }
-  auto r = pg_upmap_primaries.find(pg);
-  if (r != pg_upmap_primaries.end()) {
+  auto r = pg_upmap_primaries->find(pg);
+  if (r != pg_upmap_primaries->end()) {
     auto new_prim = r->second;	
     // Apply mapping only if new primary is not marked out and valid osd id
     if (new_prim != CRUSH_ITEM_NONE && new_prim < max_osd && new_prim >= 0 &&
@@ -2960,6 +2981,51 @@ void OSDMap::_pg_to_up_acting_osds(
     *acting_primary = _acting_primary;
 }
 
+void OSDMap::pg_range_to_up_acting_osds(
+  int64_t poolid, unsigned begin, unsigned end,
+  const std::function<void(pg_t, vector<int>&, int, vector<int>&, int)>& f) const
+{
+  const pg_pool_t *pool = get_pg_pool(poolid);
+  ceph_assert(pool);
+  ceph_assert(begin <= end && end <= pool->get_pg_num());
+  if (begin == end) {
+    return;
+  }
+  unsigned size = pool->get_size();
+  vector<int> ppss(end - begin);
+  for (unsigned ps = begin; ps < end; ++ps) {
+    ppss[ps - begin] = pool->raw_pg_to_pps(pg_t(ps, poolid));
+  }
+  vector<int> raws, raw_lens(end - begin, 0);
+  int ruleno = pool->get_crush_rule();
+  if (ruleno >= 0) {
+    crush->do_rule_batch(ruleno, ppss, size, osd_weight, poolid,
+			 &raws, &raw_lens);
+  }
+
+  // the same as _pg_to_up_acting_osds from here on
+  vector<int> raw, up, acting;
+  for (unsigned ps = begin; ps < end; ++ps) {
+    pg_t pg(ps, poolid);
+    unsigned i = ps - begin;
+    raw.assign(raws.begin() + i * size, raws.begin() + i * size + raw_lens[i]);
+    _remove_nonexistent_osds(*pool, raw);
+    _apply_upmap(*pool, pg, &raw);
+    _raw_to_up_osds(*pool, raw, &up);
+    int up_primary = _pick_primary(up);
+    _apply_primary_affinity(ppss[i], *pool, &up, &up_primary);
+    int acting_primary;
+    _get_temp_osds(*pool, pg, &acting, &acting_primary);
+    if (acting.empty()) {
+      acting = up;
+      if (acting_primary == -1) {
+	acting_primary = up_primary;
+      }
+    }
+    f(pg, up, up_primary, acting, acting_primary);
+  }
+}
+
 int OSDMap::calc_pg_role_broken(int osd, const vector<int>& acting, int nrep)
 {
   // This implementation is broken for EC PGs since the osd may appear
@@ -3250,11 +3316,11 @@ void OSDMap::encode(ceph::buffer::list& bl, uint64_t features) const
     encode(erasure_code_profiles, bl);
 
     if (v >= 4) {
-      encode(pg_upmap, bl);
-      encode(pg_upmap_items, bl);
+      encode(*pg_upmap, bl);
+      encode(*pg_upmap_items, bl);
     } else {
-      ceph_assert(pg_upmap.empty());
-      ceph_assert(pg_upmap_items.empty());
+      ceph_assert(pg_upmap->empty());
+      ceph_assert(pg_upmap_items->empty());
     }
     if (v >= 6) {
       encode(crush_version, bl);
@@ -3268,9 +3334,9 @@ void OSDMap::encode(ceph::buffer::list& bl, uint64_t features) const
       encode(last_in_change, bl);
     }
     if (v >= 10) {
-      encode(pg_upmap_primaries, bl);
+      encode(*pg_upmap_primaries, bl);
     } else {
-      ceph_assert(pg_upmap_primaries.empty());
+      ceph_assert(pg_upmap_primaries->empty());
     }
     ENCODE_FINISH(bl); // client-usable data
   }
@@ -3390,6 +3456,28 @@ void OSDMap::decode(ceph::buffer::list& bl)
   decode(p);
 }
 
+void OSDMap::unshare_for_decode()
+{
+  // the decoders fill these in place: let the epochs we share them
+  // with keep theirs
+  if (osd_addrs.use_count() > 1)
+    osd_addrs = std::make_shared<addrs_s>();
+  if (osd_uuid.use_count() > 1)
+    osd_uuid = std::make_shared<mempool::osdmap::vector<uuid_d>>();
+  if (pg_temp.use_count() > 1)
+    pg_temp = std::make_shared<PGTempMap>();
+  if (primary_temp.use_count() > 1)
+    primary_temp = std::make_shared<mempool::osdmap::map<pg_t,int32_t>>();
+  if (pg_upmap.use_count() > 1)
+    pg_upmap = std::make_shared<pg_upmap_t>();
+  if (pg_upmap_items.use_count() > 1)
+    pg_upmap_items = std::make_shared<pg_upmap_items_t>();
+  if (pg_upmap_primaries.use_count() > 1)
+    pg_upmap_primaries = std::make_shared<pg_upmap_primaries_t>();
+  if (crush.use_count() > 1)
+    crush = std::make_shared<CrushWrapper>();
+}
+
 void OSDMap::decode_classic(ceph::buffer::list::const_iterator& p)
 {
   using ceph::decode;
@@ -3514,6 +3602,8 @@ void OSDMap::decode_classic(ceph::buffer::list::const_iterator& p)
 void OSDMap::decode(ceph::buffer::list::const_iterator& bl)
 {
   using ceph::decode;
+  unshare_for_decode();
+
   /**
    * Older encodings of the OSDMap had a single struct_v which
    * covered the whole encoding, and was prior to our modern
@@ -3591,11 +3681,11 @@ void OSDMap::decode(ceph::buffer::list::const_iterator& bl)
     // version increased from 3 to 4 still in luminous, so same as above
     // applies.
     if (struct_v >= 4) {
-      decode(pg_upmap, bl);
-      decode(pg_upmap_items, bl);
+      decode(*pg_upmap, bl);
+      decode(*pg_upmap_items, bl);
     } else {
-      pg_upmap.clear();
-      pg_upmap_items.clear();
+      pg_upmap->clear();
+      pg_upmap_items->clear();
     }
     // again, version increased from 5 to 6 still in luminous, so above
     // applies.
@@ -3613,9 +3703,9 @@ void OSDMap::decode(ceph::buffer::list::const_iterator& bl)
       decode(last_in_change, bl);
     }
     if (struct_v >= 10) {
-      decode(pg_upmap_primaries, bl);
+      decode(*pg_upmap_primaries, bl);
     } else {
-      pg_upmap_primaries.clear();
+      pg_upmap_primaries->clear();
     }
     DECODE_FINISH(bl); // client-usable data
   }
@@ -3925,7 +4015,7 @@ void OSDMap::dump(Formatter *f, CephContext *cct) const
   f->close_section();
 
   f->open_array_section("pg_upmap");
-  for (auto& p : pg_upmap) {
+  for (auto& p : *pg_upmap) {
     f->open_object_section("mapping");
     f->dump_stream("pgid") << p.first;
     f->open_array_section("osds");
@@ -3938,7 +4028,7 @@ void OSDMap::dump(Formatter *f, CephContext *cct) const
   f->close_section();
 
   f->open_array_section("pg_upmap_items");
-  for (auto& [pgid, mappings] : pg_upmap_items) {
+  for (auto& [pgid, mappings] : *pg_upmap_items) {
     f->open_object_section("mapping");
     f->dump_stream("pgid") << pgid;
     f->open_array_section("mappings");
@@ -3954,7 +4044,7 @@ void OSDMap::dump(Formatter *f, CephContext *cct) const
   f->close_section();
 
   f->open_array_section("pg_upmap_primaries");
-  for (const auto& [pg, osd] : pg_upmap_primaries) {
+  for (const auto& [pg, osd] : *pg_upmap_primaries) {
     f->open_object_section("primary_mapping");
     f->dump_stream("pgid") << pg;
     f->dump_int("primary_osd", osd);
@@ -4257,14 +4347,14 @@ void OSDMap::print(CephContext *cct, ostream& out) const
   print_osds(out);
   out << std::endl;
 
-  for (auto& p : pg_upmap) {
+  for (auto& p : *pg_upmap) {
     out << "pg_upmap " << p.first << " " << p.second << "\n";
   }
-  for (auto& p : pg_upmap_items) {
+  for (auto& p : *pg_upmap_items) {
     out << "pg_upmap_items " << p.first << " " << p.second << "\n";
   }
 
-  for (auto& [pg, osd] : pg_upmap_primaries) {
+  for (auto& [pg, osd] : *pg_upmap_primaries) {
     out << "pg_upmap_primary " << pg << " " << osd << "\n";
   }
 
@@ -5100,7 +5190,7 @@ int OSDMap::balance_primaries(
 	prim_dist_scores[up_primary] -= 1;
 
 	// Update the mappings
-	tmp_osd_map.pg_upmap_primaries[pg] = curr_best_osd;
+	cow(tmp_osd_map.pg_upmap_primaries)[pg] = curr_best_osd;
 	if (curr_best_osd == orig_prims[pg]) {
           pending_inc->new_pg_upmap_primary.erase(pg);
           prim_pgs_to_check[pg] = false;
@@ -5344,8 +5434,8 @@ int OSDMap::calc_pg_upmaps(
 
       // try upmap
       for (auto pg : pgs) {
-        auto temp_it = tmp_osd_map.pg_upmap.find(pg);
-        if (temp_it != tmp_osd_map.pg_upmap.end()) {
+        auto temp_it = tmp_osd_map.pg_upmap->find(pg);
+        if (temp_it != tmp_osd_map.pg_upmap->end()) {
           // leave pg_upmap alone
           // it must be specified by admin since balancer does not
           // support pg_upmap yet
@@ -5357,8 +5447,8 @@ int OSDMap::calc_pg_upmaps(
         auto pg_pool_size = tmp_osd_map.get_pg_pool_size(pg);
         mempool::osdmap::vector<pair<int32_t,int32_t>> new_upmap_items;
         set<int> existing;
-        auto it = tmp_osd_map.pg_upmap_items.find(pg);
-        if (it != tmp_osd_map.pg_upmap_items.end()) {
+        auto it = tmp_osd_map.pg_upmap_items->find(pg);
+        if (it != tmp_osd_map.pg_upmap_items->end()) {
 	  auto& um_items = it->second;
           if (um_items.size() >= (size_t)pg_pool_size) {
             ldout(cct, 10) << " " << pg << " already has full-size pg_upmap_items "
@@ -5535,12 +5625,10 @@ map<uint64_t,set<pg_t>> OSDMap::get_pgs_by_osd(
 
   // build array of pgs from the pool
   map<uint64_t,set<pg_t>> pgs_by_osd;
-  for (unsigned ps = 0; ps < pool->get_pg_num(); ++ps) {
-    pg_t pg(ps, pid);
-    vector<int> up;
-    int primary;
-    int acting_prim;
-    tmp_osd_map.pg_to_up_acting_osds(pg, &up, &primary, nullptr, &acting_prim);
+  tmp_osd_map.pg_range_to_up_acting_osds(
+    pid, 0, pool->get_pg_num(),
+    [&](pg_t pg, vector<int>& up, int primary,
+	vector<int>& acting, int acting_prim) {
     if (cct != nullptr)
       ldout(cct, 20) << __func__ << " " << pg
                      << " up " << up
@@ -5563,7 +5651,7 @@ map<uint64_t,set<pg_t>> OSDMap::get_pgs_by_osd(
 	  (*p_acting_primaries_by_osd)[acting_prim].insert(pg);
       }
     }
-  }
+  });
   return pgs_by_osd;
 }
 
@@ -5609,16 +5697,15 @@ float OSDMap::build_pool_pgs_info (
   for (auto& [pid, pdata] : pools) {
     if (!only_pools.empty() && !only_pools.count(pid))
       continue;
-    for (unsigned ps = 0; ps < pdata.get_pg_num(); ++ps) {
-      pg_t pg(ps, pid);
-      vector<int> up;
-      tmp_osd_map.pg_to_up_acting_osds(pg, &up, nullptr, nullptr, nullptr);
+    tmp_osd_map.pg_range_to_up_acting_osds(
+      pid, 0, pdata.get_pg_num(),
+      [&](pg_t pg, vector<int>& up, int, vector<int>&, int) {
       ldout(cct, 20) << __func__ << " " << pg << " up " << up << dendl;
       for (auto osd : up) {
         if (osd != CRUSH_ITEM_NONE)
 	  pgs_by_osd[osd].insert(pg);
       }
-    }
+    });
     total_pgs += pdata.get_size() * pdata.get_pg_num();
 
     osds_weight_total = get_osds_weight(cct, tmp_osd_map, pid, osds_weight);
@@ -5733,8 +5820,8 @@ int OSDMap::pack_upmap_results(
   int num_changed = 0;
   for (auto& i : to_unmap) {
     ldout(cct, 10) << " unmap pg " << i << dendl;
-    ceph_assert(tmp_osd_map.pg_upmap_items.count(i));
-    tmp_osd_map.pg_upmap_items.erase(i);
+    ceph_assert(tmp_osd_map.pg_upmap_items->count(i));
+    cow(tmp_osd_map.pg_upmap_items).erase(i);
     pending_inc->old_pg_upmap_items.insert(i);
     ++num_changed;
   }
@@ -5742,7 +5829,7 @@ int OSDMap::pack_upmap_results(
     ldout(cct, 10) << " upmap pg " << pg
                    << " new pg_upmap_items " << um_items
                    << dendl;
-    tmp_osd_map.pg_upmap_items[pg] = um_items;
+    cow(tmp_osd_map.pg_upmap_items)[pg] = um_items;
     pending_inc->new_pg_upmap_items[pg] = um_items;
     ++num_changed;
   }
@@ -5791,8 +5878,8 @@ bool OSDMap::try_drop_remap_overfull(
   // if it found an item that can be dropped, false if not. 
   //
   for (auto pg : pgs) {
-    auto p = tmp_osd_map.pg_upmap_items.find(pg);
-    if (p == tmp_osd_map.pg_upmap_items.end())
+    auto p = tmp_osd_map.pg_upmap_items->find(pg);
+    if (p == tmp_osd_map.pg_upmap_items->end())
       continue;
     mempool::osdmap::vector<pair<int32_t,int32_t>> new_upmap_items;
     auto& pg_upmap_items = p->second;
@@ -5963,8 +6050,8 @@ OSDMap::candidates_t OSDMap::build_candidates(
   // build the candidates data structure
   //
   candidates_t candidates;
-  candidates.reserve(tmp_osd_map.pg_upmap_items.size());
-  for (auto& [pg, um_pair] : tmp_osd_map.pg_upmap_items) {
+  candidates.reserve(tmp_osd_map.pg_upmap_items->size());
+  for (auto& [pg, um_pair] : *tmp_osd_map.pg_upmap_items) {
     if (to_skip.count(pg))
       continue;
     if (!only_pools.empty() && !only_pools.count(pg.pool()))
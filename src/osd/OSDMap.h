@@ -35,6 +35,7 @@
 #include "include/common_fwd.h"
 #include "include/types.h"
 #include "common/ceph_releases.h"
+#include "common/shared_chunk_vector.h"
 #include "osd_types.h"
 
 //#include "include/ceph_features.h"
@@ -577,15 +578,18 @@ private:
   entity_addrvec_t _blank_addrvec;
 
   mempool::osdmap::vector<__u32>   osd_weight;   // 16.16 fixed point, 0x10000 = "in", 0 = "out"
-  mempool::osdmap::vector<osd_info_t> osd_info;
+  ceph::shared_chunk_vector<osd_info_t, mempool::osdmap::vector> osd_info;
   std::shared_ptr<PGTempMap> pg_temp;  // temp pg mapping (e.g. while we rebuild)
   std::shared_ptr< mempool::osdmap::map<pg_t,int32_t > > primary_temp;  // temp primary mapping (e.g. while we rebuild)
   std::shared_ptr< mempool::osdmap::vector<__u32> > osd_primary_affinity; ///< 16.16 fixed point, 0x10000 = baseline
 
   // remap (post-CRUSH, pre-up)
-  mempool::osdmap::map<pg_t,mempool::osdmap::vector<int32_t>> pg_upmap; ///< remap pg
-  mempool::osdmap::map<pg_t,mempool::osdmap::vector<std::pair<int32_t,int32_t>>> pg_upmap_items; ///< remap osds in up set
-  mempool::osdmap::map<pg_t, int32_t> pg_upmap_primaries; ///< remap primary of a pg
+  using pg_upmap_t = mempool::osdmap::map<pg_t,mempool::osdmap::vector<int32_t>>;
+  using pg_upmap_items_t = mempool::osdmap::map<pg_t,mempool::osdmap::vector<std::pair<int32_t,int32_t>>>;
+  using pg_upmap_primaries_t = mempool::osdmap::map<pg_t, int32_t>;
+  std::shared_ptr<pg_upmap_t> pg_upmap; ///< remap pg
+  std::shared_ptr<pg_upmap_items_t> pg_upmap_items; ///< remap osds in up set
+  std::shared_ptr<pg_upmap_primaries_t> pg_upmap_primaries; ///< remap primary of a pg
 
   mempool::osdmap::map<int64_t,pg_pool_t> pools;
   mempool::osdmap::map<int64_t,std::string> pool_name;
@@ -593,7 +597,7 @@ private:
   mempool::osdmap::map<std::string,int64_t, std::less<>> name_pool;
 
   std::shared_ptr< mempool::osdmap::vector<uuid_d> > osd_uuid;
-  mempool::osdmap::vector<osd_xinfo_t> osd_xinfo;
+  ceph::shared_chunk_vector<osd_xinfo_t, mempool::osdmap::vector> osd_xinfo;
 
   class range_bits {
     struct ip6 {
@@ -677,6 +681,9 @@ private:
 	     osd_addrs(std::make_shared<addrs_s>()),
 	     pg_temp(std::make_shared<PGTempMap>()),
 	     primary_temp(std::make_shared<mempool::osdmap::map<pg_t,int32_t>>()),
+	     pg_upmap(std::make_shared<pg_upmap_t>()),
+	     pg_upmap_items(std::make_shared<pg_upmap_items_t>()),
+	     pg_upmap_primaries(std::make_shared<pg_upmap_primaries_t>()),
 	     osd_uuid(std::make_shared<mempool::osdmap::vector<uuid_d>>()),
 	     cluster_snapshot_epoch(0),
 	     new_blocklist_entries(false),
@@ -690,6 +697,17 @@ private:
 private:
   OSDMap(const OSDMap& other) = default;
   OSDMap& operator=(const OSDMap& other) = default;
+
+  /// p, for writing: copied first if another epoch shares it
+  template <typename T>
+  static T& cow(std::shared_ptr<T>& p) {
+    if (p.use_count() > 1) {
+      p = std::make_shared<T>(*p);
+    }
+    return *p;
+  }
+  /// give the shared structures we are about to overwrite back to their owners
+  void unshare_for_decode();
 public:
 
   /// return feature mask subset that is relevant to OSDMap encoding
@@ -699,20 +717,19 @@ public:
 
   uint64_t get_encoding_features() const;
 
+  /**
+   * copy o, for apply_incremental or other changes
+   *
+   * The address, uuid, primary affinity, pg_temp and upmap structures
+   * and the chunks of osd_info and osd_xinfo stay shared with o: the
+   * methods changing them copy them first (see cow()), so successive
+   * epochs only pay for what their incremental changed.
+   *
+   * NOTE: we do not copy crush.  note that apply_incremental will
+   * allocate a new CrushWrapper, though.
+   */
   void deepish_copy_from(const OSDMap& o) {
     *this = o;
-    primary_temp.reset(new mempool::osdmap::map<pg_t,int32_t>(*o.primary_temp));
-    pg_temp.reset(new PGTempMap(*o.pg_temp));
-    osd_uuid.reset(new mempool::osdmap::vector<uuid_d>(*o.osd_uuid));
-
-    if (o.osd_primary_affinity)
-      osd_primary_affinity.reset(new mempool::osdmap::vector<__u32>(*o.osd_primary_affinity));
-
-    // NOTE: this still references shared entity_addrvec_t's.
-    osd_addrs.reset(new addrs_s(*o.osd_addrs));
-
-    // NOTE: we do not copy crush.  note that apply_incremental will
-    // allocate a new CrushWrapper, though.
   }
 
   // map info
@@ -833,7 +850,7 @@ public:
       osd_primary_affinity.reset(
 	new mempool::osdmap::vector<__u32>(
 	  max_osd, CEPH_OSD_DEFAULT_PRIMARY_AFFINITY));
-    (*osd_primary_affinity)[o] = w;
+    cow(osd_primary_affinity)[o] = w;
   }
   unsigned get_primary_affinity(int o) const {
     ceph_assert(o < max_osd);
@@ -1293,6 +1310,15 @@ public:
     int up_primary, acting_primary;
     pg_to_up_acting_osds(pg, &up, &up_primary, &acting, &acting_primary);
   }
+  /**
+   * map the pgs [begin, end) of a pool like pg_to_up_acting_osds(), but
+   * running CRUSH for all of them in one batch, and call
+   * f(pgid, up, up_primary, acting, acting_primary) for each of them.
+   */
+  void pg_range_to_up_acting_osds(
+    int64_t pool, unsigned begin, unsigned end,
+    const std::function<void(pg_t, std::vector<int>&, int,
+			     std::vector<int>&, int)>& f) const;
   bool pg_is_ec(pg_t pg) const {
     auto i = pools.find(pg.pool());
     ceph_assert(i != pools.end());
@@ -1661,8 +1687,8 @@ public:
   int get_osds_by_bucket_name(const std::string &name, std::set<int> *osds) const;
 
   bool have_pg_upmaps(pg_t pg) const {
-    return pg_upmap.count(pg) ||
-      pg_upmap_items.count(pg);
+    return pg_upmap->count(pg) ||
+      pg_upmap_items->count(pg);
   }
 
   bool check_full(const std::set<pg_shard_t> &missing_on) const {
@@ -1718,8 +1744,8 @@ public:
   int validate_crush_rules(CrushWrapper *crush, std::ostream *ss) const;
 
   void clear_temp() {
-    pg_temp->clear();
-    primary_temp->clear();
+    cow(pg_temp).clear();
+    cow(primary_temp).clear();
   }
 
 private:
@@ -27,6 +27,8 @@
 #include "PGTransaction.h"
 #include "common/ostream_temp.h"
 
+class ECPeerLatency;
+
 namespace Scrub {
   class Store;
 }
@@ -263,6 +265,12 @@ typedef std::shared_ptr<const OSDMap> OSDMapRef;
        GenContext<ThreadPool::TPHandle&> *c,
        uint64_t cost) = 0;
 
+     /// run c on the backend under the pg lock once delay has passed,
+     /// ahead of recovery, unless the pg was reset in the meantime
+     virtual void schedule_delayed_work(
+       GenContextURef<PGBackend*> c,
+       ceph::timespan delay) = 0;
+
      virtual pg_shard_t whoami_shard() const = 0;
      int whoami() const {
        return whoami_shard().osd;
@@ -290,6 +298,7 @@ typedef std::shared_ptr<const OSDMap> OSDMapRef;
      virtual entity_name_t get_cluster_msgr_name() = 0;
 
      virtual PerfCounters *get_logger() = 0;
+     virtual ECPeerLatency &get_ec_peer_latency() = 0;
 
      virtual ceph_tid_t get_tid() = 0;
 
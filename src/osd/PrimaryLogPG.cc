@@ -396,6 +396,7 @@ void PrimaryLogPG::on_local_recover(
 {
   dout(10) << __func__ << ": " << hoid << dendl;
 
+  read_coalescer.invalidate(hoid);
   ObjectRecoveryInfo recovery_info(_recovery_info);
   clear_object_snap_mapping(t, hoid);
   if (!is_delete && recovery_info.soid.is_snap()) {
@@ -531,6 +532,29 @@ void PrimaryLogPG::schedule_recovery_work(
     recovery_state.get_recovery_op_priority());
 }
 
+void PrimaryLogPG::schedule_delayed_work(
+  GenContextURef<PGBackend*> c,
+  ceph::timespan delay)
+{
+  PrimaryLogPGRef pg(this);
+  epoch_t e = get_osdmap_epoch();
+  osd->mono_timer.add_event(
+    delay,
+    [pg, e, c=std::move(c)]() mutable {
+      // not under the pg lock: the queued context checks for a reset
+      pg->osd->queue_recovery_context(
+	pg.get(),
+	make_gen_lambda_context<ThreadPool::TPHandle&>(
+	  [pg, e, c=std::move(c)](ThreadPool::TPHandle &) mutable {
+	    if (!pg->pg_has_reset_since(e)) {
+	      c.release()->complete(pg->pgbackend.get());
+	    }
+	  }).release(),
+	1,
+	CEPH_MSG_PRIO_HIGH);
+    });
+}
+
 void PrimaryLogPG::replica_clear_repop_obc(
   const vector<pg_log_entry_t> &logv,
   ObjectStore::Transaction &t)
@@ -1619,6 +1643,191 @@ void PrimaryLogPG::do_pg_op(OpRequestRef op)
   osd->send_message_osd_client(reply, m->get_connection());
 }
 
+/**
+ * The connection the ops of each object of a batch op come from: it
+ * gathers their replies, and sends the client the batch op's once they
+ * are all in.  Anything else sent to them (maps) is passed on to the
+ * client's connection.
+ */
+class BatchConnection : public Connection {
+  ceph::mutex lock = ceph::make_mutex("BatchConnection::lock");
+  OpRequestRef op;
+  ConnectionRef con;
+  std::vector<osd_batch_result_t> results;
+  std::vector<bool> done;
+  unsigned pending;
+  epoch_t epoch = 0;
+
+public:
+  void finish(unsigned i, osd_batch_result_t&& r, epoch_t e) {
+    std::lock_guard l{lock};
+    if (i >= results.size() || done[i]) {
+      return;
+    }
+    results[i] = std::move(r);
+    done[i] = true;
+    epoch = std::max(epoch, e);
+    if (--pending > 0) {
+      return;
+    }
+    auto m = op->get_req<MOSDOp>();
+    MOSDOpReply *reply = new MOSDOpReply(
+      m, 0, epoch, CEPH_OSD_FLAG_ACK | CEPH_OSD_FLAG_ONDISK, false);
+    vector<OSDOp> out(1);
+    encode(results, out[0].outdata);
+    reply->claim_op_out_data(out);
+    op->mark_commit_sent();
+    con->send_message(reply);
+    op.reset();
+  }
+
+  int send_message(Message *m) override {
+    if (m->get_type() != CEPH_MSG_OSD_OPREPLY) {
+      return con->send_message(m);
+    }
+    auto reply = static_cast<MOSDOpReply*>(m);
+    osd_batch_result_t r;
+    r.result = reply->get_result();
+    r.version = reply->get_replay_version();
+    r.user_version = reply->get_user_version();
+    reply->claim_ops(r.ops);
+    finish(reply->get_tid() % osd_batch_op_t::MAX_OBJECTS, std::move(r),
+	   reply->get_map_epoch());
+    m->put();
+    return 0;
+  }
+  void send_keepalive() override {
+    // silently ignore
+  }
+  void mark_down() override {
+    // silently ignore
+  }
+  void mark_disposable() override {
+    // silently ignore
+  }
+  bool is_connected() override {
+    return con->is_connected();
+  }
+  entity_addr_t get_peer_socket_addr() const override {
+    return con->get_peer_socket_addr();
+  }
+
+private:
+  FRIEND_MAKE_REF(BatchConnection);
+  BatchConnection(CephContext *cct, OpRequestRef op, unsigned n)
+    : Connection(cct, nullptr),
+      op(op),
+      con(op->get_req()->get_connection()),
+      results(n),
+      done(n),
+      pending(n) {
+    set_priv(con->get_priv());
+    set_peer_type(con->get_peer_type());
+    set_peer_addrs(con->get_peer_addrs());
+    peer_name = con->peer_name;
+    peer_global_id = con->peer_global_id;
+    // backoffs are per session, and keyed by the ops' own message
+    set_features(con->get_features() & ~CEPH_FEATURE_RADOS_BACKOFF);
+  }
+};
+
+/** do_batch_op - execute the ops of each object of a batch op
+ *
+ * Each object's ops are executed by do_op() in a message of their own,
+ * one object after the other, and the transactions they queue meanwhile
+ * are submitted to the store at once.
+ */
+void PrimaryLogPG::do_batch_op(OpRequestRef& op)
+{
+  auto m = op->get_req<MOSDOp>();
+  dout(10) << __func__ << " " << *m << dendl;
+
+  if (!is_primary()) {
+    osd->handle_misdirected_op(this, op);
+    return;
+  }
+  if (pool.info.is_tier() || pool.info.has_tiers()) {
+    osd->reply_op_error(op, -EOPNOTSUPP);
+    return;
+  }
+  vector<osd_batch_op_t> batch;
+  try {
+    auto p = m->ops[0].indata.cbegin();
+    decode(batch, p);
+  } catch (ceph::buffer::error& e) {
+    osd->reply_op_error(op, -EINVAL);
+    return;
+  }
+  if (batch.empty() || batch.size() > osd_batch_op_t::MAX_OBJECTS) {
+    osd->reply_op_error(op, -EINVAL);
+    return;
+  }
+  for (auto& b : batch) {
+    for (auto& o : b.ops) {
+      // neither those of the pg, nor those tied to the client's connection
+      if (ceph_osd_op_type_pg(o.op.op) ||
+	  o.op.op == CEPH_OSD_OP_WATCH ||
+	  o.op.op == CEPH_OSD_OP_NOTIFY ||
+	  o.op.op == CEPH_OSD_OP_NOTIFY_ACK) {
+	dout(10) << __func__ << " " << o << " not supported" << dendl;
+	osd->reply_op_error(op, -EOPNOTSUPP);
+	return;
+      }
+    }
+  }
+
+  auto con = ceph::make_ref<BatchConnection>(cct, op, batch.size());
+  const string& nspace = m->get_hobj().nspace;
+  spg_t pgid = info.pgid;
+  const unsigned split_bits =
+    info.pgid.pgid.get_split_bits(pool.info.get_pg_num());
+  ceph_assert(!batch_tls);
+  batch_tls.emplace();
+  for (unsigned i = 0; i < batch.size(); ++i) {
+    auto& b = batch[i];
+    hobject_t soid(b.oid, b.key, m->get_snapid(),
+		   pool.info.hash_key(b.key.empty() ? b.oid.name : b.key,
+				      nspace),
+		   info.pgid.pool(), nspace);
+    if (!info.pgid.pgid.contains(split_bits, soid)) {
+      // pg_num changed since the client grouped them
+      dout(10) << __func__ << " " << soid << " not in " << info.pgid << dendl;
+      osd_batch_result_t r;
+      r.result = -EXDEV;
+      con->finish(i, std::move(r), get_osdmap_epoch());
+      continue;
+    }
+    MOSDOp *sm = new MOSDOp(m->get_client_inc(),
+			    osd_batch_op_t::get_tid(m->get_tid(), i),
+			    soid, pgid, m->get_map_epoch(),
+			    m->get_flags(), m->get_features());
+    sm->ops = std::move(b.ops);
+    sm->set_mtime(m->get_mtime());
+    sm->set_snap_seq(m->get_snap_seq());
+    sm->set_snaps(m->get_snaps());
+    if (m->get_retry_attempt() >= 0) {
+      sm->set_retry_attempt(m->get_retry_attempt());
+    }
+    sm->set_src(m->get_source());
+    sm->set_priority(m->get_priority());
+    sm->set_recv_stamp(m->get_recv_stamp());
+    sm->set_connection(con);
+    OpRequestRef sop = osd->osd->op_tracker.create_request<OpRequest, Message*>(
+      sm);
+    sop->sent_epoch = op->sent_epoch;
+    sop->min_epoch = op->min_epoch;
+    sop->mark_event("batch");
+    do_op(sop);
+  }
+  vector<ObjectStore::Transaction> tls = std::move(*batch_tls);
+  batch_tls.reset();
+  if (!tls.empty()) {
+    dout(20) << __func__ << " submitting " << tls.size() << " transactions"
+	     << dendl;
+    osd->store->queue_transactions(ch, tls, op, NULL);
+  }
+}
+
 int PrimaryLogPG::do_scrub_ls(const MOSDOp *m, OSDOp *osd_op)
 {
   if (m->get_pg() != info.pgid.pgid) {
@@ -2045,6 +2254,11 @@ void PrimaryLogPG::do_op(OpRequestRef& op)
     return;
   }
 
+  if (m->ops.size() == 1 && m->ops[0].op.op == CEPH_OSD_OP_BATCH) {
+    // each object's ops are checked on their own
+    return do_batch_op(op);
+  }
+
   if (!op_has_sufficient_caps(op)) {
     osd->reply_op_error(op, -EPERM);
     return;
@@ -5825,8 +6039,10 @@ int PrimaryLogPG::do_read(OpContext *ctx, OSDOp& osd_op) {
     ctx->op_finishers[ctx->current_osd_subop_num].reset(
       new ReadFinisher(osd_op));
   } else {
-    int r = pgbackend->objects_read_sync(
-      soid, op.extent.offset, op.extent.length, op.flags, &osd_op.outdata);
+    bool coalesced = false;
+    int r = do_read_sync(
+      ctx, op.extent.offset, op.extent.length, op.flags, &osd_op.outdata,
+      &coalesced);
     // whole object?  can we verify the checksum?
     if (r >= 0 && op.extent.offset == 0 &&
         (uint64_t)r == oi.size && oi.is_data_digest()) {
@@ -5840,11 +6056,17 @@ int PrimaryLogPG::do_read(OpContext *ctx, OSDOp& osd_op) {
       }
     }
     if (r == -EIO) {
+      read_coalescer.invalidate(soid);
       r = rep_repair_primary_object(soid, ctx);
     }
-    if (r >= 0)
+    if (r >= 0) {
       op.extent.length = r;
-    else if (r == -EAGAIN) {
+      if (!coalesced && read_coalescer.enabled() &&
+	  ctx->op && !ctx->op->may_write()) {
+	read_coalescer.insert(soid, oi.version, op.extent.offset,
+			      osd_op.outdata, ceph::mono_clock::now());
+      }
+    } else if (r == -EAGAIN) {
       result = -EAGAIN;
     } else {
       result = r;
@@ -5860,6 +6082,29 @@ int PrimaryLogPG::do_read(OpContext *ctx, OSDOp& osd_op) {
   return result;
 }
 
+int PrimaryLogPG::do_read_sync(OpContext *ctx, uint64_t off, uint64_t len,
+				uint32_t op_flags, bufferlist *bl,
+				bool *coalesced)
+{
+  const auto& oi = ctx->new_obs.oi;
+  // picks up config changes, see OSDService::update_read_coalesce_limits()
+  read_coalescer.set_limits(osd->read_coalesce_max_bytes,
+			    osd->read_coalesce_window);
+  // the ops which write may have changed the object already
+  if (read_coalescer.enabled() && ctx->op && !ctx->op->may_write() &&
+      read_coalescer.lookup(oi.soid, oi.version, off, len, bl,
+			    ceph::mono_clock::now())) {
+    dout(20) << __func__ << " " << oi.soid << " " << off << "~" << len
+	     << " coalesced" << dendl;
+    osd->logger->inc(l_osd_op_r_coalesced);
+    osd->logger->inc(l_osd_op_r_coalesced_bytes, len);
+    *coalesced = true;
+    return len;
+  }
+  *coalesced = false;
+  return pgbackend->objects_read_sync(oi.soid, off, len, op_flags, bl);
+}
+
 int PrimaryLogPG::do_sparse_read(OpContext *ctx, OSDOp& osd_op) {
   dout(20) << __func__ << dendl;
   auto& op = osd_op.op;
@@ -11618,8 +11863,8 @@ void PrimaryLogPG::submit_log_entries(
       };
       t.register_on_commit(
 	new OnComplete{this, rep_tid, get_osdmap_epoch()});
-      int r = osd->store->queue_transaction(ch, std::move(t), NULL);
-      ceph_assert(r == 0);
+      // along with those of the batch it is part of, if any
+      queue_transaction(std::move(t), OpRequestRef());
       op_applied(info.last_update);
     });
 
@@ -12880,6 +13125,7 @@ void PrimaryLogPG::clear_async_reads()
 void PrimaryLogPG::clear_cache()
 {
   object_contexts.clear();
+  read_coalescer.clear();
 }
 
 void PrimaryLogPG::on_shutdown()
@@ -12913,6 +13159,7 @@ void PrimaryLogPG::on_shutdown()
 
   context_registry_on_change();
   object_contexts.clear();
+  read_coalescer.clear();
 
   clear_async_reads();
 
@@ -13097,6 +13344,7 @@ void PrimaryLogPG::on_change(ObjectStore::Transaction &t)
   // NOTE: we actually assert that all currently live references are dead
   // by the time the flush for the next interval completes.
   object_contexts.clear();
+  read_coalescer.clear();
 
   // should have been cleared above by finishing all of the degraded objects
   ceph_assert(objects_blocked_on_degraded_snap.empty());
@@ -30,6 +30,7 @@
 #include "common/shared_cache.hpp"
 #include "ReplicatedBackend.h"
 #include "PGTransaction.h"
+#include "ReadCoalescer.h"
 #include "cls/cas/cls_cas_ops.h"
 
 class CopyFromCallback;
@@ -358,10 +359,18 @@ public:
   }
   void queue_transaction(ObjectStore::Transaction&& t,
 			 OpRequestRef op) override {
+    if (batch_tls) {
+      batch_tls->push_back(std::move(t));
+      return;
+    }
     osd->store->queue_transaction(ch, std::move(t), op);
   }
   void queue_transactions(std::vector<ObjectStore::Transaction>& tls,
 			  OpRequestRef op) override {
+    if (batch_tls) {
+      std::move(tls.begin(), tls.end(), std::back_inserter(*batch_tls));
+      return;
+    }
     osd->store->queue_transactions(ch, tls, op, NULL);
   }
   epoch_t get_interval_start_epoch() const override {
@@ -545,6 +554,9 @@ public:
   void schedule_recovery_work(
     GenContext<ThreadPool::TPHandle&> *c,
     uint64_t cost) override;
+  void schedule_delayed_work(
+    GenContextURef<PGBackend*> c,
+    ceph::timespan delay) override;
 
   pg_shard_t whoami_shard() const override {
     return pg_whoami;
@@ -583,6 +595,9 @@ public:
   }
 
   PerfCounters *get_logger() override;
+  ECPeerLatency &get_ec_peer_latency() override {
+    return osd->ec_peer_latency;
+  }
 
   ceph_tid_t get_tid() override { return osd->get_tid(); }
 
@@ -997,6 +1012,11 @@ protected:
 
   // projected object info
   SharedLRU<hobject_t, ObjectContext> object_contexts;
+  // data of recent client reads, for the identical ones which follow
+  ReadCoalescer read_coalescer;
+  // set while do_batch_op() executes the ops of a batch; the transactions
+  // they queue are submitted together once they are all executed
+  std::optional<std::vector<ObjectStore::Transaction>> batch_tls;
   // std::map from oid.snapdir() to SnapSetContext *
   std::map<hobject_t, SnapSetContext*> snapset_contexts;
   ceph::mutex snapset_contexts_lock =
@@ -1396,6 +1416,10 @@ protected:
   friend struct C_ExtentCmpRead;
 
   int do_read(OpContext *ctx, OSDOp& osd_op);
+  /// objects_read_sync(), served from read_coalescer when possible
+  int do_read_sync(OpContext *ctx, uint64_t off, uint64_t len,
+		   uint32_t op_flags, ceph::buffer::list *bl,
+		   bool *coalesced);
   int do_sparse_read(OpContext *ctx, OSDOp& osd_op);
   int do_writesame(OpContext *ctx, OSDOp& osd_op);
 
@@ -1498,6 +1522,7 @@ public:
 			  MOSDOpReply *orig_reply, int r,
 			  OpContext *ctx_for_op_returns=nullptr);
   void do_pg_op(OpRequestRef op);
+  void do_batch_op(OpRequestRef& op);
   void do_scan(
     OpRequestRef op,
     ThreadPool::TPHandle &handle);
@@ -0,0 +1,134 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "ReadCoalescer.h"
+
+void ReadCoalescer::set_limits(uint64_t b, ceph::timespan w)
+{
+  if (b == max_bytes && w == window) {
+    return;
+  }
+  max_bytes = b;
+  window = w;
+  trim();
+}
+
+bool ReadCoalescer::lookup(const hobject_t &oid, eversion_t v,
+			   uint64_t off, uint64_t len,
+			   ceph::buffer::list *bl,
+			   time_point now)
+{
+  auto p = objects.find(oid);
+  if (p == objects.end()) {
+    return false;
+  }
+  object_t &o = p->second;
+  if (o.version != v) {
+    // modified since
+    erase_object(p);
+    return false;
+  }
+  // the extent starting at or before off
+  auto e = o.extents.upper_bound(off);
+  if (e == o.extents.begin()) {
+    return false;
+  }
+  --e;
+  if (now - e->second.stamp > window) {
+    erase_extent(o, e);
+    if (o.extents.empty()) {
+      erase_object(p);
+    }
+    return false;
+  }
+  if (e->first + e->second.bl.length() < off + len) {
+    return false;
+  }
+  bl->substr_of(e->second.bl, off - e->first, len);
+  lru.splice(lru.begin(), lru, o.lru_pos);
+  return true;
+}
+
+void ReadCoalescer::insert(const hobject_t &oid, eversion_t v,
+			   uint64_t off, const ceph::buffer::list &bl,
+			   time_point now)
+{
+  if (!enabled() || bl.length() == 0 || bl.length() > max_bytes) {
+    return;
+  }
+  auto [p, inserted] = objects.try_emplace(oid);
+  object_t &o = p->second;
+  if (inserted) {
+    lru.push_front(oid);
+    o.lru_pos = lru.begin();
+  } else {
+    lru.splice(lru.begin(), lru, o.lru_pos);
+  }
+  if (o.version != v) {
+    while (!o.extents.empty()) {
+      erase_extent(o, o.extents.begin());
+    }
+    o.version = v;
+  }
+
+  // the extents the new one covers are of no use anymore
+  const uint64_t end = off + bl.length();
+  auto e = o.extents.lower_bound(off);
+  while (e != o.extents.end() && e->first + e->second.bl.length() <= end) {
+    erase_extent(o, e++);
+  }
+  e = o.extents.find(off);
+  if (e != o.extents.end()) {
+    // a longer one starts there; keep it, but for its stamp
+    e->second.stamp = now;
+  } else {
+    o.extents.emplace(off, extent_t{bl, now});
+    bytes += bl.length();
+  }
+  o.stamp = now;
+  trim(now);
+}
+
+void ReadCoalescer::invalidate(const hobject_t &oid)
+{
+  auto p = objects.find(oid);
+  if (p != objects.end()) {
+    erase_object(p);
+  }
+}
+
+void ReadCoalescer::clear()
+{
+  objects.clear();
+  lru.clear();
+  bytes = 0;
+}
+
+void ReadCoalescer::erase_extent(object_t &o,
+				 std::map<uint64_t, extent_t>::iterator p)
+{
+  bytes -= p->second.bl.length();
+  o.extents.erase(p);
+}
+
+void ReadCoalescer::erase_object(
+  std::unordered_map<hobject_t, object_t>::iterator p)
+{
+  for (auto &e : p->second.extents) {
+    bytes -= e.second.bl.length();
+  }
+  lru.erase(p->second.lru_pos);
+  objects.erase(p);
+}
+
+void ReadCoalescer::trim(std::optional<time_point> now)
+{
+  while (!lru.empty()) {
+    auto p = objects.find(lru.back());
+    if (bytes <= max_bytes &&
+	(!now || *now - p->second.stamp <= window)) {
+      break;
+    }
+    erase_object(p);
+  }
+}
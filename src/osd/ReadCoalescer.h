@@ -0,0 +1,82 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <optional>
+#include <unordered_map>
+
+#include "common/ceph_time.h"
+#include "common/hobject.h"
+#include "include/buffer.h"
+#include "osd/osd_types.h"
+
+/**
+ * ReadCoalescer
+ *
+ * The extents a PG just read for its clients, tagged with the version of
+ * the object they were read at.  Client reads are executed one after the
+ * other under the PG lock, so when many clients read the same hot object
+ * at once, each of them reads the same extents from the store.  Instead,
+ * the reads which follow the first one are given a reference to the
+ * buffers it read (which its reply still holds anyway), as long as the
+ * object is at the same version.
+ *
+ * Extents are dropped once they are older than the coalescing window,
+ * and the least recently read objects when the extents held use more
+ * than max_bytes.
+ */
+class ReadCoalescer {
+public:
+  using time_point = ceph::mono_clock::time_point;
+
+  void set_limits(uint64_t max_bytes, ceph::timespan window);
+  bool enabled() const {
+    return max_bytes > 0;
+  }
+
+  /// set *bl to off~len of oid at version v if an extent holds it
+  bool lookup(const hobject_t &oid, eversion_t v,
+	      uint64_t off, uint64_t len,
+	      ceph::buffer::list *bl,
+	      time_point now);
+  /// remember bl, read at off from oid at version v
+  void insert(const hobject_t &oid, eversion_t v,
+	      uint64_t off, const ceph::buffer::list &bl,
+	      time_point now);
+  void invalidate(const hobject_t &oid);
+  void clear();
+
+  uint64_t get_bytes() const {
+    return bytes;
+  }
+  size_t get_num_objects() const {
+    return objects.size();
+  }
+
+private:
+  struct extent_t {
+    ceph::buffer::list bl;
+    time_point stamp;
+  };
+  struct object_t {
+    eversion_t version;
+    std::map<uint64_t, extent_t> extents;   ///< by offset
+    time_point stamp;                        ///< of the newest extent
+    std::list<hobject_t>::iterator lru_pos;
+  };
+
+  uint64_t max_bytes = 0;
+  ceph::timespan window = ceph::timespan::zero();
+
+  std::unordered_map<hobject_t, object_t> objects;
+  std::list<hobject_t> lru;   ///< most recently read first
+  uint64_t bytes = 0;
+
+  void erase_extent(object_t &o, std::map<uint64_t, extent_t>::iterator p);
+  void erase_object(std::unordered_map<hobject_t, object_t>::iterator p);
+  /// drop the lru objects past max_bytes, and the expired ones
+  void trim(std::optional<time_point> now = std::nullopt);
+};
@@ -657,23 +657,27 @@ int ReplicatedBackend::be_deep_scrub(
 
     const uint64_t stride = cct->_conf->osd_deep_scrub_stride;
 
-    bufferlist bl;
-    r = store->read(
-      ch,
-      ghobject_t(
-	poid, ghobject_t::NO_GEN, get_parent()->whoami_shard().shard),
-      pos.data_pos,
-      stride, bl,
-      fadvise_flags);
+    const ghobject_t goid(
+      poid, ghobject_t::NO_GEN, get_parent()->whoami_shard().shard);
+    if (cct->_conf->osd_deep_scrub_store_digest) {
+      uint32_t crc = pos.data_hash.digest();
+      r = store->digest(ch, goid, pos.data_pos, stride, &crc, fadvise_flags);
+      if (r > 0) {
+	pos.data_hash = bufferhash(crc);
+      }
+    } else {
+      bufferlist bl;
+      r = store->read(ch, goid, pos.data_pos, stride, bl, fadvise_flags);
+      if (r > 0) {
+	pos.data_hash << bl;
+      }
+    }
     if (r < 0) {
       dout(20) << __func__ << "  " << poid << " got "
 	       << r << " on read, read_error" << dendl;
       o.read_error = true;
       return 0;
     }
-    if (r > 0) {
-      pos.data_hash << bl;
-    }
     pos.data_pos += r;
     if (static_cast<uint64_t>(r) == stride) {
       dout(20) << __func__ << "  " << poid << " more data, digest so far 0x"
@@ -263,6 +263,25 @@ int OpInfo::set_from_op(
       set_promote();
       break;
 
+    case CEPH_OSD_OP_BATCH:
+      {
+	// it reads and writes whatever the ops of its objects do
+	vector<osd_batch_op_t> batch;
+	try {
+	  auto bp = iter->indata.cbegin();
+	  decode(batch, bp);
+	} catch (ceph::buffer::error&) {
+	  return -EINVAL;
+	}
+	for (auto& b : batch) {
+	  int r = set_from_op(b.ops, pg, osdmap);
+	  if (r < 0) {
+	    return r;
+	  }
+	}
+	break;
+      }
+
     default:
       break;
     }
@@ -3,6 +3,8 @@
 
 #include "osd_perf_counters.h"
 #include "include/common_fwd.h"
+#include "common/ceph_context.h"
+#include "common/perf_counters_collection.h"
 
 
 PerfCounters *build_osd_logger(CephContext *cct) {
@@ -319,6 +321,25 @@ PerfCounters *build_osd_logger(CephContext *cct) {
   osd_plb.add_u64_counter(
     l_osd_pg_biginfo, "osd_pg_biginfo", "PG updated its biginfo attr");
 
+  osd_plb.add_u64_counter(
+    l_osd_ec_read_hedge, "ec_read_hedge",
+    "EC sub reads sent because another one was late");
+  osd_plb.add_u64_counter(
+    l_osd_ec_read_hedge_win, "ec_read_hedge_win",
+    "EC reads completed thanks to a hedged sub read");
+
+  osd_plb.add_u64_counter(
+    l_osd_op_wq_steal, "op_wq_steal",
+    "Op queue items processed by a thread of another shard");
+
+  osd_plb.add_u64_counter(
+    l_osd_op_r_coalesced, "op_r_coalesced",
+    "Client reads served from the data of a previous identical read");
+  osd_plb.add_u64_counter(
+    l_osd_op_r_coalesced_bytes, "op_r_coalesced_bytes",
+    "Client read bytes served from the data of a previous identical read",
+    NULL, 0, unit_t(UNIT_BYTES));
+
   return osd_plb.create_perf_counters();
 }
  
@@ -360,3 +381,24 @@ PerfCounters *build_recoverystate_perf(CephContext *cct) {
 
   return rs_perf.create_perf_counters();
 }
+
+const std::string osd_ec_peer_counters_key = "osd_ec_peer";
+
+std::shared_ptr<PerfCounters> build_ec_peer_perf(const std::string &key,
+						 CephContext *cct) {
+  PerfCountersBuilder ec_perf(cct, key, l_osd_ec_peer_first,
+			      l_osd_ec_peer_last);
+
+  ec_perf.add_time_avg(l_osd_ec_peer_sub_read_lat, "sub_read_lat",
+		       "EC sub read latency");
+  ec_perf.add_u64(l_osd_ec_peer_sub_read_ewma, "sub_read_ewma_usec",
+		  "Moving average of the EC sub read latency (usec)");
+  ec_perf.add_u64_counter(l_osd_ec_peer_hedge, "hedge",
+			  "Hedged EC sub reads sent to this peer");
+  ec_perf.add_u64_counter(l_osd_ec_peer_hedge_win, "hedge_win",
+			  "Hedged EC sub reads to this peer that completed a read");
+
+  std::shared_ptr<PerfCounters> counters(ec_perf.create_perf_counters());
+  cct->get_perfcounters_collection()->add(counters.get());
+  return counters;
+}
@@ -3,6 +3,9 @@
 
 #pragma once
 
+#include <memory>
+#include <string>
+
 #include "include/common_fwd.h"
 #include "common/perf_counters.h"
 
@@ -131,6 +134,14 @@ enum {
   l_osd_pg_fastinfo,
   l_osd_pg_biginfo,
 
+  l_osd_ec_read_hedge,
+  l_osd_ec_read_hedge_win,
+
+  l_osd_op_wq_steal,
+
+  l_osd_op_r_coalesced,
+  l_osd_op_r_coalesced_bytes,
+
   l_osd_last,
 };
 
@@ -174,3 +185,18 @@ enum {
 };
 
 PerfCounters *build_recoverystate_perf(CephContext *cct);
+
+// EC sub read counters, one instance per peer OSD labeled with "peer"
+enum {
+  l_osd_ec_peer_first = 30000,
+  l_osd_ec_peer_sub_read_lat,
+  l_osd_ec_peer_sub_read_ewma,
+  l_osd_ec_peer_hedge,
+  l_osd_ec_peer_hedge_win,
+  l_osd_ec_peer_last,
+};
+
+extern const std::string osd_ec_peer_counters_key;
+
+std::shared_ptr<PerfCounters> build_ec_peer_perf(const std::string &key,
+						 CephContext *cct);
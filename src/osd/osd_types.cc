@@ -7272,6 +7272,116 @@ void OSDOp::merge_osd_op_vector_out_data(vector<OSDOp>& ops, ceph::buffer::list&
   }
 }
 
+// -- osd_batch_op_t --
+
+void osd_batch_op_t::encode(ceph::buffer::list& bl) const
+{
+  ENCODE_START(1, 1, bl);
+  encode(oid, bl);
+  encode(key, bl);
+  encode((uint32_t)ops.size(), bl);
+  for (auto& op : ops) {
+    encode(op.op, bl);
+    encode(op.indata, bl);
+  }
+  ENCODE_FINISH(bl);
+}
+
+void osd_batch_op_t::decode(ceph::buffer::list::const_iterator& bl)
+{
+  DECODE_START(1, bl);
+  decode(oid, bl);
+  decode(key, bl);
+  uint32_t n;
+  decode(n, bl);
+  ops.resize(n);
+  for (auto& op : ops) {
+    decode(op.op, bl);
+    decode(op.indata, bl);
+  }
+  DECODE_FINISH(bl);
+}
+
+void osd_batch_op_t::dump(Formatter *f) const
+{
+  f->dump_stream("oid") << oid;
+  f->dump_string("key", key);
+  f->open_array_section("ops");
+  for (auto& op : ops) {
+    f->dump_stream("op") << op;
+  }
+  f->close_section();
+}
+
+void osd_batch_op_t::generate_test_instances(list<osd_batch_op_t*>& o)
+{
+  o.push_back(new osd_batch_op_t);
+  vector<OSDOp> ops(2);
+  ops[0].op.op = CEPH_OSD_OP_OMAPSETVALS;
+  ops[0].indata.append("vals");
+  ops[1].op.op = CEPH_OSD_OP_STAT;
+  o.push_back(new osd_batch_op_t(object_t("foo"), "key", std::move(ops)));
+}
+
+// -- osd_batch_result_t --
+
+void osd_batch_result_t::encode(ceph::buffer::list& bl) const
+{
+  ENCODE_START(1, 1, bl);
+  encode(result, bl);
+  encode(version, bl);
+  encode(user_version, bl);
+  encode((uint32_t)ops.size(), bl);
+  for (auto& op : ops) {
+    encode(op.rval, bl);
+    encode(op.outdata, bl);
+  }
+  ENCODE_FINISH(bl);
+}
+
+void osd_batch_result_t::decode(ceph::buffer::list::const_iterator& bl)
+{
+  DECODE_START(1, bl);
+  decode(result, bl);
+  decode(version, bl);
+  decode(user_version, bl);
+  uint32_t n;
+  decode(n, bl);
+  ops.resize(n);
+  for (auto& op : ops) {
+    decode(op.rval, bl);
+    decode(op.outdata, bl);
+  }
+  DECODE_FINISH(bl);
+}
+
+void osd_batch_result_t::dump(Formatter *f) const
+{
+  f->dump_int("result", result);
+  f->dump_stream("version") << version;
+  f->dump_unsigned("user_version", user_version);
+  f->open_array_section("ops");
+  for (auto& op : ops) {
+    f->open_object_section("op");
+    f->dump_int("rval", op.rval);
+    f->dump_unsigned("outdata_length", op.outdata.length());
+    f->close_section();
+  }
+  f->close_section();
+}
+
+void osd_batch_result_t::generate_test_instances(list<osd_batch_result_t*>& o)
+{
+  o.push_back(new osd_batch_result_t);
+  o.push_back(new osd_batch_result_t);
+  o.back()->result = -ENOENT;
+  o.back()->version = eversion_t(3, 4);
+  o.back()->user_version = 4;
+  o.back()->ops.resize(1);
+  o.back()->ops[0].rval = -ENOENT;
+  o.back()->ops[0].outdata.append("out");
+}
+
 int prepare_info_keymap(
   CephContext* cct,
   map<string,bufferlist> *km,
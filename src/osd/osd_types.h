@@ -4234,6 +4234,51 @@ struct formatter<pg_log_op_return_item_t> {
 };
 } // namespace fmt
 
+/**
+ * osd_batch_op_t - the ops of one object of a CEPH_OSD_OP_BATCH op
+ *
+ * A batch op carries the ops of several objects of the same pg, in its
+ * indata, and is sent to the first of them.  The primary executes each
+ * object's ops as if they came in their own message, and replies with
+ * an osd_batch_result_t for each object in the batch op's outdata.
+ */
+struct osd_batch_op_t {
+  static constexpr unsigned MAX_OBJECTS = 1 << 16;
+
+  object_t oid;
+  std::string key;            ///< object locator key, if any
+  std::vector<OSDOp> ops;
+
+  osd_batch_op_t() = default;
+  osd_batch_op_t(const object_t& oid, const std::string& key,
+		 std::vector<OSDOp>&& ops)
+    : oid(oid), key(key), ops(std::move(ops)) {}
+
+  /// the tid of the i-th object's ops, for the reqid they are logged with
+  static ceph_tid_t get_tid(ceph_tid_t batch_tid, unsigned i) {
+    return (1ull << 63) | (batch_tid << 16) | i;
+  }
+
+  void encode(ceph::buffer::list& bl) const;
+  void decode(ceph::buffer::list::const_iterator& bl);
+  void dump(ceph::Formatter *f) const;
+  static void generate_test_instances(std::list<osd_batch_op_t*>& o);
+};
+WRITE_CLASS_ENCODER(osd_batch_op_t)
+
+struct osd_batch_result_t {
+  int32_t result = 0;
+  eversion_t version;
+  version_t user_version = 0;
+  std::vector<OSDOp> ops;     ///< the rval and outdata of each op
+
+  void encode(ceph::buffer::list& bl) const;
+  void decode(ceph::buffer::list::const_iterator& bl);
+  void dump(ceph::Formatter *f) const;
+  static void generate_test_instances(std::list<osd_batch_result_t*>& o);
+};
+WRITE_CLASS_ENCODER(osd_batch_result_t)
+
 /**
  * pg_log_entry_t - single entry/event in pg log
  *
@@ -3366,6 +3366,40 @@ int Objecter::take_linger_budget(LingerOp *info)
 }
 
 /* This function DOES put the passed message before returning */
+namespace {
+/// set the outputs of the ops of o from those of its reply
+template<typename Op>
+void set_out_ops(Op& o, vector<OSDOp>& out_ops)
+{
+  ceph_assert(o.out_bl.size() == o.out_rval.size());
+  ceph_assert(o.out_bl.size() == o.out_ec.size());
+  ceph_assert(o.out_bl.size() == o.out_handler.size());
+  auto pb = o.out_bl.begin();
+  auto pr = o.out_rval.begin();
+  auto pe = o.out_ec.begin();
+  auto ph = o.out_handler.begin();
+  for (auto p = out_ops.begin();
+       p != out_ops.end() && pb != o.out_bl.end();
+       ++p, ++pb, ++pr, ++pe, ++ph) {
+    if (*pb)
+      **pb = p->outdata;
+    // set rval before running handlers so that handlers
+    // can change it if e.g. decoding fails
+    if (*pr)
+      **pr = ceph_to_hostos_errno(p->rval);
+    if (*pe)
+      **pe = p->rval < 0 ? bs::error_code(-p->rval, osd_category()) :
+	bs::error_code();
+    if (*ph) {
+      std::move((*ph))(p->rval < 0 ?
+		       bs::error_code(-p->rval, osd_category()) :
+		       bs::error_code(),
+		       p->rval, p->outdata);
+    }
+  }
+}
+}
+
 void Objecter::handle_osd_op_reply(MOSDOpReply *m)
 {
   ldout(cct, 10) << "in handle_osd_op_reply" << dendl;
@@ -3527,37 +3561,11 @@ void Objecter::handle_osd_op_reply(MOSDOpReply *m)
 		  << " from " << m->get_source_inst() << dendl;
 
   ceph_assert(op->ops.size() == op->out_bl.size());
-  ceph_assert(op->ops.size() == op->out_rval.size());
-  ceph_assert(op->ops.size() == op->out_ec.size());
-  ceph_assert(op->ops.size() == op->out_handler.size());
-  auto pb = op->out_bl.begin();
-  auto pr = op->out_rval.begin();
-  auto pe = op->out_ec.begin();
-  auto ph = op->out_handler.begin();
-  ceph_assert(op->out_bl.size() == op->out_rval.size());
-  ceph_assert(op->out_bl.size() == op->out_handler.size());
-  auto p = out_ops.begin();
-  for (unsigned i = 0;
-       p != out_ops.end() && pb != op->out_bl.end();
-       ++i, ++p, ++pb, ++pr, ++pe, ++ph) {
-    ldout(cct, 10) << " op " << i << " rval " << p->rval
-		   << " len " << p->outdata.length() << dendl;
-    if (*pb)
-      **pb = p->outdata;
-    // set rval before running handlers so that handlers
-    // can change it if e.g. decoding fails
-    if (*pr)
-      **pr = ceph_to_hostos_errno(p->rval);
-    if (*pe)
-      **pe = p->rval < 0 ? bs::error_code(-p->rval, osd_category()) :
-	bs::error_code();
-    if (*ph) {
-      std::move((*ph))(p->rval < 0 ?
-		       bs::error_code(-p->rval, osd_category()) :
-		       bs::error_code(),
-		       p->rval, p->outdata);
-    }
+  for (unsigned i = 0; i < out_ops.size() && i < op->out_bl.size(); ++i) {
+    ldout(cct, 10) << " op " << i << " rval " << out_ops[i].rval
+		   << " len " << out_ops[i].outdata.length() << dendl;
   }
+  set_out_ops(*op, out_ops);
 
   // NOTE: we assume that since we only request ONDISK ever we will
   // only ever get back one (type of) ack ever.
@@ -5427,3 +5435,58 @@ void ::ObjectOperation::scrub_ls(const librados::object_id_t& start_after,
   scrub_ls_arg_t arg = {*interval, 1, start_after, max_to_get};
   do_scrub_ls(this, arg, snapsets, interval, rval);
 }
+
+void ::ObjectOperation::batch(
+  std::vector<std::pair<object_t, ::ObjectOperation*>>&& objects,
+  const std::string& key,
+  std::vector<int*>&& results)
+{
+  ceph_assert(ops.empty());
+  ceph_assert(!objects.empty());
+  ceph_assert(objects.size() == results.size());
+  std::vector<osd_batch_op_t> batch;
+  batch.reserve(objects.size());
+  for (auto& [oid, o] : objects) {
+    batch.emplace_back(oid, key,
+		       std::vector<OSDOp>(o->ops.begin(), o->ops.end()));
+    flags |= o->flags;
+    priority = std::max(priority, o->priority);
+  }
+  OSDOp& osd_op = add_op(CEPH_OSD_OP_BATCH);
+  encode(batch, osd_op.indata);
+  set_handler(
+    [objects = std::move(objects), results = std::move(results)]
+    (bs::error_code, int r, const cb::list& bl) mutable {
+      std::vector<osd_batch_result_t> out;
+      if (r >= 0) {
+	try {
+	  auto p = bl.cbegin();
+	  decode(out, p);
+	  if (out.size() != objects.size()) {
+	    r = -EIO;
+	  }
+	} catch (const cb::error&) {
+	  r = -EIO;
+	}
+      }
+      if (r < 0) {
+	// none was run: leave their ops to be sent again, or failed
+	for (auto result : results) {
+	  if (result) {
+	    *result = r;
+	  }
+	}
+	return;
+      }
+      for (size_t i = 0; i < objects.size(); ++i) {
+	if (results[i]) {
+	  *results[i] = ceph_to_hostos_errno(out[i].result);
+	}
+	if (ceph_to_hostos_errno(out[i].result) == -EXDEV) {
+	  // not run, left to be sent again
+	  continue;
+	}
+	set_out_ops(*objects[i].second, out[i].ops);
+      }
+    });
+}
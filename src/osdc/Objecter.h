@@ -340,6 +340,21 @@ struct ObjectOperation {
 		uint32_t *interval,
 		int *rval);
 
+  /**
+   * batch - the operations of several objects of the same pg
+   *
+   * Must be the only op of the operation, which is sent to the first
+   * of the objects.  The outputs of each object's operation are set as
+   * if it had been sent on its own, and its result in *results[i].
+   * The ops are copied, and the objects' operations left as they are
+   * for those answered -EXDEV (no longer in the pg), or all of them if
+   * the batch as a whole fails, to be sent again, so they must outlive
+   * this one.
+   */
+  void batch(std::vector<std::pair<object_t, ObjectOperation*>>&& objects,
+	     const std::string& key,
+	     std::vector<int*>&& results);
+
   void create(bool excl) {
     OSDOp& o = add_op(CEPH_OSD_OP_CREATE);
     o.op.flags = (excl ? CEPH_OSD_OP_FLAG_EXCL : 0);
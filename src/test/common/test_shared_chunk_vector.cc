@@ -0,0 +1,81 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "common/shared_chunk_vector.h"
+#include <gtest/gtest.h>
+
+using vec_t = ceph::shared_chunk_vector<int, std::vector, 2>;
+
+TEST(SharedChunkVector, Resize)
+{
+  vec_t v;
+  ASSERT_TRUE(v.empty());
+  v.resize(10, 7);
+  ASSERT_EQ(10u, v.size());
+  ASSERT_EQ(3u, v.get_num_chunks());
+  for (size_t i = 0; i < v.size(); ++i) {
+    ASSERT_EQ(7, v[i]);
+  }
+  v.resize(5);
+  ASSERT_EQ(5u, v.size());
+  ASSERT_EQ(2u, v.get_num_chunks());
+  v.resize(6, 1);
+  ASSERT_EQ(7, v[4]);
+  ASSERT_EQ(1, v[5]);
+  v.clear();
+  ASSERT_TRUE(v.empty());
+  ASSERT_EQ(0u, v.get_num_chunks());
+}
+
+TEST(SharedChunkVector, CopyOnWrite)
+{
+  vec_t a;
+  a.resize(10);
+  for (size_t i = 0; i < a.size(); ++i) {
+    a.mut(i) = i;
+  }
+  vec_t b = a;
+  ASSERT_EQ(3u, a.get_num_shared_chunks());
+
+  b.mut(5) = 50;
+  ASSERT_EQ(5, a[5]);
+  ASSERT_EQ(50, b[5]);
+  ASSERT_EQ(2u, b.get_num_shared_chunks());
+
+  // growing b copies the partial last chunk only
+  b.resize(11, 100);
+  ASSERT_EQ(10u, a.size());
+  ASSERT_EQ(1u, a.get_num_shared_chunks());
+  ASSERT_EQ(100, b[10]);
+  ASSERT_EQ(9, a[9]);
+
+  std::vector<int> copy(b.begin(), b.end());
+  ASSERT_EQ(11u, copy.size());
+  ASSERT_EQ(50, copy[5]);
+}
+
+TEST(SharedChunkVector, Encoding)
+{
+  vec_t a;
+  a.resize(9);
+  for (size_t i = 0; i < a.size(); ++i) {
+    a.mut(i) = i * 3;
+  }
+  ceph::buffer::list bl;
+  encode(a, bl);
+
+  // same wire format as a vector
+  std::vector<int> v;
+  auto p = bl.cbegin();
+  decode(v, p);
+  ASSERT_EQ(std::vector<int>(a.begin(), a.end()), v);
+
+  vec_t b;
+  b.resize(2);
+  vec_t c = b;
+  p = bl.cbegin();
+  decode(b, p);
+  ASSERT_EQ(9u, b.size());
+  ASSERT_EQ(24, b[8]);
+  ASSERT_EQ(2u, c.size());
+}
@@ -658,3 +658,45 @@ TEST_F(CRUSHTest, straw2_reweight) {
     cout << "     vs " << estddev << std::endl;
   }
 }
+
+TEST_F(CRUSHTest, hash_batch) {
+  // the vectorized path must be bit identical to the scalar one
+  __s32 b[CRUSH_HASH_BATCH * 4 + 3];
+  __u32 out[std::size(b)];
+  for (unsigned n = 0; n <= std::size(b); ++n) {
+    for (unsigned i = 0; i < n; ++i) {
+      b[i] = rand() - RAND_MAX / 2;
+    }
+    __u32 a = rand(), c = rand();
+    crush_hash32_3_batch(CRUSH_HASH_RJENKINS1, a, b, n, c, out);
+    for (unsigned i = 0; i < n; ++i) {
+      ASSERT_EQ(crush_hash32_3(CRUSH_HASH_RJENKINS1, a, b[i], c), out[i]);
+    }
+  }
+}
+
+TEST_F(CRUSHTest, do_rule_batch) {
+  std::unique_ptr<CrushWrapper> c(build_indep_map(cct, 3, 3, 3));
+  int rule = c->add_simple_rule("straw2", "default", "host", "",
+				"firstn", pg_pool_t::TYPE_REPLICATED);
+  ASSERT_LE(0, rule);
+  vector<__u32> weight(c->get_max_devices(), 0x10000);
+  weight[3] = 0;
+  weight[11] = 0x8000;
+
+  vector<int> xs;
+  for (int x = 0; x < 1000; ++x) {
+    xs.push_back(x);
+  }
+  for (int r : {0, rule}) {
+    vector<int> out, out_len;
+    c->do_rule_batch(r, xs, 3, weight, 0, &out, &out_len);
+    ASSERT_EQ(xs.size(), out_len.size());
+    for (unsigned i = 0; i < xs.size(); ++i) {
+      vector<int> expected;
+      c->do_rule(r, xs[i], expected, 3, weight, 0);
+      vector<int> got(out.begin() + i * 3, out.begin() + i * 3 + out_len[i]);
+      ASSERT_EQ(expected, got);
+    }
+  }
+}
@@ -368,6 +368,56 @@ TEST_F(IsaErasureCodeTest, encode)
   }
 }
 
+TEST_F(IsaErasureCodeTest, parity_delta)
+{
+  for (int m : {1, 3}) {
+    ErasureCodeIsaDefault Isa(tcache);
+    ErasureCodeProfile profile;
+    profile["k"] = "4";
+    profile["m"] = stringify(m);
+    ASSERT_EQ(0, Isa.init(profile, &cerr));
+    ASSERT_TRUE(Isa.get_supported_optimizations() &
+                ceph::ErasureCodeInterface::FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION);
+
+    const unsigned chunk_size = 4096;
+    set<int> want_to_encode;
+    for (unsigned i = 0; i < Isa.get_chunk_count(); ++i) {
+      want_to_encode.insert(i);
+    }
+    bufferlist in;
+    for (unsigned i = 0; i < 4 * chunk_size; ++i) {
+      in.append((char)(i * 7 + i / 13));
+    }
+    map<int,bufferlist> encoded;
+    ASSERT_EQ(0, Isa.encode(want_to_encode, in, &encoded));
+    ASSERT_EQ(chunk_size, encoded[0].length());
+
+    // overwrite part of data chunk 2
+    bufferlist changed;
+    changed.substr_of(in, 0, in.length());
+    changed.rebuild();
+    memset(changed.c_str() + 2 * chunk_size + 512, 'X', 512);
+    map<int,bufferlist> reencoded;
+    ASSERT_EQ(0, Isa.encode(want_to_encode, changed, &reencoded));
+
+    map<int,bufferptr> deltas;
+    bufferptr delta(buffer::create_page_aligned(chunk_size));
+    Isa.encode_delta(bufferptr(encoded[2].c_str(), chunk_size),
+                     bufferptr(reencoded[2].c_str(), chunk_size),
+                     &delta);
+    deltas[2] = delta;
+    map<int,bufferptr> parity;
+    for (int p = 4; p < 4 + m; ++p) {
+      parity[p] = buffer::create_page_aligned(chunk_size);
+      memcpy(parity[p].c_str(), encoded[p].c_str(), chunk_size);
+    }
+    Isa.apply_delta(deltas, parity);
+    for (int p = 4; p < 4 + m; ++p) {
+      EXPECT_EQ(0, memcmp(parity[p].c_str(), reencoded[p].c_str(), chunk_size));
+    }
+  }
+}
+
 TEST_F(IsaErasureCodeTest, sanity_check_k)
 {
   ErasureCodeIsaDefault Isa(tcache);
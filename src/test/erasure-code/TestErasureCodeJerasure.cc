@@ -21,10 +21,15 @@
 #include "crush/CrushWrapper.h"
 #include "include/stringify.h"
 #include "erasure-code/jerasure/ErasureCodeJerasure.h"
+#include "erasure-code/jerasure/jerasure_region.h"
 #include "global/global_context.h"
 #include "common/config.h"
 #include "gtest/gtest.h"
 
+extern "C" {
+#include "galois.h"
+}
+
 using namespace std;
 
 template <typename T>
@@ -228,6 +233,96 @@ TYPED_TEST(ErasureCodeTest, minimum_to_decode)
   }
 }
 
+TYPED_TEST(ErasureCodeTest, decode_cache)
+{
+  ErasureCodeJerasureDecodeCache cache;
+  TypeParam jerasure;
+  jerasure.decode_cache = &cache;
+  ErasureCodeProfile profile;
+  profile["k"] = "3";
+  profile["m"] = "2";
+  profile["packetsize"] = "8";
+  ASSERT_EQ(0, jerasure.init(profile, &cerr));
+
+  const unsigned n = jerasure.get_chunk_count();
+  set<int> want_to_encode;
+  for (unsigned i = 0; i < n; ++i) {
+    want_to_encode.insert(i);
+  }
+  bufferlist in;
+  for (unsigned i = 0; i < 3 * 4096; ++i) {
+    in.append((char)(i * 7 + i / 13));
+  }
+  map<int, bufferlist> encoded;
+  ASSERT_EQ(0, jerasure.encode(want_to_encode, in, &encoded));
+
+  // every pattern of one or two erasures, twice: computed then cached
+  unsigned patterns = 0;
+  for (int pass = 0; pass < 2; ++pass) {
+    for (unsigned a = 0; a < n; ++a) {
+      for (unsigned b = a; b < n; ++b) {
+	map<int, bufferlist> degraded = encoded;
+	degraded.erase(a);
+	degraded.erase(b);
+	map<int, bufferlist> decoded;
+	ASSERT_EQ(0, jerasure._decode(want_to_encode, degraded, &decoded));
+	for (unsigned i = 0; i < n; ++i) {
+	  ASSERT_EQ(encoded[i].length(), decoded[i].length());
+	  EXPECT_EQ(0, memcmp(encoded[i].c_str(), decoded[i].c_str(),
+			      encoded[i].length()))
+	    << "erased " << a << "," << b << " chunk " << i;
+	}
+	if (pass == 0) {
+	  ++patterns;
+	}
+      }
+    }
+  }
+  EXPECT_EQ(patterns, cache.size());
+  EXPECT_EQ(patterns, cache.get_misses());
+  EXPECT_EQ(patterns, cache.get_hits());
+
+  // evicts the least recently used plan
+  ErasureCodeJerasureDecodeCache small(2);
+  jerasure.decode_cache = &small;
+  for (int erased : {0, 1, 0, 2, 1}) {
+    map<int, bufferlist> degraded = encoded;
+    degraded.erase(erased);
+    map<int, bufferlist> decoded;
+    ASSERT_EQ(0, jerasure._decode(want_to_encode, degraded, &decoded));
+  }
+  EXPECT_EQ(2u, small.size());
+  EXPECT_EQ(1u, small.get_hits());
+  EXPECT_EQ(4u, small.get_misses());
+}
+
+TEST(ErasureCodeTest, region_multiply)
+{
+  std::cout << "w=8 region multiply: " << jerasure_region_multiply_impl()
+	    << std::endl;
+  const int len = 4096 + 77;
+  std::vector<char> src(len), dst(len), expected(len);
+  for (int i = 0; i < len; ++i) {
+    src[i] = (char)(i * 31 + i / 7);
+  }
+  for (int multby : {0, 1, 2, 3, 29, 142, 255}) {
+    for (bool add : {false, true}) {
+      for (int l : {0, 1, 31, 33, 64, 100, len}) {
+	for (int i = 0; i < len; ++i) {
+	  dst[i] = expected[i] = (char)(i * 3);
+	}
+	jerasure_region_multiply(8, src.data(), multby, l, dst.data(), add);
+	for (int i = 0; i < l; ++i) {
+	  char p = galois_single_multiply(multby, (unsigned char)src[i], 8);
+	  expected[i] = add ? expected[i] ^ p : p;
+	}
+	ASSERT_EQ(0, memcmp(dst.data(), expected.data(), len))
+	  << "multby " << multby << " add " << add << " length " << l;
+      }
+    }
+  }
+}
+
 TEST(ErasureCodeTest, encode)
 {
   ErasureCodeJerasureReedSolomonVandermonde jerasure;
@@ -278,6 +373,76 @@ TEST(ErasureCodeTest, encode)
   }
 }
 
+template <typename T>
+static void check_parity_delta(const char *w)
+{
+  T jerasure;
+  ErasureCodeProfile profile;
+  profile["k"] = "4";
+  profile["m"] = "2";
+  profile["w"] = w;
+  ASSERT_EQ(0, jerasure.init(profile, &cerr));
+  ASSERT_TRUE(jerasure.get_supported_optimizations() &
+	      ceph::ErasureCodeInterface::FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION);
+
+  const unsigned chunk_size = 4096;
+  set<int> want_to_encode;
+  for (unsigned i = 0; i < jerasure.get_chunk_count(); ++i) {
+    want_to_encode.insert(i);
+  }
+  bufferlist in;
+  for (unsigned i = 0; i < 4 * chunk_size; ++i) {
+    in.append((char)(i * 7 + i / 13));
+  }
+  map<int,bufferlist> encoded;
+  ASSERT_EQ(0, jerasure.encode(want_to_encode, in, &encoded));
+  ASSERT_EQ(chunk_size, encoded[0].length());
+
+  // overwrite part of data chunks 1 and 3
+  bufferlist changed;
+  changed.substr_of(in, 0, in.length());
+  changed.rebuild();
+  memset(changed.c_str() + chunk_size + 100, 'X', 1000);
+  memset(changed.c_str() + 3 * chunk_size, 'Y', chunk_size);
+  map<int,bufferlist> reencoded;
+  ASSERT_EQ(0, jerasure.encode(want_to_encode, changed, &reencoded));
+
+  map<int,bufferptr> deltas;
+  for (int j : {1, 3}) {
+    bufferptr delta(buffer::create_page_aligned(chunk_size));
+    jerasure.encode_delta(bufferptr(encoded[j].c_str(), chunk_size),
+			  bufferptr(reencoded[j].c_str(), chunk_size),
+			  &delta);
+    deltas[j] = delta;
+  }
+  map<int,bufferptr> parity;
+  for (int p : {4, 5}) {
+    parity[p] = buffer::create_page_aligned(chunk_size);
+    memcpy(parity[p].c_str(), encoded[p].c_str(), chunk_size);
+  }
+  jerasure.apply_delta(deltas, parity);
+  for (int p : {4, 5}) {
+    EXPECT_EQ(0, memcmp(parity[p].c_str(), reencoded[p].c_str(), chunk_size));
+  }
+}
+
+TEST(ErasureCodeTest, parity_delta)
+{
+  check_parity_delta<ErasureCodeJerasureReedSolomonVandermonde>("8");
+  check_parity_delta<ErasureCodeJerasureReedSolomonVandermonde>("16");
+  check_parity_delta<ErasureCodeJerasureReedSolomonVandermonde>("32");
+  check_parity_delta<ErasureCodeJerasureReedSolomonRAID6>("8");
+
+  // bit matrix codes don't offer it
+  ErasureCodeJerasureCauchyGood cauchy;
+  ErasureCodeProfile profile;
+  profile["k"] = "4";
+  profile["m"] = "2";
+  profile["packetsize"] = "8";
+  ASSERT_EQ(0, cauchy.init(profile, &cerr));
+  EXPECT_EQ(0u, cauchy.get_supported_optimizations());
+}
+
 TEST(ErasureCodeTest, create_rule)
 {
   std::unique_ptr<CrushWrapper> c = std::make_unique<CrushWrapper>();
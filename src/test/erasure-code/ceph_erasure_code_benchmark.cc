@@ -15,6 +15,7 @@
  *
  */
 
+#include <algorithm>
 #include <boost/scoped_ptr.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/program_options/option.hpp>
@@ -59,7 +60,9 @@ int ErasureCodeBench::setup(int argc, char** argv) {
     ("plugin,p", po::value<string>()->default_value("jerasure"),
      "erasure code plugin name")
     ("workload,w", po::value<string>()->default_value("encode"),
-     "run either encode or decode")
+     "run either encode, decode, degraded or overwrite")
+    ("overwrite-size", po::value<int>()->default_value(4096),
+     "bytes changed in the stripe by each overwrite")
     ("erasures,e", po::value<int>()->default_value(1),
      "number of erasures when decoding")
     ("erased", po::value<vector<int> >(),
@@ -119,6 +122,7 @@ int ErasureCodeBench::setup(int argc, char** argv) {
   }
 
   in_size = vm["size"].as<int>();
+  overwrite_size = vm["overwrite-size"].as<int>();
   max_iterations = vm["iterations"].as<int>();
   plugin = vm["plugin"].as<string>();
   workload = vm["workload"].as<string>();
@@ -158,6 +162,10 @@ int ErasureCodeBench::run() {
 
   if (workload == "encode")
     return encode();
+  else if (workload == "overwrite")
+    return overwrite();
+  else if (workload == "degraded")
+    return degraded();
   else
     return decode();
 }
@@ -325,6 +333,228 @@ int ErasureCodeBench::decode()
   return 0;
 }
 
+/*
+ * For every way of erasing --erasures chunks, or only for the --erased
+ * chunks if given, decode all chunks of a --size object --iterations
+ * times and print the erased chunks, the time and the decoded object
+ * bytes per second in GB/s.  One decode per pattern is done before the
+ * clock starts, so plugins which cache decoding tables are measured
+ * warm, as they run on an OSD.
+ */
+int ErasureCodeBench::degraded()
+{
+  ErasureCodePluginRegistry &instance = ErasureCodePluginRegistry::instance();
+  ErasureCodeInterfaceRef erasure_code;
+  stringstream messages;
+  int code = instance.factory(plugin,
+			      g_conf().get_val<std::string>("erasure_code_dir"),
+			      profile, &erasure_code, &messages);
+  if (code) {
+    cerr << messages.str() << endl;
+    return code;
+  }
+  if (erased.empty() && (erasures <= 0 || erasures > m)) {
+    cerr << "--erasures must be within 1.." << m << endl;
+    return -EINVAL;
+  }
+
+  bufferlist in;
+  in.append(string(in_size, 'X'));
+  in.rebuild_aligned(ErasureCode::SIMD_ALIGN);
+  set<int> want_to_read;
+  for (int i = 0; i < k + m; i++) {
+    want_to_read.insert(i);
+  }
+  map<int,bufferlist> encoded;
+  code = erasure_code->encode(want_to_read, in, &encoded);
+  if (code)
+    return code;
+
+  vector<vector<int>> patterns;
+  if (!erased.empty()) {
+    patterns.push_back(erased);
+  } else {
+    vector<bool> pick(k + m, false);
+    std::fill(pick.end() - erasures, pick.end(), true);
+    do {
+      vector<int> pattern;
+      for (int i = 0; i < k + m; i++) {
+	if (pick[i])
+	  pattern.push_back(i);
+      }
+      patterns.push_back(pattern);
+    } while (std::next_permutation(pick.begin(), pick.end()));
+  }
+
+  cout << "erased	seconds	GB/s" << endl;
+  for (auto &&pattern : patterns) {
+    map<int,bufferlist> chunks = encoded;
+    for (int e : pattern)
+      chunks.erase(e);
+    map<int,bufferlist> decoded;
+    code = erasure_code->decode(want_to_read, chunks, &decoded, 0);
+    if (code)
+      return code;
+    for (int e : pattern) {
+      if (!decoded[e].contents_equal(encoded[e])) {
+	cerr << "chunk " << e
+	     << " content and recovered content are different" << endl;
+	return -1;
+      }
+    }
+
+    utime_t begin_time = ceph_clock_now();
+    for (int i = 0; i < max_iterations; i++) {
+      map<int,bufferlist> decoded;
+      code = erasure_code->decode(want_to_read, chunks, &decoded, 0);
+      if (code)
+	return code;
+    }
+    utime_t end_time = ceph_clock_now();
+    double seconds = end_time - begin_time;
+    string name;
+    for (int e : pattern) {
+      if (!name.empty())
+	name += ",";
+      name += std::to_string(e);
+    }
+    cout << name << "\t" << seconds << "\t"
+	 << ((double)in_size * max_iterations / seconds / 1e9) << endl;
+  }
+  return 0;
+}
+
+/*
+ * Overwrite --overwrite-size bytes at a random offset of a --size
+ * stripe, --iterations times, first by reading the whole stripe and
+ * encoding it again, then by reading the touched data chunks and the
+ * coding chunks and applying the parity delta, if the plugin supports
+ * it.  For each method print the time and the bytes read and written
+ * per overwrite.
+ */
+int ErasureCodeBench::overwrite()
+{
+  ErasureCodePluginRegistry &instance = ErasureCodePluginRegistry::instance();
+  ErasureCodeInterfaceRef erasure_code;
+  stringstream messages;
+  int code = instance.factory(plugin,
+			      g_conf().get_val<std::string>("erasure_code_dir"),
+			      profile, &erasure_code, &messages);
+  if (code) {
+    cerr << messages.str() << endl;
+    return code;
+  }
+
+  bufferlist in;
+  in.append(string(in_size, 'X'));
+  in.rebuild_aligned(ErasureCode::SIMD_ALIGN);
+  set<int> want_to_encode;
+  for (int i = 0; i < k + m; i++) {
+    want_to_encode.insert(i);
+  }
+  map<int,bufferlist> encoded;
+  code = erasure_code->encode(want_to_encode, in, &encoded);
+  if (code)
+    return code;
+  const unsigned chunk_size = encoded[0].length();
+  const unsigned stripe_size = k * chunk_size;
+  if (overwrite_size <= 0 || (unsigned)overwrite_size > stripe_size) {
+    cerr << "--overwrite-size must be within 1.." << stripe_size << endl;
+    return -EINVAL;
+  }
+  bufferlist update;
+  update.append(string(overwrite_size, 'Y'));
+
+  // read the whole stripe, modify it, encode and write all chunks
+  srand(1);
+  uint64_t read = 0, written = 0;
+  utime_t begin_time = ceph_clock_now();
+  for (int i = 0; i < max_iterations; i++) {
+    unsigned off = rand() % (stripe_size - overwrite_size + 1);
+    bufferlist stripe;
+    code = erasure_code->decode_concat(encoded, &stripe);
+    if (code)
+      return code;
+    read += stripe_size;
+    stripe.rebuild_aligned(ErasureCode::SIMD_ALIGN);
+    memcpy(stripe.c_str() + off, update.c_str(), overwrite_size);
+    map<int,bufferlist> reencoded;
+    code = erasure_code->encode(want_to_encode, stripe, &reencoded);
+    if (code)
+      return code;
+    written += (k + m) * chunk_size;
+    encoded.swap(reencoded);
+  }
+  utime_t end_time = ceph_clock_now();
+  cout << "rmw	" << (end_time - begin_time)
+       << "	" << read / max_iterations
+       << "	" << written / max_iterations << endl;
+
+  if (!(erasure_code->get_supported_optimizations() &
+	ErasureCodeInterface::FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION)) {
+    cout << "delta	not supported by " << plugin << endl;
+    return 0;
+  }
+
+  // read the touched data chunks and the coding chunks, write them back
+  for (auto &&i : encoded) {
+    i.second.rebuild_aligned(ErasureCode::SIMD_ALIGN);
+  }
+  srand(1);
+  read = written = 0;
+  bufferptr new_data(buffer::create_aligned(chunk_size,
+					    ErasureCode::SIMD_ALIGN));
+  begin_time = ceph_clock_now();
+  for (int i = 0; i < max_iterations; i++) {
+    unsigned off = rand() % (stripe_size - overwrite_size + 1);
+    unsigned end = off + overwrite_size;
+    map<int,bufferptr> deltas;
+    for (unsigned j = off / chunk_size; j * chunk_size < end; j++) {
+      bufferptr old_data = encoded[j].front();
+      unsigned from = std::max(off, j * chunk_size);
+      unsigned to = std::min(end, (j + 1) * chunk_size);
+      memcpy(new_data.c_str(), old_data.c_str(), chunk_size);
+      memcpy(new_data.c_str() + from - j * chunk_size,
+	     update.c_str() + from - off, to - from);
+      bufferptr delta(buffer::create_aligned(chunk_size,
+					     ErasureCode::SIMD_ALIGN));
+      erasure_code->encode_delta(old_data, new_data, &delta);
+      deltas[j] = delta;
+      memcpy(old_data.c_str(), new_data.c_str(), chunk_size);
+      read += chunk_size;
+      written += chunk_size;
+    }
+    map<int,bufferptr> parity;
+    for (int p = k; p < k + m; p++) {
+      parity[p] = encoded[p].front();
+    }
+    erasure_code->apply_delta(deltas, parity);
+    read += m * chunk_size;
+    written += m * chunk_size;
+  }
+  end_time = ceph_clock_now();
+  cout << "delta	" << (end_time - begin_time)
+       << "	" << read / max_iterations
+       << "	" << written / max_iterations << endl;
+
+  // the coding chunks must be what a full encode gives
+  bufferlist stripe;
+  code = erasure_code->decode_concat(encoded, &stripe);
+  if (code)
+    return code;
+  map<int,bufferlist> reencoded;
+  code = erasure_code->encode(want_to_encode, stripe, &reencoded);
+  if (code)
+    return code;
+  for (int p = k; p < k + m; p++) {
+    if (!reencoded[p].contents_equal(encoded[p])) {
+      cerr << "chunk " << p << " differs from a full encode" << endl;
+      return -1;
+    }
+  }
+  return 0;
+}
+
 int main(int argc, char** argv) {
   ErasureCodeBench ecbench;
   try {
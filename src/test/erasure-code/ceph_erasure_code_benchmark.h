@@ -32,6 +32,7 @@
 
 class ErasureCodeBench {
   int in_size;
+  int overwrite_size;
   int max_iterations;
   int erasures;
   int k;
@@ -56,7 +57,9 @@ public:
 		      unsigned want_erasures,
 		      ErasureCodeInterfaceRef erasure_code);
   int decode();
+  int degraded();
   int encode();
+  int overwrite();
 };
 
 #endif
@@ -0,0 +1,222 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*
+// vim: ts=8 sw=2 smarttab
+
+#include <errno.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "include/rados/librados.hpp"
+#include "include/stringify.h"
+#include "test/librados/test_cxx.h"
+#include "test/librados/testcase_cxx.h"
+
+#include "crimson_utils.h"
+
+using namespace librados;
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+
+typedef RadosTestPP LibRadosBatchPP;
+typedef RadosTestECPP LibRadosBatchECPP;
+
+static const unsigned num_objects = 64;
+
+static string obj_name(unsigned i)
+{
+  return "obj" + stringify(i);
+}
+
+TEST_F(LibRadosBatchPP, WritePP) {
+  SKIP_IF_CRIMSON();
+  vector<ObjectWriteOperation> ops(num_objects);
+  vector<pair<string, ObjectWriteOperation*>> batch;
+  for (unsigned i = 0; i < num_objects; ++i) {
+    map<string, bufferlist> vals;
+    vals["key"].append(obj_name(i));
+    ops[i].omap_set(vals);
+    bufferlist bl;
+    bl.append("value");
+    ops[i].setxattr("attr", bl);
+    batch.emplace_back(obj_name(i), &ops[i]);
+  }
+  vector<int> results;
+  ASSERT_EQ(0, ioctx.operate_batch(batch, &results, 0));
+  ASSERT_EQ(num_objects, results.size());
+  for (unsigned i = 0; i < num_objects; ++i) {
+    ASSERT_EQ(0, results[i]);
+    map<string, bufferlist> vals;
+    ASSERT_EQ(0, ioctx.omap_get_vals_by_keys(obj_name(i), {"key"}, &vals));
+    ASSERT_EQ(obj_name(i), vals["key"].to_str());
+    bufferlist bl;
+    ASSERT_EQ(5, ioctx.getxattr(obj_name(i), "attr", bl));
+  }
+}
+
+TEST_F(LibRadosBatchPP, ReadPP) {
+  SKIP_IF_CRIMSON();
+  for (unsigned i = 0; i < num_objects; i += 2) {
+    bufferlist bl;
+    bl.append(obj_name(i));
+    ASSERT_EQ(0, ioctx.write_full(obj_name(i), bl));
+  }
+  // every other object is missing
+  vector<ObjectReadOperation> ops(num_objects);
+  vector<bufferlist> bls(num_objects);
+  vector<int> rvals(num_objects, 1);
+  vector<pair<string, ObjectReadOperation*>> batch;
+  for (unsigned i = 0; i < num_objects; ++i) {
+    ops[i].read(0, 0, &bls[i], &rvals[i]);
+    batch.emplace_back(obj_name(i), &ops[i]);
+  }
+  vector<int> results;
+  ASSERT_EQ(0, ioctx.operate_batch(batch, &results, 0));
+  ASSERT_EQ(num_objects, results.size());
+  for (unsigned i = 0; i < num_objects; ++i) {
+    if (i % 2) {
+      ASSERT_EQ(-ENOENT, results[i]);
+    } else {
+      ASSERT_EQ(0, results[i]);
+      ASSERT_EQ(0, rvals[i]);
+      ASSERT_EQ(obj_name(i), bls[i].to_str());
+    }
+  }
+}
+
+TEST_F(LibRadosBatchPP, PartialFailurePP) {
+  SKIP_IF_CRIMSON();
+  bufferlist bl;
+  bl.append("foo");
+  ASSERT_EQ(0, ioctx.write_full(obj_name(0), bl));
+
+  // the failure of one object's ops leaves the others alone
+  vector<ObjectWriteOperation> ops(2);
+  ops[0].append(bl);
+  ops[1].assert_exists();
+  ops[1].append(bl);
+  vector<pair<string, ObjectWriteOperation*>> batch = {
+    {obj_name(0), &ops[0]},
+    {obj_name(1), &ops[1]},
+  };
+  vector<int> results;
+  ASSERT_EQ(0, ioctx.operate_batch(batch, &results, 0));
+  ASSERT_EQ(0, results[0]);
+  ASSERT_EQ(-ENOENT, results[1]);
+  uint64_t size;
+  time_t mtime;
+  ASSERT_EQ(0, ioctx.stat(obj_name(0), &size, &mtime));
+  ASSERT_EQ(6u, size);
+  ASSERT_EQ(-ENOENT, ioctx.stat(obj_name(1), &size, &mtime));
+}
+
+TEST_F(LibRadosBatchPP, TieredPP) {
+  SKIP_IF_CRIMSON();
+  // the osds turn batches down in pools with tiers: the objects are
+  // sent on their own instead
+  string cache_pool_name = get_temp_pool_name();
+  ASSERT_EQ(0, cluster.pool_create(cache_pool_name.c_str()));
+  bufferlist inbl;
+  ASSERT_EQ(0, cluster.mon_command(
+    "{\"prefix\": \"osd tier add\", \"pool\": \"" + pool_name +
+    "\", \"tierpool\": \"" + cache_pool_name +
+    "\", \"force_nonempty\": \"--force-nonempty\" }",
+    inbl, NULL, NULL));
+  cluster.wait_for_latest_osdmap();
+
+  vector<ObjectWriteOperation> ops(num_objects);
+  vector<pair<string, ObjectWriteOperation*>> batch;
+  for (unsigned i = 0; i < num_objects; ++i) {
+    bufferlist bl;
+    bl.append(obj_name(i));
+    ops[i].write_full(bl);
+    batch.emplace_back(obj_name(i), &ops[i]);
+  }
+  vector<int> results;
+  ASSERT_EQ(0, ioctx.operate_batch(batch, &results, 0));
+  for (unsigned i = 0; i < num_objects; ++i) {
+    ASSERT_EQ(0, results[i]);
+    bufferlist bl;
+    ASSERT_EQ((int)obj_name(i).size(), ioctx.read(obj_name(i), bl, 0, 0));
+    ASSERT_EQ(obj_name(i), bl.to_str());
+  }
+
+  ASSERT_EQ(0, cluster.mon_command(
+    "{\"prefix\": \"osd tier remove\", \"pool\": \"" + pool_name +
+    "\", \"tierpool\": \"" + cache_pool_name + "\"}",
+    inbl, NULL, NULL));
+  cluster.wait_for_latest_osdmap();
+  ASSERT_EQ(0, cluster.pool_delete(cache_pool_name.c_str()));
+}
+
+TEST_F(LibRadosBatchPP, AioPP) {
+  SKIP_IF_CRIMSON();
+  vector<ObjectWriteOperation> ops(num_objects);
+  vector<pair<string, ObjectWriteOperation*>> batch;
+  for (unsigned i = 0; i < num_objects; ++i) {
+    bufferlist bl;
+    bl.append(obj_name(i));
+    ops[i].write_full(bl);
+    batch.emplace_back(obj_name(i), &ops[i]);
+  }
+  vector<int> results;
+  std::unique_ptr<AioCompletion> c{cluster.aio_create_completion()};
+  ASSERT_EQ(0, ioctx.aio_operate_batch(c.get(), batch, &results, 0));
+  ASSERT_EQ(0, c->wait_for_complete());
+  ASSERT_EQ(0, c->get_return_value());
+
+  vector<ObjectReadOperation> reads(num_objects);
+  vector<bufferlist> bls(num_objects);
+  vector<pair<string, ObjectReadOperation*>> read_batch;
+  for (unsigned i = 0; i < num_objects; ++i) {
+    ASSERT_EQ(0, results[i]);
+    reads[i].read(0, 0, &bls[i], nullptr);
+    read_batch.emplace_back(obj_name(i), &reads[i]);
+  }
+  c.reset(cluster.aio_create_completion());
+  ASSERT_EQ(0, ioctx.aio_operate_batch(c.get(), read_batch, &results, 0));
+  ASSERT_EQ(0, c->wait_for_complete());
+  ASSERT_EQ(0, c->get_return_value());
+  for (unsigned i = 0; i < num_objects; ++i) {
+    ASSERT_EQ(0, results[i]);
+    ASSERT_EQ(obj_name(i), bls[i].to_str());
+  }
+}
+
+TEST_F(LibRadosBatchPP, EmptyPP) {
+  SKIP_IF_CRIMSON();
+  vector<pair<string, ObjectWriteOperation*>> batch;
+  vector<int> results;
+  ASSERT_EQ(-EINVAL, ioctx.operate_batch(batch, &results, 0));
+}
+
+TEST_F(LibRadosBatchECPP, WriteReadPP) {
+  SKIP_IF_CRIMSON();
+  vector<ObjectWriteOperation> ops(num_objects);
+  vector<pair<string, ObjectWriteOperation*>> batch;
+  for (unsigned i = 0; i < num_objects; ++i) {
+    bufferlist bl;
+    bl.append(obj_name(i));
+    ops[i].write_full(bl);
+    batch.emplace_back(obj_name(i), &ops[i]);
+  }
+  vector<int> results;
+  ASSERT_EQ(0, ioctx.operate_batch(batch, &results, 0));
+
+  vector<ObjectReadOperation> reads(num_objects);
+  vector<bufferlist> bls(num_objects);
+  vector<pair<string, ObjectReadOperation*>> read_batch;
+  for (unsigned i = 0; i < num_objects; ++i) {
+    ASSERT_EQ(0, results[i]);
+    reads[i].read(0, 0, &bls[i], nullptr);
+    read_batch.emplace_back(obj_name(i), &reads[i]);
+  }
+  ASSERT_EQ(0, ioctx.operate_batch(read_batch, &results, 0));
+  for (unsigned i = 0; i < num_objects; ++i) {
+    ASSERT_EQ(0, results[i]);
+    ASSERT_EQ(obj_name(i), bls[i].to_str());
+  }
+}
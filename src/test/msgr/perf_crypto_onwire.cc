@@ -0,0 +1,114 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include <iostream>
+#include <string>
+
+#include "auth/Auth.h"
+#include "common/ceph_argparse.h"
+#include "global/global_init.h"
+#include "global/global_context.h"
+#include "msg/async/compression_meta.h"
+#include "msg/async/frames_v2.h"
+
+using namespace std;
+using namespace ceph::msgr::v2;
+
+static void usage(const char *name) {
+  cout << "Usage: " << name << " [data bytes] [fragment bytes] [frames]"
+       << std::endl;
+  cout << "Encrypts as many msgr2.1 secure mode message frames with a 200 byte"
+       << " front and that many data bytes, made of buffers of fragment bytes,"
+       << " with and without coalescing them (see ms_secure_coalesce_len), and"
+       << " reports the bytes encrypted per second of CPU time." << std::endl;
+}
+
+static bufferlist make_payload(unsigned len, unsigned fragment_len)
+{
+  bufferlist bl;
+  for (unsigned off = 0; off < len; off += fragment_len) {
+    bufferptr bp(std::min(fragment_len, len - off));
+    memset(bp.c_str(), 'D', bp.length());
+    bl.push_back(std::move(bp));
+  }
+  return bl;
+}
+
+static uint64_t thread_cpu_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static double run(uint64_t coalesce_len, const bufferlist& front,
+		  const bufferlist& data, unsigned frames)
+{
+  g_ceph_context->_conf.set_val_or_die("ms_secure_coalesce_len",
+				       std::to_string(coalesce_len));
+  AuthConnectionMeta auth_meta;
+  auth_meta.con_mode = CEPH_CON_MODE_SECURE;
+  auth_meta.connection_secret.resize(64);
+  g_ceph_context->random()->get_bytes(auth_meta.connection_secret.data(),
+				      auth_meta.connection_secret.size());
+  auto crypto = ceph::crypto::onwire::rxtx_t::create_handler_pair(
+    g_ceph_context, auth_meta, /*new_nonce_format=*/true, /*crossed=*/false);
+  ceph::compression::onwire::rxtx_t comp;
+  FrameAssembler frame_asm(&crypto, /*is_rev1=*/true, true, &comp);
+
+  ceph_msg_header2 header = {};
+  uint64_t bytes = 0;
+  uint64_t start = thread_cpu_ns();
+  for (unsigned i = 0; i < frames; i++) {
+    auto frame = MessageFrame::Encode(header, front, bufferlist(), data);
+    bytes += frame.get_buffer(frame_asm).length();
+  }
+  uint64_t ns = std::max<uint64_t>(thread_cpu_ns() - start, 1);
+  return (double)bytes / ns;
+}
+
+int main(int argc, char **argv)
+{
+  auto args = argv_to_vec(argc, argv);
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+
+  if (ceph_argparse_need_usage(args)) {
+    usage(argv[0]);
+    return 0;
+  }
+  unsigned len = args.size() > 0 ? atoi(args[0]) : 65536;
+  unsigned fragment_len = args.size() > 1 ? atoi(args[1]) : 512;
+  unsigned frames = args.size() > 2 ? atoi(args[2]) : 10000;
+  if (!fragment_len || !frames) {
+    usage(argv[0]);
+    return 1;
+  }
+  uint64_t coalesce_len =
+    g_conf().get_val<Option::size_t>("ms_secure_coalesce_len");
+
+  // an encoded message front is usually made of many small buffers
+  const bufferlist front = make_payload(200, 8);
+  const bufferlist data = make_payload(len, fragment_len);
+  cout << " frames " << frames << ", data bytes " << len
+       << " in buffers of " << fragment_len << " bytes" << std::endl;
+  cout << " one by one: " << run(0, front, data, frames)
+       << " GB/s per core" << std::endl;
+  cout << " coalesced below " << coalesce_len << " bytes: "
+       << run(coalesce_len, front, data, frames)
+       << " GB/s per core" << std::endl;
+  return 0;
+}
@@ -18,6 +18,7 @@
 #include <stdint.h>
 #include <string>
 #include <unistd.h>
+#include <sys/resource.h>
 #include <iostream>
 
 using namespace std;
@@ -32,6 +33,18 @@ using namespace std;
 
 #include <atomic>
 
+#ifdef HAVE_LIBTCMALLOC
+#include <gperftools/malloc_hook.h>
+#endif
+
+static std::atomic<uint64_t> num_allocs{0};
+
+#ifdef HAVE_LIBTCMALLOC
+static void count_alloc(const void* ptr, size_t size) {
+  num_allocs.fetch_add(1, std::memory_order_relaxed);
+}
+#endif
+
 class MessengerClient {
   class ClientThread;
   class ClientDispatcher : public Dispatcher {
@@ -166,7 +179,8 @@ void MessengerClient::ClientDispatcher::ms_fast_dispatch(Message *m) {
 
 
 void usage(const string &name) {
-  cout << "Usage: " << name << " [server ip:port] [numjobs] [concurrency] [ios] [thinktime us] [msg length]" << std::endl;
+  cout << "Usage: " << name << " [--count-allocs] [server ip:port] [numjobs] [concurrency] [ios] [thinktime us] [msg length]" << std::endl;
+  cout << "       [--count-allocs]: report the memory allocations per message (needs tcmalloc)" << std::endl;
   cout << "       [server ip:port]: connect to the ip:port pair" << std::endl;
   cout << "       [numjobs]: how much client threads spawned and do benchmark" << std::endl;
   cout << "       [concurrency]: the max inflight messages(like iodepth in fio)" << std::endl;
@@ -185,6 +199,21 @@ int main(int argc, char **argv)
   common_init_finish(g_ceph_context);
   g_ceph_context->_conf.apply_changes(nullptr);
 
+  bool count_allocs = false;
+  for (auto i = args.begin(); i != args.end(); ) {
+    if (ceph_argparse_flag(args, i, "--count-allocs", (char*)NULL)) {
+      count_allocs = true;
+    } else {
+      ++i;
+    }
+  }
+#ifndef HAVE_LIBTCMALLOC
+  if (count_allocs) {
+    cerr << "--count-allocs needs a build with tcmalloc" << std::endl;
+    return 1;
+  }
+#endif
+
   if (args.size() < 6) {
     usage(argv[0]);
     return 1;
@@ -210,10 +239,38 @@ int main(int argc, char **argv)
 
   client.ready(concurrent, numjobs, ios, len);
   Cycles::init();
+  auto cpu_time = [] {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000ull +
+      ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+  };
+#ifdef HAVE_LIBTCMALLOC
+  if (count_allocs) {
+    MallocHook::AddNewHook(&count_alloc);
+  }
+#endif
+  uint64_t cpu_start = cpu_time();
   uint64_t start = Cycles::rdtsc();
   client.start();
   uint64_t stop = Cycles::rdtsc();
-  cout << " Total op " << (ios * numjobs) << " run time " << Cycles::to_microseconds(stop - start) << "us." << std::endl;
+  uint64_t cpu_us = cpu_time() - cpu_start;
+#ifdef HAVE_LIBTCMALLOC
+  if (count_allocs) {
+    MallocHook::RemoveNewHook(&count_alloc);
+  }
+#endif
+  uint64_t us = Cycles::to_microseconds(stop - start);
+  uint64_t total = (uint64_t)ios * numjobs;
+  cout << " Total op " << total << " run time " << us << "us." << std::endl;
+  cout << " " << total * 1000000 / std::max<uint64_t>(us, 1) << " msgs/s, "
+       << (double)cpu_us / std::max<uint64_t>(total, 1)
+       << " cpu us/msg (client)" << std::endl;
+  if (count_allocs) {
+    // a message sent and its reply received
+    cout << " " << (double)num_allocs / std::max<uint64_t>(total, 1)
+	 << " allocs/msg (client)" << std::endl;
+  }
 
   return 0;
 }
@@ -29,6 +29,9 @@
 #include "include/Context.h"
 #include "msg/async/Event.h"
 #include "msg/async/Stack.h"
+#ifdef HAVE_ASYNC_URING
+#include "msg/async/IoUringStack.h"
+#endif
 
 using namespace std;
 
@@ -71,6 +74,12 @@ class NetworkWorkerTest : public ::testing::TestWithParam<const char*> {
   NetworkWorkerTest() {}
   void SetUp() override {
     cerr << __func__ << " start set up " << GetParam() << std::endl;
+#ifdef HAVE_ASYNC_URING
+    if (!strcmp(GetParam(), "io_uring") &&
+	!IoUringNetworkStack::is_supported(g_ceph_context)) {
+      GTEST_SKIP() << "io_uring sockets are not supported by the kernel";
+    }
+#endif
     if (strncmp(GetParam(), "dpdk", 4)) {
       g_ceph_context->_conf.set_val("ms_type", "async+posix");
       addr = "127.0.0.1:15000";
@@ -86,7 +95,9 @@ class NetworkWorkerTest : public ::testing::TestWithParam<const char*> {
     stack->start();
   }
   void TearDown() override {
-    stack->stop();
+    if (stack) {
+      stack->stop();
+    }
   }
   string get_addr() const {
     return addr;
@@ -1058,6 +1069,9 @@ INSTANTIATE_TEST_SUITE_P(
   ::testing::Values(
 #ifdef HAVE_DPDK
     "dpdk",
+#endif
+#ifdef HAVE_ASYNC_URING
+    "io_uring",
 #endif
     "posix"
   )
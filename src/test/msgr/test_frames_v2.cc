@@ -232,8 +232,30 @@ protected:
                       frame_asm.get_frame_onwire_len());
   }
 
+  // the same contents, in buffers of various lengths
+  static bufferlist fragment(const bufferlist& bl) {
+    static const unsigned lens[] = {1, 7, 64, 15, 200};
+    bufferlist out;
+    unsigned off = 0;
+    for (size_t i = 0; off < bl.length(); i++) {
+      unsigned len = std::min(lens[i % std::size(lens)], bl.length() - off);
+      bufferptr bp(len);
+      bl.begin(off).copy(len, bp.c_str());
+      out.push_back(std::move(bp));
+      off += len;
+    }
+    return out;
+  }
+
   void test_round_trip() {
-    auto tx_frame = TestFrame::Encode(m_header, m_front, m_middle, m_data);
+    test_round_trip(m_header, m_front, m_middle, m_data);
+  }
+
+  void test_round_trip(const bufferlist& header,
+                       const bufferlist& front,
+                       const bufferlist& middle,
+                       const bufferlist& data) {
+    auto tx_frame = TestFrame::Encode(header, front, middle, data);
     auto onwire_bl = tx_frame.get_buffer(m_tx_frame_asm);
     check_frame_assembler(m_tx_frame_asm);
     EXPECT_EQ(m_tx_frame_asm.get_frame_onwire_len(), onwire_bl.length());
@@ -279,6 +301,13 @@ TEST_P(RoundTripTest, Reuse) {
   }
 }
 
+TEST_P(RoundTripTest, Fragmented) {
+  for (int i = 0; i < 3; i++) {
+    test_round_trip(fragment(m_header), fragment(m_front),
+                    fragment(m_middle), fragment(m_data));
+  }
+}
+
 static const round_trip_instance_t round_trip_instances[] = {
   // first segment is empty
   { 0,   0,   0,   0, 1, {{32,  0,  17,   0,   0,  0},
@@ -415,6 +444,17 @@ static const round_trip_instance_t round_trip_instances[] = {
                           {32, 64, 112, 208, 304, 32},
                           {32, 53, 101, 202, 303, 13},
                           {96, 32, 112, 208, 304, 32}}},
+
+  // first segment is partially inlined, and too long to share a buffer
+  // with the preamble
+  {600,  0,   0,   0, 1, {{32, 600,  0,   0,   0, 17},
+                          {32, 608,  0,   0,   0, 32},
+                          {32, 604,  0,   0,   0,  0},
+                          {96, 576,  0,   0,   0,  0}}},
+  {600,  0,   0, 303, 4, {{32, 600,  0,   0, 303, 17},
+                          {32, 608,  0,   0, 304, 32},
+                          {32, 604,  0,   0, 303, 13},
+                          {96, 576,  0,   0, 304, 32}}},
 };
 
 INSTANTIATE_TEST_SUITE_P(
@@ -477,6 +517,8 @@ int main(int argc, char* argv[]) {
                          CODE_ENVIRONMENT_UTILITY,
                          CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
   common_init_finish(g_ceph_context);
+  // have secure mode both coalesce buffers and encrypt them one by one
+  g_ceph_context->_conf.set_val_or_die("ms_secure_coalesce_len", "64");
 
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
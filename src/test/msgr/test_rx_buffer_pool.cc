@@ -0,0 +1,116 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include "include/mempool.h"
+#include "include/page.h"
+#include "msg/async/RxBufferPool.h"
+
+using ceph::bufferptr;
+
+static bufferptr get(RxBufferPool& pool, unsigned len, unsigned align,
+		     bool *hit)
+{
+  auto raw = pool.get(len, align, hit);
+  if (!raw) {
+    return bufferptr();
+  }
+  return bufferptr(std::move(raw));
+}
+
+TEST(RxBufferPool, recycle)
+{
+  auto pool = std::make_shared<RxBufferPool>(1 << 20, 64 << 10);
+  bool hit = true;
+  auto bp = get(*pool, 4096, CEPH_PAGE_SIZE, &hit);
+  ASSERT_FALSE(hit);
+  ASSERT_EQ(4096u, bp.length());
+  ASSERT_EQ(0u, (uintptr_t)bp.c_str() % CEPH_PAGE_SIZE);
+  const char *data = bp.c_str();
+  bp = bufferptr();
+  ASSERT_EQ(4096u, pool->get_bytes());
+
+  // a shorter one of the same size class
+  bp = get(*pool, 3000, CEPH_PAGE_SIZE, &hit);
+  ASSERT_TRUE(hit);
+  ASSERT_EQ(3000u, bp.length());
+  ASSERT_EQ(data, bp.c_str());
+  ASSERT_EQ(0u, pool->get_bytes());
+
+  // until the last reference is gone
+  bufferptr other(bp, 0, 100);
+  bp = bufferptr();
+  ASSERT_EQ(0u, pool->get_bytes());
+  other = bufferptr();
+  ASSERT_EQ(4096u, pool->get_bytes());
+}
+
+TEST(RxBufferPool, classes)
+{
+  auto pool = std::make_shared<RxBufferPool>(1 << 20, 64 << 10);
+  bool hit;
+  get(*pool, 300, 8, &hit);
+  ASSERT_EQ(512u, pool->get_bytes());
+  get(*pool, 1, 8, &hit);
+  ASSERT_EQ(512u + 256u, pool->get_bytes());
+
+  // not page aligned
+  get(*pool, 500, CEPH_PAGE_SIZE, &hit);
+  ASSERT_FALSE(hit);
+  auto bp = get(*pool, 500, 16, &hit);
+  ASSERT_TRUE(hit);
+  ASSERT_EQ(0u, (uintptr_t)bp.c_str() % 16);
+
+  // not dealt with
+  ASSERT_FALSE(pool->get((64 << 10) + 1, 8, &hit));
+  ASSERT_FALSE(pool->get(4096, 2 * CEPH_PAGE_SIZE, &hit));
+  ASSERT_FALSE(pool->get(4096, 24, &hit));
+  ASSERT_FALSE(pool->get(0, 8, &hit));
+}
+
+TEST(RxBufferPool, max_bytes)
+{
+  auto pool = std::make_shared<RxBufferPool>(8192, 64 << 10);
+  bool hit;
+  {
+    auto a = get(*pool, 4096, 8, &hit);
+    auto b = get(*pool, 4096, 8, &hit);
+    auto c = get(*pool, 4096, 8, &hit);
+  }
+  ASSERT_EQ(8192u, pool->get_bytes());
+
+  auto disabled = std::make_shared<RxBufferPool>(0, 64 << 10);
+  ASSERT_FALSE(disabled->enabled());
+  ASSERT_FALSE(disabled->get(4096, 8, &hit));
+}
+
+TEST(RxBufferPool, mempool)
+{
+  auto& rx_pool = mempool::get_pool(mempool::mempool_msgr_rx_pool);
+  const size_t before = rx_pool.allocated_bytes();
+  auto pool = std::make_shared<RxBufferPool>(1 << 20, 64 << 10);
+  bool hit;
+  auto bp = get(*pool, 4096, 8, &hit);
+  ASSERT_EQ(before, rx_pool.allocated_bytes());
+  bp = bufferptr();
+  ASSERT_EQ(before + 4096, rx_pool.allocated_bytes());
+
+  // the buffers in use outlive the pool
+  bp = get(*pool, 4096, 8, &hit);
+  ASSERT_TRUE(hit);
+  pool.reset();
+  ASSERT_EQ(before, rx_pool.allocated_bytes());
+  memset(bp.c_str(), 0, bp.length());
+  bp = bufferptr();
+  ASSERT_EQ(before, rx_pool.allocated_bytes());
+}
@@ -0,0 +1,87 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include "msg/async/ZeroCopyTracker.h"
+
+using ceph::bufferlist;
+
+static bufferlist make_bl(unsigned len)
+{
+  bufferlist bl;
+  bl.append(std::string(len, 'z'));
+  return bl;
+}
+
+TEST(ZeroCopyTracker, in_order)
+{
+  ZeroCopyTracker zc;
+  auto bl = make_bl(300);
+  zc.pin(bl, 0, 100, 2);    // 0-1
+  zc.pin(bl, 100, 100, 1);  // 2
+  zc.pin(bl, 200, 100, 3);  // 3-5
+  ASSERT_EQ(3u, zc.size());
+  zc.complete(0, 1);
+  ASSERT_EQ(2u, zc.size());
+  zc.complete(2, 5);
+  ASSERT_TRUE(zc.empty());
+}
+
+TEST(ZeroCopyTracker, out_of_order)
+{
+  ZeroCopyTracker zc;
+  auto bl = make_bl(300);
+  zc.pin(bl, 0, 100, 2);    // 0-1
+  zc.pin(bl, 100, 100, 1);  // 2
+  zc.pin(bl, 200, 100, 3);  // 3-5
+  zc.complete(2, 4);
+  ASSERT_EQ(3u, zc.size());
+  zc.complete(1, 1);
+  ASSERT_EQ(3u, zc.size());
+  // the first two are done, the last still waits for 5
+  zc.complete(0, 0);
+  ASSERT_EQ(1u, zc.size());
+  zc.complete(5, 5);
+  ASSERT_TRUE(zc.empty());
+}
+
+TEST(ZeroCopyTracker, wrap)
+{
+  ZeroCopyTracker zc(0xfffffffe);
+  auto bl = make_bl(200);
+  zc.pin(bl, 0, 100, 3);    // 0xfffffffe-0
+  zc.pin(bl, 100, 100, 2);  // 1-2
+  zc.complete(0xffffffff, 1);
+  ASSERT_EQ(2u, zc.size());
+  zc.complete(0xfffffffe, 0xfffffffe);
+  ASSERT_EQ(1u, zc.size());
+  zc.complete(2, 2);
+  ASSERT_TRUE(zc.empty());
+
+  // and once more, from after the wrap
+  zc.pin(bl, 0, 200, 1);    // 3
+  zc.complete(3, 3);
+  ASSERT_TRUE(zc.empty());
+}
+
+TEST(ZeroCopyTracker, wrap_merged)
+{
+  ZeroCopyTracker zc(0xfffffff0);
+  auto bl = make_bl(400);
+  for (unsigned i = 0; i < 4; ++i) {
+    zc.pin(bl, i * 100, 100, 8);
+  }
+  // 0xfffffff0 to 0x0000000f in one go
+  zc.complete(0xfffffff0, 0x0000000f);
+  ASSERT_TRUE(zc.empty());
+}
@@ -4,7 +4,9 @@
  * In memory space allocator benchmarks.
  * Author: Igor Fedotov, ifedotov@suse.com
  */
+#include <atomic>
 #include <iostream>
+#include <thread>
 #include <boost/scoped_ptr.hpp>
 #include <gtest/gtest.h>
 
@@ -328,6 +330,83 @@ TEST_P(AllocTest, test_alloc_bench_10_300)
   doOverwriteTest(capacity, prefill, overwrite);
 }
 
+// Small-write pattern from several threads at once: every op allocates
+// one unit (occasionally 64K) and frees a random earlier allocation of
+// the same thread, on top of a 50% randomly prefilled device.
+TEST_P(AllocTest, test_alloc_bench_mt)
+{
+  uint64_t capacity = uint64_t(64) * 1024 * 1024 * 1024;
+  uint64_t alloc_unit = 4096;
+  const uint64_t ops_per_thread = 1000000;
+  const size_t working_set = 1024;
+
+  for (unsigned num_threads : {1, 2, 4, 8, 16}) {
+    init_alloc(capacity, alloc_unit);
+    alloc->init_add_free(0, capacity);
+    {
+      gen_type rng(num_threads);
+      boost::uniform_int<> u1(0, 4); // 4K-64K
+      PExtentVector tmp;
+      uint64_t n = 0;
+      for (uint64_t i = 0; i < capacity / 2; ) {
+	uint64_t want = alloc_unit << u1(rng);
+	tmp.clear();
+	auto r = alloc->allocate(want, alloc_unit, 0, 0, &tmp);
+	ASSERT_EQ(static_cast<int64_t>(want), r);
+	// punch holes so that the device is fragmented
+	if (++n % 4 == 0) {
+	  alloc->release(tmp);
+	} else {
+	  i += r;
+	}
+      }
+    }
+    double frag_before = alloc->get_fragmentation();
+
+    std::atomic<uint64_t> failed = {0};
+    std::vector<std::thread> threads;
+    utime_t start = ceph_clock_now();
+    for (unsigned t = 0; t < num_threads; ++t) {
+      threads.emplace_back([&, t] {
+	gen_type rng(t + 1);
+	boost::uniform_int<> u1(0, 7);
+	boost::uniform_int<> u2(0, working_set - 1);
+	std::vector<PExtentVector> mine(working_set);
+	PExtentVector tmp;
+	for (uint64_t i = 0; i < ops_per_thread; ++i) {
+	  uint64_t want = u1(rng) == 0 ? alloc_unit * 16 : alloc_unit;
+	  auto& slot = mine[u2(rng)];
+	  if (!slot.empty()) {
+	    alloc->release(slot);
+	    slot.clear();
+	  }
+	  if (alloc->allocate(want, alloc_unit, 0, 0, &slot) !=
+	      static_cast<int64_t>(want)) {
+	    ++failed;
+	  }
+	}
+	for (auto& slot : mine) {
+	  if (!slot.empty()) {
+	    alloc->release(slot);
+	  }
+	}
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    double secs = (double)(ceph_clock_now() - start);
+    EXPECT_EQ(0u, failed);
+    std::cout << GetParam() << " threads " << num_threads
+	      << " ops/s " << (uint64_t)(num_threads * ops_per_thread / secs)
+	      << " fragmentation " << frag_before
+	      << " -> " << alloc->get_fragmentation()
+	      << " free " << alloc->get_free() / _1m << " MB"
+	      << std::endl;
+    alloc->shutdown();
+  }
+}
+
 TEST_P(AllocTest, mempoolAccounting)
 {
   uint64_t bytes = mempool::bluestore_alloc::allocated_bytes();
@@ -365,4 +444,4 @@ TEST_P(AllocTest, mempoolAccounting)
 INSTANTIATE_TEST_SUITE_P(
   Allocator,
   AllocTest,
-  ::testing::Values("stupid", "bitmap", "avl", "hybrid", "btree"));
+  ::testing::Values("stupid", "bitmap", "avl", "hybrid", "btree", "magazine"));
@@ -13,6 +13,7 @@
 #include "include/stringify.h"
 #include "include/Context.h"
 #include "os/bluestore/Allocator.h"
+#include "os/bluestore/MagazineAllocator.h"
 
 using namespace std;
 
@@ -654,6 +655,65 @@ TEST_P(AllocTest, test_init_rm_free_unbound)
   }
 }
 
+TEST(MagazineAllocator, cache_and_flush)
+{
+  uint64_t block_size = 4096;
+  uint64_t capacity = 1024 * block_size;
+  // single shard so that the test doesn't depend on the CPU it runs on
+  MagazineAllocator alloc(g_ceph_context, capacity, block_size, 64 << 20,
+			  1, 8, "");
+  alloc.init_add_free(0, capacity);
+
+  // a miss refills half a magazine and hands out one unit of it
+  PExtentVector extents;
+  EXPECT_EQ((int64_t)block_size,
+	    alloc.allocate(block_size, block_size, 0, 0, &extents));
+  ASSERT_EQ(1u, extents.size());
+  EXPECT_EQ(block_size, extents[0].length);
+  EXPECT_EQ(3 * block_size, alloc.get_cached());
+  EXPECT_EQ(capacity - block_size, alloc.get_free());
+
+  // the released unit is parked, not returned
+  alloc.release(extents);
+  EXPECT_EQ(4 * block_size, alloc.get_cached());
+  EXPECT_EQ(capacity, alloc.get_free());
+
+  // cached units must not cause ENOSPC for larger requests
+  extents.clear();
+  EXPECT_EQ((int64_t)capacity,
+	    alloc.allocate(capacity, block_size, 0, 0, &extents));
+  EXPECT_EQ(0u, alloc.get_cached());
+  EXPECT_EQ(0u, alloc.get_free());
+  alloc.release(extents);
+  EXPECT_EQ(capacity, alloc.get_free());
+
+  // nor for single unit ones
+  std::vector<PExtentVector> all(capacity / block_size);
+  for (auto& e : all) {
+    EXPECT_EQ((int64_t)block_size,
+	      alloc.allocate(block_size, block_size, 0, 0, &e));
+  }
+  extents.clear();
+  EXPECT_EQ(-ENOSPC, alloc.allocate(block_size, block_size, 0, 0, &extents));
+  EXPECT_EQ(0u, alloc.get_free());
+
+  // overflowing the magazine returns the older half
+  for (auto& e : all) {
+    alloc.release(e);
+    EXPECT_GE(8 * block_size, alloc.get_cached());
+  }
+  EXPECT_EQ(capacity, alloc.get_free());
+
+  // foreach sees the cached units as free
+  uint64_t total = 0;
+  alloc.foreach([&](uint64_t off, uint64_t len) {
+    total += len;
+  });
+  EXPECT_EQ(capacity, total);
+  EXPECT_EQ(0u, alloc.get_cached());
+  alloc.shutdown();
+}
+
 INSTANTIATE_TEST_SUITE_P(
   Allocator,
   AllocTest,
@@ -0,0 +1,163 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+/*
+ * Compare the two ways deep scrub gets the data digest of an object:
+ * read() it by osd_deep_scrub_stride pieces and hash them, or ask the
+ * store for their digest().  Reports the throughput and the cpu time of
+ * both for each store.
+ */
+
+#include <ctime>
+#include <iostream>
+
+#include <gtest/gtest.h>
+
+#include "common/Clock.h"
+#include "common/ceph_argparse.h"
+#include "global/global_init.h"
+#include "include/stringify.h"
+#include "os/ObjectStore.h"
+#include "store_test_fixture.h"
+
+using namespace std;
+
+static unsigned num_objects = 64;
+static uint64_t object_size = 4 << 20;
+static unsigned passes = 3;
+static const uint64_t stride = 512 << 10;
+
+class ScrubDigestBench : public StoreTestFixture,
+			 public ::testing::WithParamInterface<const char*> {
+public:
+  ScrubDigestBench()
+    : StoreTestFixture(GetParam())
+  {}
+};
+
+static double cpu_seconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+TEST_P(ScrubDigestBench, ReadVsDigest) {
+  SetVal(g_conf(), "bluestore_csum_type", "crc32c");
+  g_conf().apply_changes(nullptr);
+
+  coll_t cid;
+  ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    ASSERT_EQ(0, store->queue_transaction(ch, std::move(t)));
+  }
+  bufferptr bp(object_size);
+  for (uint64_t i = 0; i < object_size; ++i) {
+    bp[i] = rand();
+  }
+  bufferlist data;
+  data.append(bp);
+  vector<ghobject_t> oids;
+  for (unsigned i = 0; i < num_objects; ++i) {
+    oids.emplace_back(hobject_t(sobject_t("object_" + stringify(i),
+					  CEPH_NOSNAP)));
+    ObjectStore::Transaction t;
+    t.write(cid, oids.back(), 0, data.length(), data);
+    ASSERT_EQ(0, store->queue_transaction(ch, std::move(t)));
+  }
+  // start from the disk, like deep scrub does
+  ch.reset();
+  ASSERT_EQ(0, store->umount());
+  ASSERT_EQ(0, store->mount());
+  ch = store->open_collection(cid);
+
+  const uint32_t flags = CEPH_OSD_OP_FLAG_FADVISE_SEQUENTIAL |
+    CEPH_OSD_OP_FLAG_FADVISE_DONTNEED |
+    CEPH_OSD_OP_FLAG_BYPASS_CLEAN_CACHE;
+  vector<uint32_t> expected;
+  auto run = [&](const char *mode, bool use_digest) {
+    utime_t start = ceph_clock_now();
+    double cpu_start = cpu_seconds();
+    for (unsigned pass = 0; pass < passes; ++pass) {
+      for (unsigned i = 0; i < num_objects; ++i) {
+	uint32_t crc = -1;
+	for (uint64_t off = 0; off < object_size; off += stride) {
+	  int r;
+	  if (use_digest) {
+	    r = store->digest(ch, oids[i], off, stride, &crc, flags);
+	  } else {
+	    bufferlist bl;
+	    r = store->read(ch, oids[i], off, stride, bl, flags);
+	    crc = bl.crc32c(crc);
+	  }
+	  ASSERT_EQ((int)stride, r);
+	}
+	if (expected.size() <= i) {
+	  expected.push_back(crc);
+	}
+	ASSERT_EQ(expected[i], crc);
+      }
+    }
+    double elapsed = (double)(ceph_clock_now() - start);
+    double cpu = cpu_seconds() - cpu_start;
+    double mb = (double)object_size * num_objects * passes / (1 << 20);
+    cout << GetParam() << "\t" << mode << "\t"
+	 << mb / elapsed << "\t" << cpu * 1000 / mb << std::endl;
+  };
+  cout << "store\tmode\tMB/s\tcpu ms/MB" << std::endl;
+  run("read", false);
+  run("digest", true);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+  ObjectStore,
+  ScrubDigestBench,
+  ::testing::Values(
+    "memstore"
+#if defined(WITH_BLUESTORE)
+    , "bluestore"
+#endif
+    ));
+
+int main(int argc, char **argv) {
+  auto args = argv_to_vec(argc, argv);
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+
+  std::string val;
+  for (auto i = args.begin(); i != args.end(); ) {
+    if (ceph_argparse_double_dash(args, i)) {
+      break;
+    } else if (ceph_argparse_witharg(args, i, &val, "--objects", (char*)NULL)) {
+      num_objects = std::stoul(val);
+    } else if (ceph_argparse_witharg(args, i, &val, "--object-size", (char*)NULL)) {
+      object_size = std::stoull(val);
+    } else if (ceph_argparse_witharg(args, i, &val, "--passes", (char*)NULL)) {
+      passes = std::stoul(val);
+    } else {
+      ++i;
+    }
+  }
+  // whole strides keep the comparison simple
+  object_size = std::max(stride, object_size / stride * stride);
+
+  // make sure we can adjust any config settings
+  g_ceph_context->_conf._clear_safe_to_start_threads();
+  g_ceph_context->_conf.set_val_or_die("bluestore_fsck_on_mkfs", "false");
+  g_ceph_context->_conf.set_val_or_die("bluestore_fsck_on_mount", "false");
+  g_ceph_context->_conf.set_val_or_die("bluestore_fsck_on_umount", "false");
+  g_ceph_context->_conf.set_val_or_die("bluestore_block_size",
+    stringify(std::max<uint64_t>(10ull << 30,
+				 2 * object_size * num_objects)));
+  g_ceph_context->_conf.set_val_or_die("memstore_device_bytes",
+    stringify(std::max<uint64_t>(1ull << 30,
+				 2 * object_size * num_objects)));
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
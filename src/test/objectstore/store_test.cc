@@ -1594,6 +1594,175 @@ TEST_P(StoreTestSpecificAUSize, ReproBug41901Test) {
 }
 
 
+TEST_P(StoreTestSpecificAUSize, CompressedChunksPartialReadTest) {
+  if(string(GetParam()) != "bluestore")
+    return;
+
+  SetVal(g_conf(), "bluestore_compression_algorithm", "snappy");
+  SetVal(g_conf(), "bluestore_compression_mode", "force");
+  SetVal(g_conf(), "bluestore_compression_max_blob_size", "65536");
+  SetVal(g_conf(), "bluestore_compression_chunk_size", "16384");
+  g_conf().apply_changes(nullptr);
+  StartDeferred(4096);
+
+  int r;
+  coll_t cid;
+  ghobject_t hoid(hobject_t(sobject_t("Object 1", CEPH_NOSNAP)));
+  ghobject_t hoid2(hobject_t(sobject_t("Object 2", CEPH_NOSNAP)));
+  const PerfCounters* logger = store->get_perf_counters();
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  // compressible, but every 4K differs so misplaced data would show
+  bufferlist data;
+  for (unsigned i = 0; i < 64; ++i) {
+    data.append(std::string(0x1000, 'a' + i % 26));
+  }
+  {
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, 0, data.length(), data);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  // and the same without chunks
+  SetVal(g_conf(), "bluestore_compression_chunk_size", "0");
+  g_conf().apply_changes(nullptr);
+  {
+    ObjectStore::Transaction t;
+    t.write(cid, hoid2, 0, data.length(), data);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  ch.reset();
+  EXPECT_EQ(store->umount(), 0);
+  EXPECT_EQ(store->mount(), 0);
+  ch = store->open_collection(cid);
+
+  auto check_read = [&](const ghobject_t& oid, uint64_t off, uint64_t len,
+                        uint64_t expect_decompressed) {
+    uint64_t before = logger->get(l_bluestore_decompressed_bytes);
+    uint64_t wanted_before = logger->get(l_bluestore_decompressed_wanted_bytes);
+    bufferlist in, expected;
+    r = store->read(ch, oid, off, len, in);
+    ASSERT_EQ((int)len, r);
+    expected.substr_of(data, off, len);
+    ASSERT_TRUE(bl_eq(expected, in));
+    ASSERT_EQ(expect_decompressed,
+              logger->get(l_bluestore_decompressed_bytes) - before);
+    ASSERT_EQ(len,
+              logger->get(l_bluestore_decompressed_wanted_bytes) - wanted_before);
+  };
+  // one chunk for a small read, two when it straddles them, the whole
+  // blob when it was compressed as one
+  check_read(hoid, 0x11000, 0x1000, 0x4000);
+  check_read(hoid, 0x23000, 0x2000, 0x8000);
+  check_read(hoid2, 0x11000, 0x1000, 0x10000);
+  {
+    bufferlist in;
+    r = store->read(ch, hoid, 0, data.length(), in);
+    ASSERT_EQ((int)data.length(), r);
+    ASSERT_TRUE(bl_eq(data, in));
+  }
+  ch.reset();
+  EXPECT_EQ(store->umount(), 0);
+  ASSERT_EQ(store->fsck(true), 0);
+  EXPECT_EQ(store->mount(), 0);
+}
+
+TEST_P(StoreTestSpecificAUSize, DigestTest) {
+  if (string(GetParam()) == "bluestore") {
+    SetVal(g_conf(), "bluestore_csum_type", "crc32c");
+  }
+  StartDeferred(4096);
+
+  int r;
+  coll_t cid;
+  ghobject_t hoid(hobject_t(sobject_t("Object 1", CEPH_NOSNAP)));
+  ghobject_t hoid2(hobject_t(sobject_t("Object 2", CEPH_NOSNAP)));
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  bufferlist data;
+  for (unsigned i = 0; i < 64; ++i) {
+    data.append(std::string(0x1000, 'a' + i % 26));
+  }
+  {
+    // blobs, a hole and a small overwrite across them
+    ObjectStore::Transaction t;
+    bufferlist a, b, c;
+    a.substr_of(data, 0, 0x20000);
+    b.substr_of(data, 0x30000, 0x10000);
+    c.append(std::string(0x1800, 'z'));
+    t.write(cid, hoid, 0, a.length(), a);
+    t.write(cid, hoid, 0x30000, b.length(), b);
+    t.write(cid, hoid, 0x1f400, c.length(), c);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  if (string(GetParam()) == "bluestore") {
+    SetVal(g_conf(), "bluestore_compression_algorithm", "snappy");
+    SetVal(g_conf(), "bluestore_compression_mode", "force");
+    g_conf().apply_changes(nullptr);
+  }
+  {
+    ObjectStore::Transaction t;
+    t.write(cid, hoid2, 0, data.length(), data);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+
+  auto check_digest = [&](const ghobject_t& oid, uint64_t off, uint64_t len,
+                          uint32_t flags) {
+    bufferlist in;
+    int rr = store->read(ch, oid, off, len, in, flags);
+    ASSERT_LE(0, rr);
+    uint32_t crc = -1;
+    r = store->digest(ch, oid, off, len, &crc, flags);
+    ASSERT_EQ(rr, r);
+    ASSERT_EQ(in.crc32c(-1), crc);
+  };
+  auto check_all = [&](uint32_t flags) {
+    for (auto& oid : {hoid, hoid2}) {
+      check_digest(oid, 0, 0, flags);
+      check_digest(oid, 0, 0x40000, flags);
+      check_digest(oid, 0x1000, 0x20000, flags);
+      check_digest(oid, 0x1e123, 0x12345, flags);
+      check_digest(oid, 0x2f000, 0x800, flags);
+      check_digest(oid, 0x3ff00, 0x1000, flags);
+      check_digest(oid, 0x50000, 0x1000, flags);
+    }
+  };
+  // with the overwrite still in the cache, then from the disk
+  check_all(0);
+  check_all(CEPH_OSD_OP_FLAG_BYPASS_CLEAN_CACHE);
+  ch.reset();
+  EXPECT_EQ(store->umount(), 0);
+  EXPECT_EQ(store->mount(), 0);
+  ch = store->open_collection(cid);
+  if (string(GetParam()) == "bluestore") {
+    const PerfCounters* logger = store->get_perf_counters();
+    uint64_t before = logger->get(l_bluestore_digest_csum_bytes);
+    check_all(CEPH_OSD_OP_FLAG_BYPASS_CLEAN_CACHE);
+    ASSERT_LT(before, logger->get(l_bluestore_digest_csum_bytes));
+  } else {
+    check_all(CEPH_OSD_OP_FLAG_BYPASS_CLEAN_CACHE);
+  }
+  {
+    uint32_t crc = 0;
+    r = store->digest(ch, ghobject_t(hobject_t(sobject_t("Object 3", CEPH_NOSNAP))),
+                      0, 0x1000, &crc);
+    ASSERT_EQ(-ENOENT, r);
+  }
+}
+
 TEST_P(StoreTestSpecificAUSize, BluestoreStatFSTest) {
   if(string(GetParam()) != "bluestore")
     return;
@@ -7189,6 +7358,22 @@ TEST_P(StoreTestSpecificAUSize, TooManyBlobsTest) {
   doMany4KWritesTest(store.get(), 1, 1000, max_object, 4*1024, 0);
 }
 
+TEST_P(StoreTestSpecificAUSize, Many4KWritesKVSyncPipelineTest) {
+  if (string(GetParam()) != "bluestore")
+    return;
+  if (smr) {
+    cout << "SKIP: no deferred; assertions around res_stat.allocated don't apply"
+	 << std::endl;
+    return;
+  }
+  SetVal(g_conf(), "bluestore_kv_sync_pipeline", "true");
+  g_conf().apply_changes(nullptr);
+  StartDeferred(0x10000);
+
+  const unsigned max_object = 4*1024*1024;
+  doMany4KWritesTest(store.get(), 10, 1000, max_object, 4*1024, 0);
+}
+
 #if defined(WITH_BLUESTORE)
 void get_mempool_stats(uint64_t* total_bytes, uint64_t* total_items)
 {
@@ -7311,6 +7496,66 @@ TEST_P(StoreTestSpecificAUSize, OnodeSizeTracking) {
   }
 }
 
+// a benchmark rather than a test: run it with
+// --gtest_also_run_disabled_tests --gtest_filter=*OnodeLookupContention*
+TEST_P(StoreTest, DISABLED_OnodeLookupContention) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  // stat() is served entirely from the onode cache once the onodes are
+  // loaded, so this measures OnodeSpace::lookup() and the unpin path
+  // under an increasing number of concurrent readers.
+  const unsigned num_objects = 64;
+  const unsigned ops_per_thread = 200000;
+  int r;
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  vector<ghobject_t> oids;
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    for (unsigned i = 0; i < num_objects; ++i) {
+      ghobject_t hoid(hobject_t(sobject_t("Object " + stringify(i),
+					  CEPH_NOSNAP)));
+      t.touch(cid, hoid);
+      oids.push_back(hoid);
+    }
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  for (unsigned nthreads = 1; nthreads <= 16; nthreads *= 2) {
+    std::atomic<unsigned> errors = {0};
+    vector<std::thread> threads;
+    auto start = ceph::mono_clock::now();
+    for (unsigned t = 0; t < nthreads; ++t) {
+      threads.emplace_back([&, t] {
+	struct stat st;
+	for (unsigned i = 0; i < ops_per_thread; ++i) {
+	  if (store->stat(ch, oids[(i + t) % num_objects], &st) < 0) {
+	    ++errors;
+	  }
+	}
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    double secs = ceph::to_seconds<double>(ceph::mono_clock::now() - start);
+    ASSERT_EQ(errors, 0u);
+    cout << "threads " << nthreads << " reads/s "
+	 << (uint64_t)(nthreads * ops_per_thread / secs) << std::endl;
+  }
+  {
+    ObjectStore::Transaction t;
+    for (auto& hoid : oids) {
+      t.remove(cid, hoid);
+    }
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
 TEST_P(StoreTestSpecificAUSize, BlobReuseOnOverwrite) {
 
   if (string(GetParam()) != "bluestore")
@@ -8538,6 +8783,95 @@ TEST_P(StoreTestSpecificAUSize, DeferredDifferentChunks) {
   }
 }
 
+TEST_P(StoreTestSpecificAUSize, DeferredElevatorAcrossCollections) {
+
+  if (string(GetParam()) != "bluestore")
+    return;
+  if (smr) {
+    cout << "SKIP: no deferred" << std::endl;
+    return;
+  }
+
+  size_t alloc_size = 4096;
+  const unsigned num_colls = 4;
+  const unsigned num_writes = 16;
+  size_t object_size = num_writes * alloc_size;
+  StartDeferred(alloc_size);
+  SetVal(g_conf(), "bluestore_prefer_deferred_size", "65536");
+  SetVal(g_conf(), "bluestore_deferred_elevator", "true");
+  SetVal(g_conf(), "bluestore_deferred_batch_ops", "1000");
+  SetVal(g_conf(), "bluestore_max_defer_interval", "1");
+  g_conf().apply_changes(nullptr);
+
+  int r;
+  const PerfCounters* logger = store->get_perf_counters();
+  std::vector<coll_t> cids;
+  std::vector<ObjectStore::CollectionHandle> chs;
+  ghobject_t hoid(hobject_t("test", "", CEPH_NOSNAP, 0, -1, ""));
+  for (unsigned c = 0; c < num_colls; ++c) {
+    cids.emplace_back(spg_t(pg_t(c, 0), shard_id_t::NO_SHARD));
+    chs.push_back(store->create_new_collection(cids.back()));
+    ObjectStore::Transaction t;
+    t.create_collection(cids.back(), 0);
+    r = queue_transaction(store, chs.back(), std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  // allocate the blocks of the objects in turns, so that those of an
+  // object are not adjacent on disk, but those of different objects are
+  for (unsigned i = 0; i < num_writes; ++i) {
+    for (unsigned c = 0; c < num_colls; ++c) {
+      ObjectStore::Transaction t;
+      bufferlist bl;
+      bl.append(std::string(alloc_size, 'a'));
+      t.write(cids[c], hoid, i * alloc_size, bl.length(), bl);
+      r = queue_transaction(store, chs[c], std::move(t));
+      ASSERT_EQ(r, 0);
+    }
+  }
+  sleep(g_conf().get_val<double>("bluestore_max_defer_interval") + 2);
+  auto ios0 = logger->get(l_bluestore_submitted_deferred_ios);
+  auto writes0 = logger->get(l_bluestore_submitted_deferred_writes);
+
+  // interleave small overwrites of all collections, every sequencer ends
+  // up with a pending batch of scattered ios
+  for (unsigned i = 0; i < num_writes; ++i) {
+    for (unsigned c = 0; c < num_colls; ++c) {
+      ObjectStore::Transaction t;
+      bufferlist bl;
+      bl.append(std::string(alloc_size, 'b' + c));
+      t.write(cids[c], hoid, (num_writes - 1 - i) * alloc_size, bl.length(), bl,
+	      CEPH_OSD_OP_FLAG_FADVISE_NOCACHE);
+      r = queue_transaction(store, chs[c], std::move(t));
+      ASSERT_EQ(r, 0);
+    }
+  }
+  sleep(g_conf().get_val<double>("bluestore_max_defer_interval") + 2);
+
+  auto ios = logger->get(l_bluestore_submitted_deferred_ios) - ios0;
+  auto writes = logger->get(l_bluestore_submitted_deferred_writes) - writes0;
+  cout << "deferred ios " << ios << " submitted as " << writes << " writes"
+       << std::endl;
+  ASSERT_EQ(ios, num_colls * num_writes);
+  // the ios of a collection are not adjacent, so only merging them with
+  // those of the others makes for fewer writes
+  ASSERT_LT(writes, ios);
+
+  for (unsigned c = 0; c < num_colls; ++c) {
+    bufferlist bl, expected;
+    r = store->read(chs[c], hoid, 0, object_size, bl);
+    ASSERT_EQ(r, (int)object_size);
+    expected.append(std::string(object_size, 'b' + c));
+    ASSERT_TRUE(bl_eq(expected, bl));
+  }
+  for (unsigned c = 0; c < num_colls; ++c) {
+    ObjectStore::Transaction t;
+    t.remove(cids[c], hoid);
+    t.remove_collection(cids[c]);
+    r = queue_transaction(store, chs[c], std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
 TEST_P(StoreTestSpecificAUSize, BlobReuseOnOverwriteReverse) {
 
   if (string(GetParam()) != "bluestore")
@@ -8980,6 +9314,205 @@ TEST_P(StoreTestSpecificAUSize, ReproBug56488Test) {
   }
 }
 
+TEST_P(StoreTestSpecificAUSize, AllocationDeltaLogTest) {
+
+  if (string(GetParam()) != "bluestore")
+    return;
+  if (smr) {
+    cout << "SKIP: no allocation file with smr" << std::endl;
+    return;
+  }
+
+  size_t alloc_size = 65536;
+  size_t obj_size = 0x30000;
+  SetVal(g_conf(), "bluestore_debug_enforce_settings", "hdd");
+  SetVal(g_conf(), "bluestore_allocation_delta_log", "true");
+  SetVal(g_conf(), "bluestore_allocation_delta_log_compact_entries", "16");
+  g_conf().apply_changes(nullptr);
+  StartDeferred(alloc_size);
+
+  int r;
+  coll_t cid;
+  ObjectStore::CollectionHandle ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  auto make_oid = [](unsigned i) {
+    return ghobject_t(hobject_t(sobject_t("Object " + stringify(i), CEPH_NOSNAP)));
+  };
+  auto make_data = [&](unsigned i) {
+    std::string s = "object " + stringify(i) + " ";
+    std::string v;
+    while (v.size() < obj_size) {
+      v += s;
+    }
+    v.resize(obj_size);
+    bufferlist bl;
+    bl.append(v);
+    return bl;
+  };
+
+  // The first mount rebuilds the allocator from the freelist, the later ones
+  // load the allocation file plus whatever deltas weren't folded into it.
+  // Space handed out twice would show up as overwritten objects.
+  std::set<unsigned> live;
+  unsigned next = 0;
+  for (unsigned round = 0; round < 4; ++round) {
+    unsigned first = next;
+    for (unsigned i = 0; i < 40; ++i, ++next) {
+      ObjectStore::Transaction t;
+      bufferlist bl = make_data(next);
+      t.write(cid, make_oid(next), 0, bl.length(), bl);
+      r = queue_transaction(store, ch, std::move(t));
+      ASSERT_EQ(r, 0);
+      live.insert(next);
+    }
+    for (unsigned i = first; i < next; i += 3) {
+      ObjectStore::Transaction t;
+      t.remove(cid, make_oid(i));
+      r = queue_transaction(store, ch, std::move(t));
+      ASSERT_EQ(r, 0);
+      live.erase(i);
+    }
+    ch.reset();
+    ASSERT_EQ(store->umount(), 0);
+    ASSERT_EQ(store->mount(), 0);
+    ch = store->open_collection(cid);
+    for (auto i : live) {
+      bufferlist expected = make_data(i);
+      bufferlist bl;
+      r = store->read(ch, make_oid(i), 0, obj_size, bl);
+      ASSERT_EQ(r, (int)obj_size);
+      ASSERT_TRUE(bl_eq(expected, bl));
+    }
+  }
+  {
+    ObjectStore::Transaction t;
+    for (auto i : live) {
+      t.remove(cid, make_oid(i));
+    }
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
+TEST_P(StoreTestSpecificAUSize, AllocationDeltaLogReplayTest) {
+
+  if (string(GetParam()) != "bluestore")
+    return;
+  if (smr) {
+    cout << "SKIP: no allocation file with smr" << std::endl;
+    return;
+  }
+
+  size_t alloc_size = 65536;
+  size_t obj_size = 0x30000;
+  SetVal(g_conf(), "bluestore_debug_enforce_settings", "hdd");
+  SetVal(g_conf(), "bluestore_allocation_delta_log", "true");
+  // nothing gets folded, the file is the one written by the clean umount
+  SetVal(g_conf(), "bluestore_allocation_delta_log_compact_entries", "1000000");
+  g_conf().apply_changes(nullptr);
+  StartDeferred(alloc_size);
+  BlueStore* bstore = dynamic_cast<BlueStore*> (store.get());
+
+  int r;
+  coll_t cid;
+  ObjectStore::CollectionHandle ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  auto make_oid = [](unsigned i) {
+    return ghobject_t(hobject_t(sobject_t("Object " + stringify(i), CEPH_NOSNAP)));
+  };
+  auto make_data = [&](unsigned i) {
+    std::string s = "object " + stringify(i) + " ";
+    std::string v;
+    while (v.size() < obj_size) {
+      v += s;
+    }
+    v.resize(obj_size);
+    bufferlist bl;
+    bl.append(v);
+    return bl;
+  };
+  std::set<unsigned> live;
+  unsigned next = 0;
+  auto write_and_remove = [&](unsigned count) {
+    unsigned first = next;
+    for (unsigned i = 0; i < count; ++i, ++next) {
+      ObjectStore::Transaction t;
+      bufferlist bl = make_data(next);
+      t.write(cid, make_oid(next), 0, bl.length(), bl);
+      ASSERT_EQ(queue_transaction(store, ch, std::move(t)), 0);
+      live.insert(next);
+    }
+    for (unsigned i = first; i < next; i += 3) {
+      ObjectStore::Transaction t;
+      t.remove(cid, make_oid(i));
+      ASSERT_EQ(queue_transaction(store, ch, std::move(t)), 0);
+      live.erase(i);
+    }
+  };
+  auto check = [&]() {
+    for (auto i : live) {
+      bufferlist expected = make_data(i);
+      bufferlist bl;
+      ASSERT_EQ(store->read(ch, make_oid(i), 0, obj_size, bl), (int)obj_size);
+      ASSERT_TRUE(bl_eq(expected, bl));
+    }
+  };
+
+  write_and_remove(40);
+  ch.reset();
+  ASSERT_EQ(store->umount(), 0);
+  ASSERT_EQ(store->mount(), 0);
+  ch = store->open_collection(cid);
+
+  // go down without storing the allocation file, as a crash would: only the
+  // deltas know about what happened since the last mount
+  write_and_remove(40);
+  ch.reset();
+  SetVal(g_conf(), "bluestore_debug_skip_allocation_file_destage", "true");
+  g_conf().apply_changes(nullptr);
+  ASSERT_EQ(store->umount(), 0);
+  SetVal(g_conf(), "bluestore_debug_skip_allocation_file_destage", "false");
+  g_conf().apply_changes(nullptr);
+
+  // the allocation file plus the deltas match the allocations of the onodes
+  ASSERT_EQ(store->fsck(false), 0);
+  ASSERT_EQ(bstore->read_allocation_from_drive_for_bluestore_tool(), 0);
+
+  ASSERT_EQ(store->mount(), 0);
+  // the 40 writes and 14 removals since the clean umount at least
+  ASSERT_GE(bstore->get_alloc_deltas_pending(), 54u);
+  ch = store->open_collection(cid);
+  check();
+  // space handed out twice would show up as overwritten objects
+  write_and_remove(40);
+  check();
+  ch.reset();
+  ASSERT_EQ(store->umount(), 0);
+  ASSERT_EQ(store->fsck(false), 0);
+  ASSERT_EQ(store->mount(), 0);
+  ch = store->open_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    for (auto i : live) {
+      t.remove(cid, make_oid(i));
+    }
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
 #endif //#if defined(WITH_BLUESTORE)
 
 TEST_P(StoreTest, KVDBHistogramTest) {
@@ -10159,6 +10692,76 @@ TEST_P(StoreTest, SpuriousReadErrorTest) {
   }
 }
 
+TEST_P(StoreTest, DeepFsckParallelReadTest) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  // spread over several pools, so that the object keyspace is split
+  // between the walkers
+  const unsigned num_colls = 4;
+  const unsigned num_objects = 20;
+  int r;
+  std::vector<coll_t> cids;
+  std::vector<ghobject_t> oids;
+  bufferlist test_data;
+  bufferptr ap(0x2000);
+  memset(ap.c_str(), 'a', 0x2000);
+  test_data.append(ap);
+  for (unsigned pool = 1; pool <= num_colls; ++pool) {
+    coll_t cid(spg_t(pg_t(0, pool), shard_id_t::NO_SHARD));
+    auto ch = store->create_new_collection(cid);
+    {
+      ObjectStore::Transaction t;
+      t.create_collection(cid, 0);
+      r = queue_transaction(store, ch, std::move(t));
+      ASSERT_EQ(r, 0);
+    }
+    for (unsigned i = 0; i < num_objects / num_colls; ++i) {
+      ghobject_t hoid(hobject_t("Object " + stringify(i), "", CEPH_NOSNAP,
+                                i, pool, ""));
+      ObjectStore::Transaction t;
+      t.write(cid, hoid, 0, 0x2000, test_data);
+      r = queue_transaction(store, ch, std::move(t));
+      ASSERT_EQ(r, 0);
+      cids.push_back(cid);
+      oids.push_back(hoid);
+    }
+  }
+  EXPECT_EQ(store->umount(), 0);
+
+  // every data read fails, so each object has to be reported exactly once
+  // no matter how many threads do the walking and reading
+  SetVal(g_conf(), "bluestore_retry_disk_reads", "0");
+  SetVal(g_conf(), "bluestore_debug_inject_csum_err_probability", "1");
+  for (auto threads : {"0", "1", "4"}) {
+    cerr << "deep fsck with " << threads << " threads" << std::endl;
+    SetVal(g_conf(), "bluestore_fsck_deep_threads", threads);
+    g_ceph_context->_conf.apply_changes(nullptr);
+    ASSERT_EQ(store->fsck(true), (int)num_objects);
+  }
+  SetVal(g_conf(), "bluestore_debug_inject_csum_err_probability", "0");
+  g_ceph_context->_conf.apply_changes(nullptr);
+  ASSERT_EQ(store->fsck(true), 0);
+
+  // space referenced from the first and the last part is still caught
+  // when different walkers come across it
+  BlueStore* bstore = dynamic_cast<BlueStore*> (store.get());
+  EXPECT_EQ(store->mount(), 0);
+  bstore->inject_misreference(cids.front(), oids.front(),
+                              cids.back(), oids.back(), 0);
+  int expected_errors = bstore->has_null_manager() ? 1 : 2;
+  EXPECT_EQ(store->umount(), 0);
+  for (auto threads : {"0", "4"}) {
+    cerr << "deep fsck with " << threads << " threads" << std::endl;
+    SetVal(g_conf(), "bluestore_fsck_deep_threads", threads);
+    g_ceph_context->_conf.apply_changes(nullptr);
+    ASSERT_EQ(store->fsck(true), expected_errors);
+  }
+  ASSERT_EQ(bstore->repair(false), 0);
+  ASSERT_EQ(store->fsck(true), 0);
+  EXPECT_EQ(store->mount(), 0);
+}
+
 TEST_P(StoreTest, mergeRegionTest) {
   if (string(GetParam()) != "bluestore")
     return;
@@ -3,7 +3,9 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <sys/resource.h>
 #include <iostream>
+#include <random>
 #include <gtest/gtest.h>
 #include "global/global_init.h"
 #include "global/global_context.h"
@@ -91,6 +93,85 @@ TEST(KernelDevice, Ticket45337) {
   b->close();
 }
 
+static double cpu_seconds()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+    ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+// 4K random direct IO at a fixed queue depth; reports IOPS and CPU
+// time per op for libaio, io_uring and io_uring with fixed buffers.
+// a benchmark rather than a test: run it with
+// --gtest_also_run_disabled_tests --gtest_filter=*SmallIOBench
+TEST(KernelDevice, DISABLED_SmallIOBench) {
+  const uint64_t size = 1ull << 30;
+  const unsigned io_size = 4096;
+  const unsigned qd = 32;
+  const unsigned rounds = 300;
+  TempBdev bdev{ size };
+
+  struct mode_t {
+    const char *name;
+    const char *ioring;
+    const char *fixed_buffers;
+  } modes[] = {
+    { "libaio", "false", "0" },
+    { "io_uring", "true", "0" },
+    { "io_uring-fixed", "true", "128" },
+  };
+  for (auto& m : modes) {
+    g_ceph_context->_conf.set_val_or_die("bdev_ioring", m.ioring);
+    g_ceph_context->_conf.set_val_or_die("bdev_ioring_fixed_buffers",
+					 m.fixed_buffers);
+    g_ceph_context->_conf.apply_changes(nullptr);
+
+    std::unique_ptr<BlockDevice> b(
+      BlockDevice::create(g_ceph_context, bdev.path, NULL, NULL,
+	[](void* handle, void* aio) {}, NULL));
+    int r = b->open(bdev.path);
+    ASSERT_EQ(0, r);
+    std::mt19937_64 rng(0);
+    std::uniform_int_distribution<uint64_t> dist(0, size / io_size - 1);
+    bufferlist data;
+    data.append(std::string(io_size, 'x'));
+
+    for (bool write : {true, false}) {
+      auto start = ceph::mono_clock::now();
+      double cpu_start = cpu_seconds();
+      for (unsigned i = 0; i < rounds; ++i) {
+	IOContext ioc(g_ceph_context, NULL);
+	bufferlist out[qd];
+	for (unsigned j = 0; j < qd; ++j) {
+	  uint64_t off = dist(rng) * io_size;
+	  if (write) {
+	    bufferlist bl = data;
+	    ASSERT_EQ(0, b->aio_write(off, bl, &ioc, false));
+	  } else {
+	    ASSERT_EQ(0, b->aio_read(off, io_size, &out[j], &ioc));
+	  }
+	}
+	if (ioc.has_pending_aios()) {
+	  b->aio_submit(&ioc);
+	  ioc.aio_wait();
+	}
+	ASSERT_EQ(0, ioc.get_return_value());
+      }
+      double secs = ceph::to_seconds<double>(ceph::mono_clock::now() - start);
+      double cpu = cpu_seconds() - cpu_start;
+      uint64_t ops = rounds * qd;
+      std::cout << m.name << (write ? " write" : " read")
+		<< " iops " << (uint64_t)(ops / secs)
+		<< " cpu_us/op " << cpu * 1e6 / ops << std::endl;
+    }
+    b->close();
+  }
+  g_ceph_context->_conf.set_val_or_die("bdev_ioring", "false");
+  g_ceph_context->_conf.set_val_or_die("bdev_ioring_fixed_buffers", "0");
+  g_ceph_context->_conf.apply_changes(nullptr);
+}
+
 int main(int argc, char **argv) {
   auto args = argv_to_vec(argc, argv);
   map<string,string> defaults = {
@@ -1112,6 +1112,103 @@ TEST(BlueFS, truncate_fsync) {
   }
 }
 
+TEST(BlueFS, wal_ring_recover) {
+  uint64_t size = 1048576 * 128;
+  TempBdev bdev{size};
+  uuid_d fsid;
+  ConfSaver conf(g_ceph_context->_conf);
+  conf.SetVal("bluefs_wal_ring", "true");
+  conf.ApplyChanges();
+
+  std::string content;
+  {
+    BlueFS fs(g_ceph_context);
+    ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_DB, bdev.path, false));
+    ASSERT_EQ(0, fs.mkfs(fsid, { BlueFS::BDEV_DB, false, false }));
+    ASSERT_EQ(0, fs.mount());
+    ASSERT_EQ(0, fs.mkdir("dir"));
+    BlueFS::FileWriter *h;
+    ASSERT_EQ(0, fs.open_for_write("dir", "000001.log", &h, false));
+    ASSERT_TRUE(h->file->fnode.is_wal_ring());
+    ASSERT_EQ(0, fs.preallocate(h->file, 0, 1048576));
+    for (unsigned i = 0; i < 100; ++i) {
+      std::string rec(100 + i * 37, 'a' + i % 26);
+      h->append(rec.c_str(), rec.length());
+      content += rec;
+      ASSERT_EQ(0, fs.fsync(h));
+    }
+    // all but the fsyncs that persisted new metadata skip the log
+    ASSERT_GE(fs.get_perf_counters()->get(l_bluefs_wal_ring_fsync_count), 98u);
+    fs.close_writer(h);
+    // no umount: the log never saw the final size
+  }
+  {
+    BlueFS fs(g_ceph_context);
+    ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_DB, bdev.path, false));
+    ASSERT_EQ(0, fs.mount());
+    uint64_t file_size = 0;
+    utime_t mtime;
+    ASSERT_EQ(0, fs.stat("dir", "000001.log", &file_size, &mtime));
+    ASSERT_EQ(content.length(), file_size);
+    BlueFS::FileReader *h;
+    ASSERT_EQ(0, fs.open_for_read("dir", "000001.log", &h));
+    bufferlist bl;
+    ASSERT_EQ((int)content.length(),
+	      fs.read(h, 0, content.length(), &bl, NULL));
+    ASSERT_EQ(content, bl.to_str());
+    delete h;
+    fs.umount();
+  }
+  {
+    // the recovered size must have been made durable by umount
+    conf.SetVal("bluefs_wal_ring", "false");
+    conf.ApplyChanges();
+    BlueFS fs(g_ceph_context);
+    ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_DB, bdev.path, false));
+    ASSERT_EQ(0, fs.mount());
+    uint64_t file_size = 0;
+    utime_t mtime;
+    ASSERT_EQ(0, fs.stat("dir", "000001.log", &file_size, &mtime));
+    ASSERT_EQ(content.length(), file_size);
+    fs.umount();
+  }
+}
+
+// a benchmark rather than a test: run it with
+// --gtest_also_run_disabled_tests --gtest_filter=*wal_ring_fsync_latency
+TEST(BlueFS, DISABLED_wal_ring_fsync_latency) {
+  uint64_t size = 1048576 * 128;
+  const unsigned count = 1000;
+  const std::string rec(500, 'x');
+  for (auto ring : {"false", "true"}) {
+    TempBdev bdev{size};
+    uuid_d fsid;
+    ConfSaver conf(g_ceph_context->_conf);
+    conf.SetVal("bluefs_wal_ring", ring);
+    conf.ApplyChanges();
+    BlueFS fs(g_ceph_context);
+    ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_DB, bdev.path, false));
+    ASSERT_EQ(0, fs.mkfs(fsid, { BlueFS::BDEV_DB, false, false }));
+    ASSERT_EQ(0, fs.mount());
+    ASSERT_EQ(0, fs.mkdir("dir"));
+    BlueFS::FileWriter *h;
+    ASSERT_EQ(0, fs.open_for_write("dir", "000001.log", &h, false));
+    ASSERT_EQ(0, fs.preallocate(h->file, 0, count * rec.length()));
+    auto start = mono_clock::now();
+    for (unsigned i = 0; i < count; ++i) {
+      h->append(rec.c_str(), rec.length());
+      ASSERT_EQ(0, fs.fsync(h));
+    }
+    auto elapsed = mono_clock::now() - start;
+    std::cout << "bluefs_wal_ring=" << ring << ": " << count << " fsyncs, "
+	      << std::chrono::duration<double, std::micro>(elapsed).count() / count
+	      << " us avg, " << fs.get_perf_counters()->get(l_bluefs_log_write_count)
+	      << " log writes" << std::endl;
+    fs.close_writer(h);
+    fs.umount();
+  }
+}
+
 TEST(BlueFS, test_shared_alloc) {
   uint64_t size = 1048576 * 128;
   TempBdev bdev_slow{size};
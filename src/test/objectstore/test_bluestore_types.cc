@@ -949,6 +949,48 @@ TEST(bluestore_blob_t, can_split_at)
   ASSERT_FALSE(a.can_split_at(0x2800));
 }
 
+TEST(bluestore_blob_t, compressed_chunks)
+{
+  bluestore_blob_t a;
+  a.allocated_test(bluestore_pextent_t(0x10000, 0x8000));
+  a.set_compressed(0x10000, 0x7100);
+  a.set_compressed_chunks(14, {0x1c00, 0x3900, 0x5000, 0x7100});
+  ASSERT_TRUE(a.has_compressed_chunks());
+  ASSERT_FALSE(a.can_split());
+  ASSERT_EQ(0x4000u, a.get_compressed_chunk_size());
+
+  unsigned first, last;
+  a.get_compressed_chunk_range(0, 0x1000, &first, &last);
+  ASSERT_EQ(0u, first);
+  ASSERT_EQ(0u, last);
+  a.get_compressed_chunk_range(0x3000, 0x2000, &first, &last);
+  ASSERT_EQ(0u, first);
+  ASSERT_EQ(1u, last);
+  a.get_compressed_chunk_range(0xc000, 0x4000, &first, &last);
+  ASSERT_EQ(3u, first);
+  ASSERT_EQ(3u, last);
+  ASSERT_EQ(0x5000u, a.get_compressed_chunk_start(3));
+  ASSERT_EQ(0x7100u, a.get_compressed_chunk_end(3));
+
+  size_t bound = 0;
+  a.bound_encode(bound, 2);
+  bufferlist bl;
+  {
+    auto app = bl.get_contiguous_appender(bound);
+    a.encode(app, 2);
+  }
+  bl.rebuild();
+  bluestore_blob_t b;
+  auto p = bl.front().cbegin();
+  b.decode(p, 2);
+  ASSERT_TRUE(b.has_compressed_chunks());
+  ASSERT_EQ(a.get_logical_length(), b.get_logical_length());
+  ASSERT_EQ(a.get_compressed_payload_length(),
+            b.get_compressed_payload_length());
+  ASSERT_EQ(a.compressed_chunk_order, b.compressed_chunk_order);
+  ASSERT_EQ(a.compressed_chunk_ends, b.compressed_chunk_ends);
+}
+
 TEST(bluestore_blob_t, prune_tail)
 {
   bluestore_blob_t a;
@@ -1825,6 +1867,76 @@ TEST(ExtentMap, dup_extent_map)
 }
 
 
+TEST(ExtentMap, decode_bench)
+{
+  BlueStore store(g_ceph_context, "", 4096);
+  BlueStore::OnodeCacheShard *oc = BlueStore::OnodeCacheShard::create(
+    g_ceph_context, "lru", NULL);
+  BlueStore::BufferCacheShard *bc = BlueStore::BufferCacheShard::create(
+    g_ceph_context, "lru", NULL);
+  auto coll = ceph::make_ref<BlueStore::Collection>(&store, oc, bc, coll_t());
+
+  // a typical rbd-like shard: 4K extents, each in its own csum'd blob
+  const unsigned num_extents = 512;
+  const uint32_t ext_len = 0x1000;
+  bufferlist encoded;
+  {
+    BlueStore::Onode onode(coll.get(), ghobject_t(), "");
+    BlueStore::ExtentMap& em = onode.extent_map;
+    for (unsigned i = 0; i < num_extents; ++i) {
+      BlueStore::BlobRef b(new BlueStore::Blob);
+      b->shared_blob = new BlueStore::SharedBlob(coll.get());
+      auto& bb = b->dirty_blob();
+      bb.init_csum(Checksummer::CSUM_CRC32C, 12, ext_len);
+      PExtentVector pextents;
+      pextents.emplace_back(0x100000 + i * 2 * ext_len, ext_len);
+      bb.allocated(0, ext_len, pextents);
+      auto *e = new BlueStore::Extent(i * ext_len, 0, ext_len, b);
+      em.extent_map.insert(*e);
+      b->get_ref(coll.get(), 0, ext_len);
+      bb.mark_used(0, ext_len);
+    }
+    unsigned n = 0;
+    ASSERT_FALSE(em.encode_some(0, num_extents * ext_len, encoded, &n));
+    ASSERT_EQ(num_extents, n);
+  }
+
+  {
+    BlueStore::Onode onode(coll.get(), ghobject_t(), "");
+    ASSERT_EQ(num_extents, onode.extent_map.decode_some(encoded));
+    ASSERT_EQ(num_extents, onode.extent_map.extent_map.size());
+    auto& last = *onode.extent_map.extent_map.rbegin();
+    ASSERT_EQ((num_extents - 1) * ext_len, last.logical_offset);
+    ASSERT_EQ(ext_len, last.length);
+    ASSERT_EQ(ext_len, last.blob->get_referenced_bytes());
+  }
+
+  // decode from a private copy of the value (what fault_range used to do)
+  // and from an in-place view of it (what it does with get_pinned)
+  const int count = 200;
+  for (bool in_place : {false, true}) {
+    BlueStore::Onode onode(coll.get(), ghobject_t(), "");
+    auto start = ceph::mono_clock::now();
+    for (int i = 0; i < count; ++i) {
+      bufferlist v;
+      if (in_place) {
+	v.push_back(buffer::create_static(encoded.length(), encoded.c_str()));
+      } else {
+	v.append(encoded.c_str(), encoded.length());
+      }
+      onode.extent_map.decode_some(v);
+      onode.extent_map.clear();
+    }
+    auto end = ceph::mono_clock::now();
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      end - start).count();
+    cout << (in_place ? "in-place" : "copied") << " decode: "
+	 << encoded.length() << " bytes, " << num_extents << " extents, "
+	 << (double)ns / (count * num_extents) << " ns/extent" << std::endl;
+  }
+}
+
+
 void clear_and_dispose(BlueStore::old_extent_map_t& old_em)
 {
   auto oep = old_em.begin();
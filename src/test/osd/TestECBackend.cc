@@ -17,6 +17,10 @@
 #include <errno.h>
 #include <signal.h>
 #include "osd/ECBackend.h"
+#include "osd/ECPeerLatency.h"
+#include "common/ceph_context.h"
+#include "common/ceph_timer.h"
+#include "common/ceph_mutex.h"
 #include "gtest/gtest.h"
 
 using namespace std;
@@ -60,3 +64,115 @@ TEST(ECUtil, stripe_info_t)
             make_pair((uint64_t)0, 2*swidth));
 }
 
+
+TEST(ECPeerLatency, ewma)
+{
+  using namespace std::chrono_literals;
+  boost::intrusive_ptr<CephContext> cct = new CephContext(CEPH_ENTITY_TYPE_OSD);
+  ECPeerLatency latency(cct.get());
+  ceph::timespan avg, dev;
+
+  ASSERT_FALSE(latency.get(1, &avg, &dev));
+
+  latency.add_sample(1, 8ms);
+  ASSERT_TRUE(latency.get(1, &avg, &dev));
+  ASSERT_EQ(avg, ceph::timespan(8ms));
+  ASSERT_EQ(dev, ceph::timespan(4ms));
+
+  // converges on a steady latency, and the deviation fades away
+  for (int i = 0; i < 100; ++i) {
+    latency.add_sample(1, 2ms);
+  }
+  ASSERT_TRUE(latency.get(1, &avg, &dev));
+  ASSERT_GT(avg, ceph::timespan(2ms));
+  ASSERT_LT(avg, ceph::timespan(2001us));
+  ASSERT_LT(dev, ceph::timespan(1us));
+
+  // a single outlier moves the average by an eighth of the difference
+  latency.add_sample(1, 10ms);
+  ceph::timespan avg2, dev2;
+  ASSERT_TRUE(latency.get(1, &avg2, &dev2));
+  std::chrono::duration<double, std::micro> moved = avg2 - avg;
+  ASSERT_NEAR(moved.count(), 1000, 1);
+  ASSERT_GT(dev2, ceph::timespan(1ms));
+
+  // peers are tracked separately
+  ASSERT_FALSE(latency.get(2, &avg, &dev));
+  latency.hedge_sent(2);
+  latency.hedge_won(2);
+}
+
+TEST(ECPeerLatency, fastest_shard)
+{
+  using namespace std::chrono_literals;
+  boost::intrusive_ptr<CephContext> cct = new CephContext(CEPH_ENTITY_TYPE_OSD);
+  ECPeerLatency latency(cct.get());
+
+  // shard -> osd
+  std::map<int, int> shards = {{0, 10}, {1, 11}, {2, 12}};
+  latency.add_sample(10, 5ms);  // 5ms +- 2.5ms
+  latency.add_sample(11, 2ms);  // 2ms +- 1ms
+  latency.add_sample(12, 4ms);  // 4ms +- 2ms
+
+  ASSERT_EQ(latency.fastest_shard(shards), std::optional<int>(1));
+  ASSERT_EQ(latency.sort_shards(shards, {0, 1, 2}),
+	    std::vector<int>({1, 2, 0}));
+
+  // one not wanted has to beat the wanted ones by its deviation: 4ms + 2ms
+  // doesn't beat the 5ms of osd.10
+  ASSERT_EQ(latency.sort_shards(shards, {0, 1}),
+	    std::vector<int>({1, 0, 2}));
+
+  // a peer never measured goes first, so it gets measured
+  shards[3] = 13;
+  ASSERT_EQ(latency.fastest_shard(shards), std::optional<int>(3));
+  ASSERT_EQ(latency.sort_shards(shards, {0, 1, 2, 3}).front(), 3);
+
+  ASSERT_FALSE(latency.fastest_shard({}));
+}
+
+TEST(ECPeerLatency, hedge)
+{
+  using namespace std::chrono_literals;
+  boost::intrusive_ptr<CephContext> cct = new CephContext(CEPH_ENTITY_TYPE_OSD);
+  ECPeerLatency latency(cct.get());
+
+  latency.add_sample(10, 20ms);  // 20ms +- 10ms
+  latency.add_sample(11, 2ms);
+
+  // nothing to judge lateness by for osd.12
+  ASSERT_FALSE(latency.hedge_delay({10, 11, 12}, 2, 1ms));
+  // waits for the slowest, plus the deviations asked for
+  ASSERT_EQ(latency.hedge_delay({10, 11}, 2, 1ms),
+	    std::optional<ceph::timespan>(40ms));
+  // but never less than the minimum
+  ASSERT_EQ(latency.hedge_delay({11}, 0, 5ms),
+	    std::optional<ceph::timespan>(5ms));
+
+  // the hedged read goes out once the delay has passed, to the fastest
+  // shard that isn't busy already
+  auto delay = latency.hedge_delay({10}, 2, 1ms);
+  ASSERT_TRUE(delay);
+  ceph::mutex lock = ceph::make_mutex("TestECBackend::hedge");
+  std::condition_variable cond;
+  std::optional<int> hedged;
+  ceph::mono_time sent;
+  ceph::timer<ceph::mono_clock> timer;
+  auto scheduled = ceph::mono_clock::now();
+  timer.add_event(*delay, [&] {
+    std::map<int, int> idle = {{1, 11}, {2, 12}};
+    std::lock_guard l{lock};
+    hedged = latency.fastest_shard(idle);
+    latency.hedge_sent(12);
+    sent = ceph::mono_clock::now();
+    cond.notify_all();
+  });
+  {
+    std::unique_lock l{lock};
+    ASSERT_FALSE(hedged);
+    cond.wait_for(l, 10s, [&] { return hedged.has_value(); });
+    // osd.12 was never measured, so it goes first
+    ASSERT_EQ(hedged, std::optional<int>(2));
+  }
+  ASSERT_GE(sent - scheduled, *delay);
+}
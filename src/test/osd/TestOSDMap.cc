@@ -442,6 +442,51 @@ TEST_F(OSDMapTest, CleanTemps) {
 	      !pending_inc.new_primary_temp.count(pgb));
 }
 
+TEST_F(OSDMapTest, DeepishCopyIsIndependent) {
+  set_up_map();
+
+  pg_t pgid = osdmap.raw_pg_to_pg(pg_t(0, my_rep_pool));
+  OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+  inc.fsid = osdmap.get_fsid();
+  inc.new_up_thru[0] = osdmap.get_epoch();
+  inc.new_xinfo[1] = osdmap.get_xinfo(1);
+  inc.new_xinfo[1].laggy_probability = .5;
+  inc.new_pg_temp[pgid] = mempool::osdmap::vector<int>({2, 1, 0});
+  inc.new_primary_temp[pgid] = 2;
+  inc.new_pg_upmap_items[pgid] =
+    mempool::osdmap::vector<pair<int32_t,int32_t>>({{0, 3}});
+  inc.new_primary_affinity[4] = 0;
+
+  OSDMap next;
+  next.deepish_copy_from(osdmap);
+  next.apply_incremental(inc);
+
+  // the changes are only visible in the new epoch...
+  ASSERT_EQ(osdmap.get_epoch(), next.get_up_thru(0));
+  ASSERT_EQ(.5, next.get_xinfo(1).laggy_probability);
+  ASSERT_EQ(1u, next.get_num_pg_temp());
+  ASSERT_TRUE(next.have_pg_upmaps(pgid));
+  ASSERT_EQ(0u, next.get_primary_affinity(4));
+  // ...and the previous one is left alone
+  ASSERT_EQ(0u, osdmap.get_up_thru(0));
+  ASSERT_EQ(0, osdmap.get_xinfo(1).laggy_probability);
+  ASSERT_EQ(0u, osdmap.get_num_pg_temp());
+  ASSERT_FALSE(osdmap.have_pg_upmaps(pgid));
+  ASSERT_EQ(CEPH_OSD_DEFAULT_PRIMARY_AFFINITY,
+	    osdmap.get_primary_affinity(4));
+  ASSERT_EQ(osdmap.get_addrs(0), next.get_addrs(0));
+
+  // decoding into a map sharing structures leaves the other one alone
+  bufferlist bl;
+  osdmap.encode(bl, CEPH_FEATURES_SUPPORTED_DEFAULT | CEPH_FEATURE_RESERVED);
+  OSDMap other;
+  other.deepish_copy_from(next);
+  other.decode(bl);
+  ASSERT_TRUE(next.have_pg_upmaps(pgid));
+  ASSERT_EQ(1u, next.get_num_pg_temp());
+  ASSERT_FALSE(other.have_pg_upmaps(pgid));
+}
+
 TEST_F(OSDMapTest, KeepsNecessaryTemps) {
   set_up_map();
 
@@ -0,0 +1,178 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+/*
+ * Apply a series of incrementals looking like the ones of a large
+ * cluster (OSDs flapping, up_thru updates, pg_temp and upmap churn) to a
+ * synthetic OSDMap, the way OSD::handle_osd_map does, and report the
+ * time it takes and the memory the cached epochs use.
+ */
+
+#include <deque>
+#include <iostream>
+#include <random>
+
+#include "common/Clock.h"
+#include "common/ceph_argparse.h"
+#include "common/common_init.h"
+#include "global/global_init.h"
+#include "include/mempool.h"
+#include "osd/OSDMap.h"
+
+using namespace std;
+
+static void usage(const char *name)
+{
+  cout << name << " [--osds N] [--epochs N] [--cached N]\n"
+       << "\t osds: number of osds in the map (default 10000)\n"
+       << "\t epochs: number of incrementals applied (default 1000)\n"
+       << "\t cached: number of epochs kept around (default 500)\n";
+}
+
+static size_t osdmap_mempool_bytes()
+{
+  return mempool::get_pool(mempool::mempool_osdmap).allocated_bytes();
+}
+
+static entity_addrvec_t make_addrs(int osd, int port)
+{
+  entity_addr_t a;
+  a.set_type(entity_addr_t::TYPE_MSGR2);
+  a.set_family(AF_INET);
+  a.set_port(port);
+  a.set_nonce(osd);
+  return entity_addrvec_t(a);
+}
+
+static void build_map(OSDMap *m, uuid_d fsid, int num_osds)
+{
+  m->build_simple_with_pool(g_ceph_context, 0, fsid, num_osds, 4, 4);
+  OSDMap::Incremental inc(m->get_epoch() + 1);
+  inc.fsid = m->get_fsid();
+  for (int i = 0; i < num_osds; ++i) {
+    uuid_d u;
+    u.generate_random();
+    inc.new_state[i] = CEPH_OSD_EXISTS | CEPH_OSD_NEW;
+    inc.new_up_client[i] = make_addrs(i, 6800);
+    inc.new_up_cluster[i] = make_addrs(i, 6801);
+    inc.new_hb_back_up[i] = make_addrs(i, 6802);
+    inc.new_hb_front_up[i] = make_addrs(i, 6803);
+    inc.new_weight[i] = CEPH_OSD_IN;
+    inc.new_uuid[i] = u;
+  }
+  m->apply_incremental(inc);
+}
+
+static OSDMap::Incremental make_incremental(const OSDMap &m, std::mt19937 &rng)
+{
+  OSDMap::Incremental inc(m.get_epoch() + 1);
+  inc.fsid = m.get_fsid();
+  std::uniform_int_distribution<int> osd(0, m.get_max_osd() - 1);
+  auto pool = m.get_pools().begin();
+  std::uniform_int_distribution<unsigned> ps(0, pool->second.get_pg_num() - 1);
+
+  // a few osds flap
+  for (int i = 0; i < 3; ++i) {
+    int o = osd(rng);
+    if (inc.new_state.count(o)) {
+      continue;
+    }
+    inc.new_state[o] = CEPH_OSD_UP;
+    if (!m.is_up(o)) {
+      inc.new_up_client[o] = make_addrs(o, 6900 + m.get_epoch() % 100);
+      inc.new_up_cluster[o] = make_addrs(o, 6901);
+      inc.new_hb_back_up[o] = make_addrs(o, 6902);
+      inc.new_hb_front_up[o] = make_addrs(o, 6903);
+    }
+  }
+  // peering bumps up_thru
+  for (int i = 0; i < 20; ++i) {
+    inc.new_up_thru[osd(rng)] = m.get_epoch();
+  }
+  // backfill comes and goes
+  for (int i = 0; i < 10; ++i) {
+    pg_t pgid(ps(rng), pool->first);
+    if (m.get_num_pg_temp() > 500 && i % 2) {
+      inc.new_pg_temp[pgid];
+    } else {
+      inc.new_pg_temp[pgid] = {osd(rng), osd(rng), osd(rng)};
+    }
+  }
+  // the balancer moves a few pgs
+  for (int i = 0; i < 5; ++i) {
+    inc.new_pg_upmap_items[pg_t(ps(rng), pool->first)] = {{osd(rng), osd(rng)}};
+  }
+  return inc;
+}
+
+int main(int argc, const char **argv)
+{
+  auto args = argv_to_vec(argc, argv);
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_OSD,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+
+  int num_osds = 10000;
+  unsigned epochs = 1000;
+  unsigned cached = 500;
+  std::string val;
+  for (auto i = args.begin(); i != args.end(); ) {
+    if (ceph_argparse_double_dash(args, i)) {
+      break;
+    } else if (ceph_argparse_witharg(args, i, &val, "--osds", (char*)NULL)) {
+      num_osds = std::stoi(val);
+    } else if (ceph_argparse_witharg(args, i, &val, "--epochs", (char*)NULL)) {
+      epochs = std::stoul(val);
+    } else if (ceph_argparse_witharg(args, i, &val, "--cached", (char*)NULL)) {
+      cached = std::stoul(val);
+    } else {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (num_osds <= 0 || cached == 0) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  uuid_d fsid;
+  fsid.generate_random();
+  std::vector<OSDMap::Incremental> incs;
+  {
+    OSDMap m;
+    build_map(&m, fsid, num_osds);
+    std::mt19937 rng(42);
+    for (unsigned i = 0; i < epochs; ++i) {
+      incs.push_back(make_incremental(m, rng));
+      m.apply_incremental(incs.back());
+    }
+  }
+
+  size_t before = osdmap_mempool_bytes();
+  std::deque<std::shared_ptr<OSDMap>> maps;
+  maps.push_back(std::make_shared<OSDMap>());
+  build_map(maps.back().get(), fsid, num_osds);
+  size_t full = osdmap_mempool_bytes() - before;
+
+  utime_t start = ceph_clock_now();
+  for (auto& inc : incs) {
+    auto o = std::make_shared<OSDMap>();
+    o->deepish_copy_from(*maps.back());
+    o->apply_incremental(inc);
+    maps.push_back(o);
+    if (maps.size() > cached) {
+      maps.pop_front();
+    }
+  }
+  utime_t elapsed = ceph_clock_now() - start;
+  size_t bytes = osdmap_mempool_bytes() - before;
+
+  cout << "# " << num_osds << " osds, " << epochs << " epochs, "
+       << maps.size() << " cached" << std::endl;
+  cout << "usec/incremental\t"
+       << (double)elapsed * 1000000 / (double)epochs << std::endl;
+  cout << "bytes/full map\t" << full << std::endl;
+  cout << "bytes/cached epoch\t" << bytes / maps.size() << std::endl;
+  return 0;
+}
@@ -122,3 +122,60 @@ TEST(ectransaction, many_writes)
   ASSERT_EQ(0u, plan.to_read.size());
   ASSERT_EQ(1u, plan.will_write.size());
 }
+
+TEST(ectransaction, parity_delta_plan)
+{
+  hobject_t h;
+  // k=4, 4096 byte chunks
+  ECUtil::stripe_info_t sinfo(4, 16384);
+  auto get_hinfo = [&](const hobject_t &i) {
+    ECUtil::HashInfoRef ref(new ECUtil::HashInfo(6));
+    ref->set_projected_total_logical_size(sinfo, 65536);
+    return ref;
+  };
+
+  {
+    // a small overwrite only touches one chunk
+    PGTransactionUPtr t(new PGTransaction);
+    bufferlist a;
+    a.append_zero(512);
+    t->write(h, 16384 + 5000, a.length(), a, 0);
+    auto plan = ECTransaction::get_write_plan(sinfo, *t, get_hinfo, &dpp, 2);
+    generic_derr << "delta_write " << plan.delta_write << dendl;
+    ASSERT_EQ(1u, plan.to_read.size());
+    ASSERT_EQ(1u, plan.delta_write.size());
+    ASSERT_EQ(4096u, plan.delta_write[h].size());
+    ASSERT_TRUE(plan.delta_write[h].contains(16384 + 4096, 4096));
+  }
+
+  {
+    // most of a stripe: rewriting it is cheaper
+    PGTransactionUPtr t(new PGTransaction);
+    bufferlist a;
+    a.append_zero(16000);
+    t->write(h, 100, a.length(), a, 0);
+    auto plan = ECTransaction::get_write_plan(sinfo, *t, get_hinfo, &dpp, 2);
+    ASSERT_EQ(1u, plan.to_read.size());
+    ASSERT_EQ(0u, plan.delta_write.size());
+  }
+
+  {
+    // appends can't be done in place
+    PGTransactionUPtr t(new PGTransaction);
+    bufferlist a;
+    a.append_zero(512);
+    t->write(h, 65536 - 256, a.length(), a, 0);
+    auto plan = ECTransaction::get_write_plan(sinfo, *t, get_hinfo, &dpp, 2);
+    ASSERT_EQ(0u, plan.delta_write.size());
+  }
+
+  {
+    // not asked for
+    PGTransactionUPtr t(new PGTransaction);
+    bufferlist a;
+    a.append_zero(512);
+    t->write(h, 16384 + 5000, a.length(), a, 0);
+    auto plan = ECTransaction::get_write_plan(sinfo, *t, get_hinfo, &dpp);
+    ASSERT_EQ(0u, plan.delta_write.size());
+  }
+}
@@ -0,0 +1,152 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <gtest/gtest.h>
+#include "osd/ReadCoalescer.h"
+
+using namespace std;
+using namespace std::chrono_literals;
+
+static hobject_t make_oid(const string &name)
+{
+  return hobject_t(object_t(name), "", CEPH_NOSNAP, 0, 1, "");
+}
+
+static bufferlist make_data(uint64_t len, char c)
+{
+  bufferlist bl;
+  bl.append(string(len, c));
+  return bl;
+}
+
+TEST(ReadCoalescer, disabled)
+{
+  ReadCoalescer rc;
+  auto now = ceph::mono_clock::now();
+  hobject_t oid = make_oid("foo");
+  rc.insert(oid, eversion_t(1, 1), 0, make_data(4096, 'a'), now);
+  bufferlist out;
+  ASSERT_FALSE(rc.lookup(oid, eversion_t(1, 1), 0, 4096, &out, now));
+  ASSERT_EQ(0u, rc.get_bytes());
+}
+
+TEST(ReadCoalescer, zero_copy)
+{
+  ReadCoalescer rc;
+  rc.set_limits(1 << 20, 100ms);
+  auto now = ceph::mono_clock::now();
+  hobject_t oid = make_oid("foo");
+  bufferlist data;
+  data.append(make_data(4096, 'a'));
+  data.append(make_data(4096, 'b'));
+  rc.insert(oid, eversion_t(1, 1), 8192, data, now);
+
+  bufferlist out;
+  ASSERT_TRUE(rc.lookup(oid, eversion_t(1, 1), 8192, 8192, &out, now));
+  ASSERT_TRUE(out.contents_equal(data));
+  ASSERT_EQ(data.front().c_str(), out.front().c_str());
+
+  // within the extent
+  bufferlist part;
+  ASSERT_TRUE(rc.lookup(oid, eversion_t(1, 1), 12000, 1000, &part, now));
+  ASSERT_EQ(string(288, 'a') + string(712, 'b'), part.to_str());
+
+  // sticking out of it, before or after it
+  bufferlist miss;
+  ASSERT_FALSE(rc.lookup(oid, eversion_t(1, 1), 4096, 8192, &miss, now));
+  ASSERT_FALSE(rc.lookup(oid, eversion_t(1, 1), 12288, 8192, &miss, now));
+  ASSERT_FALSE(rc.lookup(make_oid("bar"), eversion_t(1, 1), 8192, 1, &miss,
+			 now));
+  ASSERT_EQ(0u, miss.length());
+}
+
+TEST(ReadCoalescer, version)
+{
+  ReadCoalescer rc;
+  rc.set_limits(1 << 20, 100ms);
+  auto now = ceph::mono_clock::now();
+  hobject_t oid = make_oid("foo");
+  rc.insert(oid, eversion_t(1, 1), 0, make_data(4096, 'a'), now);
+
+  bufferlist out;
+  ASSERT_FALSE(rc.lookup(oid, eversion_t(1, 2), 0, 4096, &out, now));
+  // the stale data is gone
+  ASSERT_EQ(0u, rc.get_bytes());
+  ASSERT_FALSE(rc.lookup(oid, eversion_t(1, 1), 0, 4096, &out, now));
+
+  rc.insert(oid, eversion_t(1, 2), 0, make_data(4096, 'b'), now);
+  rc.insert(oid, eversion_t(1, 3), 0, make_data(2048, 'c'), now);
+  ASSERT_EQ(2048u, rc.get_bytes());
+  ASSERT_TRUE(rc.lookup(oid, eversion_t(1, 3), 0, 2048, &out, now));
+  ASSERT_EQ(string(2048, 'c'), out.to_str());
+
+  rc.invalidate(oid);
+  ASSERT_EQ(0u, rc.get_bytes());
+  ASSERT_EQ(0u, rc.get_num_objects());
+}
+
+TEST(ReadCoalescer, window)
+{
+  ReadCoalescer rc;
+  rc.set_limits(1 << 20, 100ms);
+  auto now = ceph::mono_clock::now();
+  hobject_t oid = make_oid("foo");
+  rc.insert(oid, eversion_t(1, 1), 0, make_data(4096, 'a'), now);
+
+  bufferlist out;
+  ASSERT_TRUE(rc.lookup(oid, eversion_t(1, 1), 0, 4096, &out, now + 50ms));
+  ASSERT_FALSE(rc.lookup(oid, eversion_t(1, 1), 0, 4096, &out, now + 150ms));
+  ASSERT_EQ(0u, rc.get_bytes());
+
+  // expired objects are dropped as others are read
+  rc.insert(oid, eversion_t(1, 1), 0, make_data(4096, 'a'), now);
+  rc.insert(make_oid("bar"), eversion_t(1, 1), 0, make_data(4096, 'b'),
+	    now + 150ms);
+  ASSERT_EQ(1u, rc.get_num_objects());
+  ASSERT_EQ(4096u, rc.get_bytes());
+}
+
+TEST(ReadCoalescer, overlap)
+{
+  ReadCoalescer rc;
+  rc.set_limits(1 << 20, 100ms);
+  auto now = ceph::mono_clock::now();
+  hobject_t oid = make_oid("foo");
+  rc.insert(oid, eversion_t(1, 1), 4096, make_data(4096, 'a'), now);
+  rc.insert(oid, eversion_t(1, 1), 16384, make_data(4096, 'a'), now);
+  ASSERT_EQ(8192u, rc.get_bytes());
+  // covers both
+  rc.insert(oid, eversion_t(1, 1), 0, make_data(32768, 'a'), now);
+  ASSERT_EQ(32768u, rc.get_bytes());
+  // covered by it
+  rc.insert(oid, eversion_t(1, 1), 0, make_data(4096, 'a'), now);
+  ASSERT_EQ(32768u, rc.get_bytes());
+  bufferlist out;
+  ASSERT_TRUE(rc.lookup(oid, eversion_t(1, 1), 20000, 10000, &out, now));
+}
+
+TEST(ReadCoalescer, max_bytes)
+{
+  ReadCoalescer rc;
+  rc.set_limits(16384, 100ms);
+  auto now = ceph::mono_clock::now();
+  rc.insert(make_oid("a"), eversion_t(1, 1), 0, make_data(8192, 'a'), now);
+  rc.insert(make_oid("b"), eversion_t(1, 1), 0, make_data(8192, 'b'), now);
+  bufferlist out;
+  // a becomes the most recently read
+  ASSERT_TRUE(rc.lookup(make_oid("a"), eversion_t(1, 1), 0, 1, &out, now));
+  rc.insert(make_oid("c"), eversion_t(1, 1), 0, make_data(8192, 'c'), now);
+  ASSERT_EQ(16384u, rc.get_bytes());
+  ASSERT_TRUE(rc.lookup(make_oid("a"), eversion_t(1, 1), 0, 1, &out, now));
+  ASSERT_FALSE(rc.lookup(make_oid("b"), eversion_t(1, 1), 0, 1, &out, now));
+
+  // too large to keep at all
+  rc.insert(make_oid("d"), eversion_t(1, 1), 0, make_data(32768, 'd'), now);
+  ASSERT_EQ(16384u, rc.get_bytes());
+
+  rc.set_limits(8192, 100ms);
+  ASSERT_EQ(8192u, rc.get_bytes());
+  rc.clear();
+  ASSERT_EQ(0u, rc.get_bytes());
+  ASSERT_EQ(0u, rc.get_num_objects());
+}
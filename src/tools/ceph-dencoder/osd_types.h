@@ -33,6 +33,8 @@ TYPE_FEATUREFUL(pg_missing_item)
 TYPE_FEATUREFUL(pg_missing_t)
 TYPE(pg_nls_response_t)
 TYPE(pg_ls_response_t)
+TYPE(osd_batch_op_t)
+TYPE(osd_batch_result_t)
 TYPE(object_copy_cursor_t)
 TYPE_FEATUREFUL(object_copy_data_t)
 TYPE(pg_create_t)
@@ -101,6 +103,7 @@ TYPE(bluestore_deferred_transaction_t)
 #include "os/bluestore/bluefs_types.h"
 TYPE(bluefs_extent_t)
 TYPE(bluefs_fnode_t)
+TYPE(bluefs_wal_ring_header_t)
 TYPE(bluefs_super_t)
 TYPE(bluefs_transaction_t)
 #endif
@@ -120,11 +120,11 @@ void usage(ostream& out)
 "   rollback <obj-name> <snap-name>  roll back object to snap <snap-name>\n"
 "\n"
 "   listsnaps <obj-name>             list the snapshots of this object\n"
-"   bench <seconds> write|seq|rand [-t concurrent_operations] [--no-cleanup] [--run-name run_name] [--no-hints] [--reuse-bench]\n"
+"   bench <seconds> write|seq|rand [-t concurrent_operations] [--no-cleanup] [--run-name run_name] [--no-hints] [--reuse-bench] [--batch N]\n"
 "                                    default is 16 concurrent IOs and 4 MB ops\n"
 "                                    default is to clean up after write benchmark\n"
 "                                    default run-name is 'benchmark_last_metadata'\n"
-"   cleanup [--run-name run_name] [--prefix prefix]\n"
+"   cleanup [--run-name run_name] [--prefix prefix] [--batch N]\n"
 "                                    clean up a previous benchmark operation\n"
 "                                    default run-name is 'benchmark_last_metadata'\n"
 "   load-gen [options]               generate load on the cluster\n"
@@ -241,6 +241,9 @@ void usage(ostream& out)
 "        prefix output with date/time\n"
 "   --no-verify\n"
 "        do not verify contents of read objects\n"
+"   --batch=N\n"
+"        stripe each object over N objects, and access them with\n"
+"        one batched operation per placement group\n"
 "   --write-object\n"
 "        write contents to the objects\n"
 "   --write-omap\n"
@@ -1066,9 +1069,38 @@ class RadosBencher : public ObjBencher {
   bool iterator_valid;
   OpWriteDest write_destination;
 
+  // with a batch size, each object of the benchmark is striped over that
+  // many rados objects, which a single batch op per pg accesses
+  unsigned batch_size = 1;
+  std::vector<std::vector<int>> batch_results;
+  struct batch_read_t {
+    std::vector<bufferlist> pieces;
+    bufferlist *pbl = nullptr;
+  };
+  std::vector<batch_read_t> batch_reads;
+
+  static std::string batch_oid(const std::string& oid, unsigned i) {
+    return i ? oid + "@" + stringify(i) : oid;
+  }
+  bool is_batched(const std::string& oid) const {
+    return batch_size > 1 && oid.find('@') == std::string::npos;
+  }
+  void finish_batch_read(int slot) {
+    auto& r = batch_reads[slot];
+    if (r.pbl) {
+      r.pbl->clear();
+      for (auto& piece : r.pieces) {
+	r.pbl->claim_append(piece);
+      }
+      r.pbl = nullptr;
+    }
+  }
+
 protected:
   int completions_init(int concurrentios) override {
     completions = new librados::AioCompletion *[concurrentios];
+    batch_results.assign(concurrentios, {});
+    batch_reads.assign(concurrentios, {});
     return 0;
   }
   void completions_done() override {
@@ -1090,13 +1122,46 @@ protected:
 
   int aio_read(const std::string& oid, int slot, bufferlist *pbl, size_t len,
 	       size_t offset) override {
-    return io_ctx.aio_read(oid, completions[slot], pbl, len, offset);
+    batch_results[slot].clear();
+    if (!is_batched(oid)) {
+      return io_ctx.aio_read(oid, completions[slot], pbl, len, offset);
+    }
+    auto& r = batch_reads[slot];
+    r.pieces.assign(batch_size, {});
+    r.pbl = pbl;
+    std::vector<librados::ObjectReadOperation> ops(batch_size);
+    std::vector<std::pair<std::string, librados::ObjectReadOperation*>> batch;
+    for (unsigned i = 0; i < batch_size; ++i) {
+      ops[i].read(offset / batch_size, len / batch_size, &r.pieces[i], nullptr);
+      batch.emplace_back(batch_oid(oid, i), &ops[i]);
+    }
+    return io_ctx.aio_operate_batch(completions[slot], batch,
+				    &batch_results[slot], 0);
   }
 
   int aio_write(const std::string& oid, int slot, bufferlist& bl, size_t len,
 		size_t offset) override {
-    librados::ObjectWriteOperation op;
-
+    batch_results[slot].clear();
+    if (!is_batched(oid)) {
+      librados::ObjectWriteOperation op;
+      prepare_write(op, bl, offset);
+      return io_ctx.aio_operate(oid, completions[slot], &op);
+    }
+    const size_t piece = len / batch_size;
+    std::vector<librados::ObjectWriteOperation> ops(batch_size);
+    std::vector<std::pair<std::string, librados::ObjectWriteOperation*>> batch;
+    for (unsigned i = 0; i < batch_size; ++i) {
+      bufferlist p;
+      p.substr_of(bl, i * piece, piece);
+      prepare_write(ops[i], p, offset / batch_size);
+      batch.emplace_back(batch_oid(oid, i), &ops[i]);
+    }
+    return io_ctx.aio_operate_batch(completions[slot], batch,
+				    &batch_results[slot], 0);
+  }
+
+  void prepare_write(librados::ObjectWriteOperation& op, bufferlist& bl,
+		     size_t offset) {
     if (write_destination & OP_WRITE_DEST_OBJ) {
       if (data.hints)
 	op.set_alloc_hint2(data.object_size, data.op_size,
@@ -1118,12 +1183,21 @@ protected:
       snprintf(key, sizeof(key), "bench-xattr-key-%d", (int)offset);
       op.setxattr(key, bl);
     }
-
-    return io_ctx.aio_operate(oid, completions[slot], &op);
   }
 
   int aio_remove(const std::string& oid, int slot) override {
-    return io_ctx.aio_remove(oid, completions[slot]);
+    batch_results[slot].clear();
+    if (!is_batched(oid)) {
+      return io_ctx.aio_remove(oid, completions[slot]);
+    }
+    std::vector<librados::ObjectWriteOperation> ops(batch_size);
+    std::vector<std::pair<std::string, librados::ObjectWriteOperation*>> batch;
+    for (unsigned i = 0; i < batch_size; ++i) {
+      ops[i].remove();
+      batch.emplace_back(batch_oid(oid, i), &ops[i]);
+    }
+    return io_ctx.aio_operate_batch(completions[slot], batch,
+				    &batch_results[slot], 0);
   }
 
   int sync_read(const std::string& oid, bufferlist& bl, size_t len) override {
@@ -1138,14 +1212,29 @@ protected:
   }
 
   bool completion_is_done(int slot) override {
-    return completions[slot] && completions[slot]->is_complete();
+    if (completions[slot] && completions[slot]->is_complete()) {
+      finish_batch_read(slot);
+      return true;
+    }
+    return false;
   }
 
   int completion_wait(int slot) override {
-    return completions[slot]->wait_for_complete_and_cb();
+    int r = completions[slot]->wait_for_complete_and_cb();
+    finish_batch_read(slot);
+    return r;
   }
   int completion_ret(int slot) override {
-    return completions[slot]->get_return_value();
+    int r = completions[slot]->get_return_value();
+    if (r >= 0) {
+      // the first object of the batch which failed, if any
+      for (int br : batch_results[slot]) {
+	if (br < 0) {
+	  return br;
+	}
+      }
+    }
+    return r;
   }
 
   bool get_objects(std::list<Object>* objects, int num) override {
@@ -1185,6 +1274,9 @@ public:
   void set_write_destination(OpWriteDest dest) {
     write_destination = dest;
   }
+  void set_batch_size(unsigned n) {
+    batch_size = n;
+  }
 };
 
 static int do_lock_cmd(std::vector<const char*> &nargs,
@@ -1878,6 +1970,7 @@ static int rados_tool_common(const std::map < std::string, std::string > &opts,
   unsigned op_size = default_op_size;
   unsigned object_size = 0;
   unsigned max_objects = 0;
+  unsigned batch_size = 1;
   uint64_t obj_offset = 0;
   bool obj_offset_specified = false;
   bool block_size_specified = false;
@@ -2098,6 +2191,12 @@ static int rados_tool_common(const std::map < std::string, std::string > &opts,
   if (i != opts.end()) {
     no_verify = true;
   }
+  i = opts.find("batch");
+  if (i != opts.end()) {
+    if (rados_sistrtoll(i, &batch_size) || batch_size == 0) {
+      return -EINVAL;
+    }
+  }
   i = opts.find("output");
   if (i != opts.end()) {
     output = i->second.c_str();
@@ -3302,9 +3401,14 @@ static int rados_tool_common(const std::map < std::string, std::string > &opts,
            << std::endl;
       return 1;
     }
+    if (operation == OP_WRITE && op_size % batch_size) {
+      cerr << "the op size must be a multiple of --batch" << std::endl;
+      return 1;
+    }
     RadosBencher bencher(g_ceph_context, rados, io_ctx);
     bencher.set_show_time(show_time);
     bencher.set_write_destination(static_cast<OpWriteDest>(bench_write_dest));
+    bencher.set_batch_size(batch_size);
 
     ostream *outstream = NULL;
     if (formatter) {
@@ -3336,6 +3440,7 @@ static int rados_tool_common(const std::map < std::string, std::string > &opts,
     if (wildcard)
       io_ctx.set_namespace(all_nspaces);
     RadosBencher bencher(g_ceph_context, rados, io_ctx);
+    bencher.set_batch_size(batch_size);
     ret = bencher.clean_up(prefix, concurrent_ios, run_name);
     if (ret != 0)
       cerr << "error during cleanup: " << cpp_strerror(ret) << std::endl;
@@ -4110,6 +4215,8 @@ int main(int argc, const char **argv)
       opts["reuse-bench"] = "true";
     } else if (ceph_argparse_flag(args, i, "--no-verify", (char*)NULL)) {
       opts["no-verify"] = "true";
+    } else if (ceph_argparse_witharg(args, i, &val, "--batch", (char*)NULL)) {
+      opts["batch"] = val;
     } else if (ceph_argparse_witharg(args, i, &val, "--run-name", (char*)NULL)) {
       opts["run-name"] = val;
     } else if (ceph_argparse_witharg(args, i, &val, "--prefix", (char*)NULL)) {